@@ -8,18 +8,25 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <functional>
 #include <string>
+#include <vector>
+#ifdef DISTR_MMIO_WITH_MPI
+#include <mpi.h>
+#endif
 #define MM_MAX_LINE_LENGTH 1025
 #define MatrixMarketBanner "%%MatrixMarket"
 #define MM_MAX_TOKEN_LENGTH 64
 
-typedef char MM_typecode[6];
+typedef char MM_typecode[7];
+
+struct Matrix_Metadata;
 
 int required_bytes_index(uint64_t maxval);
 
 char* mm_typecode_to_str(MM_typecode matcode);
 
-int mm_read_banner(FILE* f, MM_typecode* matcode, bool is_bmtx);
+int mm_read_banner(FILE* f, MM_typecode* matcode, bool is_bmtx, Matrix_Metadata* meta = NULL);
 int mm_read_mtx_crd_size(FILE* f, uint64_t* M, uint64_t* N, uint64_t* nz);
 
 int required_bytes_index(uint64_t maxval);
@@ -45,6 +52,8 @@ int required_bytes_index(uint64_t maxval);
 
 #define mm_get_idx_bytes(typecode)  ((uint8_t)((unsigned char)((typecode)[4])))
 #define mm_get_val_bytes(typecode)  ((uint8_t)((unsigned char)((typecode)[5])))
+#define mm_is_compressed(typecode)  (mm_get_idx_bytes(typecode) == MM_IDX_BYTES_COMPRESSED)
+#define mm_get_val_encoding(typecode) ((MM_VAL_ENCODING)((typecode)[6]))
 
 int mm_is_valid(MM_typecode matcode); /* too complex for a macro */
 
@@ -69,8 +78,9 @@ int mm_is_valid(MM_typecode matcode); /* too complex for a macro */
 
 #define mm_set_idx_bytes(typecode, bytes)  ((*typecode)[4]=(char)((uint8_t)(bytes)))
 #define mm_set_val_bytes(typecode, bytes)  ((*typecode)[5]=(char)((uint8_t)(bytes)))
+#define mm_set_val_encoding(typecode, enc) ((*typecode)[6]=(char)(enc))
 
-#define mm_clear_typecode(typecode) ((*typecode)[0]=(*typecode)[1]=(*typecode)[2]=' ',(*typecode)[3]='G',(*typecode)[4]=(*typecode)[5]='0')
+#define mm_clear_typecode(typecode) ((*typecode)[0]=(*typecode)[1]=(*typecode)[2]=' ',(*typecode)[3]='G',(*typecode)[4]=(*typecode)[5]='0',(*typecode)[6]=(char)MM_VAL_ENCODING_FLOAT)
 
 #define mm_initialize_typecode(typecode) mm_clear_typecode(typecode)
 
@@ -84,6 +94,9 @@ int mm_is_valid(MM_typecode matcode); /* too complex for a macro */
 #define MM_UNSUPPORTED_TYPE		  15
 #define MM_LINE_TOO_LONG		    16
 #define MM_COULD_NOT_WRITE_FILE	17
+#define MM_CANCELLED            18
+#define MM_CHECKSUM_MISMATCH    19
+#define MM_INDEX_OUT_OF_RANGE   20
 
 
 /******************** Matrix Market internal definitions ********************
@@ -116,6 +129,25 @@ int mm_is_valid(MM_typecode matcode); /* too complex for a macro */
 #define MM_SKEW_STR		        "skew-symmetric"
 #define MM_PATTERN_STR        "pattern"
 
+/* BMTX values encoding, optional last header token (IEEE float when absent) */
+#define MM_VAL_ENC_FLOAT_STR  "float"
+#define MM_VAL_ENC_HALF_STR   "half"
+#define MM_VAL_ENC_BF16_STR   "bfloat16"
+#define MM_VAL_ENC_INT_STR    "int"
+
+/* BMTX entries order, optional header token after the values encoding (row-major when absent) */
+#define MM_SORT_ROW_MAJOR_STR "row-major"
+#define MM_SORT_COL_MAJOR_STR "col-major"
+#define MM_SORT_MORTON_STR    "morton"
+#define MM_SORT_HILBERT_STR   "hilbert"
+
+/* BMTX files whose header declares 0 index bytes are block-compressed (.cbmtx) */
+#define MM_IDX_BYTES_COMPRESSED 0
+/* Binary array files have no indices, their header declares 255 index bytes */
+#define MM_IDX_BYTES_NONE       255
+#define CBMTX_BLOCK_ENTRIES     65536
+#define CBMTX_CODEC_NONE        0
+
 enum MM_VAL_TYPE
 {
     MM_VAL_TYPE_REAL,
@@ -123,6 +155,76 @@ enum MM_VAL_TYPE
     MM_VAL_TYPE_PATTERN
 };
 
+enum MM_REORDER
+{
+    MM_REORDER_NONE,
+    MM_REORDER_RCM,    // Reverse Cuthill-McKee of A + A^T, reduces the bandwidth
+    MM_REORDER_DEGREE, // Decreasing degree
+    MM_REORDER_HUB     // Hub clustering: vertices with more than the average degree first, original order otherwise
+};
+
+enum MM_SORT_ORDER
+{
+    MM_SORT_ROW_MAJOR,
+    MM_SORT_COL_MAJOR,
+    MM_SORT_MORTON,    // Z-order curve, row bits interleaved above column bits
+    MM_SORT_HILBERT,   // Hilbert curve over the smallest power of two square containing the matrix
+    MM_SORT_NONE       // No known order: binary files without an order token (.sbmtx ones are row-major)
+};
+
+enum MM_VAL_ENCODING
+{
+    MM_VAL_ENCODING_FLOAT,    // IEEE float (4 bytes) or double (8 bytes)
+    MM_VAL_ENCODING_HALF,     // IEEE binary16 (2 bytes)
+    MM_VAL_ENCODING_BFLOAT16, // bfloat16 (2 bytes)
+    MM_VAL_ENCODING_INTEGER   // Signed integer (1, 2, 4 or 8 bytes)
+};
+
+#define MM_ROW_LENGTH_BUCKETS 64
+#define MM_STRUCTURE_COMMENT  "%%MMIO-structure" // Header line of binary files persisting Distr_MMIO_Structure
+
+/*
+ * Structural statistics of a loaded matrix (after symmetric expansion), collected while building the CSR.
+ * Bucket 0 of the histogram counts the empty rows, bucket b > 0 the rows with length in [2^(b-1), 2^b)
+ * (the last bucket also holds all the longer rows).
+ */
+struct Distr_MMIO_Structure
+{
+    bool valid = false;
+    uint64_t nrows, ncols, nnz;
+    uint64_t empty_rows;
+    uint64_t max_row_length;
+    double avg_row_length;
+    uint64_t row_length_histogram[MM_ROW_LENGTH_BUCKETS];
+    uint64_t bandwidth;  // max |i - j|
+    uint64_t profile;    // Sum over the rows of i - (first column of row i), for rows starting left of the diagonal
+    uint64_t diagonal;   // Entries with i == j
+    uint64_t duplicates; // Entries with the same (i, j) of another entry, not counting the first one
+};
+
+// Reducer applied to the values of the entries with the same coordinates
+enum MM_DUPLICATES
+{
+    MM_DUPLICATES_KEEP,  // No merge, all the entries are kept (default)
+    MM_DUPLICATES_SUM,
+    MM_DUPLICATES_MIN,
+    MM_DUPLICATES_MAX,
+    MM_DUPLICATES_FIRST, // In file order (after symmetric expansion, mirrors follow the stored entries)
+    MM_DUPLICATES_LAST
+};
+
+/*
+ * Canonical form of CSR and sorted COO reads. Entries are merged while sorted, then explicit zeros (after the merge,
+ * pattern entries have value 1) and diagonal entries are dropped if requested. The nnz of the result shrinks
+ * accordingly and its arrays are allocated with the exact size.
+ */
+struct Distr_MMIO_Canonical
+{
+    MM_DUPLICATES duplicates = MM_DUPLICATES_KEEP;
+    bool drop_zeros = false;
+    bool drop_diagonal = false;
+};
+
 struct Matrix_Metadata
 {
     MM_VAL_TYPE val_type;
@@ -130,8 +232,136 @@ struct Matrix_Metadata
     std::string mm_header;
     std::string mm_header_body;
     uint8_t val_bytes;
+    MM_VAL_ENCODING val_encoding = MM_VAL_ENCODING_FLOAT; // Used for binary files only
+    MM_SORT_ORDER sort_order = MM_SORT_ROW_MAJOR;         // Order of the entries of binary files (MM_SORT_NONE if not sorted)
+    uint64_t nrows = 0;
+    uint64_t ncols = 0;
+    uint64_t nnz = 0;          // Entries stored in the file (values for arrays)
+    uint64_t expanded_nnz = 0; // Entries after symmetric expansion (upper bound when probed)
+    bool is_array = false;     // Dense "array" file, see Dense_local
+    bool collect_structure = false;  // Set before a CSR read to get the statistics below
+    Distr_MMIO_Structure structure;  // Filled by CSR reads with collect_structure, or from the header of binary files
+    Distr_MMIO_Canonical canonical;  // Set before a CSR or sorted COO read to merge/drop entries
+};
+
+/********************* Memory allocation ***************************/
+
+#define MM_ALLOC_ALIGNMENT 64
+#define MM_HUGE_PAGE_SIZE  (2UL * 1024 * 1024)
+
+enum MM_ALLOCATOR
+{
+    MM_ALLOCATOR_MALLOC,    // Plain malloc (default)
+    MM_ALLOCATOR_ALIGNED,   // 64 bytes aligned
+    MM_ALLOCATOR_HUGE_PAGES // 2MB aligned with transparent huge pages advice (64 bytes aligned if smaller)
+};
+
+/*
+ * Allocator used by every allocation of the library (matrices, parsing and I/O buffers).
+ * Memory allocated with an allocator must be released while the same allocator is set.
+ * When first_touch is set, allocations are zero-filled in parallel with the same static
+ * partition used to fill the arrays, so pages are placed on the NUMA node using them.
+ */
+struct Distr_MMIO_Allocator
+{
+    void* (*alloc)(size_t bytes, void* ctx);
+    void (*free)(void* ptr, void* ctx);
+    void* ctx;
+    bool first_touch;
+};
+
+Distr_MMIO_Allocator Distr_MMIO_builtin_allocator(MM_ALLOCATOR kind, bool first_touch = false);
+void Distr_MMIO_set_allocator(const Distr_MMIO_Allocator* allocator); // NULL restores the default one
+Distr_MMIO_Allocator Distr_MMIO_get_allocator(); // The one used by the calling thread
+/*
+ * Overrides the allocator for the calling thread only (NULL removes the override), e.g. for the duration of
+ * a call while other threads keep using theirs. The allocator is not copied and must outlive the override.
+ * Returns the previous override of the thread, to be restored afterwards.
+ */
+const Distr_MMIO_Allocator* Distr_MMIO_set_thread_allocator(const Distr_MMIO_Allocator* allocator);
+
+void* mm_alloc(size_t bytes);
+void mm_free(void* ptr);
+
+/********************* I/O sources ***************************/
+
+#define MM_SOURCE_UNKNOWN_SIZE UINT64_MAX
+
+/*
+ * Byte source the parser reads from. Sources whose contents are in memory expose them in data and are parsed
+ * without copies; seekable ones provide pread (thread safe, used to read large blocks in parallel and to skip
+ * data); the others are read sequentially with read, so pipes and sockets work too. Callbacks return the number
+ * of bytes read, 0 at the end of the source and a negative value on errors.
+ */
+struct Distr_MMIO_Source
+{
+    int64_t (*read)(void* ctx, void* buf, uint64_t bytes);
+    int64_t (*pread)(void* ctx, void* buf, uint64_t bytes, uint64_t offset);
+    void (*close)(void* ctx);
+    void* ctx;
+    const uint8_t* data;
+    uint64_t size; // MM_SOURCE_UNKNOWN_SIZE for streams
+};
+
+// Each function returns 0 on success or a MM_* error code; sources must be released with Distr_MMIO_source_close
+int Distr_MMIO_source_memory(const void* data, uint64_t size, Distr_MMIO_Source* src); // The buffer is not copied
+int Distr_MMIO_source_fd(int fd, bool close_fd, Distr_MMIO_Source* src); // pread for regular files, read otherwise
+int Distr_MMIO_source_mmap(const char* filename, Distr_MMIO_Source* src);
+int Distr_MMIO_source_file(const char* filename, Distr_MMIO_Source* src);  // Opens the file with Distr_MMIO_source_fd
+int Distr_MMIO_source_stream(FILE* f, Distr_MMIO_Source* src);             // From the current position, f is not closed
+void Distr_MMIO_source_close(Distr_MMIO_Source* src);
+
+/********************* Read/write statistics ***************************/
+
+enum MM_PHASE
+{
+    MM_PHASE_BANNER,              // Banner (header line and comments) read or written
+    MM_PHASE_SIZE_LINE,
+    MM_PHASE_DATA_IO,             // File reads/writes, including text printing which is interleaved with them
+    MM_PHASE_DECODE,              // Text, binary and compressed entries decoding
+    MM_PHASE_SYMMETRIC_EXPANSION,
+    MM_PHASE_SORT,
+    MM_PHASE_ASSEMBLY,            // Output structure allocation and fill
+    MM_PHASE_ENCODE,              // Compressed blocks encoding
+    MM_PHASE_FREE,                // Release of the temporary buffers
+    MM_PHASE_REORDER,             // Permutation computation (or load) and relabeling
+    MM_PHASE_CANONICALIZATION,    // Merge of duplicates and removal of zeros/diagonal (sort excluded)
+    MM_PHASE_COUNT
 };
 
+/*
+ * Filled by every read and write function called by a thread after Distr_MMIO_set_stats (previous values are overwritten).
+ */
+struct Distr_MMIO_Stats
+{
+    double phase_seconds[MM_PHASE_COUNT];
+    double total_seconds;
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+    uint64_t peak_bytes_allocated; // Through mm_alloc, including the returned matrix
+    uint64_t entries;              // Entries of the matrix read or written
+    int threads;                   // OpenMP threads available to the call
+    double gb_per_s;               // (bytes_read + bytes_written) / total_seconds
+    double entries_per_s;
+};
+
+/*
+ * Called periodically while reading, decoding and writing the entries (done out of total, in the unit of the phase).
+ * Returning false cancels the operation, which then fails with MM_CANCELLED.
+ */
+typedef bool (*Distr_MMIO_Progress_Callback)(MM_PHASE phase, uint64_t done, uint64_t total, void* ctx);
+
+// Both settings are per thread, NULL disables them
+void Distr_MMIO_set_stats(Distr_MMIO_Stats* stats);
+Distr_MMIO_Stats* Distr_MMIO_get_stats();
+void Distr_MMIO_set_progress_callback(Distr_MMIO_Progress_Callback callback, void* ctx);
+
+// Error code (MM_*) of the last matrix read of the calling thread, 0 if it succeeded. Readers that fail return NULL,
+// the code tells why: the file could not be opened (MM_COULD_NOT_READ_FILE) or parsed (MM_PREMATURE_EOF, MM_UNSUPPORTED_TYPE...)
+int Distr_MMIO_last_error();
+
+const char* Distr_MMIO_phase_name(MM_PHASE phase);
+
 /*  high level routines */
 
 template <typename IT, typename VT>
@@ -142,28 +372,122 @@ struct Entry
     VT val;
 }; // For parsing
 
-template <typename IT, typename VT>
+// OT is the type of nnz and offsets, it can be wider than IT for matrices with many entries
+template <typename IT, typename VT, typename OT = IT>
 struct CSR_local
 {
     IT nrows;
     IT ncols;
-    IT nnz;
-    IT* row_ptr;
+    OT nnz;
+    OT* row_ptr;
     IT* col_idx;
     VT* val;
 };
 
-template <typename IT, typename VT>
+template <typename IT, typename VT, typename OT = IT>
 struct COO_local
 {
     IT nrows;
     IT ncols;
-    IT nnz;
+    OT nnz;
     IT* row;
     IT* col;
     VT* val;
 };
 
+/*
+ * SELL-C-sigma: rows are sorted by decreasing length inside windows of sigma rows and grouped in
+ * chunks of C rows. Each chunk is stored column-major and padded to its longest row: element j of
+ * the r-th row of chunk c is at chunk_ptr[c] + j * C + r (padding has val 0 and a valid column).
+ * val is always allocated (pattern entries are 1). Arrays are 64 bytes aligned.
+ */
+template <typename IT, typename VT, typename OT = IT>
+struct SELL_local
+{
+    IT nrows;
+    IT ncols;
+    OT nnz;         // Entries, without padding
+    IT C;
+    IT sigma;
+    IT nchunks;
+    OT* chunk_ptr;  // nchunks + 1 offsets in col_idx/val
+    IT* chunk_len;  // Width of each chunk
+    IT* row_perm;   // Original row of the r-th sorted row (nrows)
+    IT* col_idx;
+    VT* val;
+};
+
+/*
+ * Block CSR with square dense blocks of block_size x block_size, stored row-major. Missing entries
+ * inside a block are 0. Arrays are 64 bytes aligned.
+ */
+template <typename IT, typename VT, typename OT = IT>
+struct BSR_local
+{
+    IT nrows;
+    IT ncols;
+    OT nnz;            // Entries, without padding
+    IT block_size;
+    IT nblock_rows;
+    IT nblock_cols;
+    OT nblocks;
+    OT* block_row_ptr; // nblock_rows + 1
+    IT* block_col_idx; // nblocks
+    VT* val;           // nblocks * block_size * block_size
+};
+
+/*
+ * Dense matrix stored column-major (val[j * nrows + i]) or row-major (val[i * ncols + j]). val is 64 bytes aligned,
+ * or points into the file when the matrix is mapped (mapping is then set and released by the destroy function).
+ */
+template <typename IT, typename VT>
+struct Dense_local
+{
+    IT nrows;
+    IT ncols;
+    bool row_major;
+    VT* val;
+    void* mapping;
+    uint64_t mapping_bytes;
+};
+
+/*
+ * Read-only view of a row-major sorted binary file, mapped and decoded row by row on access (see
+ * Distr_MMIO_CSR_view_open). row_ptr holds nrows + 1 entry offsets, mapped from the row index file (index_mapping
+ * set) or allocated when the index is not persisted.
+ */
+template <typename IT, typename VT, typename OT = IT>
+struct CSR_view
+{
+    IT nrows;
+    IT ncols;
+    OT nnz;
+    const uint64_t* row_ptr;
+    const uint8_t* data;         // First entry, entries are <row> <col> [<val>] with idx_bytes indices
+    uint8_t idx_bytes;
+    uint8_t val_bytes;           // 0 for pattern files
+    MM_VAL_ENCODING val_encoding;
+    void* mapping;
+    uint64_t mapping_bytes;
+    void* index_mapping;
+    uint64_t index_mapping_bytes;
+};
+
+/*
+ * Compressed BMTX (.cbmtx) block index entry. Entries are stored row-major sorted
+ * and split in blocks of CBMTX_BLOCK_ENTRIES entries that can be decoded independently.
+ * Inside a block rows are run-length encoded and columns are delta + varint encoded.
+ */
+struct CBMTX_Block_Info
+{
+    uint64_t first_row;
+    uint64_t last_row;
+    uint64_t first_entry;
+    uint64_t nnz;
+    uint64_t offset; // From the end of the block index
+    uint64_t size;   // In bytes
+};
+
 int mm_write_mtx_crd(char fname[], int M, int N, int nz, int I[], int J[], double val[], MM_typecode matcode);
 
 template <typename IT, typename VT>
@@ -181,62 +505,419 @@ bool is_file_extension_bmtx(std::string filename);
 // Entry<IT, VT>* mm_parse_file(FILE *f, IT &nrows, IT &ncols, IT &nnz, MM_typecode *matcode);
 bool is_file_extension_sbmtx(std::string filename);
 
-template <typename IT, typename VT>
-int write_binary_matrix_market(FILE* f, COO_local<IT, VT>* coo, Matrix_Metadata* meta);
+bool is_file_extension_cbmtx(std::string filename);
+
+bool is_file_extension_metis(std::string filename); // .graph, .metis
+bool is_file_extension_graph(std::string filename); // METIS or edge list (.txt, .tsv, .csv, .el, .edges, .snap)
+
+// Temporary file next to filename (-1 on failure), renamed over it by mm_replace_file once written (fd is not closed)
+int mm_create_temp(const char* filename, unsigned mode, std::string* tmp_filename);
+int mm_replace_file(int fd, const std::string& tmp_filename, const char* filename);
+
+// The header records sort_order (not meta->sort_order), which must be the order of the entries of coo
+template <typename IT, typename VT, typename OT = IT>
+int write_binary_matrix_market(FILE* f, COO_local<IT, VT, OT>* coo, Matrix_Metadata* meta, MM_SORT_ORDER sort_order = MM_SORT_NONE);
+
+/*
+ * Narrows meta->val_bytes and meta->val_encoding to the smallest encoding (not wider than the
+ * current meta->val_bytes) that stores every value of the matrix without loss. Returns true if narrowed.
+ */
+template <typename IT, typename VT, typename OT = IT>
+bool Distr_MMIO_narrow_val_encoding(COO_local<IT, VT, OT>* coo, Matrix_Metadata* meta);
+
+template <typename IT, typename VT, typename OT = IT>
+bool Distr_MMIO_narrow_val_encoding(CSR_local<IT, VT, OT>* csr, Matrix_Metadata* meta);
+
+// Metadata probe
+
+/*
+ * Reads only the banner and the size line of a file, filling meta (sizes included).
+ * Returns 0 on success or a MM_* error code.
+ */
+int Distr_MMIO_probe(const char* filename, Matrix_Metadata* meta);
+
+// In-memory size in bytes of a matrix described by a (probed) Matrix_Metadata
+template <typename IT, typename VT, typename OT = IT>
+uint64_t Distr_MMIO_CSR_local_footprint(const Matrix_Metadata* meta, bool expl_val_for_bin_mtx = false);
+
+template <typename IT, typename VT, typename OT = IT>
+uint64_t Distr_MMIO_COO_local_footprint(const Matrix_Metadata* meta, bool expl_val_for_bin_mtx = false);
 
 // Local CSR
+// The *_read_f functions read from the current position of f and do not close it, the *_read_source ones read
+// from any I/O source (e.g. a shared memory buffer or a pipe) and do not close it either.
 
-template <typename IT, typename VT>
-CSR_local<IT, VT>* Distr_MMIO_CSR_local_create(IT nrows, IT ncols, IT nnz, bool alloc_val);
+template <typename IT, typename VT, typename OT = IT>
+CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_create(IT nrows, IT ncols, OT nnz, bool alloc_val);
 
-template <typename IT, typename VT>
-void Distr_MMIO_CSR_local_destroy(CSR_local<IT, VT>** csr);
+template <typename IT, typename VT, typename OT = IT>
+void Distr_MMIO_CSR_local_destroy(CSR_local<IT, VT, OT>** csr);
 
-template <typename IT, typename VT>
-CSR_local<IT, VT>* Distr_MMIO_CSR_local_read(const char* filename, bool expl_val_for_bin_mtx = false,
+template <typename IT, typename VT, typename OT = IT>
+CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read(const char* filename, bool expl_val_for_bin_mtx = false,
                                              Matrix_Metadata* meta = NULL);
 
-template <typename IT, typename VT>
-CSR_local<IT, VT>* Distr_MMIO_CSR_local_read_f(FILE* f, bool is_bmtx, bool expl_val_for_bin_mtx = false,
+template <typename IT, typename VT, typename OT = IT>
+CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read_f(FILE* f, bool is_bmtx, bool expl_val_for_bin_mtx = false,
                                                Matrix_Metadata* meta = NULL);
 
+template <typename IT, typename VT, typename OT = IT>
+CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read_source(Distr_MMIO_Source* src, bool is_bmtx, bool expl_val_for_bin_mtx = false,
+                                                    Matrix_Metadata* meta = NULL);
+
+/*
+ * Writes a CSR as .mtx or, with write_as_binary, as .bmtx. Rows are written in order, so the binary file is also
+ * a valid .sbmtx when the columns of each row are sorted (as in the CSRs read by this library). With write_triangle
+ * a matrix declared symmetric (meta->is_symmetric) is stored as its lower triangle, otherwise all the entries are
+ * written and the header is general.
+ */
+template <typename IT, typename VT, typename OT = IT>
+int Distr_MMIO_CSR_local_write(CSR_local<IT, VT, OT>* csr, const char* filename, bool write_as_binary, bool write_triangle,
+                               Matrix_Metadata* meta);
+
+template <typename IT, typename VT, typename OT = IT>
+int Distr_MMIO_CSR_local_write_f(CSR_local<IT, VT, OT>* csr, FILE* f, bool write_as_binary, bool write_triangle,
+                                 Matrix_Metadata* meta);
+
+/*
+ * Reads a square matrix as CSR with rows and columns symmetrically permuted by the given ordering. Entries are
+ * relabeled before the CSR assembly, so no copy of the matrix is made. If perm is given, it receives the
+ * permutation (perm[old] = new, allocated with mm_alloc). With persist_perm the permutation is stored in
+ * "<filename>.<order>.perm" and reused by later loads, as long as the matrix file keeps its size and modification time.
+ */
+template <typename IT, typename VT, typename OT = IT>
+CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read_reordered(const char* filename, MM_REORDER order, IT** perm = NULL,
+                                                       bool persist_perm = false, bool expl_val_for_bin_mtx = false,
+                                                       Matrix_Metadata* meta = NULL);
+
 // Local COO
 
-template <typename IT, typename VT>
-COO_local<IT, VT>* Distr_MMIO_COO_local_create(IT nrows, IT ncols, IT nnz, bool alloc_val);
+template <typename IT, typename VT, typename OT = IT>
+COO_local<IT, VT, OT>* Distr_MMIO_COO_local_create(IT nrows, IT ncols, OT nnz, bool alloc_val);
 
-template <typename IT, typename VT>
-void Distr_MMIO_COO_local_destroy(COO_local<IT, VT>** csr);
+template <typename IT, typename VT, typename OT = IT>
+void Distr_MMIO_COO_local_destroy(COO_local<IT, VT, OT>** csr);
 
-template <typename IT, typename VT>
-COO_local<IT, VT>* Distr_MMIO_COO_local_read(const char* filename, bool expl_val_for_bin_mtx = false,
+template <typename IT, typename VT, typename OT = IT>
+COO_local<IT, VT, OT>* Distr_MMIO_COO_local_read(const char* filename, bool expl_val_for_bin_mtx = false,
                                              Matrix_Metadata* meta = NULL);
 
-template <typename IT, typename VT>
-COO_local<IT, VT>* Distr_MMIO_COO_local_read_f(FILE* f, bool is_bmtx, bool expl_val_for_bin_mtx = false,
+template <typename IT, typename VT, typename OT = IT>
+COO_local<IT, VT, OT>* Distr_MMIO_COO_local_read_f(FILE* f, bool is_bmtx, bool expl_val_for_bin_mtx = false,
                                                Matrix_Metadata* meta = NULL);
 
-template <typename IT, typename VT>
-int Distr_MMIO_COO_local_write(COO_local<IT, VT>* coo, const char* filename, bool write_as_binary,
+template <typename IT, typename VT, typename OT = IT>
+COO_local<IT, VT, OT>* Distr_MMIO_COO_local_read_source(Distr_MMIO_Source* src, bool is_bmtx, bool expl_val_for_bin_mtx = false,
+                                                    Matrix_Metadata* meta = NULL);
+
+template <typename IT, typename VT, typename OT = IT>
+int Distr_MMIO_COO_local_write(COO_local<IT, VT, OT>* coo, const char* filename, bool write_as_binary,
                                Matrix_Metadata* meta);
 
+template <typename IT, typename VT, typename OT = IT>
+int Distr_MMIO_COO_local_write_f(COO_local<IT, VT, OT>* coo, FILE* f, bool write_as_binary, Matrix_Metadata* meta);
+
+
+/*
+ * Reads a COO sorted in the given order. The entries of .sbmtx files already written in that order (and of .cbmtx
+ * files, for row-major) are not sorted again. meta->sort_order is set to the order of the returned entries.
+ */
+template <typename IT, typename VT, typename OT = IT>
+COO_local<IT, VT, OT>* Distr_MMIO_sorted_COO_local_read(const char* filename, bool fail_if_require_sort, bool expl_val_for_bin_mtx = false,
+                                                    Matrix_Metadata* meta = NULL, MM_SORT_ORDER order = MM_SORT_ROW_MAJOR);
+
+template <typename IT, typename VT, typename OT = IT>
+COO_local<IT, VT, OT>* Distr_MMIO_sorted_COO_local_read_f(FILE* f, bool fail_if_require_sort, bool is_bmtx, bool is_sbmtx,
+                                                      bool expl_val_for_bin_mtx = false, Matrix_Metadata* meta = NULL,
+                                                      MM_SORT_ORDER order = MM_SORT_ROW_MAJOR);
+
+template <typename IT, typename VT, typename OT = IT>
+COO_local<IT, VT, OT>* Distr_MMIO_sorted_COO_local_read_source(Distr_MMIO_Source* src, bool fail_if_require_sort, bool is_bmtx,
+                                                           bool is_sbmtx, bool expl_val_for_bin_mtx = false,
+                                                           Matrix_Metadata* meta = NULL, MM_SORT_ORDER order = MM_SORT_ROW_MAJOR);
+
+/*
+ * Writes a COO whose entries are sorted in meta->sort_order; binary files record the order in the header.
+ */
+template <typename IT, typename VT, typename OT = IT>
+int Distr_MMIO_sorted_COO_local_write(COO_local<IT, VT, OT>* coo, const char* filename, bool write_as_binary,
+                                      Matrix_Metadata* meta);
+
+template <typename IT, typename VT, typename OT = IT>
+int Distr_MMIO_sorted_COO_local_write_f(COO_local<IT, VT, OT>* coo, FILE* f, bool write_as_binary, Matrix_Metadata* meta);
+
+// Compressed (block) COO
+
+template <typename IT, typename VT, typename OT = IT>
+COO_local<IT, VT, OT>* Distr_MMIO_compressed_COO_local_read_rows(const char* filename, IT row_begin, IT row_end,
+                                                             bool expl_val_for_bin_mtx = false, Matrix_Metadata* meta = NULL);
+
+template <typename IT, typename VT, typename OT = IT>
+int Distr_MMIO_compressed_COO_local_write(COO_local<IT, VT, OT>* coo, const char* filename, Matrix_Metadata* meta);
+
+template <typename IT, typename VT, typename OT = IT>
+int Distr_MMIO_compressed_COO_local_write_f(COO_local<IT, VT, OT>* coo, FILE* f, Matrix_Metadata* meta);
+
+// Submatrix reads
+// Only the entries in a row set and a column set are kept (both sets for induced subgraphs). The filter runs inside
+// the parallel decode, so the other entries are never stored; rows outside the row set are not even read from
+// row-major .sbmtx files on seekable sources, nor from .cbmtx files.
+
+enum MM_INDEX_SET
+{
+    MM_INDEX_SET_ALL,
+    MM_INDEX_SET_RANGE,  // [begin, end)
+    MM_INDEX_SET_BITMAP, // Index i < size is in the set if bit i % 64 of bitmap[i / 64] is set
+    MM_INDEX_SET_LIST    // The size indices in list, in increasing order
+};
+
+struct Distr_MMIO_Index_Set
+{
+    MM_INDEX_SET kind = MM_INDEX_SET_ALL;
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    const uint64_t* bitmap = NULL;
+    const uint64_t* list = NULL;
+    uint64_t size = 0;
+};
+
+struct Distr_MMIO_Submatrix
+{
+    Distr_MMIO_Index_Set rows;
+    Distr_MMIO_Index_Set cols;
+    bool relabel = false; // Renumbers the kept rows (and columns) 0, 1, ... in increasing order, sizes become those of the sets
+};
+
+/*
+ * Reads the entries (i, j) of the matrix with i in sub->rows and j in sub->cols (symmetric matrices are expanded
+ * first, so mirrored entries are selected too). Without relabelling the sizes are those of the whole matrix.
+ * Entries keep the order of the file, so a submatrix of a .sbmtx general file is still row-major sorted.
+ */
+template <typename IT, typename VT, typename OT = IT>
+COO_local<IT, VT, OT>* Distr_MMIO_COO_local_read_submatrix(const char* filename, const Distr_MMIO_Submatrix* sub,
+                                                       bool expl_val_for_bin_mtx = false, Matrix_Metadata* meta = NULL);
+
+template <typename IT, typename VT, typename OT = IT>
+COO_local<IT, VT, OT>* Distr_MMIO_COO_local_read_submatrix_source(Distr_MMIO_Source* src, const Distr_MMIO_Submatrix* sub,
+                                                              bool is_bmtx, bool is_sbmtx, bool expl_val_for_bin_mtx = false,
+                                                              Matrix_Metadata* meta = NULL);
+
+template <typename IT, typename VT, typename OT = IT>
+CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read_submatrix(const char* filename, const Distr_MMIO_Submatrix* sub,
+                                                       bool expl_val_for_bin_mtx = false, Matrix_Metadata* meta = NULL);
+
+template <typename IT, typename VT, typename OT = IT>
+CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read_submatrix_source(Distr_MMIO_Source* src, const Distr_MMIO_Submatrix* sub,
+                                                              bool is_bmtx, bool is_sbmtx, bool expl_val_for_bin_mtx = false,
+                                                              Matrix_Metadata* meta = NULL);
+
+// Graph files
+// SNAP edge lists, TSV/CSV triplets and METIS graphs are parsed in parallel with the Matrix Market text parser,
+// into the same COO_local/CSR_local. Their matrices are general: values are real for weighted edge lists, integer
+// for METIS graphs with edge weights, pattern otherwise.
+
+enum MM_GRAPH_FORMAT
+{
+    MM_GRAPH_FORMAT_AUTO,      // METIS for .graph and .metis files, edge list otherwise (and for sources)
+    MM_GRAPH_FORMAT_EDGE_LIST, // One "i j [value]" edge per line, further fields (e.g. timestamps) are ignored
+    MM_GRAPH_FORMAT_METIS      // "n m [fmt [ncon]]", then the neighbours of each vertex (blank lines have none)
+};
+
+struct Distr_MMIO_Graph_Options
+{
+    MM_GRAPH_FORMAT format = MM_GRAPH_FORMAT_AUTO;
+    const char* comments = "#%"; // Lines starting with one of these characters are skipped
+    char delimiter = ',';        // Fields are separated by blanks and at most one delimiter
+    int index_base = -1;         // 0 or 1, -1 for the convention of the format (0 for edge lists, 1 for METIS)
+    bool undirected = false;     // Edge lists: (j, i) is added for each edge (i, j) off the diagonal
+    uint64_t skip_lines = 0;     // Edge lists: header lines (e.g. CSV column names)
+    uint64_t nrows = 0;          // Edge lists: sizes, 0 for the largest index + 1
+    uint64_t ncols = 0;
+};
+
+// opts can be NULL for the defaults
+template <typename IT, typename VT, typename OT = IT>
+COO_local<IT, VT, OT>* Distr_MMIO_COO_local_read_graph(const char* filename, const Distr_MMIO_Graph_Options* opts = NULL,
+                                                   bool expl_val_for_bin_mtx = false, Matrix_Metadata* meta = NULL);
+
+template <typename IT, typename VT, typename OT = IT>
+COO_local<IT, VT, OT>* Distr_MMIO_COO_local_read_graph_source(Distr_MMIO_Source* src, const Distr_MMIO_Graph_Options* opts = NULL,
+                                                          bool expl_val_for_bin_mtx = false, Matrix_Metadata* meta = NULL);
+
+template <typename IT, typename VT, typename OT = IT>
+CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read_graph(const char* filename, const Distr_MMIO_Graph_Options* opts = NULL,
+                                                   bool expl_val_for_bin_mtx = false, Matrix_Metadata* meta = NULL);
+
+template <typename IT, typename VT, typename OT = IT>
+CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read_graph_source(Distr_MMIO_Source* src, const Distr_MMIO_Graph_Options* opts = NULL,
+                                                          bool expl_val_for_bin_mtx = false, Matrix_Metadata* meta = NULL);
+
+// Sharded files
+// A manifest lists K self-contained .sbmtx shards, each one holding the rows of a range chosen to balance the
+// entries, with global indices and the sizes of the whole matrix. Each worker can read its own shard with the
+// usual read functions, or all shards can be read in parallel into one CSR.
+
+struct Distr_MMIO_Shard
+{
+    std::string filename; // Resolved against the directory of the manifest
+    uint64_t row_begin;
+    uint64_t row_end;
+    uint64_t nnz;
+    uint64_t checksum;    // Of the whole file, see Distr_MMIO_verify_shard
+};
+
+/*
+ * Writes the CSR as nshards files named after the manifest (matrix.shards -> matrix.0.sbmtx, ...) and the
+ * manifest listing them. Shards are always general, symmetric matrices are written with all their entries.
+ */
+template <typename IT, typename VT, typename OT = IT>
+int Distr_MMIO_CSR_local_write_sharded(CSR_local<IT, VT, OT>* csr, const char* manifest_filename, int nshards,
+                                       Matrix_Metadata* meta);
+
+template <typename IT, typename VT, typename OT = IT>
+CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read_sharded(const char* manifest_filename, bool verify_checksums = false,
+                                                     bool expl_val_for_bin_mtx = false, Matrix_Metadata* meta = NULL);
+
+// Fills the shards and the sizes in meta (if not NULL), returns 0 on success or a MM_* error code
+int Distr_MMIO_read_manifest(const char* manifest_filename, std::vector<Distr_MMIO_Shard>* shards,
+                             Matrix_Metadata* meta = NULL);
+
+// Returns 0 if the shard file matches its checksum, MM_CHECKSUM_MISMATCH (or another MM_* error code) otherwise
+int Distr_MMIO_verify_shard(const Distr_MMIO_Shard* shard);
+
+// Row views
+// A row-major sorted binary file (.sbmtx, or a general .bmtx written from a CSR) can be used without loading it: the
+// file is mapped and only the rows accessed are decoded, so only their pages (and those of their row index entries)
+// become resident. Rows are located with a row index of nrows + 1 entry offsets, built with one parallel pass over
+// the file the first time and stored next to it (<file>.rowidx), then mapped too.
+
+/*
+ * Maps the file and its row index (rebuilt if missing or built from another version of the file: the index records
+ * the size and modification time, with nanoseconds, of the file it was built from). Without persist_index the index is
+ * built in memory (8 bytes per row). Symmetric files are not supported, as only one triangle of each row is stored.
+ * Returns NULL if the file cannot be mapped or is not row-major sorted.
+ */
+template <typename IT, typename VT, typename OT = IT>
+CSR_view<IT, VT, OT>* Distr_MMIO_CSR_view_open(const char* filename, bool persist_index = true, Matrix_Metadata* meta = NULL);
+
+template <typename IT, typename VT, typename OT = IT>
+void Distr_MMIO_CSR_view_close(CSR_view<IT, VT, OT>** view);
+
+// Decodes the columns (and the values, if val is not NULL) of row i, which has row_ptr[i + 1] - row_ptr[i] entries
+template <typename IT, typename VT, typename OT = IT>
+uint64_t Distr_MMIO_CSR_view_row(const CSR_view<IT, VT, OT>* view, IT i, IT* col, VT* val);
+
+// Calls f on the decoded rows [row_begin, row_end) in order (val is NULL for pattern files)
+template <typename IT, typename VT, typename OT = IT>
+void Distr_MMIO_CSR_view_for_each_row(const CSR_view<IT, VT, OT>* view, IT row_begin, IT row_end,
+                                      const std::function<void(IT row, const IT* col, const VT* val, uint64_t length)>& f);
+
+// Hints that the given rows will be accessed soon: their pages are read ahead asynchronously
+template <typename IT, typename VT, typename OT = IT>
+void Distr_MMIO_CSR_view_prefetch(const CSR_view<IT, VT, OT>* view, const IT* rows, uint64_t nrows);
+
+#ifdef DISTR_MMIO_WITH_MPI
+// Collective writes (built with DISTR_MMIO_WITH_MPI)
+
+/*
+ * Writes the row blocks held by the ranks of comm as one binary file, with MPI-IO. Rank r holds the rows
+ * [first_row, first_row + csr->nrows) of the matrix, where first_row is the sum of the nrows of the ranks before it,
+ * with global column indices. Each rank writes its entries at its own offset (exclusive scan of the entries), rank 0
+ * writes the header. Entries are row-major sorted, so the file can be named .bmtx or .sbmtx; it is always general.
+ * Must be called by all the ranks with the same filename and meta. Returns 0 (on every rank) or a MM_* error code.
+ */
+template <typename IT, typename VT, typename OT = IT>
+int Distr_MMIO_CSR_write_collective(CSR_local<IT, VT, OT>* csr, const char* filename, MPI_Comm comm, Matrix_Metadata* meta);
+#endif
+
+// Appendable BMTX
+// Binary files keep their sizes in a fixed-width line, so entries can be appended without rewriting the file:
+// the cost of an append only depends on the size of the batch.
+
+/*
+ * Appends the entries of coo to a .bmtx file in its encoding (only the lower triangle for symmetric files),
+ * growing its sizes to those of coo if larger. A missing file is created using the types and the encoding in
+ * meta, with indices wide enough for coo->nrows and coo->ncols (which can be set larger to leave room). The
+ * entries are on disk before the sizes are updated, so readers never see a partial batch. meta is then filled
+ * with the metadata of the file. Returns 0 on success or a MM_* error code.
+ */
+template <typename IT, typename VT, typename OT = IT>
+int Distr_MMIO_COO_local_append(COO_local<IT, VT, OT>* coo, const char* filename, Matrix_Metadata* meta);
+
+/*
+ * Merges all the entries of the .bmtx log into the general row-major sorted file (created if missing, e.g.
+ * matrix.sbmtx) and removes them from the log. Appends to the log can run concurrently (e.g. with the compaction
+ * on a background thread); only the sort of the log entries and a linear merge are needed. Both files are replaced
+ * atomically and durably, and a compaction interrupted by a crash is completed by the next one. VT should be wide
+ * enough for the values of the log (double for all encodings). Returns 0 on success or a MM_* error code.
+ */
+template <typename IT, typename VT, typename OT = IT>
+int Distr_MMIO_compact(const char* log_filename, const char* sorted_filename, Matrix_Metadata* meta = NULL);
+
+// Local dense arrays
+// Matrix Market "array" files store the values column-major, only the lower triangle for symmetric matrices (strictly
+// lower for skew-symmetric ones), and are read with the same parallel text parser. Their binary form (.bmtx with the
+// array banner, "0 <sizeof(VT)> float <row-major|col-major>") stores every value as VT after a header padded to 64
+// bytes, so it can be read with a single (parallel) copy or mapped and used in place.
+
 template <typename IT, typename VT>
-int Distr_MMIO_COO_local_write_f(COO_local<IT, VT>* coo, FILE* f, bool write_as_binary, Matrix_Metadata* meta);
+Dense_local<IT, VT>* Distr_MMIO_Dense_local_create(IT nrows, IT ncols, bool row_major);
 
+template <typename IT, typename VT>
+void Distr_MMIO_Dense_local_destroy(Dense_local<IT, VT>** dense);
+
+// Symmetric and skew-symmetric files are expanded, the values are stored in the requested layout
+template <typename IT, typename VT>
+Dense_local<IT, VT>* Distr_MMIO_Dense_local_read(const char* filename, bool row_major = false, Matrix_Metadata* meta = NULL);
 
 template <typename IT, typename VT>
-COO_local<IT, VT>* Distr_MMIO_sorted_COO_local_read(const char* filename, bool fail_if_require_sort, bool expl_val_for_bin_mtx = false,
+Dense_local<IT, VT>* Distr_MMIO_Dense_local_read_source(Distr_MMIO_Source* src, bool is_bmtx, bool row_major = false,
                                                     Matrix_Metadata* meta = NULL);
 
+/*
+ * Maps a binary array file written with the same VT (private mapping: changes are not written back). The layout
+ * is the one of the file. Returns NULL if the file cannot be mapped.
+ */
 template <typename IT, typename VT>
-COO_local<IT, VT>* Distr_MMIO_sorted_COO_local_read_f(FILE* f, bool fail_if_require_sort, bool is_bmtx, bool is_sbmtx,
-                                                      bool expl_val_for_bin_mtx = false, Matrix_Metadata* meta = NULL);
+Dense_local<IT, VT>* Distr_MMIO_Dense_local_map(const char* filename, Matrix_Metadata* meta = NULL);
 
+/*
+ * Writes a dense matrix as a text array (only the lower triangle if meta->is_symmetric) or, with write_as_binary,
+ * in the binary form with its layout. meta can be NULL (real general).
+ */
 template <typename IT, typename VT>
-int Distr_MMIO_sorted_COO_local_write(COO_local<IT, VT>* coo, const char* filename, bool write_as_binary,
-                                      Matrix_Metadata* meta);
+int Distr_MMIO_Dense_local_write(Dense_local<IT, VT>* dense, const char* filename, bool write_as_binary, Matrix_Metadata* meta);
 
 template <typename IT, typename VT>
-int Distr_MMIO_sorted_COO_local_write_f(COO_local<IT, VT>* coo, FILE* f, bool write_as_binary, Matrix_Metadata* meta);
+int Distr_MMIO_Dense_local_write_f(Dense_local<IT, VT>* dense, FILE* f, bool write_as_binary, Matrix_Metadata* meta);
+
+// Local SELL-C-sigma and BSR
+// Built directly from the parsed entries of any supported file; files with the .sell/.bsr extension
+// are loaded from their binary form (written by the *_write functions), which must use the same types
+// (C, sigma and block_size are then taken from the file).
+
+template <typename IT, typename VT, typename OT = IT>
+SELL_local<IT, VT, OT>* Distr_MMIO_SELL_local_read(const char* filename, IT C, IT sigma, Matrix_Metadata* meta = NULL);
+
+template <typename IT, typename VT, typename OT = IT>
+SELL_local<IT, VT, OT>* Distr_MMIO_SELL_local_from_COO(COO_local<IT, VT, OT>* coo, IT C, IT sigma);
+
+template <typename IT, typename VT, typename OT = IT>
+int Distr_MMIO_SELL_local_write(SELL_local<IT, VT, OT>* sell, const char* filename);
+
+template <typename IT, typename VT, typename OT = IT>
+void Distr_MMIO_SELL_local_destroy(SELL_local<IT, VT, OT>** sell);
+
+template <typename IT, typename VT, typename OT = IT>
+BSR_local<IT, VT, OT>* Distr_MMIO_BSR_local_read(const char* filename, IT block_size, Matrix_Metadata* meta = NULL);
+
+template <typename IT, typename VT, typename OT = IT>
+BSR_local<IT, VT, OT>* Distr_MMIO_BSR_local_from_COO(COO_local<IT, VT, OT>* coo, IT block_size);
+
+template <typename IT, typename VT, typename OT = IT>
+int Distr_MMIO_BSR_local_write(BSR_local<IT, VT, OT>* bsr, const char* filename);
+
+template <typename IT, typename VT, typename OT = IT>
+void Distr_MMIO_BSR_local_destroy(BSR_local<IT, VT, OT>** bsr);
 
 #endif // MM_IO_H
@@ -0,0 +1,64 @@
+#ifndef MM_IO_BATCH_H
+#define MM_IO_BATCH_H
+
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "mmio.h"
+
+#define MM_BATCH_SMALL_FILE_BYTES (1UL * 1024 * 1024) // Files smaller than this are loaded in groups
+#define MM_BATCH_SMALL_GROUP_SIZE 32
+
+struct Distr_MMIO_Batch_Options
+{
+    unsigned n_threads = 0;     // Concurrent loads, 0 means hardware concurrency
+    size_t memory_budget = 0;   // Bytes that loads in flight can use at once, 0 means unlimited
+    bool expl_val_for_bin_mtx = false;
+};
+
+template <typename IT, typename VT, typename OT = IT>
+struct Distr_MMIO_Batch_Result
+{
+    std::string filename;
+    int err; // 0 on success, MM_* error code otherwise
+    CSR_local<IT, VT, OT>* csr;
+    Matrix_Metadata meta;
+    Distr_MMIO_Stats stats; // Filled by the loading thread
+};
+
+struct Distr_MMIO_Catalog_Entry
+{
+    std::string filename;
+    uint64_t file_bytes;
+    int64_t mtime;
+    int64_t mtime_nsec;
+    Matrix_Metadata meta; // As filled by Distr_MMIO_probe (header strings excluded)
+};
+
+/*
+ * Lists the matrix files (.mtx, .bmtx, .sbmtx, .cbmtx) in a directory (recursively) or matching a glob pattern.
+ */
+std::vector<std::string> Distr_MMIO_list_matrix_files(const char* dir_or_glob);
+
+/*
+ * Loads a collection of matrices on a bounded thread pool. Results are returned (and passed to on_done,
+ * if given, from the loading thread) in completion order. Large files are started first and only as
+ * many as fit in the memory budget are in flight at once; small files are loaded in groups.
+ */
+template <typename IT, typename VT, typename OT = IT>
+std::vector<Distr_MMIO_Batch_Result<IT, VT, OT>> Distr_MMIO_CSR_local_read_batch(
+    const std::vector<std::string>& filenames, const Distr_MMIO_Batch_Options* opts = NULL,
+    std::type_identity_t<std::function<void(const Distr_MMIO_Batch_Result<IT, VT, OT>&)>> on_done = nullptr);
+
+/*
+ * Probes (in parallel) all the matrix files in a directory or matching a glob and writes their metadata
+ * to a catalog file. Entries of an existing catalog whose file size and modification time did not
+ * change are reused without opening the file. Returns 0 on success or a MM_* error code.
+ */
+int Distr_MMIO_write_catalog(const char* dir_or_glob, const char* catalog_filename);
+
+int Distr_MMIO_read_catalog(const char* catalog_filename, std::vector<Distr_MMIO_Catalog_Entry>* entries);
+
+#endif // MM_IO_BATCH_H
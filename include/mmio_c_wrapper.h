@@ -93,12 +93,51 @@ typedef struct {
     double*   val;
 } mmio_coo_u64_f64_t;
 
+// --- Combination: uint64_t offsets, uint32_t index, float value ---
+typedef struct {
+    uint32_t nrows;
+    uint32_t ncols;
+    uint64_t nnz;
+    uint64_t* row_ptr;
+    uint32_t* col_idx;
+    float*    val;
+} mmio_csr_u64_u32_f32_t;
+
+typedef struct {
+    uint32_t nrows;
+    uint32_t ncols;
+    uint64_t nnz;
+    uint32_t* row;
+    uint32_t* col;
+    float*    val;
+} mmio_coo_u64_u32_f32_t;
+
+// --- Combination: uint64_t offsets, uint32_t index, double value ---
+typedef struct {
+    uint32_t nrows;
+    uint32_t ncols;
+    uint64_t nnz;
+    uint64_t* row_ptr;
+    uint32_t* col_idx;
+    double*   val;
+} mmio_csr_u64_u32_f64_t;
+
+typedef struct {
+    uint32_t nrows;
+    uint32_t ncols;
+    uint64_t nnz;
+    uint32_t* row;
+    uint32_t* col;
+    double*   val;
+} mmio_coo_u64_u32_f64_t;
+
 
 /*
  * ============================================================================
  * C-friendly function wrappers.
  * A function is provided for each data format and type combination.
  * The naming convention is: mmio_read/destroy_<format>_<index_type>_<value_type>
+ * or mmio_read/destroy_<format>_<offset_type>_<index_type>_<value_type> for mixed widths.
  * ============================================================================
  */
 
@@ -126,6 +165,148 @@ mmio_coo_u64_f64_t* mmio_read_coo_u64_f64(const char* filename, bool alloc_val);
 void mmio_destroy_csr_u64_f64(mmio_csr_u64_f64_t* matrix);
 void mmio_destroy_coo_u64_f64(mmio_coo_u64_f64_t* matrix);
 
+// --- uint64_t offsets / uint32_t / float ---
+mmio_csr_u64_u32_f32_t* mmio_read_csr_u64_u32_f32(const char* filename, bool alloc_val);
+mmio_coo_u64_u32_f32_t* mmio_read_coo_u64_u32_f32(const char* filename, bool alloc_val);
+void mmio_destroy_csr_u64_u32_f32(mmio_csr_u64_u32_f32_t* matrix);
+void mmio_destroy_coo_u64_u32_f32(mmio_coo_u64_u32_f32_t* matrix);
+
+// --- uint64_t offsets / uint32_t / double ---
+mmio_csr_u64_u32_f64_t* mmio_read_csr_u64_u32_f64(const char* filename, bool alloc_val);
+mmio_coo_u64_u32_f64_t* mmio_read_coo_u64_u32_f64(const char* filename, bool alloc_val);
+void mmio_destroy_csr_u64_u32_f64(mmio_csr_u64_u32_f64_t* matrix);
+void mmio_destroy_coo_u64_u32_f64(mmio_coo_u64_u32_f64_t* matrix);
+
+
+/*
+ * ============================================================================
+ * Options based API.
+ * Every call takes an options struct (NULL for the defaults, see mmio_options_init).
+ * Reads return NULL on errors, the other functions 0 on success or an error code.
+ * ============================================================================
+ */
+
+// Error codes (the MM_* codes of mmio.h)
+#define MMIO_OK                   0
+#define MMIO_END                  (-1) // No more matrices in a batch
+#define MMIO_COULD_NOT_READ_FILE  11
+#define MMIO_PREMATURE_EOF        12
+#define MMIO_NOT_MTX              13
+#define MMIO_NO_HEADER            14
+#define MMIO_UNSUPPORTED_TYPE     15
+#define MMIO_LINE_TOO_LONG        16
+#define MMIO_COULD_NOT_WRITE_FILE 17
+#define MMIO_CANCELLED            18
+#define MMIO_CHECKSUM_MISMATCH    19
+#define MMIO_INDEX_OUT_OF_RANGE   20
+
+typedef enum {
+    MMIO_FORMAT_AUTO,  // From the file extension
+    MMIO_FORMAT_MTX,   // Text Matrix Market
+    MMIO_FORMAT_BMTX,  // Binary (.bmtx, .sbmtx and .cbmtx when reading)
+    MMIO_FORMAT_CBMTX  // Block-compressed binary (writes of COO matrices only)
+} mmio_format_t;
+
+typedef enum {
+    MMIO_VAL_REAL,
+    MMIO_VAL_INTEGER,
+    MMIO_VAL_PATTERN
+} mmio_val_type_t;
+
+typedef struct {
+    int n_threads;             // OpenMP threads used by the call, 0 keeps the current setting
+    mmio_format_t format;
+    bool alloc_val;            // Allocate (and fill with 1) the values of pattern matrices
+    bool symmetric_triangle;   // Matrices declared symmetric are written as one triangle (lower, upper for binary COO)
+    bool use_mmap;             // Parse a memory mapping of the file instead of reading it
+    // Allocator of the matrices and of the temporary buffers, both NULL for the default one. It is installed for the
+    // duration of each call (so concurrent calls must use the same one): destroy matrices with the *_ex functions.
+    void* (*alloc)(size_t bytes, void* ctx);
+    void (*free)(void* ptr, void* ctx);
+    void* alloc_ctx;
+} mmio_options_t;
+
+typedef struct {
+    mmio_val_type_t val_type;
+    bool is_symmetric;
+    uint8_t val_bytes;         // Bytes of the values of binary files (4 or 8 for writes, 0 means sizeof the value type)
+    uint64_t nrows;
+    uint64_t ncols;
+    uint64_t nnz;              // Entries stored in the file (entries of the matrix after reads)
+    uint64_t expanded_nnz;     // Entries after symmetric expansion (upper bound when probed)
+    bool is_array;
+} mmio_metadata_t;
+
+// Iterator over the matrix files of a directory (recursively) or matching a glob, read one at a time
+typedef struct mmio_batch mmio_batch_t;
+
+void mmio_options_init(mmio_options_t* opts); // Defaults: current threads, format from the extension, no mmap
+int mmio_probe(const char* filename, mmio_metadata_t* meta); // Header only
+
+mmio_batch_t* mmio_batch_open(const char* dir_or_glob, const mmio_options_t* opts);
+size_t mmio_batch_count(const mmio_batch_t* batch);
+const char* mmio_batch_filename(const mmio_batch_t* batch); // File of the last matrix returned (or failed)
+void mmio_batch_close(mmio_batch_t* batch);
+
+// --- uint32_t / float ---
+mmio_csr_u32_f32_t* mmio_read_csr_u32_f32_ex(const char* filename, const mmio_options_t* opts, mmio_metadata_t* meta);
+mmio_coo_u32_f32_t* mmio_read_coo_u32_f32_ex(const char* filename, const mmio_options_t* opts, mmio_metadata_t* meta);
+int mmio_write_csr_u32_f32(const mmio_csr_u32_f32_t* matrix, const char* filename, const mmio_options_t* opts, const mmio_metadata_t* meta);
+int mmio_write_coo_u32_f32(const mmio_coo_u32_f32_t* matrix, const char* filename, const mmio_options_t* opts, const mmio_metadata_t* meta);
+int mmio_batch_next_csr_u32_f32(mmio_batch_t* batch, mmio_csr_u32_f32_t** matrix, mmio_metadata_t* meta);
+int mmio_batch_next_coo_u32_f32(mmio_batch_t* batch, mmio_coo_u32_f32_t** matrix, mmio_metadata_t* meta);
+void mmio_destroy_csr_u32_f32_ex(mmio_csr_u32_f32_t* matrix, const mmio_options_t* opts);
+void mmio_destroy_coo_u32_f32_ex(mmio_coo_u32_f32_t* matrix, const mmio_options_t* opts);
+
+// --- uint32_t / double ---
+mmio_csr_u32_f64_t* mmio_read_csr_u32_f64_ex(const char* filename, const mmio_options_t* opts, mmio_metadata_t* meta);
+mmio_coo_u32_f64_t* mmio_read_coo_u32_f64_ex(const char* filename, const mmio_options_t* opts, mmio_metadata_t* meta);
+int mmio_write_csr_u32_f64(const mmio_csr_u32_f64_t* matrix, const char* filename, const mmio_options_t* opts, const mmio_metadata_t* meta);
+int mmio_write_coo_u32_f64(const mmio_coo_u32_f64_t* matrix, const char* filename, const mmio_options_t* opts, const mmio_metadata_t* meta);
+int mmio_batch_next_csr_u32_f64(mmio_batch_t* batch, mmio_csr_u32_f64_t** matrix, mmio_metadata_t* meta);
+int mmio_batch_next_coo_u32_f64(mmio_batch_t* batch, mmio_coo_u32_f64_t** matrix, mmio_metadata_t* meta);
+void mmio_destroy_csr_u32_f64_ex(mmio_csr_u32_f64_t* matrix, const mmio_options_t* opts);
+void mmio_destroy_coo_u32_f64_ex(mmio_coo_u32_f64_t* matrix, const mmio_options_t* opts);
+
+// --- uint64_t / float ---
+mmio_csr_u64_f32_t* mmio_read_csr_u64_f32_ex(const char* filename, const mmio_options_t* opts, mmio_metadata_t* meta);
+mmio_coo_u64_f32_t* mmio_read_coo_u64_f32_ex(const char* filename, const mmio_options_t* opts, mmio_metadata_t* meta);
+int mmio_write_csr_u64_f32(const mmio_csr_u64_f32_t* matrix, const char* filename, const mmio_options_t* opts, const mmio_metadata_t* meta);
+int mmio_write_coo_u64_f32(const mmio_coo_u64_f32_t* matrix, const char* filename, const mmio_options_t* opts, const mmio_metadata_t* meta);
+int mmio_batch_next_csr_u64_f32(mmio_batch_t* batch, mmio_csr_u64_f32_t** matrix, mmio_metadata_t* meta);
+int mmio_batch_next_coo_u64_f32(mmio_batch_t* batch, mmio_coo_u64_f32_t** matrix, mmio_metadata_t* meta);
+void mmio_destroy_csr_u64_f32_ex(mmio_csr_u64_f32_t* matrix, const mmio_options_t* opts);
+void mmio_destroy_coo_u64_f32_ex(mmio_coo_u64_f32_t* matrix, const mmio_options_t* opts);
+
+// --- uint64_t / double ---
+mmio_csr_u64_f64_t* mmio_read_csr_u64_f64_ex(const char* filename, const mmio_options_t* opts, mmio_metadata_t* meta);
+mmio_coo_u64_f64_t* mmio_read_coo_u64_f64_ex(const char* filename, const mmio_options_t* opts, mmio_metadata_t* meta);
+int mmio_write_csr_u64_f64(const mmio_csr_u64_f64_t* matrix, const char* filename, const mmio_options_t* opts, const mmio_metadata_t* meta);
+int mmio_write_coo_u64_f64(const mmio_coo_u64_f64_t* matrix, const char* filename, const mmio_options_t* opts, const mmio_metadata_t* meta);
+int mmio_batch_next_csr_u64_f64(mmio_batch_t* batch, mmio_csr_u64_f64_t** matrix, mmio_metadata_t* meta);
+int mmio_batch_next_coo_u64_f64(mmio_batch_t* batch, mmio_coo_u64_f64_t** matrix, mmio_metadata_t* meta);
+void mmio_destroy_csr_u64_f64_ex(mmio_csr_u64_f64_t* matrix, const mmio_options_t* opts);
+void mmio_destroy_coo_u64_f64_ex(mmio_coo_u64_f64_t* matrix, const mmio_options_t* opts);
+
+// --- uint64_t offsets / uint32_t / float ---
+mmio_csr_u64_u32_f32_t* mmio_read_csr_u64_u32_f32_ex(const char* filename, const mmio_options_t* opts, mmio_metadata_t* meta);
+mmio_coo_u64_u32_f32_t* mmio_read_coo_u64_u32_f32_ex(const char* filename, const mmio_options_t* opts, mmio_metadata_t* meta);
+int mmio_write_csr_u64_u32_f32(const mmio_csr_u64_u32_f32_t* matrix, const char* filename, const mmio_options_t* opts, const mmio_metadata_t* meta);
+int mmio_write_coo_u64_u32_f32(const mmio_coo_u64_u32_f32_t* matrix, const char* filename, const mmio_options_t* opts, const mmio_metadata_t* meta);
+int mmio_batch_next_csr_u64_u32_f32(mmio_batch_t* batch, mmio_csr_u64_u32_f32_t** matrix, mmio_metadata_t* meta);
+int mmio_batch_next_coo_u64_u32_f32(mmio_batch_t* batch, mmio_coo_u64_u32_f32_t** matrix, mmio_metadata_t* meta);
+void mmio_destroy_csr_u64_u32_f32_ex(mmio_csr_u64_u32_f32_t* matrix, const mmio_options_t* opts);
+void mmio_destroy_coo_u64_u32_f32_ex(mmio_coo_u64_u32_f32_t* matrix, const mmio_options_t* opts);
+
+// --- uint64_t offsets / uint32_t / double ---
+mmio_csr_u64_u32_f64_t* mmio_read_csr_u64_u32_f64_ex(const char* filename, const mmio_options_t* opts, mmio_metadata_t* meta);
+mmio_coo_u64_u32_f64_t* mmio_read_coo_u64_u32_f64_ex(const char* filename, const mmio_options_t* opts, mmio_metadata_t* meta);
+int mmio_write_csr_u64_u32_f64(const mmio_csr_u64_u32_f64_t* matrix, const char* filename, const mmio_options_t* opts, const mmio_metadata_t* meta);
+int mmio_write_coo_u64_u32_f64(const mmio_coo_u64_u32_f64_t* matrix, const char* filename, const mmio_options_t* opts, const mmio_metadata_t* meta);
+int mmio_batch_next_csr_u64_u32_f64(mmio_batch_t* batch, mmio_csr_u64_u32_f64_t** matrix, mmio_metadata_t* meta);
+int mmio_batch_next_coo_u64_u32_f64(mmio_batch_t* batch, mmio_coo_u64_u32_f64_t** matrix, mmio_metadata_t* meta);
+void mmio_destroy_csr_u64_u32_f64_ex(mmio_csr_u64_u32_f64_t* matrix, const mmio_options_t* opts);
+void mmio_destroy_coo_u64_u32_f64_ex(mmio_coo_u64_u32_f64_t* matrix, const mmio_options_t* opts);
 
 #ifdef __cplusplus
 }
@@ -1,13 +1,15 @@
 #ifndef MM_IO_UTILS_H
 #define MM_IO_UTILS_H
 
-template<typename IT, typename VT>
-void print_csr(CSR_local<IT, VT> *csr, std::string header="");
+template<typename IT, typename VT, typename OT = IT>
+void print_csr(CSR_local<IT, VT, OT> *csr, std::string header="");
 
-template<typename IT, typename VT>
-void print_csr_as_dense(CSR_local<IT, VT> *csr, std::string header="");
+template<typename IT, typename VT, typename OT = IT>
+void print_csr_as_dense(CSR_local<IT, VT, OT> *csr, std::string header="");
 
-template<typename IT, typename VT>
-void print_coo(COO_local<IT, VT> *coo, std::string header="");
+template<typename IT, typename VT, typename OT = IT>
+void print_coo(COO_local<IT, VT, OT> *coo, std::string header="");
+
+void print_stats(const Distr_MMIO_Stats *stats, std::string header="");
 
 #endif
\ No newline at end of file
@@ -0,0 +1,109 @@
+"""Python bindings of distributed_mmio: parallel Matrix Market (.mtx) and binary (.bmtx, .sbmtx, .cbmtx) reads and
+writes of scipy.sparse matrices.
+
+The indptr/indices/data (or row/col/data) arrays of the matrices returned by the reads wrap the buffers allocated by
+the library, without copies. Every array (and every view or slice of it) holds a reference to an owner of the whole
+matrix, so the buffers are only released when the last of them is garbage-collected, in any order; copy an array
+(e.g. with numpy.array) to keep it independent of the others.
+"""
+import os
+
+import numpy as np
+import scipy.sparse as sp
+
+from . import _distributed_mmio as _lib
+
+__all__ = ["probe", "read", "read_csr", "read_coo", "write"]
+
+_INT32_MAX = np.iinfo(np.int32).max
+_BINARY = {None: -1, False: 0, True: 1, "cbmtx": 2}
+
+
+def probe(filename):
+    """Metadata of the header of a matrix file (val_type, symmetric, val_bytes, nrows, ncols, nnz, expanded_nnz, array)."""
+    return _lib.probe(os.fspath(filename))
+
+
+def _index_type(filename, index_dtype):
+    if index_dtype is None:
+        # SciPy keeps int32 indices when every index and nnz fit, so int64 ones would be copied by the constructors
+        meta = probe(filename)
+        fits = max(meta["nrows"], meta["ncols"], meta["expanded_nnz"]) <= _INT32_MAX
+        return "i" if fits else "q"
+    dtype = np.dtype(index_dtype)
+    if dtype not in (np.dtype(np.int32), np.dtype(np.int64)):
+        raise ValueError("index_dtype must be int32 or int64")
+    return "i" if dtype == np.int32 else "q"
+
+
+def _value_type(value_dtype):
+    dtype = np.dtype(value_dtype)
+    if dtype not in (np.dtype(np.float32), np.dtype(np.float64)):
+        raise ValueError("value_dtype must be float32 or float64")
+    return "f" if dtype == np.float32 else "d"
+
+
+def _read(filename, format, index_dtype, value_dtype, binary, mmap, n_threads):
+    filename = os.fspath(filename)
+    nrows, ncols, (a0, a1, data) = _lib.read(filename, format, _index_type(filename, index_dtype),
+                                             _value_type(value_dtype), _BINARY[binary], mmap, n_threads)
+    index_dtype = np.int32 if memoryview(a0).format == "i" else np.int64
+    a0 = np.frombuffer(a0, dtype=index_dtype)
+    a1 = np.frombuffer(a1, dtype=index_dtype)
+    data = np.frombuffer(data, dtype=value_dtype) if data is not None else np.ones(len(a1), dtype=value_dtype)
+    return (nrows, ncols), a0, a1, data
+
+
+def read_csr(filename, index_dtype=None, value_dtype=np.float64, binary=None, mmap=False, n_threads=0):
+    """Reads a matrix file into a scipy.sparse.csr_matrix, expanding symmetric matrices.
+
+    index_dtype: np.int32 or np.int64, None for the narrowest one that fits the matrix.
+    value_dtype: np.float32 or np.float64; pattern matrices get values equal to 1.
+    binary: None to detect the format from the file extension, False for text, True for binary.
+    mmap: parse a memory mapping of the file instead of reading it.
+    n_threads: OpenMP threads of the read, 0 for the current setting.
+    """
+    shape, indptr, indices, data = _read(filename, "csr", index_dtype, value_dtype, binary, mmap, n_threads)
+    return sp.csr_matrix((data, indices, indptr), shape=shape, copy=False)
+
+
+def read_coo(filename, index_dtype=None, value_dtype=np.float64, binary=None, mmap=False, n_threads=0):
+    """Reads a matrix file into a scipy.sparse.coo_matrix, expanding symmetric matrices (arguments as read_csr)."""
+    shape, row, col, data = _read(filename, "coo", index_dtype, value_dtype, binary, mmap, n_threads)
+    return sp.coo_matrix((data, (row, col)), shape=shape, copy=False)
+
+
+def read(filename, format="csr", **kwargs):
+    """Reads a matrix file as read_csr (format="csr") or read_coo (format="coo")."""
+    if format == "csr":
+        return read_csr(filename, **kwargs)
+    if format == "coo":
+        return read_coo(filename, **kwargs)
+    raise ValueError("format must be 'csr' or 'coo'")
+
+
+def write(matrix, filename, binary=None, symmetric=False, pattern=False, val_bytes=0, n_threads=0):
+    """Writes a scipy.sparse matrix (CSR and COO in place, other formats after a conversion to CSR).
+
+    binary: None to choose the format from the file extension, False for text, True for binary, "cbmtx" for
+    block-compressed binary (COO matrices only).
+    symmetric: write the matrix as symmetric, storing one triangle: the lower one (row >= col) for CSR matrices and
+    text COO files, the upper one (row <= col) for binary COO files. "cbmtx" files are always written as general.
+    pattern: write only the positions of the entries.
+    val_bytes: bytes of the values of binary files (4 or 8), 0 for the size of the dtype of the matrix.
+    """
+    if not sp.issparse(matrix):
+        raise TypeError("matrix must be a scipy.sparse matrix")
+    if matrix.format == "coo":
+        format, a0, a1 = "coo", matrix.row, matrix.col
+    else:
+        matrix = matrix.tocsr()
+        format, a0, a1 = "csr", matrix.indptr, matrix.indices
+    index_dtype = np.int64 if np.int64 in (a0.dtype, a1.dtype) else np.int32
+    value_dtype = np.float32 if matrix.dtype == np.float32 else np.float64
+    a0 = np.ascontiguousarray(a0, dtype=index_dtype)
+    a1 = np.ascontiguousarray(a1, dtype=index_dtype)
+    data = None if pattern else np.ascontiguousarray(matrix.data, dtype=value_dtype)
+    nrows, ncols = matrix.shape
+    _lib.write(os.fspath(filename), format, nrows, ncols, a0, a1, data, _BINARY[binary], symmetric,
+               "pattern" if pattern else "real", val_bytes, n_threads)
@@ -11,51 +11,683 @@
 #include <cstdlib>
 #include <algorithm>
 #include <string>
+#include <vector>
+#include <limits>
+#include <cmath>
+#include <chrono>
+#include <unordered_map>
+#include <charconv>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "../include/mmio.h"
 
 #define MMIO_EXPLICIT_TEMPLATE_INST(IT, VT) \
   template int mm_read_mtx_crd_data(FILE *f, int nnz, Entry<IT, VT> *entries, MM_typecode matcode, bool is_bmtx, uint8_t idx_bytes, uint8_t val_bytes); \
-  template CSR_local<IT, VT>* Distr_MMIO_CSR_local_create(IT nrows, IT ncols, IT nnz, bool alloc_val); \
-  template void Distr_MMIO_CSR_local_destroy(CSR_local<IT, VT> **csr); \
-  template COO_local<IT, VT>* Distr_MMIO_COO_local_create(IT nrows, IT ncols, IT nnz, bool alloc_val); \
-  template void Distr_MMIO_COO_local_destroy(COO_local<IT, VT> **coo); \
-  template void entries_to_local_csr(Entry<IT, VT> *entries, CSR_local<IT, VT> *csr); \
-  template void entries_to_local_coo(Entry<IT, VT> *entries, COO_local<IT, VT> *coo); \
-  template int write_binary_matrix_market(FILE *f, COO_local<IT, VT> *coo, Matrix_Metadata *meta); \
-  template CSR_local<IT, VT>* Distr_MMIO_CSR_local_read(const char *filename, bool expl_val_for_bin_mtx, Matrix_Metadata* meta); \
-  template CSR_local<IT, VT>* Distr_MMIO_CSR_local_read_f(FILE *f, bool is_bmtx, bool expl_val_for_bin_mtx, Matrix_Metadata* meta); \
-  template COO_local<IT, VT>* Distr_MMIO_COO_local_read(const char *filename, bool expl_val_for_bin_mtx, Matrix_Metadata* meta); \
-  template COO_local<IT, VT>* Distr_MMIO_COO_local_read_f(FILE *f, bool is_bmtx, bool expl_val_for_bin_mtx, Matrix_Metadata* meta); \
-  template int Distr_MMIO_COO_local_write(COO_local<IT, VT>* coo, const char *filename, bool write_as_binary, Matrix_Metadata* meta); \
-  template int Distr_MMIO_COO_local_write_f(COO_local<IT, VT>* coo, FILE *f, bool write_as_binary, Matrix_Metadata* meta);\
-  template COO_local<IT, VT>* Distr_MMIO_sorted_COO_local_read(const char *filename, bool fail_if_require_sort, bool expl_val_for_bin_mtx, Matrix_Metadata* meta); \
-  template COO_local<IT, VT>* Distr_MMIO_sorted_COO_local_read_f(FILE *f, bool fail_if_require_sort, bool is_bmtx, bool is_sbmtx, bool expl_val_for_bin_mtx, Matrix_Metadata* meta); \
-  template int Distr_MMIO_sorted_COO_local_write(COO_local<IT, VT>* coo, const char *filename, bool write_as_binary, Matrix_Metadata* meta); \
-  template int Distr_MMIO_sorted_COO_local_write_f(COO_local<IT, VT>* coo, FILE *f, bool write_as_binary, Matrix_Metadata* meta);
+  template Dense_local<IT, VT>* Distr_MMIO_Dense_local_create(IT nrows, IT ncols, bool row_major); \
+  template void Distr_MMIO_Dense_local_destroy(Dense_local<IT, VT> **dense); \
+  template Dense_local<IT, VT>* Distr_MMIO_Dense_local_read(const char *filename, bool row_major, Matrix_Metadata* meta); \
+  template Dense_local<IT, VT>* Distr_MMIO_Dense_local_read_source(Distr_MMIO_Source *src, bool is_bmtx, bool row_major, Matrix_Metadata* meta); \
+  template Dense_local<IT, VT>* Distr_MMIO_Dense_local_map(const char *filename, Matrix_Metadata* meta); \
+  template int Distr_MMIO_Dense_local_write(Dense_local<IT, VT>* dense, const char *filename, bool write_as_binary, Matrix_Metadata* meta); \
+  template int Distr_MMIO_Dense_local_write_f(Dense_local<IT, VT>* dense, FILE *f, bool write_as_binary, Matrix_Metadata* meta); \
+  MMIO_EXPLICIT_TEMPLATE_INST_OT(IT, VT, IT)
+
+// Instantiations depending on the offsets type, OT can differ from IT (e.g. 64 bits offsets, 32 bits indices)
+#define MMIO_EXPLICIT_TEMPLATE_INST_OT(IT, VT, OT) \
+  template uint64_t Distr_MMIO_CSR_local_footprint<IT, VT, OT>(const Matrix_Metadata* meta, bool expl_val_for_bin_mtx); \
+  template uint64_t Distr_MMIO_COO_local_footprint<IT, VT, OT>(const Matrix_Metadata* meta, bool expl_val_for_bin_mtx); \
+  template CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_create(IT nrows, IT ncols, OT nnz, bool alloc_val); \
+  template void Distr_MMIO_CSR_local_destroy(CSR_local<IT, VT, OT> **csr); \
+  template COO_local<IT, VT, OT>* Distr_MMIO_COO_local_create(IT nrows, IT ncols, OT nnz, bool alloc_val); \
+  template void Distr_MMIO_COO_local_destroy(COO_local<IT, VT, OT> **coo); \
+  template void entries_to_local_csr(Entry<IT, VT> *entries, CSR_local<IT, VT, OT> *csr, Distr_MMIO_Structure *structure, bool is_sorted); \
+  template CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read_reordered(const char *filename, MM_REORDER order, IT **perm, bool persist_perm, bool expl_val_for_bin_mtx, Matrix_Metadata* meta); \
+  template void entries_to_local_coo(Entry<IT, VT> *entries, COO_local<IT, VT, OT> *coo); \
+  template int write_binary_matrix_market(FILE *f, COO_local<IT, VT, OT> *coo, Matrix_Metadata *meta, MM_SORT_ORDER sort_order); \
+  template bool Distr_MMIO_narrow_val_encoding(COO_local<IT, VT, OT>* coo, Matrix_Metadata* meta); \
+  template bool Distr_MMIO_narrow_val_encoding(CSR_local<IT, VT, OT>* csr, Matrix_Metadata* meta); \
+  template CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read(const char *filename, bool expl_val_for_bin_mtx, Matrix_Metadata* meta); \
+  template CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read_f(FILE *f, bool is_bmtx, bool expl_val_for_bin_mtx, Matrix_Metadata* meta); \
+  template CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read_source(Distr_MMIO_Source *src, bool is_bmtx, bool expl_val_for_bin_mtx, Matrix_Metadata* meta); \
+  template int Distr_MMIO_CSR_local_write(CSR_local<IT, VT, OT>* csr, const char *filename, bool write_as_binary, bool write_triangle, Matrix_Metadata* meta); \
+  template int Distr_MMIO_CSR_local_write_f(CSR_local<IT, VT, OT>* csr, FILE *f, bool write_as_binary, bool write_triangle, Matrix_Metadata* meta); \
+  template COO_local<IT, VT, OT>* Distr_MMIO_COO_local_read(const char *filename, bool expl_val_for_bin_mtx, Matrix_Metadata* meta); \
+  template COO_local<IT, VT, OT>* Distr_MMIO_COO_local_read_f(FILE *f, bool is_bmtx, bool expl_val_for_bin_mtx, Matrix_Metadata* meta); \
+  template COO_local<IT, VT, OT>* Distr_MMIO_COO_local_read_source(Distr_MMIO_Source *src, bool is_bmtx, bool expl_val_for_bin_mtx, Matrix_Metadata* meta); \
+  template int Distr_MMIO_COO_local_write(COO_local<IT, VT, OT>* coo, const char *filename, bool write_as_binary, Matrix_Metadata* meta); \
+  template int Distr_MMIO_COO_local_write_f(COO_local<IT, VT, OT>* coo, FILE *f, bool write_as_binary, Matrix_Metadata* meta);\
+  template COO_local<IT, VT, OT>* Distr_MMIO_sorted_COO_local_read(const char *filename, bool fail_if_require_sort, bool expl_val_for_bin_mtx, Matrix_Metadata* meta, MM_SORT_ORDER order); \
+  template COO_local<IT, VT, OT>* Distr_MMIO_sorted_COO_local_read_f(FILE *f, bool fail_if_require_sort, bool is_bmtx, bool is_sbmtx, bool expl_val_for_bin_mtx, Matrix_Metadata* meta, MM_SORT_ORDER order); \
+  template COO_local<IT, VT, OT>* Distr_MMIO_sorted_COO_local_read_source(Distr_MMIO_Source *src, bool fail_if_require_sort, bool is_bmtx, bool is_sbmtx, bool expl_val_for_bin_mtx, Matrix_Metadata* meta, MM_SORT_ORDER order); \
+  template int Distr_MMIO_sorted_COO_local_write(COO_local<IT, VT, OT>* coo, const char *filename, bool write_as_binary, Matrix_Metadata* meta); \
+  template int Distr_MMIO_sorted_COO_local_write_f(COO_local<IT, VT, OT>* coo, FILE *f, bool write_as_binary, Matrix_Metadata* meta); \
+  template COO_local<IT, VT, OT>* Distr_MMIO_compressed_COO_local_read_rows(const char *filename, IT row_begin, IT row_end, bool expl_val_for_bin_mtx, Matrix_Metadata* meta); \
+  template int Distr_MMIO_compressed_COO_local_write(COO_local<IT, VT, OT>* coo, const char *filename, Matrix_Metadata* meta); \
+  template int Distr_MMIO_compressed_COO_local_write_f(COO_local<IT, VT, OT>* coo, FILE *f, Matrix_Metadata* meta); \
+  template COO_local<IT, VT, OT>* Distr_MMIO_COO_local_read_submatrix(const char *filename, const Distr_MMIO_Submatrix *sub, bool expl_val_for_bin_mtx, Matrix_Metadata* meta); \
+  template COO_local<IT, VT, OT>* Distr_MMIO_COO_local_read_submatrix_source(Distr_MMIO_Source *src, const Distr_MMIO_Submatrix *sub, bool is_bmtx, bool is_sbmtx, bool expl_val_for_bin_mtx, Matrix_Metadata* meta); \
+  template CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read_submatrix(const char *filename, const Distr_MMIO_Submatrix *sub, bool expl_val_for_bin_mtx, Matrix_Metadata* meta); \
+  template CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read_submatrix_source(Distr_MMIO_Source *src, const Distr_MMIO_Submatrix *sub, bool is_bmtx, bool is_sbmtx, bool expl_val_for_bin_mtx, Matrix_Metadata* meta); \
+  template int Distr_MMIO_CSR_local_write_sharded(CSR_local<IT, VT, OT>* csr, const char *manifest_filename, int nshards, Matrix_Metadata* meta); \
+  template CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read_sharded(const char *manifest_filename, bool verify_checksums, bool expl_val_for_bin_mtx, Matrix_Metadata* meta); \
+  template COO_local<IT, VT, OT>* Distr_MMIO_COO_local_read_graph(const char *filename, const Distr_MMIO_Graph_Options *opts, bool expl_val_for_bin_mtx, Matrix_Metadata* meta); \
+  template COO_local<IT, VT, OT>* Distr_MMIO_COO_local_read_graph_source(Distr_MMIO_Source *src, const Distr_MMIO_Graph_Options *opts, bool expl_val_for_bin_mtx, Matrix_Metadata* meta); \
+  template CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read_graph(const char *filename, const Distr_MMIO_Graph_Options *opts, bool expl_val_for_bin_mtx, Matrix_Metadata* meta); \
+  template CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read_graph_source(Distr_MMIO_Source *src, const Distr_MMIO_Graph_Options *opts, bool expl_val_for_bin_mtx, Matrix_Metadata* meta); \
+  template int Distr_MMIO_COO_local_append(COO_local<IT, VT, OT>* coo, const char *filename, Matrix_Metadata* meta); \
+  template int Distr_MMIO_compact<IT, VT, OT>(const char *log_filename, const char *sorted_filename, Matrix_Metadata* meta); \
+  template SELL_local<IT, VT, OT>* Distr_MMIO_SELL_local_read(const char *filename, IT C, IT sigma, Matrix_Metadata* meta); \
+  template SELL_local<IT, VT, OT>* Distr_MMIO_SELL_local_from_COO(COO_local<IT, VT, OT>* coo, IT C, IT sigma); \
+  template int Distr_MMIO_SELL_local_write(SELL_local<IT, VT, OT>* sell, const char *filename); \
+  template void Distr_MMIO_SELL_local_destroy(SELL_local<IT, VT, OT> **sell); \
+  template BSR_local<IT, VT, OT>* Distr_MMIO_BSR_local_read(const char *filename, IT block_size, Matrix_Metadata* meta); \
+  template BSR_local<IT, VT, OT>* Distr_MMIO_BSR_local_from_COO(COO_local<IT, VT, OT>* coo, IT block_size); \
+  template int Distr_MMIO_BSR_local_write(BSR_local<IT, VT, OT>* bsr, const char *filename); \
+  template void Distr_MMIO_BSR_local_destroy(BSR_local<IT, VT, OT> **bsr); \
+  template CSR_view<IT, VT, OT>* Distr_MMIO_CSR_view_open(const char *filename, bool persist_index, Matrix_Metadata* meta); \
+  template void Distr_MMIO_CSR_view_close(CSR_view<IT, VT, OT> **view); \
+  template uint64_t Distr_MMIO_CSR_view_row(const CSR_view<IT, VT, OT>* view, IT i, IT* col, VT* val); \
+  template void Distr_MMIO_CSR_view_for_each_row(const CSR_view<IT, VT, OT>* view, IT row_begin, IT row_end, \
+                                                 const std::function<void(IT row, const IT* col, const VT* val, uint64_t length)>& f); \
+  template void Distr_MMIO_CSR_view_prefetch(const CSR_view<IT, VT, OT>* view, const IT* rows, uint64_t nrows); \
+  MMIO_MPI_TEMPLATE_INST(IT, VT, OT)
+
+#ifdef DISTR_MMIO_WITH_MPI
+#define MMIO_MPI_TEMPLATE_INST(IT, VT, OT) \
+  template int Distr_MMIO_CSR_write_collective(CSR_local<IT, VT, OT>* csr, const char *filename, MPI_Comm comm, Matrix_Metadata* meta);
+#else
+#define MMIO_MPI_TEMPLATE_INST(IT, VT, OT)
+#endif
 
   // template Entry<IT, VT>* mm_parse_file(FILE *f);
   // template int compare_entries_csr(const void *a, const void *b);
 
+/**
+ * Read/write statistics
+ */
+
+#define MM_PROGRESS_ENTRIES   (1UL << 16)  // Entries between two progress callbacks
+#define MM_IO_CHUNK_BYTES     (64UL << 20) // Binary data is read in chunks of this size
+
+static thread_local Distr_MMIO_Stats *mm_stats = NULL;
+static thread_local double mm_stats_start = 0.0;
+static thread_local uint64_t mm_live_bytes = 0;
+static thread_local std::unordered_map<void *, size_t> mm_live_allocs; // Tracked only while stats are enabled
+static thread_local Distr_MMIO_Progress_Callback mm_progress_callback = NULL;
+static thread_local void *mm_progress_ctx = NULL;
+static thread_local int mm_last_error = 0;
+
+// Records the error of a failed parse (Distr_MMIO_last_error), for the readers that only return NULL
+template<typename IT, typename VT>
+static inline Entry<IT, VT> *mm_parse_failed(int err) {
+  mm_last_error = err;
+  return NULL;
+}
+
+void Distr_MMIO_set_stats(Distr_MMIO_Stats *stats) {
+  mm_stats = stats;
+}
+
+Distr_MMIO_Stats *Distr_MMIO_get_stats() {
+  return mm_stats;
+}
+
+int Distr_MMIO_last_error() {
+  return mm_last_error;
+}
+
+void Distr_MMIO_set_progress_callback(Distr_MMIO_Progress_Callback callback, void *ctx) {
+  mm_progress_callback = callback;
+  mm_progress_ctx = ctx;
+}
+
+const char *Distr_MMIO_phase_name(MM_PHASE phase) {
+  switch (phase) {
+    case MM_PHASE_BANNER:              return "banner";
+    case MM_PHASE_SIZE_LINE:           return "size line";
+    case MM_PHASE_DATA_IO:             return "data I/O";
+    case MM_PHASE_DECODE:              return "decode";
+    case MM_PHASE_SYMMETRIC_EXPANSION: return "symmetric expansion";
+    case MM_PHASE_SORT:                return "sort";
+    case MM_PHASE_ASSEMBLY:            return "assembly";
+    case MM_PHASE_ENCODE:              return "encode";
+    case MM_PHASE_FREE:                return "free";
+    case MM_PHASE_REORDER:             return "reorder";
+    case MM_PHASE_CANONICALIZATION:    return "canonicalization";
+    default:                           return "unknown";
+  }
+}
+
+static inline double mm_clock() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Phases are timed only when stats are enabled
+static inline double mm_phase_begin() {
+  return mm_stats != NULL ? mm_clock() : 0.0;
+}
+
+static inline void mm_phase_end(MM_PHASE phase, double begin) {
+  if (mm_stats != NULL) mm_stats->phase_seconds[phase] += mm_clock() - begin;
+}
+
+static inline bool mm_progress(MM_PHASE phase, uint64_t done, uint64_t total) {
+  return mm_progress_callback == NULL || mm_progress_callback(phase, done, total, mm_progress_ctx);
+}
+
+static void mm_stats_begin() {
+  if (mm_stats == NULL) return;
+  memset(mm_stats, 0, sizeof(Distr_MMIO_Stats));
+#ifdef _OPENMP
+  mm_stats->threads = omp_get_max_threads();
+#else
+  mm_stats->threads = 1;
+#endif
+  mm_live_bytes = 0;
+  mm_live_allocs.clear();
+  mm_stats_start = mm_clock();
+}
+
+static void mm_stats_end(uint64_t entries) {
+  if (mm_stats == NULL) return;
+  mm_stats->total_seconds = mm_clock() - mm_stats_start;
+  mm_stats->entries = entries;
+  if (mm_stats->total_seconds > 0) {
+    mm_stats->gb_per_s = (mm_stats->bytes_read + mm_stats->bytes_written) / mm_stats->total_seconds / 1e9;
+    mm_stats->entries_per_s = entries / mm_stats->total_seconds;
+  }
+  mm_live_allocs.clear();
+}
+
+static inline void mm_stats_bytes_read(uint64_t bytes) {
+  if (mm_stats != NULL) mm_stats->bytes_read += bytes;
+}
+
+static inline void mm_stats_bytes_written(FILE *f) {
+  long pos = ftell(f);
+  if (mm_stats != NULL && pos > 0) mm_stats->bytes_written += pos;
+}
+
+/*
+ * fread of large buffers split in chunks, so that progress is reported and cancellation honoured.
+ */
+static int mm_fread_chunked(uint8_t *buffer, size_t bytes, FILE *f) {
+  for (size_t done = 0; done < bytes;) {
+    if (!mm_progress(MM_PHASE_DATA_IO, done, bytes)) return MM_CANCELLED;
+    size_t chunk = std::min(MM_IO_CHUNK_BYTES, bytes - done);
+    if (fread(buffer + done, 1, chunk, f) != chunk) return MM_PREMATURE_EOF;
+    done += chunk;
+  }
+  mm_stats_bytes_read(bytes);
+  return 0;
+}
+
+/**
+ * Memory allocation
+ */
+
+static void *mm_malloc_alloc(size_t bytes, void *ctx) {
+  (void)ctx;
+  return malloc(bytes);
+}
+
+static void *mm_aligned_alloc(size_t bytes, void *ctx) {
+  (void)ctx;
+  void *ptr = NULL;
+  return posix_memalign(&ptr, MM_ALLOC_ALIGNMENT, bytes) == 0 ? ptr : NULL;
+}
+
+static void *mm_huge_pages_alloc(size_t bytes, void *ctx) {
+  (void)ctx;
+  if (bytes < MM_HUGE_PAGE_SIZE) return mm_aligned_alloc(bytes, ctx);
+  void *ptr = NULL;
+  if (posix_memalign(&ptr, MM_HUGE_PAGE_SIZE, bytes) != 0) return NULL;
+#ifdef MADV_HUGEPAGE
+  madvise(ptr, bytes, MADV_HUGEPAGE); // Only a hint, failures are not relevant
+#endif
+  return ptr;
+}
+
+static void mm_std_free(void *ptr, void *ctx) {
+  (void)ctx;
+  free(ptr);
+}
+
+static Distr_MMIO_Allocator mm_allocator = {mm_malloc_alloc, mm_std_free, NULL, false};
+static thread_local const Distr_MMIO_Allocator *mm_thread_allocator = NULL; // Overrides mm_allocator when set
+
+static inline const Distr_MMIO_Allocator &mm_current_allocator() {
+  return mm_thread_allocator != NULL ? *mm_thread_allocator : mm_allocator;
+}
+
+Distr_MMIO_Allocator Distr_MMIO_builtin_allocator(MM_ALLOCATOR kind, bool first_touch) {
+  switch (kind) {
+    case MM_ALLOCATOR_ALIGNED:    return {mm_aligned_alloc, mm_std_free, NULL, first_touch};
+    case MM_ALLOCATOR_HUGE_PAGES: return {mm_huge_pages_alloc, mm_std_free, NULL, first_touch};
+    default:                      return {mm_malloc_alloc, mm_std_free, NULL, first_touch};
+  }
+}
+
+void Distr_MMIO_set_allocator(const Distr_MMIO_Allocator *allocator) {
+  mm_allocator = allocator != NULL ? *allocator : Distr_MMIO_builtin_allocator(MM_ALLOCATOR_MALLOC, false);
+}
+
+Distr_MMIO_Allocator Distr_MMIO_get_allocator() {
+  return mm_current_allocator();
+}
+
+const Distr_MMIO_Allocator *Distr_MMIO_set_thread_allocator(const Distr_MMIO_Allocator *allocator) {
+  const Distr_MMIO_Allocator *prev = mm_thread_allocator;
+  mm_thread_allocator = allocator;
+  return prev;
+}
+
+static void *mm_alloc_with(void *(*alloc)(size_t, void *), size_t bytes) {
+  const Distr_MMIO_Allocator &allocator = mm_current_allocator();
+  void *ptr = alloc(bytes, allocator.ctx);
+  if (ptr != NULL && mm_stats != NULL) {
+    mm_live_allocs[ptr] = bytes;
+    mm_live_bytes += bytes;
+    mm_stats->peak_bytes_allocated = std::max(mm_stats->peak_bytes_allocated, mm_live_bytes);
+  }
+  if (ptr == NULL || !allocator.first_touch) return ptr;
+
+  // Touch the pages with the same static partition used to fill the arrays, so they are placed on the NUMA node of the thread writing them
+  const size_t page = 4096;
+  size_t npages = (bytes + page - 1) / page;
+  #pragma omp parallel for schedule(static)
+  for (size_t p = 0; p < npages; ++p) {
+    memset((uint8_t *)ptr + p * page, 0, std::min(page, bytes - p * page));
+  }
+  return ptr;
+}
+
+void *mm_alloc(size_t bytes) {
+  return mm_alloc_with(mm_current_allocator().alloc, bytes);
+}
+
+/*
+ * For the SIMD-oriented formats, released with mm_free_aligned. Whatever the allocator, blocks are allocated larger
+ * and the array starts at the first aligned address after the start of the block, which is stored just before it:
+ * the layout does not depend on the allocator set when the array is released.
+ */
+static void *mm_alloc_aligned(size_t bytes) {
+  uint8_t *block = (uint8_t *)mm_alloc(bytes + MM_ALLOC_ALIGNMENT + sizeof(void *));
+  if (block == NULL) return NULL;
+  uintptr_t aligned = ((uintptr_t)block + sizeof(void *) + MM_ALLOC_ALIGNMENT - 1) & ~(uintptr_t)(MM_ALLOC_ALIGNMENT - 1);
+  ((void **)aligned)[-1] = block;
+  return (void *)aligned;
+}
+
+void mm_free(void *ptr) {
+  if (ptr == NULL) return;
+  if (mm_stats != NULL) {
+    auto it = mm_live_allocs.find(ptr);
+    if (it != mm_live_allocs.end()) {
+      mm_live_bytes -= it->second;
+      mm_live_allocs.erase(it);
+    }
+  }
+  const Distr_MMIO_Allocator &allocator = mm_current_allocator();
+  allocator.free(ptr, allocator.ctx);
+}
+
+static void mm_free_aligned(void *ptr) {
+  if (ptr == NULL) return;
+  mm_free(((void **)ptr)[-1]);
+}
+
+/**
+ * I/O sources
+ */
+
+static inline int mm_max_threads() {
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+#define MM_PREAD_CHUNK_BYTES  (8UL << 20)  // Large reads from seekable sources are split in chunks read in parallel
+#define MM_TEXT_WINDOW_BYTES  (64UL << 20) // Text entries are parsed in windows of this size
+#define MM_READ_AHEAD_BYTES   (64UL << 10) // Minimum size of the buffered reads (header lines)
+
+struct mm_fd_ctx {
+  int fd;
+  bool close_fd;
+};
+
+static int64_t mm_fd_read(void *ctx, void *buf, uint64_t bytes) {
+  ssize_t n;
+  do {
+    n = read(((mm_fd_ctx *)ctx)->fd, buf, bytes);
+  } while (n < 0 && errno == EINTR);
+  return n;
+}
+
+static int64_t mm_fd_pread(void *ctx, void *buf, uint64_t bytes, uint64_t offset) {
+  ssize_t n;
+  do {
+    n = pread(((mm_fd_ctx *)ctx)->fd, buf, bytes, offset);
+  } while (n < 0 && errno == EINTR);
+  return n;
+}
+
+static void mm_fd_close(void *ctx) {
+  mm_fd_ctx *fd_ctx = (mm_fd_ctx *)ctx;
+  if (fd_ctx->close_fd) close(fd_ctx->fd);
+  delete fd_ctx;
+}
+
+static int64_t mm_stream_read(void *ctx, void *buf, uint64_t bytes) {
+  size_t n = fread(buf, 1, bytes, (FILE *)ctx);
+  return n > 0 || !ferror((FILE *)ctx) ? (int64_t)n : -1;
+}
+
+static void mm_munmap_close(void *ctx) {
+  Distr_MMIO_Source *src = (Distr_MMIO_Source *)ctx;
+  if (src->size > 0) munmap((void *)src->data, src->size);
+  delete src;
+}
+
+int Distr_MMIO_source_memory(const void *data, uint64_t size, Distr_MMIO_Source *src) {
+  *src = {NULL, NULL, NULL, NULL, (const uint8_t *)data, size};
+  return 0;
+}
+
+int Distr_MMIO_source_fd(int fd, bool close_fd, Distr_MMIO_Source *src) {
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) return MM_COULD_NOT_READ_FILE;
+  bool seekable = S_ISREG(st.st_mode) || S_ISBLK(st.st_mode);
+  uint64_t start = 0;
+  if (seekable) {
+    off_t pos = lseek(fd, 0, SEEK_CUR);
+    seekable = pos >= 0;
+    start = pos;
+  }
+  mm_fd_ctx *ctx = new mm_fd_ctx{fd, close_fd};
+  if (seekable && start == 0) {
+    *src = {mm_fd_read, mm_fd_pread, mm_fd_close, ctx, NULL, (uint64_t)st.st_size};
+  } else { // Positional reads would ignore the current position of the descriptor
+    *src = {mm_fd_read, NULL, mm_fd_close, ctx, NULL, MM_SOURCE_UNKNOWN_SIZE};
+  }
+  return 0;
+}
+
+int Distr_MMIO_source_mmap(const char *filename, Distr_MMIO_Source *src) {
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Could not open file [%s] (read).\n", filename);
+    return mm_last_error = MM_COULD_NOT_READ_FILE;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return mm_last_error = MM_COULD_NOT_READ_FILE;
+  }
+  void *data = NULL;
+  if (st.st_size > 0) {
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      fprintf(stderr, "Could not map file [%s].\n", filename);
+      close(fd);
+      return mm_last_error = MM_COULD_NOT_READ_FILE;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL); // Only a hint
+  }
+  close(fd); // The mapping stays valid
+  Distr_MMIO_Source *mapping = new Distr_MMIO_Source{NULL, NULL, NULL, NULL, (const uint8_t *)data, (uint64_t)st.st_size};
+  *src = {NULL, NULL, mm_munmap_close, mapping, (const uint8_t *)data, (uint64_t)st.st_size};
+  return 0;
+}
+
+int Distr_MMIO_source_file(const char *filename, Distr_MMIO_Source *src) {
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Could not open file [%s] (read).\n", filename);
+    return mm_last_error = MM_COULD_NOT_READ_FILE;
+  }
+  int err = Distr_MMIO_source_fd(fd, true, src);
+  if (err != 0) {
+    close(fd);
+    mm_last_error = err;
+  }
+  return err;
+}
+
+int Distr_MMIO_source_stream(FILE *f, Distr_MMIO_Source *src) {
+  if (f == NULL) return MM_COULD_NOT_READ_FILE;
+  *src = {mm_stream_read, NULL, NULL, f, NULL, MM_SOURCE_UNKNOWN_SIZE};
+  return 0;
+}
+
+void Distr_MMIO_source_close(Distr_MMIO_Source *src) {
+  if (src->close != NULL) src->close(src->ctx);
+  *src = {NULL, NULL, NULL, NULL, NULL, 0};
+}
+
+/*
+ * Buffered reader over a source, used by all the parsing functions. It keeps its own position (so seekable sources
+ * are only accessed with pread) and exposes the data as contiguous windows: in-memory sources are never copied.
+ */
+class mm_reader {
+public:
+  explicit mm_reader(Distr_MMIO_Source *src) : src(src) {}
+  ~mm_reader() { mm_free(buf); }
+
+  uint64_t position() const { return pos; }
+
+  uint64_t size() const { return src->size; } // MM_SOURCE_UNKNOWN_SIZE for streams
+
+  // Up to want bytes (less only at the end of the source) starting at the current position, without consuming them
+  const uint8_t *window(uint64_t want, uint64_t *got) {
+    if (src->data != NULL) {
+      *got = src->size > pos ? std::min(want, src->size - pos) : 0;
+      return src->data + pos;
+    }
+    if (tail - head < want && !eof) {
+      uint64_t size = std::max(want, MM_READ_AHEAD_BYTES);
+      if (size > cap) {
+        uint8_t *bigger = (uint8_t *)mm_alloc(size);
+        if (tail > head) memcpy(bigger, buf + head, tail - head);
+        mm_free(buf);
+        buf = bigger;
+        cap = size;
+      } else if (head > 0 && tail > head) {
+        memmove(buf, buf + head, tail - head);
+      }
+      tail -= head;
+      head = 0;
+      int64_t n = fetch(buf + tail, cap - tail, pos + tail); // Offset of buf[0] is pos
+      if (n < 0) error = true;
+      if (n < (int64_t)(cap - tail)) eof = true; // Short reads only happen at the end (or on errors)
+      if (n > 0) {
+        tail += n;
+        mm_stats_bytes_read(n);
+      }
+    }
+    *got = std::min(want, tail - head);
+    return buf + head;
+  }
+
+  void consume(uint64_t n) {
+    if (src->data == NULL) head += n;
+    else mm_stats_bytes_read(n);
+    pos += n;
+  }
+
+  // Like fgets: the line (with its '\n') is copied in line, truncated to size - 1 bytes
+  bool getline(char *line, size_t size) {
+    uint64_t got;
+    const uint8_t *w = window(size - 1, &got);
+    if (got == 0) return false;
+    const uint8_t *nl = (const uint8_t *)memchr(w, '\n', got);
+    uint64_t len = nl != NULL ? nl - w + 1 : got;
+    memcpy(line, w, len);
+    line[len] = '\0';
+    consume(len);
+    return true;
+  }
+
+  int peek() {
+    uint64_t got;
+    const uint8_t *w = window(1, &got);
+    return got > 0 ? w[0] : EOF;
+  }
+
+  // Exactly bytes bytes. In-memory data is returned in place, otherwise it is read (in parallel chunks from seekable
+  // sources) in a buffer returned in owned, that the caller must release with mm_free
+  int view(uint64_t bytes, const uint8_t **data, uint8_t **owned) {
+    *owned = NULL;
+    if (src->data != NULL) {
+      if (src->size < pos || src->size - pos < bytes) return MM_PREMATURE_EOF;
+      *data = src->data + pos;
+      consume(bytes);
+      return 0;
+    }
+    *owned = (uint8_t *)mm_alloc(bytes);
+    int err = read(*owned, bytes);
+    if (err != 0) {
+      mm_free(*owned);
+      *owned = NULL;
+      return err;
+    }
+    *data = *owned;
+    return 0;
+  }
+
+  int read(uint8_t *dst, uint64_t bytes) {
+    if (src->data != NULL) {
+      if (src->size < pos || src->size - pos < bytes) return MM_PREMATURE_EOF;
+      memcpy(dst, src->data + pos, bytes);
+      consume(bytes);
+      return 0;
+    }
+    uint64_t buffered = std::min(bytes, tail - head);
+    if (buffered > 0) memcpy(dst, buf + head, buffered);
+    consume(buffered);
+    if (bytes == buffered) return 0;
+    int err = fetch_all(dst + buffered, bytes - buffered, pos);
+    if (err != 0) return err;
+    mm_stats_bytes_read(bytes - buffered);
+    pos += bytes - buffered;
+    return 0;
+  }
+
+  int skip(uint64_t bytes) {
+    if (src->data != NULL || src->pread != NULL) {
+      head += std::min(bytes, tail - head);
+      pos += bytes;
+      eof = false;
+      return 0;
+    }
+    uint8_t tmp[4096];
+    while (bytes > 0) {
+      uint64_t n = std::min<uint64_t>(bytes, sizeof(tmp));
+      int err = read(tmp, n);
+      if (err != 0) return err;
+      bytes -= n;
+    }
+    return 0;
+  }
+
+  bool failed() const { return error; }
+
+  bool seekable() const { return src->data != NULL || src->pread != NULL; }
+
+  // Copies bytes bytes at offset (at or after the current position) without moving, only for seekable sources
+  int peek_at(uint64_t offset, uint8_t *dst, uint64_t bytes) {
+    if (src->data != NULL) {
+      if (src->size < offset || src->size - offset < bytes) return MM_PREMATURE_EOF;
+      memcpy(dst, src->data + offset, bytes);
+      return 0;
+    }
+    if (src->pread == NULL) return MM_UNSUPPORTED_TYPE;
+    if (fetch(dst, bytes, offset) != (int64_t)bytes) return MM_PREMATURE_EOF;
+    mm_stats_bytes_read(bytes);
+    return 0;
+  }
+
+private:
+  // Reads until bytes are read or the source ends, returns the bytes read (-1 on errors with nothing read)
+  int64_t fetch(uint8_t *dst, uint64_t bytes, uint64_t offset) {
+    int64_t total = 0;
+    while ((uint64_t)total < bytes) {
+      int64_t n = src->pread != NULL ? src->pread(src->ctx, dst + total, bytes - total, offset + total)
+                                     : src->read(src->ctx, dst + total, bytes - total);
+      if (n < 0) return total > 0 ? total : -1;
+      if (n == 0) break;
+      total += n;
+    }
+    return total;
+  }
+
+  int fetch_all(uint8_t *dst, uint64_t bytes, uint64_t offset) {
+    if (src->pread == NULL) {
+      for (uint64_t done = 0; done < bytes;) {
+        if (!mm_progress(MM_PHASE_DATA_IO, done, bytes)) return MM_CANCELLED;
+        uint64_t chunk = std::min(MM_IO_CHUNK_BYTES, bytes - done);
+        if (fetch(dst + done, chunk, offset + done) != (int64_t)chunk) return MM_PREMATURE_EOF;
+        done += chunk;
+      }
+      return 0;
+    }
+
+    // Positional reads do not share any file position or lock, so chunks are read concurrently
+    uint64_t nchunks = (bytes + MM_PREAD_CHUNK_BYTES - 1) / MM_PREAD_CHUNK_BYTES;
+    int err = 0;
+    uint64_t done = 0;
+    #pragma omp parallel for schedule(dynamic)
+    for (uint64_t c = 0; c < nchunks; ++c) {
+      int chunk_err;
+      #pragma omp atomic read
+      chunk_err = err;
+      if (chunk_err != 0) continue;
+      uint64_t begin = c * MM_PREAD_CHUNK_BYTES, len = std::min(MM_PREAD_CHUNK_BYTES, bytes - begin);
+      if (fetch(dst + begin, len, offset + begin) != (int64_t)len) chunk_err = MM_PREMATURE_EOF;
+      uint64_t chunk_done;
+      #pragma omp atomic capture
+      chunk_done = done += len;
+      if (chunk_err == 0 && !mm_progress(MM_PHASE_DATA_IO, chunk_done, bytes)) chunk_err = MM_CANCELLED;
+      if (chunk_err != 0) {
+        #pragma omp atomic write
+        err = chunk_err;
+      }
+    }
+    return err;
+  }
+
+  Distr_MMIO_Source *src;
+  uint64_t pos = 0;
+  uint8_t *buf = NULL;
+  uint64_t cap = 0, head = 0, tail = 0;
+  bool eof = false, error = false;
+};
+
 /**
  * Matrix Market parsing utilities
  */
 
-int mm_read_banner(FILE *f, MM_typecode *matcode, bool is_bmtx, Matrix_Metadata* meta) {
-  char line[MM_MAX_LINE_LENGTH];
+static int mm_parse_banner(const char *line, MM_typecode *matcode, bool is_bmtx, Matrix_Metadata* meta) {
   char banner[MM_MAX_TOKEN_LENGTH];
   char mtx[MM_MAX_TOKEN_LENGTH];
   char crd[MM_MAX_TOKEN_LENGTH];
   char data_type[MM_MAX_TOKEN_LENGTH];
   char storage_scheme[MM_MAX_TOKEN_LENGTH];
+  char val_encoding[MM_MAX_TOKEN_LENGTH];
+  char sort_order[MM_MAX_TOKEN_LENGTH];
   uint8_t idx_bytes, val_bytes;
   char *p;
 
-  mm_clear_typecode(matcode);
-
-  if (fgets(line, MM_MAX_LINE_LENGTH, f) == NULL)
-    return MM_PREMATURE_EOF;
-
   if (meta) {
     meta->mm_header = std::string(line);
     if (!meta->mm_header.empty() && meta->mm_header.back() == '\n') {
@@ -64,10 +696,39 @@ int mm_read_banner(FILE *f, MM_typecode *matcode, bool is_bmtx, Matrix_Metadata*
   }
 
   if (is_bmtx) {
-    if (sscanf(line, "%s %s %s %s %s %hhu %hhu", banner, mtx, crd, data_type, storage_scheme, &idx_bytes, &val_bytes) != 7)
+    int n_tokens = sscanf(line, "%s %s %s %s %s %hhu %hhu %s %s", banner, mtx, crd, data_type, storage_scheme, &idx_bytes, &val_bytes, val_encoding, sort_order);
+    if (n_tokens < 7)
       return MM_PREMATURE_EOF;
     mm_set_idx_bytes(matcode, idx_bytes);
     mm_set_val_bytes(matcode, val_bytes);
+
+    /* optional values encoding */
+    if (n_tokens == 7 || strcmp(val_encoding, MM_VAL_ENC_FLOAT_STR) == 0)
+      mm_set_val_encoding(matcode, MM_VAL_ENCODING_FLOAT);
+    else if (strcmp(val_encoding, MM_VAL_ENC_HALF_STR) == 0)
+      mm_set_val_encoding(matcode, MM_VAL_ENCODING_HALF);
+    else if (strcmp(val_encoding, MM_VAL_ENC_BF16_STR) == 0)
+      mm_set_val_encoding(matcode, MM_VAL_ENCODING_BFLOAT16);
+    else if (strcmp(val_encoding, MM_VAL_ENC_INT_STR) == 0)
+      mm_set_val_encoding(matcode, MM_VAL_ENCODING_INTEGER);
+    else
+      return MM_UNSUPPORTED_TYPE;
+
+    /* optional entries order, only recorded by the writers of sorted files */
+    MM_SORT_ORDER order = MM_SORT_NONE;
+    if (n_tokens < 9)
+      order = MM_SORT_NONE;
+    else if (strcmp(sort_order, MM_SORT_ROW_MAJOR_STR) == 0)
+      order = MM_SORT_ROW_MAJOR;
+    else if (strcmp(sort_order, MM_SORT_COL_MAJOR_STR) == 0)
+      order = MM_SORT_COL_MAJOR;
+    else if (strcmp(sort_order, MM_SORT_MORTON_STR) == 0)
+      order = MM_SORT_MORTON;
+    else if (strcmp(sort_order, MM_SORT_HILBERT_STR) == 0)
+      order = MM_SORT_HILBERT;
+    else
+      return MM_UNSUPPORTED_TYPE;
+    if (meta) meta->sort_order = order;
   } else {
     if (sscanf(line, "%s %s %s %s %s", banner, mtx, crd, data_type, storage_scheme) != 5)
       return MM_PREMATURE_EOF;
@@ -127,15 +788,53 @@ int mm_read_banner(FILE *f, MM_typecode *matcode, bool is_bmtx, Matrix_Metadata*
   else
     return MM_UNSUPPORTED_TYPE;
 
+  return 0;
+}
+
+// Parses the line written by mm_write_structure_line
+static bool mm_parse_structure_line(const char *line, Distr_MMIO_Structure *s) {
+  int pos;
+  line += strlen(MM_STRUCTURE_COMMENT);
+  if (sscanf(line, "%lu %lu %lu %lu %lu %lu %lu %lu %lu%n", &s->nrows, &s->ncols, &s->nnz, &s->empty_rows,
+             &s->max_row_length, &s->bandwidth, &s->profile, &s->diagonal, &s->duplicates, &pos) != 9)
+    return false;
+  int b = 0, len;
+  for (; b < MM_ROW_LENGTH_BUCKETS && sscanf(line + pos, "%lu%n", &s->row_length_histogram[b], &len) == 1; ++b) pos += len;
+  for (; b < MM_ROW_LENGTH_BUCKETS; ++b) s->row_length_histogram[b] = 0;
+  s->avg_row_length = s->nrows > 0 ? (double)s->nnz / s->nrows : 0.0;
+  return true;
+}
+
+// Header comment lines are kept in meta, except the structural statistics of binary files which are parsed
+static void mm_read_header_line(const char *line, bool is_bmtx, Matrix_Metadata *meta) {
+  if (is_bmtx && strncmp(line, MM_STRUCTURE_COMMENT " ", strlen(MM_STRUCTURE_COMMENT) + 1) == 0)
+    meta->structure.valid = mm_parse_structure_line(line, &meta->structure);
+  else
+    meta->mm_header_body += line;
+}
+
+int mm_read_banner(FILE *f, MM_typecode *matcode, bool is_bmtx, Matrix_Metadata* meta) {
+  char line[MM_MAX_LINE_LENGTH];
+
+  mm_clear_typecode(matcode);
+
+  if (fgets(line, MM_MAX_LINE_LENGTH, f) == NULL)
+    return MM_PREMATURE_EOF;
+
+  int err = mm_parse_banner(line, matcode, is_bmtx, meta);
+  if (err != 0)
+    return err;
+
   // Read and store all header lines (starting with '%')
   if (meta) {
+    meta->structure.valid = false;
     long pos = ftell(f);
     while (fgets(line, sizeof(line), f)) {
       if (line[0] != '%') {
         fseek(f, pos, SEEK_SET); // back to start of non-comment line
         break;
       }
-      meta->mm_header_body += line;
+      mm_read_header_line(line, is_bmtx, meta);
       pos = ftell(f);
     }
   }
@@ -143,6 +842,28 @@ int mm_read_banner(FILE *f, MM_typecode *matcode, bool is_bmtx, Matrix_Metadata*
   return 0;
 }
 
+static int mm_read_banner(mm_reader &r, MM_typecode *matcode, bool is_bmtx, Matrix_Metadata* meta) {
+  char line[MM_MAX_LINE_LENGTH];
+
+  mm_clear_typecode(matcode);
+
+  if (!r.getline(line, sizeof(line)))
+    return MM_PREMATURE_EOF;
+
+  int err = mm_parse_banner(line, matcode, is_bmtx, meta);
+  if (err != 0)
+    return err;
+
+  // Read and store all header lines (starting with '%'), no need to seek back as the reader can peek
+  if (meta) {
+    meta->structure.valid = false;
+    while (r.peek() == '%' && r.getline(line, sizeof(line)))
+      mm_read_header_line(line, is_bmtx, meta);
+  }
+
+  return 0;
+}
+
 int mm_read_mtx_crd_size(FILE *f, uint64_t *nrows, uint64_t *ncols, uint64_t *nnz) {
   char line[MM_MAX_LINE_LENGTH];
   int num_items_read;
@@ -170,6 +891,44 @@ int mm_read_mtx_crd_size(FILE *f, uint64_t *nrows, uint64_t *ncols, uint64_t *nn
   return 0;
 }
 
+static int mm_read_mtx_crd_size(mm_reader &r, uint64_t *nrows, uint64_t *ncols, uint64_t *nnz) {
+  char line[MM_MAX_LINE_LENGTH];
+
+  *nrows = *ncols = *nnz = 0;
+
+  /* skip the comments and the blank lines */
+  do {
+    if (!r.getline(line, sizeof(line)))
+      return MM_PREMATURE_EOF;
+  } while (line[0] == '%' || sscanf(line, "%lu %lu %lu", nrows, ncols, nnz) != 3);
+
+  return 0;
+}
+
+static int mm_read_mtx_array_size(mm_reader &r, uint64_t *nrows, uint64_t *ncols) {
+  char line[MM_MAX_LINE_LENGTH];
+
+  *nrows = *ncols = 0;
+
+  /* skip the comments and the blank lines, the first other line must be the size */
+  do {
+    if (!r.getline(line, sizeof(line)))
+      return MM_PREMATURE_EOF;
+  } while (line[0] == '%' || line[strspn(line, " \t\r\n")] == '\0');
+
+  if (sscanf(line, "%lu %lu", nrows, ncols) != 2)
+    return MM_NOT_MTX;
+
+  return 0;
+}
+
+// Values stored by an array file: all of them, or the lower triangle of symmetric (strictly lower of skew) ones
+static uint64_t mm_array_stored_values(MM_typecode matcode, uint64_t nrows, uint64_t ncols) {
+  if (mm_is_symmetric(matcode)) return nrows * (nrows + 1) / 2;
+  if (mm_is_skew(matcode)) return nrows * (nrows - 1) / 2;
+  return nrows * ncols;
+}
+
 // FIXME this is a draft
 // template<typename IT, typename VT>
 // int parse_ascii_entries(FILE *f, int nentries, Entry<IT, VT> *entries, MM_typecode matcode) {
@@ -223,98 +982,1001 @@ int mm_read_mtx_crd_size(FILE *f, uint64_t *nrows, uint64_t *ncols, uint64_t *nn
 //   return (count == nentries) ? 0 : MM_PREMATURE_EOF;
 // }
 
-template<typename IT, typename VT>
-int mm_read_mtx_crd_data(FILE *f, int nentries, Entry<IT, VT> *entries, MM_typecode matcode, bool is_bmtx, uint8_t idx_bytes, uint8_t val_bytes) {
-  bool is_pattern = mm_is_pattern(matcode);
-
-  size_t entry_size = 2 * idx_bytes + (is_pattern ? 0 : val_bytes);
-  size_t total_size = nentries * entry_size;
-
-  if (!is_bmtx) {
-    // FIXME uncomment and test return parse_ascii_entries(f, nentries, entries, matcode);
-
-    // Original ASCII Matrix Market parsing
-    const char *I_FMT = std::is_same<IT, uint64_t>::value ? "%lu" : "%u";
-    const char *V_FMT = std::is_same<VT, double>::value   ? "%lg" : "%g";
-    char fmt[32];
-    int i;
-
-    if (mm_is_real(matcode) || mm_is_integer(matcode)) {
-      snprintf(fmt, 32, "%s %s %s", I_FMT, I_FMT, V_FMT);
-      for (i = 0; i < nentries; i++) {
-        if (fscanf(f, fmt, &entries[i].row, &entries[i].col, &entries[i].val) != 3)
-          return MM_PREMATURE_EOF;
-        --entries[i].row;
-        --entries[i].col;
-      }
-    } else if (is_pattern) {
-      snprintf(fmt, sizeof(fmt), "%s %s", I_FMT, I_FMT);
-      for (i = 0; i < nentries; i++) {
-        if (fscanf(f, fmt, &entries[i].row, &entries[i].col) != 2)
-          return MM_PREMATURE_EOF;
-        --entries[i].row;
-        --entries[i].col;
-        entries[i].val = static_cast<VT>(1.0);
-      }
-    } else return MM_UNSUPPORTED_TYPE;
+/**
+ * Binary values encoding
+ */
 
-    return 0;
+static inline uint16_t mm_float_to_half(float f) {
+  uint32_t x;
+  memcpy(&x, &f, sizeof(x));
+  uint32_t sign = (x >> 16) & 0x8000;
+  uint32_t abs = x & 0x7FFFFFFF;
+  if (abs >= 0x7F800000) // Inf or NaN
+    return sign | 0x7C00 | (abs > 0x7F800000 ? 0x200 : 0);
+  if (abs >= 0x477FF000) // Overflows to Inf
+    return sign | 0x7C00;
+  if (abs < 0x38800000) { // Subnormal or zero
+    if (abs < 0x33000000) return sign;
+    uint32_t mant = (abs & 0x7FFFFF) | 0x800000;
+    int shift = 126 - (abs >> 23);
+    uint32_t half = mant >> shift;
+    uint32_t rem = mant & ((1u << shift) - 1);
+    uint32_t mid = 1u << (shift - 1);
+    if (rem > mid || (rem == mid && (half & 1))) ++half;
+    return sign | half;
   }
+  uint32_t half = ((abs - 0x38000000) >> 13);
+  uint32_t rem = abs & 0x1FFF;
+  if (rem > 0x1000 || (rem == 0x1000 && (half & 1))) ++half;
+  return sign | half;
+}
 
-  // Binary BMTX parsing
+static inline float mm_half_to_float(uint16_t h) {
+  uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+  uint32_t exp = (h >> 10) & 0x1F;
+  uint32_t mant = h & 0x3FF;
+  uint32_t x;
+  if (exp == 0x1F) {
+    x = sign | 0x7F800000 | (mant << 13);
+  } else if (exp != 0) {
+    x = sign | ((exp + 112) << 23) | (mant << 13);
+  } else if (mant == 0) {
+    x = sign;
+  } else { // Subnormal, normalize it
+    exp = 113;
+    while (!(mant & 0x400)) { mant <<= 1; --exp; }
+    x = sign | (exp << 23) | ((mant & 0x3FF) << 13);
+  }
+  float f;
+  memcpy(&f, &x, sizeof(f));
+  return f;
+}
 
-  // Allocate buffer to read the entire data block
-  uint8_t *buffer = (uint8_t *)malloc(total_size);
-  if (!buffer) {
-    fprintf(stderr, "Failed to allocate %zu bytes for input buffer.\n", total_size);
-    return MM_COULD_NOT_READ_FILE;
+static inline uint16_t mm_float_to_bf16(float f) {
+  uint32_t x;
+  memcpy(&x, &f, sizeof(x));
+  if ((x & 0x7FFFFFFF) > 0x7F800000) return (x >> 16) | 0x40; // Keep NaN quiet
+  return (x + 0x7FFF + ((x >> 16) & 1)) >> 16;                 // Round to nearest even
+}
+
+static inline float mm_bf16_to_float(uint16_t b) {
+  uint32_t x = (uint32_t)b << 16;
+  float f;
+  memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+static inline bool mm_is_valid_val_encoding(uint8_t val_bytes, MM_VAL_ENCODING enc) {
+  switch (enc) {
+    case MM_VAL_ENCODING_FLOAT:    return val_bytes == 4 || val_bytes == 8;
+    case MM_VAL_ENCODING_HALF:
+    case MM_VAL_ENCODING_BFLOAT16: return val_bytes == 2;
+    case MM_VAL_ENCODING_INTEGER:  return val_bytes == 1 || val_bytes == 2 || val_bytes == 4 || val_bytes == 8;
   }
+  return false;
+}
 
-  if (fread(buffer, 1, total_size, f) != total_size) {
-    fprintf(stderr, "Failed to read expected %zu bytes from file.\n", total_size);
-    free(buffer);
-    return MM_PREMATURE_EOF;
+// Integer of an integer encoding: v truncated and clamped to the range of T, 0 for NaN (a plain cast of NaN, infinities
+// or values out of range is undefined)
+template<typename T>
+static inline T mm_saturate_cast(double v) {
+  if (std::isnan(v)) return 0;
+  if (v <= (double)std::numeric_limits<T>::min()) return std::numeric_limits<T>::min();
+  if (v >= (double)std::numeric_limits<T>::max()) return std::numeric_limits<T>::max();
+  return static_cast<T>(v);
+}
+
+template<typename VT>
+static inline void mm_encode_val(uint8_t *dst, VT val, uint8_t val_bytes, MM_VAL_ENCODING enc) {
+  switch (enc) {
+    case MM_VAL_ENCODING_HALF:     { uint16_t v = mm_float_to_half(static_cast<float>(val)); memcpy(dst, &v, 2); break; }
+    case MM_VAL_ENCODING_BFLOAT16: { uint16_t v = mm_float_to_bf16(static_cast<float>(val)); memcpy(dst, &v, 2); break; }
+    case MM_VAL_ENCODING_INTEGER: {
+      switch (val_bytes) {
+        case 1:  { int8_t  v = mm_saturate_cast<int8_t>(val);  memcpy(dst, &v, 1); break; }
+        case 2:  { int16_t v = mm_saturate_cast<int16_t>(val); memcpy(dst, &v, 2); break; }
+        case 4:  { int32_t v = mm_saturate_cast<int32_t>(val); memcpy(dst, &v, 4); break; }
+        default: { int64_t v = mm_saturate_cast<int64_t>(val); memcpy(dst, &v, 8); break; }
+      }
+      break;
+    }
+    default: {
+      if (val_bytes == 8) { double v = static_cast<double>(val); memcpy(dst, &v, sizeof(double)); }
+      else                { float  v = static_cast<float>(val);  memcpy(dst, &v, sizeof(float));  }
+    }
   }
+}
 
-  uint8_t *ptr = buffer;
+template<typename VT>
+static inline int mm_decode_val(const uint8_t *src, uint8_t val_bytes, MM_VAL_ENCODING enc, VT *val) {
+  switch (enc) {
+    case MM_VAL_ENCODING_HALF:     { uint16_t v; memcpy(&v, src, 2); *val = static_cast<VT>(mm_half_to_float(v)); return 0; }
+    case MM_VAL_ENCODING_BFLOAT16: { uint16_t v; memcpy(&v, src, 2); *val = static_cast<VT>(mm_bf16_to_float(v)); return 0; }
+    case MM_VAL_ENCODING_INTEGER: {
+      switch (val_bytes) {
+        case 1: { int8_t  v; memcpy(&v, src, 1); *val = static_cast<VT>(v); return 0; }
+        case 2: { int16_t v; memcpy(&v, src, 2); *val = static_cast<VT>(v); return 0; }
+        case 4: { int32_t v; memcpy(&v, src, 4); *val = static_cast<VT>(v); return 0; }
+        case 8: { int64_t v; memcpy(&v, src, 8); *val = static_cast<VT>(v); return 0; }
+      }
+      return MM_UNSUPPORTED_TYPE;
+    }
+    default: {
+      if (val_bytes == 4)      { float  v; memcpy(&v, src, sizeof(float));  *val = static_cast<VT>(v); }
+      else if (val_bytes == 8) { double v; memcpy(&v, src, sizeof(double)); *val = static_cast<VT>(v); }
+      else return MM_UNSUPPORTED_TYPE;
+    }
+  }
+  return 0;
+}
 
-  for (int i = 0; i < nentries; ++i) {
-    uint64_t row = 0, col = 0;
+/**
+ * Specialised decoders
+ *
+ * The read loops are instantiated for each index width and value format, selected once per read by the
+ * mm_dispatch_* functions, so that no branch on the format is left inside them.
+ */
 
-    // Read row
-    memcpy(&row, ptr, idx_bytes);
-    entries[i].row = static_cast<IT>(row);
-    ptr += idx_bytes;
+enum mm_val_format
+{
+  MM_VAL_FORMAT_PATTERN,
+  MM_VAL_FORMAT_F32,
+  MM_VAL_FORMAT_F64,
+  MM_VAL_FORMAT_F16,
+  MM_VAL_FORMAT_BF16,
+  MM_VAL_FORMAT_I8,
+  MM_VAL_FORMAT_I16,
+  MM_VAL_FORMAT_I32,
+  MM_VAL_FORMAT_I64
+};
+
+static int mm_get_val_format(bool is_pattern, uint8_t val_bytes, MM_VAL_ENCODING enc, mm_val_format *fmt) {
+  if (is_pattern) {
+    *fmt = MM_VAL_FORMAT_PATTERN;
+    return 0;
+  }
+  if (!mm_is_valid_val_encoding(val_bytes, enc)) return MM_UNSUPPORTED_TYPE;
+  switch (enc) {
+    case MM_VAL_ENCODING_HALF:     *fmt = MM_VAL_FORMAT_F16; break;
+    case MM_VAL_ENCODING_BFLOAT16: *fmt = MM_VAL_FORMAT_BF16; break;
+    case MM_VAL_ENCODING_INTEGER:
+      *fmt = val_bytes == 1 ? MM_VAL_FORMAT_I8 : val_bytes == 2 ? MM_VAL_FORMAT_I16 : val_bytes == 4 ? MM_VAL_FORMAT_I32 : MM_VAL_FORMAT_I64;
+      break;
+    default: *fmt = val_bytes == 4 ? MM_VAL_FORMAT_F32 : MM_VAL_FORMAT_F64;
+  }
+  return 0;
+}
 
-    // Read col
-    memcpy(&col, ptr, idx_bytes);
-    entries[i].col = static_cast<IT>(col);
-    ptr += idx_bytes;
-
-    // Read val if present
-    if (!is_pattern) {
-      if (val_bytes == 4) {
-        float val_f;
-        memcpy(&val_f, ptr, sizeof(float));
-        entries[i].val = static_cast<VT>(val_f);
-      } else if (val_bytes == 8) {
-        double val_d;
-        memcpy(&val_d, ptr, sizeof(double));
-        entries[i].val = static_cast<VT>(val_d);
-      } else {
-        free(buffer);
+template<int FMT>
+static constexpr uint8_t mm_val_format_bytes() {
+  if constexpr (FMT == MM_VAL_FORMAT_PATTERN) return 0;
+  else if constexpr (FMT == MM_VAL_FORMAT_I8) return 1;
+  else if constexpr (FMT == MM_VAL_FORMAT_F16 || FMT == MM_VAL_FORMAT_BF16 || FMT == MM_VAL_FORMAT_I16) return 2;
+  else if constexpr (FMT == MM_VAL_FORMAT_F32 || FMT == MM_VAL_FORMAT_I32) return 4;
+  else return 8;
+}
+
+template<int BYTES>
+using mm_uint_t = std::conditional_t<BYTES == 1, uint8_t, std::conditional_t<BYTES == 2, uint16_t, std::conditional_t<BYTES == 4, uint32_t, uint64_t>>>;
+
+template<int IDX_BYTES>
+static inline uint64_t mm_load_index(const uint8_t *src) {
+  mm_uint_t<IDX_BYTES> v;
+  memcpy(&v, src, IDX_BYTES);
+  return v;
+}
+
+template<typename VT, int FMT>
+static inline VT mm_load_val(const uint8_t *src) {
+  if constexpr (FMT == MM_VAL_FORMAT_PATTERN) { return static_cast<VT>(1.0); }
+  else if constexpr (FMT == MM_VAL_FORMAT_F32) { float v; memcpy(&v, src, 4); return static_cast<VT>(v); }
+  else if constexpr (FMT == MM_VAL_FORMAT_F64) { double v; memcpy(&v, src, 8); return static_cast<VT>(v); }
+  else if constexpr (FMT == MM_VAL_FORMAT_F16) { uint16_t v; memcpy(&v, src, 2); return static_cast<VT>(mm_half_to_float(v)); }
+  else if constexpr (FMT == MM_VAL_FORMAT_BF16) { uint16_t v; memcpy(&v, src, 2); return static_cast<VT>(mm_bf16_to_float(v)); }
+  else {
+    std::make_signed_t<mm_uint_t<mm_val_format_bytes<FMT>()>> v;
+    memcpy(&v, src, sizeof(v));
+    return static_cast<VT>(v);
+  }
+}
+
+template<int IDX_BYTES, typename F>
+static int mm_dispatch_val_format(mm_val_format fmt, F f) {
+  switch (fmt) {
+    case MM_VAL_FORMAT_PATTERN: return f(std::integral_constant<int, IDX_BYTES>(), std::integral_constant<int, MM_VAL_FORMAT_PATTERN>());
+    case MM_VAL_FORMAT_F32:     return f(std::integral_constant<int, IDX_BYTES>(), std::integral_constant<int, MM_VAL_FORMAT_F32>());
+    case MM_VAL_FORMAT_F64:     return f(std::integral_constant<int, IDX_BYTES>(), std::integral_constant<int, MM_VAL_FORMAT_F64>());
+    case MM_VAL_FORMAT_F16:     return f(std::integral_constant<int, IDX_BYTES>(), std::integral_constant<int, MM_VAL_FORMAT_F16>());
+    case MM_VAL_FORMAT_BF16:    return f(std::integral_constant<int, IDX_BYTES>(), std::integral_constant<int, MM_VAL_FORMAT_BF16>());
+    case MM_VAL_FORMAT_I8:      return f(std::integral_constant<int, IDX_BYTES>(), std::integral_constant<int, MM_VAL_FORMAT_I8>());
+    case MM_VAL_FORMAT_I16:     return f(std::integral_constant<int, IDX_BYTES>(), std::integral_constant<int, MM_VAL_FORMAT_I16>());
+    case MM_VAL_FORMAT_I32:     return f(std::integral_constant<int, IDX_BYTES>(), std::integral_constant<int, MM_VAL_FORMAT_I32>());
+    case MM_VAL_FORMAT_I64:     return f(std::integral_constant<int, IDX_BYTES>(), std::integral_constant<int, MM_VAL_FORMAT_I64>());
+  }
+  return MM_UNSUPPORTED_TYPE;
+}
+
+// Calls f(idx_bytes, fmt) with both as compile-time constants (std::integral_constant), returns what f returns
+template<typename F>
+static int mm_dispatch_bmtx(uint8_t idx_bytes, mm_val_format fmt, F f) {
+  switch (idx_bytes) {
+    case 1: return mm_dispatch_val_format<1>(fmt, f);
+    case 2: return mm_dispatch_val_format<2>(fmt, f);
+    case 4: return mm_dispatch_val_format<4>(fmt, f);
+    case 8: return mm_dispatch_val_format<8>(fmt, f);
+  }
+  return MM_UNSUPPORTED_TYPE;
+}
+
+static inline bool mm_is_blank(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Which text lines hold data: those starting (after blanks) with a comment character never do, blank ones only
+// with blank_lines (METIS adjacency lists, where they are vertices without neighbours)
+struct mm_line_syntax {
+  bool comment[256] = {};
+  bool blank_lines = false;
+
+  explicit mm_line_syntax(const char *comments, bool blank_lines = false) : blank_lines(blank_lines) {
+    for (const char *c = comments; c != NULL && *c != '\0'; ++c) comment[(uint8_t)*c] = true;
+  }
+
+  // p is past the leading blanks of a line
+  inline bool is_data(const char *p, const char *end) const {
+    return p == end || *p == '\n' ? blank_lines : !comment[(uint8_t)*p];
+  }
+};
+
+static const mm_line_syntax mm_mtx_syntax("%");
+
+// Lines with entries, i.e. neither blank nor comments (as defined by syn)
+static uint64_t mm_count_data_lines(const char *p, const char *end, const mm_line_syntax &syn) {
+  uint64_t count = 0;
+  while (p < end) {
+    while (p < end && mm_is_blank(*p)) ++p;
+    count += syn.is_data(p, end);
+    const char *nl = (const char *)memchr(p, '\n', end - p);
+    p = nl != NULL ? nl + 1 : end;
+  }
+  return count;
+}
+
+template<typename T>
+static inline bool mm_parse_number(const char *&p, const char *end, T *value) {
+  while (p < end && mm_is_blank(*p)) ++p;
+  if (p < end && *p == '+') ++p; // Not accepted by from_chars
+  auto res = std::from_chars(p, end, *value);
+  if (res.ec != std::errc()) return false;
+  p = res.ptr;
+  return true;
+}
+
+// Values of integer files are parsed as integers, falling back to floating point for values such as "2.0"
+template<typename VT>
+static inline bool mm_parse_integer_val(const char *&p, const char *end, VT *value) {
+  while (p < end && mm_is_blank(*p)) ++p;
+  if (p < end && *p == '+') ++p;
+  int64_t v;
+  auto res = std::from_chars(p, end, v);
+  if (res.ec == std::errc() && (res.ptr == end || mm_is_blank(*res.ptr) || *res.ptr == '\n')) {
+    *value = static_cast<VT>(v);
+    p = res.ptr;
+    return true;
+  }
+  return mm_parse_number(p, end, value);
+}
+
+/**
+ * Submatrix filters
+ */
+
+#define MM_SUBMATRIX_MAX_RUNS 4096 // Row runs searched separately in sorted files, more are read as one span
+
+// Index set resolved against a dimension: a range, or a bitmap (lists are converted) with ranks for the relabelling
+struct mm_index_filter {
+  uint64_t begin = 0, end = 0; // Every member is in [begin, end)
+  std::vector<uint64_t> bits;  // Empty for ranges
+  std::vector<uint64_t> rank;  // Members before each word of bits
+  uint64_t count = 0;
+
+  inline bool has(uint64_t i) const {
+    if (i < begin || i >= end) return false;
+    return bits.empty() || ((bits[i >> 6] >> (i & 63)) & 1);
+  }
+
+  inline uint64_t relabel(uint64_t i) const {
+    if (bits.empty()) return i - begin;
+    return rank[i >> 6] + __builtin_popcountll(bits[i >> 6] & ((1ULL << (i & 63)) - 1));
+  }
+};
+
+static int mm_resolve_index_set(const Distr_MMIO_Index_Set *set, uint64_t n, mm_index_filter *f) {
+  f->bits.clear();
+  f->rank.clear();
+  switch (set->kind) {
+    case MM_INDEX_SET_ALL:
+      f->begin = 0;
+      f->end = n;
+      break;
+    case MM_INDEX_SET_RANGE:
+      f->begin = std::min(set->begin, n);
+      f->end = std::max(f->begin, std::min(set->end, n));
+      break;
+    case MM_INDEX_SET_BITMAP:
+    case MM_INDEX_SET_LIST: {
+      if ((set->kind == MM_INDEX_SET_BITMAP ? (const void *)set->bitmap : (const void *)set->list) == NULL && set->size > 0)
         return MM_UNSUPPORTED_TYPE;
+      uint64_t words = (n + 63) / 64;
+      f->bits.assign(words, 0);
+      if (set->kind == MM_INDEX_SET_BITMAP) {
+        uint64_t m = std::min(set->size, n);
+        if (m > 0) memcpy(f->bits.data(), set->bitmap, (m + 63) / 64 * sizeof(uint64_t));
+        if (m % 64 != 0) f->bits[m / 64] &= (1ULL << (m % 64)) - 1;
+      } else {
+        for (uint64_t i = 0; i < set->size; ++i) {
+          if (set->list[i] < n) f->bits[set->list[i] >> 6] |= 1ULL << (set->list[i] & 63);
+        }
       }
-      ptr += val_bytes;
-    } else {
-      entries[i].val = static_cast<VT>(1.0);  // Default for pattern
+      f->rank.resize(words);
+      f->count = 0;
+      f->begin = f->end = 0;
+      for (uint64_t w = 0; w < words; ++w) {
+        f->rank[w] = f->count;
+        if (f->bits[w] == 0) continue;
+        if (f->count == 0) f->begin = w * 64 + __builtin_ctzll(f->bits[w]);
+        f->end = w * 64 + 64 - __builtin_clzll(f->bits[w]);
+        f->count += __builtin_popcountll(f->bits[w]);
+      }
+      return 0;
+    }
+    default:
+      return MM_UNSUPPORTED_TYPE;
+  }
+  f->count = f->end - f->begin;
+  return 0;
+}
+
+struct mm_submatrix_filter {
+  mm_index_filter rows, cols;
+  bool symmetric; // Stored entries of symmetric files also stand for their mirror
+
+  inline bool keep(uint64_t row, uint64_t col) const { return rows.has(row) && cols.has(col); }
+  inline bool keep_stored(uint64_t row, uint64_t col) const { return keep(row, col) || (symmetric && keep(col, row)); }
+
+  // Sorted, disjoint [begin, end) row runs covering every stored entry that can be kept
+  void stored_row_runs(std::vector<std::pair<uint64_t, uint64_t>> &runs) const {
+    runs.clear();
+    if (rows.count == 0 || cols.count == 0) return;
+    if (symmetric) { // The row of a stored entry can be in either set
+      runs.push_back({std::min(rows.begin, cols.begin), std::max(rows.end, cols.end)});
+      return;
+    }
+    if (!rows.bits.empty()) {
+      for (uint64_t i = rows.begin; i < rows.end && runs.size() <= MM_SUBMATRIX_MAX_RUNS; ++i) {
+        if (!rows.has(i)) continue;
+        uint64_t j = i + 1;
+        while (j < rows.end && rows.has(j)) ++j;
+        runs.push_back({i, j});
+        i = j;
+      }
+      if (runs.size() <= MM_SUBMATRIX_MAX_RUNS) return;
+      runs.clear();
+    }
+    runs.push_back({rows.begin, rows.end});
+  }
+};
+
+/*
+ * Growing array of the entries kept by a filtered read. Data is decoded in windows split among the threads: each
+ * part is decoded where it would go without filtering, keeping only the entries of the submatrix, and the parts are
+ * then packed. So only the kept entries (plus one window) are ever stored.
+ */
+template<typename IT, typename VT>
+struct mm_kept_entries {
+  Entry<IT, VT> *data = NULL;
+  uint64_t n = 0, cap = 0;
+
+  void reserve(uint64_t extra) {
+    if (n + extra <= cap) return;
+    uint64_t size = 2 * n + extra; // Grows with the kept entries, not with the windows
+    Entry<IT, VT> *bigger = (Entry<IT, VT> *)mm_alloc(size * sizeof(Entry<IT, VT>));
+    if (n > 0) memcpy(bigger, data, n * sizeof(Entry<IT, VT>));
+    mm_free(data);
+    data = bigger;
+    cap = size;
+  }
+
+  // Part c has kept[c] entries at data + n + offset[c]
+  void pack(const uint64_t *offset, const uint64_t *kept, uint64_t nparts) {
+    uint64_t base = n;
+    for (uint64_t c = 0; c < nparts; ++c) {
+      if (n != base + offset[c]) memmove(data + n, data + base + offset[c], kept[c] * sizeof(Entry<IT, VT>));
+      n += kept[c];
+    }
+  }
+};
+
+/*
+ * Parses the text entries of [p, end), starting from entry first and stopping at entry last. With a filter, only
+ * the entries of the submatrix are stored (from entries[first] on) and kept is set to their number. Returns false
+ * on malformed lines.
+ */
+template<typename IT, typename VT, MM_VAL_TYPE VALS, bool FILTERED>
+static bool mm_parse_text_lines(const char *p, const char *end, Entry<IT, VT> *entries, uint64_t first, uint64_t last,
+                                const mm_submatrix_filter *filter, uint64_t *kept) {
+  uint64_t k = first;
+  for (uint64_t i = first; i < last && p < end;) {
+    while (p < end && mm_is_blank(*p)) ++p;
+    if (p < end && *p != '\n' && *p != '%') {
+      uint64_t row, col;
+      if (!mm_parse_number(p, end, &row) || !mm_parse_number(p, end, &col)) return false;
+      ++i;
+      if constexpr (FILTERED) {
+        if (!filter->keep_stored(row - 1, col - 1)) {
+          const char *nl = (const char *)memchr(p, '\n', end - p);
+          p = nl != NULL ? nl + 1 : end;
+          continue;
+        }
+      }
+      entries[k].row = static_cast<IT>(row - 1);
+      entries[k].col = static_cast<IT>(col - 1);
+      if constexpr (VALS == MM_VAL_TYPE_PATTERN) {
+        entries[k].val = static_cast<VT>(1.0);
+      } else if constexpr (VALS == MM_VAL_TYPE_INTEGER) {
+        if (!mm_parse_integer_val(p, end, &entries[k].val)) return false;
+      } else {
+        if (!mm_parse_number(p, end, &entries[k].val)) return false;
+      }
+      ++k;
+    }
+    const char *nl = (const char *)memchr(p, '\n', end - p);
+    p = nl != NULL ? nl + 1 : end;
+  }
+  if (kept != NULL) *kept = k - first;
+  return true;
+}
+
+#define MM_UNKNOWN_LINES UINT64_MAX // Data lines of files without sizes, parsed up to the end of the source
+
+/*
+ * Text data is parsed window by window: each window (cut at its last full line) is split among the threads, which
+ * count their lines first, so that each one knows where its entries go. parse(w, bounds, first) then parses the
+ * window in parallel: chunk c is [w + bounds[c], w + bounds[c + 1]) and holds the lines first[c] to first[c + 1]
+ * (counted from the start of the data), it returns 0 or a MM_* error code. With MM_UNKNOWN_LINES, the data ends
+ * with the source.
+ */
+template<typename ParseWindow>
+static int mm_read_text_windows(mm_reader &r, uint64_t nlines, ParseWindow parse, const mm_line_syntax &syn = mm_mtx_syntax) {
+  int nthreads = mm_max_threads();
+  std::vector<uint64_t> bounds(nthreads + 1), first(nthreads + 1);
+  for (uint64_t done = 0; done < nlines;) {
+    if (!(nlines == MM_UNKNOWN_LINES ? mm_progress(MM_PHASE_DECODE, r.position(), r.size())
+                                     : mm_progress(MM_PHASE_DECODE, done, nlines)))
+      return MM_CANCELLED;
+
+    double t = mm_phase_begin();
+    uint64_t len;
+    const char *w = (const char *)r.window(MM_TEXT_WINDOW_BYTES, &len);
+    mm_phase_end(MM_PHASE_DATA_IO, t);
+    if (r.failed()) return MM_COULD_NOT_READ_FILE;
+    if (len == 0) return nlines == MM_UNKNOWN_LINES ? 0 : MM_PREMATURE_EOF;
+    if (len == MM_TEXT_WINDOW_BYTES) { // Not at the end of the source: leave the last partial line to the next window
+      const char *last_nl = (const char *)memrchr(w, '\n', len);
+      if (last_nl == NULL) return MM_PREMATURE_EOF; // Line longer than a window
+      len = last_nl - w + 1;
+    }
+
+    t = mm_phase_begin();
+    bounds[0] = 0;
+    for (int c = 1; c < nthreads; ++c) {
+      uint64_t b = std::max(bounds[c - 1], len / nthreads * c);
+      const char *nl = b < len ? (const char *)memchr(w + b, '\n', len - b) : NULL;
+      bounds[c] = nl != NULL ? nl - w + 1 : len;
+    }
+    bounds[nthreads] = len;
+
+    #pragma omp parallel for schedule(static)
+    for (int c = 0; c < nthreads; ++c) first[c + 1] = mm_count_data_lines(w + bounds[c], w + bounds[c + 1], syn);
+    first[0] = done;
+    for (int c = 0; c < nthreads; ++c) first[c + 1] += first[c];
+
+    int err = parse(w, bounds, first);
+    mm_phase_end(MM_PHASE_DECODE, t);
+    if (err != 0) return err;
+
+    r.consume(len);
+    done = std::min(first[nthreads], nlines);
+  }
+  return 0;
+}
+
+/*
+ * Parses nentries text entries with mm_read_text_windows. With a filter, the entries of the submatrix are appended
+ * to out instead of being stored in entries.
+ */
+template<typename IT, typename VT, MM_VAL_TYPE VALS, bool FILTERED>
+static int mm_read_text_entries(mm_reader &r, uint64_t nentries, Entry<IT, VT> *entries, const mm_submatrix_filter *filter,
+                                mm_kept_entries<IT, VT> *out) {
+  int nthreads = mm_max_threads();
+  std::vector<uint64_t> offset(nthreads), kept(nthreads);
+  return mm_read_text_windows(r, nentries, [&](const char *w, const std::vector<uint64_t> &bounds, const std::vector<uint64_t> &first) {
+    // Filtered entries are parsed after the kept ones, entry i of the window going (at most) to dst[i - done]
+    uint64_t done = first[0];
+    Entry<IT, VT> *dst = entries;
+    uint64_t shift = 0;
+    if (filter != NULL) {
+      out->reserve(std::min(first[nthreads], nentries) - done);
+      dst = out->data + out->n;
+      shift = done;
+    }
+
+    bool ok = true;
+    #pragma omp parallel for schedule(static) reduction(&&:ok)
+    for (int c = 0; c < nthreads; ++c) {
+      offset[c] = first[c] - done;
+      kept[c] = 0;
+      if (first[c] < nentries)
+        ok = mm_parse_text_lines<IT, VT, VALS, FILTERED>(w + bounds[c], w + bounds[c + 1], dst, first[c] - shift,
+                                                         std::min(first[c + 1], nentries) - shift, filter, &kept[c]);
+    }
+    if (filter != NULL) out->pack(offset.data(), kept.data(), nthreads);
+    return ok ? 0 : MM_PREMATURE_EOF;
+  });
+}
+
+// Selects the text parser for the value type and the filtering
+template<typename IT, typename VT>
+static int mm_read_text_entries(mm_reader &r, uint64_t nentries, Entry<IT, VT> *entries, MM_typecode matcode,
+                                const mm_submatrix_filter *filter = NULL, mm_kept_entries<IT, VT> *out = NULL) {
+  if (mm_is_pattern(matcode)) {
+    return filter != NULL ? mm_read_text_entries<IT, VT, MM_VAL_TYPE_PATTERN, true>(r, nentries, entries, filter, out)
+                          : mm_read_text_entries<IT, VT, MM_VAL_TYPE_PATTERN, false>(r, nentries, entries, filter, out);
+  } else if (mm_is_integer(matcode)) {
+    return filter != NULL ? mm_read_text_entries<IT, VT, MM_VAL_TYPE_INTEGER, true>(r, nentries, entries, filter, out)
+                          : mm_read_text_entries<IT, VT, MM_VAL_TYPE_INTEGER, false>(r, nentries, entries, filter, out);
+  } else if (mm_is_real(matcode)) {
+    return filter != NULL ? mm_read_text_entries<IT, VT, MM_VAL_TYPE_REAL, true>(r, nentries, entries, filter, out)
+                          : mm_read_text_entries<IT, VT, MM_VAL_TYPE_REAL, false>(r, nentries, entries, filter, out);
+  }
+  return MM_UNSUPPORTED_TYPE;
+}
+
+template<typename IT, typename VT>
+static int mm_read_mtx_crd_data(mm_reader &r, uint64_t nentries, Entry<IT, VT> *entries, MM_typecode matcode, bool is_bmtx, uint8_t idx_bytes, uint8_t val_bytes) {
+  if (!is_bmtx) return mm_read_text_entries(r, nentries, entries, matcode);
+
+  // Binary BMTX parsing
+  bool is_pattern = mm_is_pattern(matcode);
+  mm_val_format fmt;
+  if (mm_get_val_format(is_pattern, val_bytes, mm_get_val_encoding(matcode), &fmt) != 0) return MM_UNSUPPORTED_TYPE;
+  size_t entry_size = 2 * idx_bytes + (is_pattern ? 0 : val_bytes);
+  size_t total_size = nentries * entry_size;
+
+  // In-memory data is decoded in place, otherwise it is read in a buffer
+  const uint8_t *data;
+  uint8_t *buffer;
+  double t = mm_phase_begin();
+  int err = r.view(total_size, &data, &buffer);
+  if (err != 0) {
+    if (err == MM_PREMATURE_EOF) fprintf(stderr, "Failed to read expected %zu bytes from file.\n", total_size);
+    return err;
+  }
+  mm_phase_end(MM_PHASE_DATA_IO, t);
+
+  t = mm_phase_begin();
+  err = mm_dispatch_bmtx(idx_bytes, fmt, [&](auto ib, auto vf) {
+    constexpr int IB = decltype(ib)::value, VF = decltype(vf)::value;
+    constexpr size_t ENTRY_SIZE = 2 * IB + mm_val_format_bytes<VF>();
+    #pragma omp parallel for schedule(static)
+    for (uint64_t i = 0; i < nentries; ++i) {
+      const uint8_t *ptr = data + i * ENTRY_SIZE;
+      entries[i].row = static_cast<IT>(mm_load_index<IB>(ptr));
+      entries[i].col = static_cast<IT>(mm_load_index<IB>(ptr + IB));
+      entries[i].val = mm_load_val<VT, VF>(ptr + 2 * IB); // 1 for pattern matrices
+    }
+    return 0;
+  });
+  mm_phase_end(MM_PHASE_DECODE, t);
+
+  t = mm_phase_begin();
+  mm_free(buffer);
+  mm_phase_end(MM_PHASE_FREE, t);
+  return err;
+}
+
+template<typename IT, typename VT>
+int mm_read_mtx_crd_data(FILE *f, int nentries, Entry<IT, VT> *entries, MM_typecode matcode, bool is_bmtx, uint8_t idx_bytes, uint8_t val_bytes) {
+  Distr_MMIO_Source src;
+  if (Distr_MMIO_source_stream(f, &src) != 0) return MM_COULD_NOT_READ_FILE;
+  mm_reader r(&src);
+  return mm_read_mtx_crd_data(r, (uint64_t)nentries, entries, matcode, is_bmtx, idx_bytes, val_bytes);
+}
+
+/**
+ * Compressed BMTX (.cbmtx) encoding
+ *
+ * After the size line the file contains:
+ *   uint64_t nblocks, uint32_t block_entries, uint32_t codec
+ *   CBMTX_Block_Info index[nblocks]
+ *   block payloads
+ * Each payload is: varint nruns, nruns x (varint row delta, varint run length),
+ * nnz x varint column (absolute on the first entry of a run, delta otherwise),
+ * nnz x val_bytes raw values (absent for pattern matrices).
+ */
+
+static inline void cbmtx_put_varint(std::vector<uint8_t> &out, uint64_t v) {
+  while (v >= 0x80) {
+    out.push_back(static_cast<uint8_t>(v) | 0x80);
+    v >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(v));
+}
+
+static inline bool cbmtx_get_varint(const uint8_t *&ptr, const uint8_t *end, uint64_t *v) {
+  uint64_t res = 0;
+  for (int shift = 0; shift < 64 && ptr < end; shift += 7) {
+    uint8_t byte = *ptr++;
+    res |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      *v = res;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Varint with a fast path for the one byte values, which most of the column gaps of a block are
+static inline bool cbmtx_get_small_varint(const uint8_t *&ptr, const uint8_t *end, uint64_t *v) {
+  if (ptr < end && *ptr < 0x80) {
+    *v = *ptr++;
+    return true;
+  }
+  return cbmtx_get_varint(ptr, end, v);
+}
+
+/*
+ * Decodes one block, instantiated per value format (selected once per read with mm_dispatch_val_format): indices
+ * are varints, whose width is in the data itself, values are loaded with a fixed-size memcpy.
+ */
+template<typename IT, typename VT, int FMT>
+static int cbmtx_decode_block(const uint8_t *src, const CBMTX_Block_Info *blk, Entry<IT, VT> *entries) {
+  const uint8_t *ptr = src;
+  const uint8_t *end = src + blk->size;
+
+  uint64_t nruns, row = blk->first_row, k = 0;
+  if (!cbmtx_get_varint(ptr, end, &nruns)) return MM_PREMATURE_EOF;
+  for (uint64_t r = 0; r < nruns; ++r) {
+    uint64_t delta, len;
+    if (!cbmtx_get_small_varint(ptr, end, &delta) || !cbmtx_get_varint(ptr, end, &len)) return MM_PREMATURE_EOF;
+    row += delta;
+    if (k + len > blk->nnz) return MM_PREMATURE_EOF;
+    for (uint64_t i = 0; i < len; ++i) entries[k++].row = static_cast<IT>(row);
+  }
+  if (k != blk->nnz) return MM_PREMATURE_EOF;
+
+  uint64_t col = 0;
+  for (uint64_t i = 0; i < blk->nnz; ++i) {
+    uint64_t v;
+    if (!cbmtx_get_small_varint(ptr, end, &v)) return MM_PREMATURE_EOF;
+    col = (i == 0 || entries[i].row != entries[i - 1].row) ? v : col + v;
+    entries[i].col = static_cast<IT>(col);
+  }
+
+  constexpr uint8_t val_bytes = mm_val_format_bytes<FMT>();
+  if ((uint64_t)(end - ptr) < blk->nnz * val_bytes) return MM_PREMATURE_EOF;
+  for (uint64_t i = 0; i < blk->nnz; ++i) entries[i].val = mm_load_val<VT, FMT>(ptr + i * val_bytes);
+  return 0;
+}
+
+template<typename IT, typename VT>
+using cbmtx_block_decoder = int (*)(const uint8_t *, const CBMTX_Block_Info *, Entry<IT, VT> *);
+
+template<typename IT, typename VT>
+static int cbmtx_get_block_decoder(MM_typecode matcode, uint8_t val_bytes, cbmtx_block_decoder<IT, VT> *decode) {
+  mm_val_format fmt;
+  *decode = NULL;
+  if (mm_get_val_format(mm_is_pattern(matcode), val_bytes, mm_get_val_encoding(matcode), &fmt) != 0) return MM_UNSUPPORTED_TYPE;
+  return mm_dispatch_val_format<0>(fmt, [&](auto, auto vf) {
+    *decode = cbmtx_decode_block<IT, VT, decltype(vf)::value>;
+    return 0;
+  });
+}
+
+/*
+ * Reads the block index of a CBMTX file, leaving the reader at the start of the payload. The index comes from the
+ * file and the blocks are located with it, so it is checked first: the nnz entries of the size line are split in
+ * blocks of block_entries entries, in order, whose payloads follow each other inside the source.
+ */
+static int cbmtx_read_index(mm_reader &r, uint64_t nnz, std::vector<CBMTX_Block_Info> &index) {
+  uint64_t nblocks;
+  uint32_t block_entries, codec;
+  if (r.read((uint8_t *)&nblocks, sizeof(nblocks)) != 0 ||
+      r.read((uint8_t *)&block_entries, sizeof(block_entries)) != 0 ||
+      r.read((uint8_t *)&codec, sizeof(codec)) != 0)
+    return MM_PREMATURE_EOF;
+  if (codec != CBMTX_CODEC_NONE) {
+    fprintf(stderr, "CBMTX: unsupported block codec (%u).\n", codec);
+    return MM_UNSUPPORTED_TYPE;
+  }
+  // The payload size is only known for files and buffers, streams end with MM_PREMATURE_EOF instead
+  uint64_t remaining = r.size() != MM_SOURCE_UNKNOWN_SIZE && r.size() > r.position() ? r.size() - r.position() : 0;
+  if (block_entries == 0 || nblocks != nnz / block_entries + (nnz % block_entries != 0) ||
+      (r.size() != MM_SOURCE_UNKNOWN_SIZE && nblocks > remaining / sizeof(CBMTX_Block_Info))) {
+    fprintf(stderr, "CBMTX: corrupt block index (%lu blocks for %lu entries).\n", nblocks, nnz);
+    return MM_NOT_MTX;
+  }
+
+  index.resize(nblocks);
+  if (r.read((uint8_t *)index.data(), nblocks * sizeof(CBMTX_Block_Info)) != 0)
+    return MM_PREMATURE_EOF;
+  uint64_t payload = r.size() != MM_SOURCE_UNKNOWN_SIZE ? remaining - nblocks * sizeof(CBMTX_Block_Info) : UINT64_MAX;
+  uint64_t next_entry = 0, next_byte = 0, last_row = 0;
+  for (uint64_t b = 0; b < nblocks; ++b) {
+    const CBMTX_Block_Info &blk = index[b];
+    if (blk.first_entry != next_entry || blk.nnz == 0 || blk.nnz > block_entries || blk.nnz > nnz - next_entry ||
+        blk.offset < next_byte || blk.offset > payload || blk.size > payload - blk.offset ||
+        blk.first_row > blk.last_row || blk.first_row < last_row) {
+      fprintf(stderr, "CBMTX: corrupt block index (block %lu).\n", b);
+      return MM_NOT_MTX;
+    }
+    next_entry += blk.nnz;
+    next_byte = blk.offset + blk.size;
+    last_row = blk.last_row;
+  }
+  if (next_entry != nnz) {
+    fprintf(stderr, "CBMTX: corrupt block index (%lu entries in the blocks, %lu in the size line).\n", next_entry, nnz);
+    return MM_NOT_MTX;
+  }
+  return 0;
+}
+
+// Number of entries a CBMTX read of rows [row_begin, row_end) will decode
+static uint64_t cbmtx_count_entries(const std::vector<CBMTX_Block_Info> &index, uint64_t row_begin, uint64_t row_end) {
+  uint64_t count = 0;
+  for (const CBMTX_Block_Info &blk : index) {
+    if (blk.last_row >= row_begin && blk.first_row < row_end) count += blk.nnz;
+  }
+  return count;
+}
+
+/*
+ * Reads the blocks of a CBMTX file that overlap rows [row_begin, row_end), the reader must be at the start of the
+ * payload. Entries outside the range are dropped, nread is set to the number of entries kept. Blocks are decoded
+ * in parallel.
+ */
+template<typename IT, typename VT>
+static int mm_read_cbmtx_data(mm_reader &r, const std::vector<CBMTX_Block_Info> &index, Entry<IT, VT> *entries,
+                              MM_typecode matcode, uint8_t val_bytes, uint64_t row_begin, uint64_t row_end, uint64_t *nread) {
+  // Blocks are row-major sorted, select the contiguous range overlapping the requested rows
+  uint64_t nblocks = index.size();
+  uint64_t b_begin = 0, b_end = nblocks;
+  while (b_begin < nblocks && index[b_begin].last_row < row_begin) ++b_begin;
+  while (b_end > b_begin && index[b_end - 1].first_row >= row_end) --b_end;
+  *nread = 0;
+  if (b_begin == b_end) return 0;
+  cbmtx_block_decoder<IT, VT> decode;
+  int err = cbmtx_get_block_decoder(matcode, val_bytes, &decode);
+  if (err != 0) return err;
+
+  uint64_t first_byte = index[b_begin].offset;
+  uint64_t total_size = index[b_end - 1].offset + index[b_end - 1].size - first_byte;
+  const uint8_t *data;
+  uint8_t *buffer;
+  double t = mm_phase_begin();
+  err = r.skip(first_byte);
+  if (err == 0) err = r.view(total_size, &data, &buffer);
+  if (err != 0) {
+    if (err == MM_PREMATURE_EOF) fprintf(stderr, "Failed to read expected %lu bytes from file.\n", total_size);
+    return err;
+  }
+  mm_phase_end(MM_PHASE_DATA_IO, t);
+
+  t = mm_phase_begin();
+  uint64_t first_entry = index[b_begin].first_entry;
+  #pragma omp parallel for schedule(dynamic)
+  for (uint64_t b = b_begin; b < b_end; ++b) {
+    int block_err = decode(data + index[b].offset - first_byte, &index[b], entries + index[b].first_entry - first_entry);
+    if (block_err != 0) {
+      #pragma omp atomic write
+      err = block_err;
+    }
+  }
+  mm_phase_end(MM_PHASE_DECODE, t);
+  t = mm_phase_begin();
+  mm_free(buffer);
+  mm_phase_end(MM_PHASE_FREE, t);
+  if (err != 0) return err;
+  if (!mm_progress(MM_PHASE_DECODE, b_end - b_begin, b_end - b_begin)) return MM_CANCELLED;
+
+  uint64_t n = index[b_end - 1].first_entry + index[b_end - 1].nnz - first_entry;
+  if (row_begin > index[b_begin].first_row || row_end <= index[b_end - 1].last_row) {
+    uint64_t kept = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+      uint64_t row = (uint64_t)entries[i].row;
+      if (row >= row_begin && row < row_end) entries[kept++] = entries[i];
+    }
+    n = kept;
+  }
+  *nread = n;
+  return 0;
+}
+
+/*
+ * Decodes the next nentries binary entries, window by window, appending those of the submatrix to out.
+ */
+template<typename IT, typename VT>
+static int mm_read_bmtx_filtered(mm_reader &r, uint64_t nentries, MM_typecode matcode, uint8_t idx_bytes, uint8_t val_bytes,
+                                 const mm_submatrix_filter *filter, mm_kept_entries<IT, VT> *out) {
+  bool is_pattern = mm_is_pattern(matcode);
+  mm_val_format fmt;
+  if (mm_get_val_format(is_pattern, val_bytes, mm_get_val_encoding(matcode), &fmt) != 0) return MM_UNSUPPORTED_TYPE;
+  uint64_t entry_size = 2 * idx_bytes + (is_pattern ? 0 : val_bytes);
+  uint64_t window_entries = std::max<uint64_t>(1, MM_TEXT_WINDOW_BYTES / entry_size);
+  int nthreads = mm_max_threads();
+  std::vector<uint64_t> offset(nthreads), kept(nthreads);
+
+  for (uint64_t done = 0; done < nentries;) {
+    if (!mm_progress(MM_PHASE_DECODE, done, nentries)) return MM_CANCELLED;
+    uint64_t n = std::min(window_entries, nentries - done), got;
+    double t = mm_phase_begin();
+    const uint8_t *w = r.window(n * entry_size, &got);
+    mm_phase_end(MM_PHASE_DATA_IO, t);
+    if (r.failed()) return MM_COULD_NOT_READ_FILE;
+    if (got < n * entry_size) {
+      fprintf(stderr, "Failed to read expected %lu bytes from file.\n", n * entry_size);
+      return MM_PREMATURE_EOF;
     }
+
+    t = mm_phase_begin();
+    out->reserve(n);
+    Entry<IT, VT> *dst = out->data + out->n;
+    int err = mm_dispatch_bmtx(idx_bytes, fmt, [&](auto ib, auto vf) {
+      constexpr int IB = decltype(ib)::value, VF = decltype(vf)::value;
+      constexpr size_t ENTRY_SIZE = 2 * IB + mm_val_format_bytes<VF>();
+      #pragma omp parallel for schedule(static)
+      for (int c = 0; c < nthreads; ++c) {
+        uint64_t begin = n * c / nthreads, end = n * (c + 1) / nthreads, k = begin;
+        for (uint64_t i = begin; i < end; ++i) {
+          const uint8_t *ptr = w + i * ENTRY_SIZE;
+          uint64_t row = mm_load_index<IB>(ptr), col = mm_load_index<IB>(ptr + IB);
+          if (!filter->keep_stored(row, col)) continue;
+          dst[k].row = static_cast<IT>(row);
+          dst[k].col = static_cast<IT>(col);
+          dst[k].val = mm_load_val<VT, VF>(ptr + 2 * IB);
+          ++k;
+        }
+        offset[c] = begin;
+        kept[c] = k - begin;
+      }
+      return 0;
+    });
+    out->pack(offset.data(), kept.data(), nthreads);
+    mm_phase_end(MM_PHASE_DECODE, t);
+    if (err != 0) return err;
+
+    r.consume(n * entry_size);
+    done += n;
+  }
+  return 0;
+}
+
+// First of the nentries binary entries at the current position whose row is not below row (row-major sorted data)
+static int mm_bmtx_lower_bound(mm_reader &r, uint64_t nentries, uint64_t entry_size, uint8_t idx_bytes, uint64_t row,
+                               uint64_t *found) {
+  uint64_t lo = 0, hi = nentries;
+  while (lo < hi) {
+    uint64_t mid = lo + (hi - lo) / 2, mid_row = 0;
+    int err = r.peek_at(r.position() + mid * entry_size, (uint8_t *)&mid_row, idx_bytes);
+    if (err != 0) return err;
+    if (mid_row < row) lo = mid + 1;
+    else hi = mid;
+  }
+  *found = lo;
+  return 0;
+}
+
+/*
+ * Decodes the CBMTX blocks holding rows of the submatrix (selected from the block index, the others are skipped),
+ * in groups of contiguous blocks decoded in parallel, appending the entries of the submatrix to out.
+ */
+template<typename IT, typename VT>
+static int mm_read_cbmtx_filtered(mm_reader &r, uint64_t nnz, MM_typecode matcode, uint8_t val_bytes, const mm_submatrix_filter *filter,
+                                  mm_kept_entries<IT, VT> *out) {
+  std::vector<CBMTX_Block_Info> index;
+  int err = cbmtx_read_index(r, nnz, index);
+  if (err != 0) return err;
+  uint64_t payload = r.position();
+
+  std::vector<std::pair<uint64_t, uint64_t>> runs;
+  filter->stored_row_runs(runs);
+  std::vector<uint64_t> blocks;
+  for (uint64_t b = 0, k = 0; b < index.size() && k < runs.size();) {
+    if (runs[k].second <= index[b].first_row) ++k;
+    else if (runs[k].first > index[b].last_row) ++b;
+    else blocks.push_back(b++);
   }
 
-  free(buffer);
+  cbmtx_block_decoder<IT, VT> decode;
+  err = cbmtx_get_block_decoder(matcode, val_bytes, &decode);
+  if (err != 0) return err;
+  uint64_t group_blocks = std::max<uint64_t>(mm_max_threads(), MM_TEXT_WINDOW_BYTES / (CBMTX_BLOCK_ENTRIES * sizeof(Entry<IT, VT>)));
+  std::vector<uint64_t> offset, kept;
+  for (uint64_t g = 0; g < blocks.size();) {
+    if (!mm_progress(MM_PHASE_DECODE, g, blocks.size())) return MM_CANCELLED;
+    uint64_t h = g + 1;
+    while (h < blocks.size() && h - g < group_blocks && blocks[h] == blocks[h - 1] + 1) ++h;
+    const CBMTX_Block_Info &first = index[blocks[g]], &last = index[blocks[h - 1]];
+
+    const uint8_t *data;
+    uint8_t *buffer;
+    double t = mm_phase_begin();
+    err = r.skip(payload + first.offset - r.position());
+    if (err == 0) err = r.view(last.offset + last.size - first.offset, &data, &buffer);
+    if (err != 0) return err;
+    mm_phase_end(MM_PHASE_DATA_IO, t);
+
+    t = mm_phase_begin();
+    out->reserve(last.first_entry + last.nnz - first.first_entry);
+    Entry<IT, VT> *dst = out->data + out->n;
+    offset.resize(h - g);
+    kept.resize(h - g);
+    #pragma omp parallel for schedule(dynamic)
+    for (uint64_t i = g; i < h; ++i) {
+      const CBMTX_Block_Info *blk = &index[blocks[i]];
+      Entry<IT, VT> *e = dst + blk->first_entry - first.first_entry;
+      int block_err = decode(data + blk->offset - first.offset, blk, e);
+      uint64_t k = 0;
+      if (block_err == 0) {
+        for (uint64_t j = 0; j < blk->nnz; ++j) {
+          if (filter->keep_stored(e[j].row, e[j].col)) e[k++] = e[j];
+        }
+      } else {
+        #pragma omp atomic write
+        err = block_err;
+      }
+      offset[i - g] = blk->first_entry - first.first_entry;
+      kept[i - g] = k;
+    }
+    out->pack(offset.data(), kept.data(), h - g);
+    mm_phase_end(MM_PHASE_DECODE, t);
+    t = mm_phase_begin();
+    mm_free(buffer);
+    mm_phase_end(MM_PHASE_FREE, t);
+    if (err != 0) return err;
+    g = h;
+  }
   return 0;
 }
 
+/*
+ * Reads the stored entries of a submatrix into out. Row-major sorted binary data (.sbmtx) on seekable sources is
+ * binary searched for the row runs of the submatrix and CBMTX blocks are selected from their index, so the rest
+ * of the file is never read.
+ */
+template<typename IT, typename VT>
+static int mm_read_submatrix_entries(mm_reader &r, uint64_t nentries, MM_typecode matcode, bool is_bmtx, bool sorted_rows,
+                                     uint8_t idx_bytes, uint8_t val_bytes, const mm_submatrix_filter *filter,
+                                     mm_kept_entries<IT, VT> *out) {
+  if (!is_bmtx) return mm_read_text_entries<IT, VT>(r, nentries, NULL, matcode, filter, out);
+  if (idx_bytes == MM_IDX_BYTES_COMPRESSED) return mm_read_cbmtx_filtered(r, nentries, matcode, val_bytes, filter, out);
+  if (!sorted_rows || !r.seekable()) return mm_read_bmtx_filtered(r, nentries, matcode, idx_bytes, val_bytes, filter, out);
+
+  uint64_t entry_size = 2 * idx_bytes + (mm_is_pattern(matcode) ? 0 : val_bytes);
+  std::vector<std::pair<uint64_t, uint64_t>> runs;
+  filter->stored_row_runs(runs);
+  uint64_t current = 0; // Entries before the current position
+  for (const std::pair<uint64_t, uint64_t> &run : runs) {
+    uint64_t begin, end;
+    int err = mm_bmtx_lower_bound(r, nentries - current, entry_size, idx_bytes, run.first, &begin);
+    if (err == 0) err = r.skip(begin * entry_size);
+    if (err == 0) err = mm_bmtx_lower_bound(r, nentries - current - begin, entry_size, idx_bytes, run.second, &end);
+    if (err == 0) err = mm_read_bmtx_filtered(r, end, matcode, idx_bytes, val_bytes, filter, out);
+    if (err != 0) return err;
+    current += begin + end;
+  }
+  return 0;
+}
 
 int required_bytes_index(uint64_t maxval) {
   if (maxval <= UINT8_MAX)  return 1;
@@ -329,74 +1991,74 @@ int required_bytes_index(uint64_t maxval) {
 
 // CSR
 
-template<typename IT, typename VT>
-CSR_local<IT, VT>* Distr_MMIO_CSR_local_create(IT nrows, IT ncols, IT nnz, bool alloc_val) {
-  CSR_local<IT, VT> *csr = (CSR_local<IT, VT> *)malloc(sizeof(CSR_local<IT, VT>));
+template<typename IT, typename VT, typename OT>
+CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_create(IT nrows, IT ncols, OT nnz, bool alloc_val) {
+  CSR_local<IT, VT, OT> *csr = (CSR_local<IT, VT, OT> *)mm_alloc(sizeof(CSR_local<IT, VT, OT>));
   csr->nrows = nrows;
   csr->ncols = ncols;
   csr->nnz = nnz;
-  csr->row_ptr = (IT *)malloc((nrows + 1) * sizeof(IT));
-  csr->col_idx = (IT *)malloc(nnz * sizeof(IT));
+  csr->row_ptr = (OT *)mm_alloc((nrows + 1) * sizeof(OT));
+  csr->col_idx = (IT *)mm_alloc(nnz * sizeof(IT));
   csr->val = NULL;
   if (alloc_val) {
-    csr->val = (VT *)malloc(nnz * sizeof(VT));
+    csr->val = (VT *)mm_alloc(nnz * sizeof(VT));
   }
   return csr;
 }
 
-template<typename IT, typename VT>
-void Distr_MMIO_CSR_local_destroy(CSR_local<IT, VT> **csr) {
+template<typename IT, typename VT, typename OT>
+void Distr_MMIO_CSR_local_destroy(CSR_local<IT, VT, OT> **csr) {
   if (*csr != NULL) {
     if ((*csr)->row_ptr != NULL) {
-      free((*csr)->row_ptr);
+      mm_free((*csr)->row_ptr);
       (*csr)->row_ptr = NULL;
     }
     if ((*csr)->col_idx != NULL) {
-      free((*csr)->col_idx);
+      mm_free((*csr)->col_idx);
       (*csr)->col_idx = NULL;
     }
     if ((*csr)->val != NULL) {
-      free((*csr)->val);
+      mm_free((*csr)->val);
       (*csr)->val = NULL;
     }
-    free(*csr);
+    mm_free(*csr);
     *csr = NULL;
   }
 }
 
 // COO
 
-template<typename IT, typename VT>
-COO_local<IT, VT>* Distr_MMIO_COO_local_create(IT nrows, IT ncols, IT nnz, bool alloc_val) {
-  COO_local<IT, VT> *coo = (COO_local<IT, VT> *)malloc(sizeof(COO_local<IT, VT>));
+template<typename IT, typename VT, typename OT>
+COO_local<IT, VT, OT>* Distr_MMIO_COO_local_create(IT nrows, IT ncols, OT nnz, bool alloc_val) {
+  COO_local<IT, VT, OT> *coo = (COO_local<IT, VT, OT> *)mm_alloc(sizeof(COO_local<IT, VT, OT>));
   coo->nrows = nrows;
   coo->ncols = ncols;
   coo->nnz = nnz;
-  coo->row = (IT *)malloc(nnz * sizeof(IT));
-  coo->col = (IT *)malloc(nnz * sizeof(IT));
+  coo->row = (IT *)mm_alloc(nnz * sizeof(IT));
+  coo->col = (IT *)mm_alloc(nnz * sizeof(IT));
   coo->val = NULL;
   if (alloc_val) {
-    coo->val = (VT *)malloc(nnz * sizeof(VT));
+    coo->val = (VT *)mm_alloc(nnz * sizeof(VT));
   }
   return coo;
 }
 
-template<typename IT, typename VT>
-void Distr_MMIO_COO_local_destroy(COO_local<IT, VT> **coo) {
+template<typename IT, typename VT, typename OT>
+void Distr_MMIO_COO_local_destroy(COO_local<IT, VT, OT> **coo) {
   if (*coo != NULL) {
     if ((*coo)->row != NULL) {
-      free((*coo)->row);
+      mm_free((*coo)->row);
       (*coo)->row = NULL;
     }
     if ((*coo)->col != NULL) {
-      free((*coo)->col);
+      mm_free((*coo)->col);
       (*coo)->col = NULL;
     }
     if ((*coo)->val != NULL) {
-      free((*coo)->val);
+      mm_free((*coo)->val);
       (*coo)->val = NULL;
     }
-    free(*coo);
+    mm_free(*coo);
     *coo = NULL;
   }
 }
@@ -411,37 +2073,110 @@ template<typename IT, typename VT>
 int compare_entries_csr(const void *a, const void *b) {
   Entry<IT, VT> *ea = (Entry<IT, VT> *)a;
   Entry<IT, VT> *eb = (Entry<IT, VT> *)b;
+  // Not a subtraction, which overflows int for 64-bit (and large unsigned 32-bit) indices
   if (ea->row != eb->row)
-    return ea->row - eb->row;
-  return ea->col - eb->col;
+    return (ea->row > eb->row) - (ea->row < eb->row);
+  return (ea->col > eb->col) - (ea->col < eb->col);
 }
 
-template<typename IT, typename VT>
-void entries_to_local_csr(Entry<IT, VT> *entries, CSR_local<IT, VT> *csr) {
-  qsort(entries, csr->nnz, sizeof(Entry<IT, VT>), compare_entries_csr<IT, VT>);
+static inline int mm_row_length_bucket(uint64_t length) {
+  int bits = 0;
+  for (; length > 0; length >>= 1) ++bits;
+  return std::min(bits, MM_ROW_LENGTH_BUCKETS - 1);
+}
 
-  for (IT v = 0, i = 0; v < csr->nrows; v++) {
-    csr->row_ptr[v] = i;
-    while (i < csr->nnz && entries[i].row == v) {
-      csr->col_idx[i] = entries[i].col;
-      if (csr->val != NULL) {
-        csr->val[i] = entries[i].val;
+// Row statistics of a built CSR, accumulated per thread (entries statistics are counted by the caller)
+template<typename IT, typename VT, typename OT>
+static void mm_row_structure(const CSR_local<IT, VT, OT> *csr, Distr_MMIO_Structure *s) {
+  uint64_t empty_rows = 0, max_row_length = 0, bandwidth = 0, profile = 0;
+  std::fill(s->row_length_histogram, s->row_length_histogram + MM_ROW_LENGTH_BUCKETS, 0);
+  #pragma omp parallel reduction(+:empty_rows, profile) reduction(max:max_row_length, bandwidth)
+  {
+    uint64_t histogram[MM_ROW_LENGTH_BUCKETS] = {0};
+    #pragma omp for schedule(static)
+    for (IT r = 0; r < csr->nrows; ++r) {
+      uint64_t length = csr->row_ptr[r + 1] - csr->row_ptr[r];
+      ++histogram[mm_row_length_bucket(length)];
+      if (length == 0) {
+        ++empty_rows;
+        continue;
       }
-      ++i;
+      max_row_length = std::max(max_row_length, length);
+      uint64_t first = csr->col_idx[csr->row_ptr[r]], last = csr->col_idx[csr->row_ptr[r + 1] - 1];
+      if (first < (uint64_t)r) profile += r - first;
+      bandwidth = std::max(bandwidth, first < (uint64_t)r ? r - first : 0);
+      bandwidth = std::max(bandwidth, last > (uint64_t)r ? last - r : 0);
     }
+    #pragma omp critical
+    for (int b = 0; b < MM_ROW_LENGTH_BUCKETS; ++b) s->row_length_histogram[b] += histogram[b];
   }
-  csr->row_ptr[csr->nrows] = csr->nnz;
+  s->empty_rows = empty_rows;
+  s->max_row_length = max_row_length;
+  s->bandwidth = bandwidth;
+  s->profile = profile;
+}
+
+/*
+ * Sorts the entries (unless already sorted row-major) and fills the CSR. With structure, the statistics are
+ * collected in the same parallel loops (entries) and in a pass over the row offsets.
+ */
+template<typename IT, typename VT, typename OT>
+void entries_to_local_csr(Entry<IT, VT> *entries, CSR_local<IT, VT, OT> *csr, Distr_MMIO_Structure *structure = NULL, bool is_sorted = false) {
+  double t = mm_phase_begin();
+  if (!is_sorted) qsort(entries, csr->nnz, sizeof(Entry<IT, VT>), compare_entries_csr<IT, VT>);
+  mm_phase_end(MM_PHASE_SORT, t);
+
+  t = mm_phase_begin();
+
+  // Each entry sets the offsets of the rows between the previous entry row and its own
+  bool collect = structure != NULL;
+  uint64_t diagonal = 0, duplicates = 0;
+  #pragma omp parallel for schedule(static) reduction(+:diagonal, duplicates)
+  for (OT i = 0; i < csr->nnz; ++i) {
+    csr->col_idx[i] = entries[i].col;
+    if (csr->val != NULL) {
+      csr->val[i] = entries[i].val;
+    }
+    IT first_row = i == 0 ? 0 : entries[i - 1].row + 1;
+    for (IT v = first_row; v <= entries[i].row; ++v) csr->row_ptr[v] = i;
+    if (collect) {
+      diagonal += entries[i].row == entries[i].col;
+      duplicates += i > 0 && entries[i - 1].row == entries[i].row && entries[i - 1].col == entries[i].col;
+    }
+  }
+  IT last_row = csr->nnz == 0 ? 0 : entries[csr->nnz - 1].row + 1;
+  for (IT v = last_row; v <= csr->nrows; ++v) csr->row_ptr[v] = csr->nnz;
+
+  if (collect) {
+    mm_row_structure(csr, structure);
+    structure->nrows = csr->nrows;
+    structure->ncols = csr->ncols;
+    structure->nnz = csr->nnz;
+    structure->avg_row_length = csr->nrows > 0 ? (double)csr->nnz / csr->nrows : 0.0;
+    structure->diagonal = diagonal;
+    structure->duplicates = duplicates;
+    structure->valid = true;
+  }
+  mm_phase_end(MM_PHASE_ASSEMBLY, t);
+}
+
+// Statistics to collect while building a CSR: none if not requested or already read from the header of the file
+static Distr_MMIO_Structure *mm_structure_to_collect(Matrix_Metadata *meta) {
+  return meta != NULL && meta->collect_structure && !meta->structure.valid ? &meta->structure : NULL;
 }
 
 // COO
 
-template<typename IT, typename VT>
-void entries_to_local_coo(Entry<IT, VT> *entries, COO_local<IT, VT> *coo) {
-  for (IT i = 0; i < coo->nnz; ++i) {
+template<typename IT, typename VT, typename OT>
+void entries_to_local_coo(Entry<IT, VT> *entries, COO_local<IT, VT, OT> *coo) {
+  double t = mm_phase_begin();
+  #pragma omp parallel for schedule(static)
+  for (OT i = 0; i < coo->nnz; ++i) {
     coo->row[i] = entries[i].row;
     coo->col[i] = entries[i].col;
     if (coo->val != NULL) coo->val[i] = entries[i].val;
   }
+  mm_phase_end(MM_PHASE_ASSEMBLY, t);
 }
 
 /**
@@ -472,11 +2207,454 @@ bool is_file_extension_bmtx(std::string filename) {
 bool is_file_extension_sbmtx(std::string filename) {
     return filename.size() >= 6 && filename.compare(filename.size() - 6, 6, ".sbmtx") == 0;
 }
+bool is_file_extension_cbmtx(std::string filename) {
+  return filename.size() >= 6 && filename.compare(filename.size() - 6, 6, ".cbmtx") == 0;
+}
 
-int write_matrix_market_header(FILE *f, Matrix_Metadata *meta, int index_bytes, uint64_t nrows, uint64_t ncols, uint64_t nentries) {
-  if (!f) return MM_COULD_NOT_WRITE_FILE;
+/**
+ * Reordering
+ */
 
-  std::string header = meta->mm_header;
+#define MM_PERM_BANNER "%%MMIOPermutation"
+
+static const char *mm_reorder_name(MM_REORDER order) {
+  switch (order) {
+    case MM_REORDER_RCM:    return "rcm";
+    case MM_REORDER_DEGREE: return "degree";
+    case MM_REORDER_HUB:    return "hub";
+    default:                return "none";
+  }
+}
+
+template<typename KT>
+static void mm_radix_sort(KT *keys, uint64_t *idx, uint64_t n, int key_bytes);
+
+/*
+ * Vertices sorted by degree (decreasing or increasing), ties keep the original order.
+ * The (degree, vertex) pairs go through the parallel radix sort, with only as many passes as the degree bytes.
+ */
+template<typename IT>
+static void mm_sort_by_degree(const std::vector<IT> &degree, IT max_degree, bool decreasing, IT *sorted) {
+  uint64_t n = degree.size();
+  uint64_t *keys = (uint64_t *)mm_alloc(n * sizeof(uint64_t));
+  uint64_t *idx = (uint64_t *)mm_alloc(n * sizeof(uint64_t));
+  #pragma omp parallel for schedule(static)
+  for (uint64_t v = 0; v < n; ++v) {
+    keys[v] = decreasing ? (uint64_t)(max_degree - degree[v]) : (uint64_t)degree[v];
+    idx[v] = v;
+  }
+  int key_bytes = max_degree > 0 ? (64 - __builtin_clzl((uint64_t)max_degree) + 7) / 8 : 0;
+  mm_radix_sort(keys, idx, n, key_bytes);
+  #pragma omp parallel for schedule(static)
+  for (uint64_t i = 0; i < n; ++i) sorted[i] = static_cast<IT>(idx[i]);
+  mm_free(keys);
+  mm_free(idx);
+}
+
+/*
+ * Computes perm[old] = new from the structure of the entries of a n x n matrix.
+ */
+template<typename IT, typename VT>
+static void mm_compute_permutation(const Entry<IT, VT> *entries, uint64_t nnz, IT n, MM_REORDER order, IT *perm) {
+  std::vector<IT> degree(n, 0);
+  #pragma omp parallel for schedule(static)
+  for (uint64_t i = 0; i < nnz; ++i) {
+    #pragma omp atomic
+    ++degree[entries[i].row];
+  }
+  IT max_degree = 0;
+  #pragma omp parallel for reduction(max:max_degree)
+  for (IT v = 0; v < n; ++v) max_degree = std::max(max_degree, degree[v]);
+
+  switch (order) {
+    case MM_REORDER_DEGREE: {
+      std::vector<IT> sorted(n);
+      mm_sort_by_degree(degree, max_degree, true, sorted.data());
+      #pragma omp parallel for schedule(static)
+      for (IT i = 0; i < n; ++i) perm[sorted[i]] = i;
+      break;
+    }
+    case MM_REORDER_HUB: {
+      // Stable partition (hubs first) with a blocked parallel prefix sum
+      double avg = n > 0 ? (double)nnz / n : 0.0;
+      int nt = mm_max_threads();
+      IT chunk = (n + nt - 1) / nt;
+      std::vector<uint64_t> hubs(nt + 1, 0);
+      #pragma omp parallel for schedule(static, 1)
+      for (int t = 0; t < nt; ++t) {
+        for (IT v = std::min<IT>(n, t * chunk); v < std::min<IT>(n, (t + 1) * chunk); ++v) hubs[t + 1] += degree[v] > avg;
+      }
+      for (int t = 0; t < nt; ++t) hubs[t + 1] += hubs[t];
+      uint64_t nhubs = hubs[nt];
+      #pragma omp parallel for schedule(static, 1)
+      for (int t = 0; t < nt; ++t) {
+        uint64_t h = hubs[t], other = nhubs + std::min<IT>(n, t * chunk) - hubs[t];
+        for (IT v = std::min<IT>(n, t * chunk); v < std::min<IT>(n, (t + 1) * chunk); ++v) perm[v] = degree[v] > avg ? h++ : other++;
+      }
+      break;
+    }
+    case MM_REORDER_RCM: {
+      // Adjacency of A + A^T, without self loops and duplicates, so that the ordering does not depend on the
+      // direction of the edges. The neighbours of each vertex are sorted by increasing degree.
+      std::vector<IT> adj_degree(n, 0);
+      #pragma omp parallel for schedule(static)
+      for (uint64_t i = 0; i < nnz; ++i) {
+        if (entries[i].row == entries[i].col) continue;
+        #pragma omp atomic
+        ++adj_degree[entries[i].row];
+        #pragma omp atomic
+        ++adj_degree[entries[i].col];
+      }
+      std::vector<uint64_t> adj_ptr(n + 1, 0);
+      for (IT v = 0; v < n; ++v) adj_ptr[v + 1] = adj_ptr[v] + adj_degree[v];
+      std::vector<IT> adj(adj_ptr[n]);
+      std::vector<uint64_t> fill(adj_ptr.begin(), adj_ptr.end() - 1);
+      #pragma omp parallel for schedule(static)
+      for (uint64_t i = 0; i < nnz; ++i) {
+        IT r = entries[i].row, c = entries[i].col;
+        if (r == c) continue;
+        uint64_t pos;
+        #pragma omp atomic capture
+        pos = fill[r]++;
+        adj[pos] = c;
+        #pragma omp atomic capture
+        pos = fill[c]++;
+        adj[pos] = r;
+      }
+      IT max_adj_degree = 0;
+      #pragma omp parallel for schedule(dynamic, 1024) reduction(max:max_adj_degree)
+      for (IT v = 0; v < n; ++v) {
+        std::sort(adj.begin() + adj_ptr[v], adj.begin() + adj_ptr[v + 1]);
+        adj_degree[v] = std::unique(adj.begin() + adj_ptr[v], adj.begin() + adj_ptr[v + 1]) - (adj.begin() + adj_ptr[v]);
+        max_adj_degree = std::max(max_adj_degree, adj_degree[v]);
+      }
+      #pragma omp parallel for schedule(dynamic, 1024)
+      for (IT v = 0; v < n; ++v) {
+        std::sort(adj.begin() + adj_ptr[v], adj.begin() + adj_ptr[v] + adj_degree[v],
+                  [&](IT a, IT b) { return adj_degree[a] != adj_degree[b] ? adj_degree[a] < adj_degree[b] : a < b; });
+      }
+
+      // Breadth-first visit of each component, starting from its minimum degree vertex
+      std::vector<IT> start(n), visit;
+      mm_sort_by_degree(adj_degree, max_adj_degree, false, start.data());
+      std::vector<char> visited(n, 0);
+      visit.reserve(n);
+      for (IT s : start) {
+        if (visited[s]) continue;
+        visited[s] = 1;
+        visit.push_back(s);
+        for (size_t head = visit.size() - 1; head < visit.size(); ++head) {
+          IT u = visit[head];
+          for (uint64_t j = adj_ptr[u]; j < adj_ptr[u] + adj_degree[u]; ++j) {
+            if (!visited[adj[j]]) {
+              visited[adj[j]] = 1;
+              visit.push_back(adj[j]);
+            }
+          }
+        }
+      }
+      #pragma omp parallel for schedule(static)
+      for (IT i = 0; i < n; ++i) perm[visit[i]] = n - 1 - i;
+      break;
+    }
+    default: {
+      for (IT v = 0; v < n; ++v) perm[v] = v;
+      break;
+    }
+  }
+}
+
+// Version of the matrix file an index or a permutation was computed from: size and modification time (with nanoseconds)
+struct mm_file_stamp {
+  uint64_t size, mtime_sec, mtime_nsec;
+
+  explicit mm_file_stamp(const struct stat &st)
+      : size(st.st_size), mtime_sec(st.st_mtim.tv_sec), mtime_nsec(st.st_mtim.tv_nsec) {}
+};
+
+/*
+ * Loads a permutation stored next to a matrix, it is used only if it was computed with the same
+ * ordering, for the same size and from this version of the matrix file (same stamp).
+ */
+template<typename IT>
+static bool mm_read_permutation(const std::string &perm_filename, const mm_file_stamp &stamp, MM_REORDER order, IT n, IT *perm) {
+  FILE *f = fopen(perm_filename.c_str(), "rb");
+  if (f == NULL) return false;
+  char line[MM_MAX_LINE_LENGTH], banner[MM_MAX_TOKEN_LENGTH], name[MM_MAX_TOKEN_LENGTH];
+  uint64_t size, file_size, mtime_sec, mtime_nsec;
+  bool ok = fgets(line, sizeof(line), f) != NULL &&
+            sscanf(line, "%63s %63s %lu %lu %lu %lu", banner, name, &size, &file_size, &mtime_sec, &mtime_nsec) == 6 &&
+            strcmp(banner, MM_PERM_BANNER) == 0 && strcmp(name, mm_reorder_name(order)) == 0 && size == (uint64_t)n &&
+            file_size == stamp.size && mtime_sec == stamp.mtime_sec && mtime_nsec == stamp.mtime_nsec;
+  std::vector<uint64_t> values(ok ? n : 0);
+  ok = ok && fread(values.data(), sizeof(uint64_t), n, f) == (size_t)n;
+  fclose(f);
+  if (!ok) return false;
+
+  bool out_of_range = false; // A damaged file would relabel entries outside the matrix
+  #pragma omp parallel for schedule(static) reduction(||:out_of_range)
+  for (IT v = 0; v < n; ++v) {
+    out_of_range = out_of_range || values[v] >= (uint64_t)n;
+    perm[v] = static_cast<IT>(values[v]);
+  }
+  return !out_of_range;
+}
+
+template<typename IT>
+static int mm_write_permutation(const std::string &perm_filename, const mm_file_stamp &stamp, MM_REORDER order, IT n, const IT *perm) {
+  FILE *f = open_file_w(perm_filename.c_str());
+  if (f == NULL) return MM_COULD_NOT_WRITE_FILE;
+  fprintf(f, "%s %s %lu %lu %lu %lu\n", MM_PERM_BANNER, mm_reorder_name(order), (uint64_t)n, stamp.size, stamp.mtime_sec,
+          stamp.mtime_nsec);
+  std::vector<uint64_t> values(perm, perm + n);
+  size_t written = fwrite(values.data(), sizeof(uint64_t), n, f);
+  fclose(f);
+  return written == (size_t)n ? 0 : MM_COULD_NOT_WRITE_FILE;
+}
+
+/**
+ * Sort orders
+ */
+
+// .sbmtx files are row-major sorted: those written before the order token existed record none
+static inline MM_SORT_ORDER mm_file_sort_order(const Matrix_Metadata *meta, bool is_sbmtx) {
+  return is_sbmtx && meta->sort_order == MM_SORT_NONE ? MM_SORT_ROW_MAJOR : meta->sort_order;
+}
+
+static const char *mm_sort_order_name(MM_SORT_ORDER order) {
+  switch (order) {
+    case MM_SORT_COL_MAJOR: return MM_SORT_COL_MAJOR_STR;
+    case MM_SORT_MORTON:    return MM_SORT_MORTON_STR;
+    case MM_SORT_HILBERT:   return MM_SORT_HILBERT_STR;
+    default:                return MM_SORT_ROW_MAJOR_STR;
+  }
+}
+
+// Spreads the bits of v, so that bit i moves to bit 2i
+template<typename KT>
+static inline KT mm_morton_spread(uint64_t v) {
+  KT r = 0;
+  for (int half = 0; half < (int)(sizeof(KT) / 8); ++half, v >>= 32) {
+    uint64_t x = v & 0xffffffffUL;
+    x = (x | (x << 16)) & 0x0000ffff0000ffffUL;
+    x = (x | (x << 8))  & 0x00ff00ff00ff00ffUL;
+    x = (x | (x << 4))  & 0x0f0f0f0f0f0f0f0fUL;
+    x = (x | (x << 2))  & 0x3333333333333333UL;
+    x = (x | (x << 1))  & 0x5555555555555555UL;
+    r |= (KT)x << (64 * half);
+  }
+  return r;
+}
+
+// Distance along the Hilbert curve covering a 2^bits x 2^bits grid
+template<typename KT>
+static inline KT mm_hilbert_key(uint64_t x, uint64_t y, int bits) {
+  KT d = 0;
+  for (int b = bits - 1; b >= 0; --b) {
+    uint64_t rx = (x >> b) & 1, ry = (y >> b) & 1;
+    d |= (KT)((3 * rx) ^ ry) << (2 * b);
+    if (ry == 0) { // Rotate the quadrant (only the low bits matter from here on)
+      if (rx == 1) {
+        x = ~x;
+        y = ~y;
+      }
+      std::swap(x, y);
+    }
+  }
+  return d;
+}
+
+template<typename IT, typename KT>
+static inline KT mm_sort_key(IT row, IT col, MM_SORT_ORDER order, int bits) {
+  switch (order) {
+    case MM_SORT_COL_MAJOR: return ((KT)col << bits) | (KT)row;
+    case MM_SORT_MORTON:    return (mm_morton_spread<KT>(row) << 1) | mm_morton_spread<KT>(col);
+    case MM_SORT_HILBERT:   return mm_hilbert_key<KT>(col, row, bits);
+    default:                return ((KT)row << bits) | (KT)col;
+  }
+}
+
+/*
+ * Stable LSD radix sort of (key, index) pairs, one byte per pass. Each thread histograms and scatters its own
+ * contiguous block, passes where all the keys share the same byte are skipped.
+ */
+template<typename KT>
+static void mm_radix_sort(KT *keys, uint64_t *idx, uint64_t n, int key_bytes) {
+  int nthreads = mm_max_threads();
+  uint64_t block = (n + nthreads - 1) / nthreads;
+  KT *keys_in = keys, *keys_out = (KT *)mm_alloc(n * sizeof(KT));
+  uint64_t *idx_in = idx, *idx_out = (uint64_t *)mm_alloc(n * sizeof(uint64_t));
+  std::vector<uint64_t> hist((size_t)nthreads * 256);
+
+  for (int pass = 0; pass < key_bytes; ++pass) {
+    int shift = 8 * pass;
+    std::fill(hist.begin(), hist.end(), 0);
+    #pragma omp parallel for schedule(static)
+    for (int t = 0; t < nthreads; ++t) {
+      uint64_t *h = &hist[(size_t)t * 256];
+      for (uint64_t i = t * block; i < std::min(n, (t + 1) * block); ++i) h[(uint8_t)(keys_in[i] >> shift)]++;
+    }
+
+    uint64_t sum = 0;
+    bool single_bucket = false;
+    for (int b = 0; b < 256; ++b) {
+      uint64_t bucket_begin = sum;
+      for (int t = 0; t < nthreads; ++t) {
+        uint64_t c = hist[(size_t)t * 256 + b];
+        hist[(size_t)t * 256 + b] = sum;
+        sum += c;
+      }
+      if (sum - bucket_begin == n) single_bucket = true;
+    }
+    if (single_bucket) continue;
+
+    #pragma omp parallel for schedule(static)
+    for (int t = 0; t < nthreads; ++t) {
+      uint64_t *h = &hist[(size_t)t * 256];
+      for (uint64_t i = t * block; i < std::min(n, (t + 1) * block); ++i) {
+        uint64_t dst = h[(uint8_t)(keys_in[i] >> shift)]++;
+        keys_out[dst] = keys_in[i];
+        idx_out[dst] = idx_in[i];
+      }
+    }
+    std::swap(keys_in, keys_out);
+    std::swap(idx_in, idx_out);
+  }
+
+  if (idx_in != idx) memcpy(idx, idx_in, n * sizeof(uint64_t)); // Keys are not needed anymore
+  mm_free(keys_in != keys ? keys_in : keys_out);
+  mm_free(idx_in != idx ? idx_in : idx_out);
+}
+
+template<typename IT, typename VT, typename KT>
+static Entry<IT, VT> *mm_sort_entries_by_key(Entry<IT, VT> *entries, uint64_t nnz, MM_SORT_ORDER order, int bits) {
+  KT *keys = (KT *)mm_alloc(nnz * sizeof(KT));
+  uint64_t *idx = (uint64_t *)mm_alloc(nnz * sizeof(uint64_t));
+  #pragma omp parallel for schedule(static)
+  for (uint64_t i = 0; i < nnz; ++i) {
+    keys[i] = mm_sort_key<IT, KT>(entries[i].row, entries[i].col, order, bits);
+    idx[i] = i;
+  }
+  mm_radix_sort(keys, idx, nnz, (2 * bits + 7) / 8);
+  mm_free(keys);
+
+  Entry<IT, VT> *sorted = (Entry<IT, VT> *)mm_alloc(nnz * sizeof(Entry<IT, VT>));
+  #pragma omp parallel for schedule(static)
+  for (uint64_t i = 0; i < nnz; ++i) sorted[i] = entries[idx[i]];
+  mm_free(idx);
+  mm_free(entries);
+  return sorted;
+}
+
+/*
+ * Sorts the entries in the given order (stable for equal coordinates). The array is replaced: the returned
+ * one must be used and freed instead.
+ */
+template<typename IT, typename VT>
+static Entry<IT, VT> *mm_sort_entries(Entry<IT, VT> *entries, uint64_t nnz, IT nrows, IT ncols, MM_SORT_ORDER order) {
+  uint64_t max_idx = std::max<uint64_t>(std::max<uint64_t>(nrows, ncols), 2) - 1;
+  int bits = 64 - __builtin_clzl(max_idx);
+  if (2 * bits <= 64) return mm_sort_entries_by_key<IT, VT, uint64_t>(entries, nnz, order, bits);
+  return mm_sort_entries_by_key<IT, VT, unsigned __int128>(entries, nnz, order, bits);
+}
+
+/*
+ * Merges the runs of entries with the same coordinates and drops the zeros/diagonal entries, as requested by
+ * canonical. Entries must be sorted (in any order), stably if the reducer is first/last. The array is split in one
+ * part per thread, each starting at the beginning of a run, the parts are compacted in place in parallel and then
+ * packed. Returns the number of entries left.
+ */
+template<typename IT, typename VT>
+static uint64_t mm_canonicalize_sorted(Entry<IT, VT> *entries, uint64_t nnz, const Distr_MMIO_Canonical &canonical) {
+  auto same = [entries](uint64_t i, uint64_t j) { return entries[i].row == entries[j].row && entries[i].col == entries[j].col; };
+  uint64_t nparts = std::max<uint64_t>(std::min<uint64_t>(mm_max_threads(), nnz), 1);
+  std::vector<uint64_t> offset(nparts + 1), kept(nparts);
+  offset[nparts] = nnz;
+  for (uint64_t c = 1; c < nparts; ++c) {
+    uint64_t b = std::max(offset[c - 1], nnz / nparts * c);
+    while (b > 0 && b < nnz && same(b - 1, b)) ++b;
+    offset[c] = b;
+  }
+
+  #pragma omp parallel for schedule(static, 1)
+  for (uint64_t c = 0; c < nparts; ++c) {
+    uint64_t k = offset[c];
+    for (uint64_t i = offset[c]; i < offset[c + 1];) {
+      Entry<IT, VT> e = entries[i++];
+      if (canonical.duplicates != MM_DUPLICATES_KEEP) {
+        for (; i < offset[c + 1] && same(i, i - 1); ++i) {
+          VT v = entries[i].val;
+          switch (canonical.duplicates) {
+            case MM_DUPLICATES_SUM:   e.val += v; break;
+            case MM_DUPLICATES_MIN:   e.val = std::min(e.val, v); break;
+            case MM_DUPLICATES_MAX:   e.val = std::max(e.val, v); break;
+            case MM_DUPLICATES_LAST:  e.val = v; break;
+            default: break;
+          }
+        }
+      }
+      if (canonical.drop_zeros && e.val == 0) continue;
+      if (canonical.drop_diagonal && e.row == e.col) continue;
+      entries[k++] = e;
+    }
+    kept[c] = k - offset[c];
+  }
+
+  mm_kept_entries<IT, VT> packed;
+  packed.data = entries;
+  packed.pack(offset.data(), kept.data(), nparts);
+  return packed.n;
+}
+
+static bool mm_is_canonical_requested(const Matrix_Metadata *meta) {
+  return meta != NULL && (meta->canonical.duplicates != MM_DUPLICATES_KEEP || meta->canonical.drop_zeros || meta->canonical.drop_diagonal);
+}
+
+/*
+ * Applies the canonical form requested in meta (if any) to the entries read, sorting them first unless already
+ * sorted. Returns whether the entries are now sorted.
+ */
+template<typename IT, typename VT, typename OT>
+static bool mm_canonicalize(Entry<IT, VT> *&entries, OT &nnz, IT nrows, IT ncols, MM_SORT_ORDER order, bool is_sorted, Matrix_Metadata *meta) {
+  if (!mm_is_canonical_requested(meta)) return is_sorted;
+  if (!is_sorted) {
+    double t = mm_phase_begin();
+    entries = mm_sort_entries(entries, nnz, nrows, ncols, order);
+    mm_phase_end(MM_PHASE_SORT, t);
+  }
+
+  double t = mm_phase_begin();
+  OT canonical_nnz = (OT)mm_canonicalize_sorted(entries, nnz, meta->canonical);
+  if (canonical_nnz != nnz) meta->structure.valid = false; // Statistics from the header of the file are stale
+  nnz = canonical_nnz;
+  mm_phase_end(MM_PHASE_CANONICALIZATION, t);
+  return true;
+}
+
+#define MM_FIXED_SIZE_LINE_FMT    "%-20lu %-20lu %-20lu\n" // Binary files can have their sizes updated in place (appends)
+#define MM_FIXED_SIZE_LINE_LENGTH 63
+
+// Persists meta->structure in a binary header, if it describes the matrix being written
+static void mm_write_structure_line(FILE *f, const Matrix_Metadata *meta, uint64_t nrows, uint64_t ncols, uint64_t nentries) {
+  const Distr_MMIO_Structure &s = meta->structure;
+  // Symmetric files store the diagonal and one of the two triangles
+  uint64_t stored = meta->is_symmetric ? (s.nnz + s.diagonal) / 2 : s.nnz;
+  if (!s.valid || s.nrows != nrows || s.ncols != ncols || stored != nentries) return;
+
+  int nbuckets = MM_ROW_LENGTH_BUCKETS;
+  while (nbuckets > 1 && s.row_length_histogram[nbuckets - 1] == 0) --nbuckets;
+  fprintf(f, "%s %lu %lu %lu %lu %lu %lu %lu %lu %lu", MM_STRUCTURE_COMMENT, s.nrows, s.ncols, s.nnz, s.empty_rows,
+          s.max_row_length, s.bandwidth, s.profile, s.diagonal, s.duplicates);
+  for (int b = 0; b < nbuckets; ++b) fprintf(f, " %lu", s.row_length_histogram[b]);
+  fprintf(f, "\n");
+}
+
+// Only files whose entries are known to be sorted record their order (sort_order), whatever meta->sort_order says
+int write_matrix_market_header(FILE *f, Matrix_Metadata *meta, int index_bytes, uint64_t nrows, uint64_t ncols, uint64_t nentries,
+                               MM_SORT_ORDER sort_order = MM_SORT_NONE) {
+  if (!f) return MM_COULD_NOT_WRITE_FILE;
+
+  std::string header = meta->mm_header;
   // Strip trailing spaces
   while (!header.empty() && header.back() == ' ') header.pop_back();
   int space_count = std::count(header.begin(), header.end(), ' ');
@@ -492,11 +2670,18 @@ int write_matrix_market_header(FILE *f, Matrix_Metadata *meta, int index_bytes,
       }
     }
     if (pos != std::string::npos) {
-      header = header.substr(0, pos); // up to and including 5th space
+      header = header.substr(0, pos - 1); // up to the 5th space
     }
   }
-  if (index_bytes > 0) { // This determines if header is for bmtx
+  if (index_bytes >= 0) { // This determines if header is for bmtx (0 means compressed)
     header += " " + std::to_string(index_bytes) + " " + std::to_string(meta->val_bytes > 0 ? meta->val_bytes : 4);
+    switch (meta->val_encoding) {
+      case MM_VAL_ENCODING_HALF:     { header += " " MM_VAL_ENC_HALF_STR; break; }
+      case MM_VAL_ENCODING_BFLOAT16: { header += " " MM_VAL_ENC_BF16_STR; break; }
+      case MM_VAL_ENCODING_INTEGER:  { header += " " MM_VAL_ENC_INT_STR;  break; }
+      default: { if (index_bytes > 0 && sort_order != MM_SORT_NONE) header += " " MM_VAL_ENC_FLOAT_STR; break; }
+    }
+    if (index_bytes > 0 && sort_order != MM_SORT_NONE) header += std::string(" ") + mm_sort_order_name(sort_order);
   }
   fprintf(f, "%s\n", header.c_str());
   if (!meta->mm_header_body.empty()) {
@@ -507,28 +2692,41 @@ int write_matrix_market_header(FILE *f, Matrix_Metadata *meta, int index_bytes,
     }
     fprintf(f, "%s\n", header_body.c_str());
   }
+  if (index_bytes >= 0) mm_write_structure_line(f, meta, nrows, ncols, nentries);
   // Write size line
-  fprintf(f, "%ld %ld %ld\n", nrows, ncols, nentries);
+  if (index_bytes > 0) {
+    fprintf(f, MM_FIXED_SIZE_LINE_FMT, nrows, ncols, nentries);
+  } else {
+    fprintf(f, "%ld %ld %ld\n", nrows, ncols, nentries);
+  }
   return 0;
 }
 
-template<typename IT, typename VT>
-int write_binary_matrix_market(FILE *f, COO_local<IT, VT> *coo, Matrix_Metadata *meta) {
+template<typename IT, typename VT, typename OT>
+int write_binary_matrix_market(FILE *f, COO_local<IT, VT, OT> *coo, Matrix_Metadata *meta, MM_SORT_ORDER sort_order) {
   if (!f) return MM_COULD_NOT_WRITE_FILE;
 
   int index_bytes = required_bytes_index(std::max(coo->nrows, coo->ncols));
+  uint8_t val_bytes = meta->val_bytes > 0 ? meta->val_bytes : 4;
+  if (!mm_is_valid_val_encoding(val_bytes, meta->val_encoding)) {
+    fprintf(stderr, "Values cannot be encoded using %hhu bytes with the requested encoding.\n", val_bytes);
+    fclose(f);
+    return MM_UNSUPPORTED_TYPE;
+  }
 
-  IT nentries = coo->nnz;
+  OT nentries = coo->nnz;
   if (meta->is_symmetric) { // TODO optimize
     nentries = 0;
-    for (IT i = 0; i < coo->nnz; ++i) {
+    for (OT i = 0; i < coo->nnz; ++i) {
       if (coo->row[i] <= coo->col[i]) {
         ++nentries;
       }
     }
   }
 
-  int err = write_matrix_market_header(f, meta, index_bytes, coo->nrows, coo->ncols, nentries);
+  double t = mm_phase_begin();
+  int err = write_matrix_market_header(f, meta, index_bytes, coo->nrows, coo->ncols, nentries, sort_order);
+  mm_phase_end(MM_PHASE_BANNER, t);
   if (err != 0) {
     fprintf(stderr, "Something went wrong writing the file header.\n");
     fclose(f);
@@ -536,7 +2734,12 @@ int write_binary_matrix_market(FILE *f, COO_local<IT, VT> *coo, Matrix_Metadata
   }
 
   // Write binary data
-  for (IT i = 0; i < coo->nnz; ++i) {
+  t = mm_phase_begin();
+  for (OT i = 0; i < coo->nnz; ++i) {
+    if (i % MM_PROGRESS_ENTRIES == 0 && !mm_progress(MM_PHASE_DATA_IO, i, coo->nnz)) {
+      fclose(f);
+      return MM_CANCELLED;
+    }
     if (meta->is_symmetric && coo->row[i] > coo->col[i]) continue; // For patter matrices
 
     // Write row
@@ -557,38 +2760,218 @@ int write_binary_matrix_market(FILE *f, COO_local<IT, VT> *coo, Matrix_Metadata
 
     // Write value
     if (meta->val_type != MM_VAL_TYPE_PATTERN && coo->val != NULL) {
-      // TODO generalize
-      if (meta->val_bytes == 8) { double v = (double)coo->val[i]; fwrite(&v, sizeof(double), 1, f); }
-      else                      { float  v =  (float)coo->val[i]; fwrite(&v, sizeof(float),  1, f); }
+      uint8_t v[8];
+      mm_encode_val(v, coo->val[i], val_bytes, meta->val_encoding);
+      fwrite(v, val_bytes, 1, f);
     }
   }
+  mm_phase_end(MM_PHASE_DATA_IO, t);
 
+  mm_stats_bytes_written(f);
   fclose(f);
   return 0;
 }
 
-template<typename IT, typename VT>
-int write_matrix_market(FILE *f, COO_local<IT, VT> *coo, Matrix_Metadata *meta) {
+template<typename IT, typename VT, typename OT>
+static void cbmtx_encode_block(COO_local<IT, VT, OT> *coo, const uint64_t *perm, uint64_t begin, uint64_t end,
+                               bool write_val, uint8_t val_bytes, MM_VAL_ENCODING val_enc, CBMTX_Block_Info *blk,
+                               std::vector<uint8_t> &out) {
+  auto at = [&](uint64_t i) { return perm ? perm[i] : i; };
+
+  blk->first_row = coo->row[at(begin)];
+  blk->last_row = coo->row[at(end - 1)];
+  blk->first_entry = begin;
+  blk->nnz = end - begin;
+
+  // Row runs
+  std::vector<uint8_t> runs;
+  uint64_t nruns = 0, prev_row = blk->first_row;
+  for (uint64_t i = begin; i < end;) {
+    uint64_t row = coo->row[at(i)], len = 0;
+    while (i < end && (uint64_t)coo->row[at(i)] == row) { ++i; ++len; }
+    cbmtx_put_varint(runs, row - prev_row);
+    cbmtx_put_varint(runs, len);
+    prev_row = row;
+    ++nruns;
+  }
+  cbmtx_put_varint(out, nruns);
+  out.insert(out.end(), runs.begin(), runs.end());
+
+  // Column deltas
+  for (uint64_t i = begin; i < end; ++i) {
+    bool run_start = (i == begin || coo->row[at(i)] != coo->row[at(i - 1)]);
+    uint64_t col = coo->col[at(i)];
+    cbmtx_put_varint(out, run_start ? col : col - (uint64_t)coo->col[at(i - 1)]);
+  }
+
+  // Values
+  if (write_val) {
+    size_t pos = out.size();
+    out.resize(pos + (end - begin) * val_bytes);
+    for (uint64_t i = begin; i < end; ++i, pos += val_bytes) mm_encode_val(out.data() + pos, coo->val[at(i)], val_bytes, val_enc);
+  }
+  blk->size = out.size();
+}
+
+template<typename IT, typename VT, typename OT>
+int write_compressed_binary_matrix_market(FILE *f, COO_local<IT, VT, OT> *coo, Matrix_Metadata *meta) {
+  if (!f) return MM_COULD_NOT_WRITE_FILE;
+
+  uint64_t nnz = coo->nnz;
+  uint8_t val_bytes = meta->val_bytes > 0 ? meta->val_bytes : 4;
+  bool write_val = meta->val_type != MM_VAL_TYPE_PATTERN && coo->val != NULL;
+  if (!mm_is_valid_val_encoding(val_bytes, meta->val_encoding)) {
+    fprintf(stderr, "Values cannot be encoded using %hhu bytes with the requested encoding.\n", val_bytes);
+    fclose(f);
+    return MM_UNSUPPORTED_TYPE;
+  }
+
+  // Blocks must be row-major sorted, sort a permutation if the input is not
+  double t = mm_phase_begin();
+  std::vector<uint64_t> perm;
+  bool sorted = true;
+  for (uint64_t i = 1; i < nnz && sorted; ++i) {
+    sorted = coo->row[i - 1] < coo->row[i] || (coo->row[i - 1] == coo->row[i] && coo->col[i - 1] <= coo->col[i]);
+  }
+  if (!sorted) {
+    perm.resize(nnz);
+    for (uint64_t i = 0; i < nnz; ++i) perm[i] = i;
+    std::sort(perm.begin(), perm.end(), [&](uint64_t a, uint64_t b) {
+      return coo->row[a] != coo->row[b] ? coo->row[a] < coo->row[b] : coo->col[a] < coo->col[b];
+    });
+  }
+  mm_phase_end(MM_PHASE_SORT, t);
+
+  t = mm_phase_begin();
+  uint64_t nblocks = (nnz + CBMTX_BLOCK_ENTRIES - 1) / CBMTX_BLOCK_ENTRIES;
+  std::vector<CBMTX_Block_Info> index(nblocks);
+  std::vector<std::vector<uint8_t>> payloads(nblocks);
+  #pragma omp parallel for schedule(dynamic)
+  for (uint64_t b = 0; b < nblocks; ++b) {
+    uint64_t end = std::min(nnz, (b + 1) * CBMTX_BLOCK_ENTRIES);
+    cbmtx_encode_block(coo, perm.empty() ? NULL : perm.data(), b * CBMTX_BLOCK_ENTRIES, end, write_val, val_bytes, meta->val_encoding, &index[b], payloads[b]);
+  }
+  for (uint64_t b = 0, offset = 0; b < nblocks; ++b) {
+    index[b].offset = offset;
+    offset += index[b].size;
+  }
+  mm_phase_end(MM_PHASE_ENCODE, t);
+
+  t = mm_phase_begin();
+  int err = write_matrix_market_header(f, meta, MM_IDX_BYTES_COMPRESSED, coo->nrows, coo->ncols, nnz);
+  mm_phase_end(MM_PHASE_BANNER, t);
+  if (err != 0) {
+    fprintf(stderr, "Something went wrong writing the file header.\n");
+    fclose(f);
+    return err;
+  }
+
+  t = mm_phase_begin();
+  uint32_t block_entries = CBMTX_BLOCK_ENTRIES, codec = CBMTX_CODEC_NONE;
+  fwrite(&nblocks, sizeof(nblocks), 1, f);
+  fwrite(&block_entries, sizeof(block_entries), 1, f);
+  fwrite(&codec, sizeof(codec), 1, f);
+  fwrite(index.data(), sizeof(CBMTX_Block_Info), nblocks, f);
+  for (uint64_t b = 0; b < nblocks; ++b) {
+    if (!mm_progress(MM_PHASE_DATA_IO, b, nblocks)) {
+      fclose(f);
+      return MM_CANCELLED;
+    }
+    if (fwrite(payloads[b].data(), 1, payloads[b].size(), f) != payloads[b].size()) {
+      fclose(f);
+      return MM_COULD_NOT_WRITE_FILE;
+    }
+  }
+  mm_phase_end(MM_PHASE_DATA_IO, t);
+
+  mm_stats_bytes_written(f);
+  fclose(f);
+  return 0;
+}
+
+template<typename VT>
+static bool mm_narrow_val_encoding(const VT *val, uint64_t nnz, Matrix_Metadata* meta) {
+  if (meta->val_type == MM_VAL_TYPE_PATTERN || val == NULL) return false;
+
+  bool is_int = true, half_exact = true, bf16_exact = true, float_exact = true;
+  double min_val = 0.0, max_val = 0.0;
+  #pragma omp parallel for reduction(&&:is_int, half_exact, bf16_exact, float_exact) reduction(min:min_val) reduction(max:max_val)
+  for (uint64_t i = 0; i < nnz; ++i) {
+    double v = static_cast<double>(val[i]);
+    // Only finite values in range are cast (anything else is undefined), infinities are exact in the float encodings
+    bool finite = std::isfinite(v);
+    bool in_float_range = std::isinf(v) || (finite && std::fabs(v) <= (double)std::numeric_limits<float>::max());
+    float vf = in_float_range ? static_cast<float>(v) : 0.0f;
+    is_int = is_int && finite && std::trunc(v) == v;
+    float_exact = float_exact && in_float_range && (double)vf == v;
+    half_exact = half_exact && (double)mm_half_to_float(mm_float_to_half(vf)) == v;
+    bf16_exact = bf16_exact && (double)mm_bf16_to_float(mm_float_to_bf16(vf)) == v;
+    if (finite) {
+      min_val = std::min(min_val, v);
+      max_val = std::max(max_val, v);
+    }
+  }
+
+  // Candidates from the narrowest, for each width the first lossless one is taken
+  struct { uint8_t bytes; MM_VAL_ENCODING enc; bool lossless; } candidates[] = {
+    {1, MM_VAL_ENCODING_INTEGER,  is_int && min_val >= INT8_MIN  && max_val <= INT8_MAX},
+    {2, MM_VAL_ENCODING_INTEGER,  is_int && min_val >= INT16_MIN && max_val <= INT16_MAX},
+    {2, MM_VAL_ENCODING_HALF,     half_exact},
+    {2, MM_VAL_ENCODING_BFLOAT16, bf16_exact},
+    {4, MM_VAL_ENCODING_INTEGER,  is_int && min_val >= INT32_MIN && max_val <= INT32_MAX},
+    {4, MM_VAL_ENCODING_FLOAT,    float_exact},
+  };
+  uint8_t max_bytes = meta->val_bytes > 0 ? meta->val_bytes : 4;
+  for (auto &c : candidates) {
+    if (c.bytes > max_bytes) break;
+    if (c.lossless && (c.bytes < max_bytes || c.enc != meta->val_encoding)) {
+      meta->val_bytes = c.bytes;
+      meta->val_encoding = c.enc;
+      return true;
+    }
+  }
+  return false;
+}
+
+template<typename IT, typename VT, typename OT>
+bool Distr_MMIO_narrow_val_encoding(COO_local<IT, VT, OT>* coo, Matrix_Metadata* meta) {
+  return mm_narrow_val_encoding(coo->val, coo->nnz, meta);
+}
+
+template<typename IT, typename VT, typename OT>
+bool Distr_MMIO_narrow_val_encoding(CSR_local<IT, VT, OT>* csr, Matrix_Metadata* meta) {
+  return mm_narrow_val_encoding(csr->val, csr->nnz, meta);
+}
+
+template<typename IT, typename VT, typename OT>
+int write_matrix_market(FILE *f, COO_local<IT, VT, OT> *coo, Matrix_Metadata *meta) {
   if (!f) return MM_COULD_NOT_WRITE_FILE;
 
-  IT nentries = coo->nnz;
+  OT nentries = coo->nnz;
   if (meta->is_symmetric) { // TODO optimize
     nentries = 0;
-    for (IT i = 0; i < coo->nnz; ++i) {
+    for (OT i = 0; i < coo->nnz; ++i) {
       if (coo->row[i] >= coo->col[i]) {
         ++nentries;
       }
     }
   }
 
+  double t = mm_phase_begin();
   int err = write_matrix_market_header(f, meta, -1, coo->nrows, coo->ncols, nentries);
+  mm_phase_end(MM_PHASE_BANNER, t);
   if (err != 0) {
     fprintf(stderr, "Something went wrong writing the file header.\n");
     fclose(f);
     return err;
   }
 
-  for (IT i = 0; i < coo->nnz; ++i) {
+  t = mm_phase_begin();
+  for (OT i = 0; i < coo->nnz; ++i) {
+    if (i % MM_PROGRESS_ENTRIES == 0 && !mm_progress(MM_PHASE_DATA_IO, i, coo->nnz)) {
+      fclose(f);
+      return MM_CANCELLED;
+    }
     if (meta->is_symmetric && coo->row[i] < coo->col[i]) continue;
     if (meta->val_type == MM_VAL_TYPE_PATTERN) {
       fprintf(f, "%ld %ld\n", (long)(coo->row[i] + 1), (long)(coo->col[i] + 1));
@@ -604,11 +2987,137 @@ int write_matrix_market(FILE *f, COO_local<IT, VT> *coo, Matrix_Metadata *meta)
       return MM_UNSUPPORTED_TYPE;
     }
   }
+  mm_phase_end(MM_PHASE_DATA_IO, t);
 
+  mm_stats_bytes_written(f);
   fclose(f);
   return 0;
 }
 
+#define MM_WRITE_RANGE_ENTRIES (1UL << 20) // Entries encoded by one thread before its output is written
+
+template<typename IT, typename VT, typename OT>
+static void mm_encode_csr_rows(CSR_local<IT, VT, OT> *csr, IT row_begin, IT row_end, bool triangle, int index_bytes, uint8_t val_bytes,
+                               Matrix_Metadata *meta, std::vector<char> &out) {
+  bool with_val = meta->val_type != MM_VAL_TYPE_PATTERN && csr->val != NULL;
+  out.clear();
+  if (index_bytes > 0) {
+    out.reserve((size_t)(csr->row_ptr[row_end] - csr->row_ptr[row_begin]) * (2 * index_bytes + (with_val ? val_bytes : 0)));
+  }
+  char line[128];
+  for (IT r = row_begin; r < row_end; ++r) {
+    for (OT k = csr->row_ptr[r]; k < csr->row_ptr[r + 1]; ++k) {
+      IT c = csr->col_idx[k];
+      if (triangle && r < c) continue; // Lower triangle, as in the Matrix Market specification
+      if (index_bytes > 0) {
+        uint64_t idx[2] = {(uint64_t)r, (uint64_t)c};
+        for (uint64_t v : idx) { // Little endian, truncated to index_bytes
+          size_t pos = out.size();
+          out.resize(pos + index_bytes);
+          memcpy(out.data() + pos, &v, index_bytes);
+        }
+        if (with_val) {
+          size_t pos = out.size();
+          out.resize(pos + val_bytes);
+          mm_encode_val((uint8_t *)out.data() + pos, csr->val[k], val_bytes, meta->val_encoding);
+        }
+      } else {
+        int len;
+        if (!with_val) {
+          len = snprintf(line, sizeof(line), "%ld %ld\n", (long)(r + 1), (long)(c + 1));
+        } else if (meta->val_type == MM_VAL_TYPE_INTEGER) {
+          len = snprintf(line, sizeof(line), "%ld %ld %ld\n", (long)(r + 1), (long)(c + 1), mm_saturate_cast<int64_t>(csr->val[k]));
+        } else if (meta->val_bytes == 8) {
+          len = snprintf(line, sizeof(line), "%ld %ld %.16g\n", (long)(r + 1), (long)(c + 1), (double)csr->val[k]);
+        } else {
+          len = snprintf(line, sizeof(line), "%ld %ld %.9g\n", (long)(r + 1), (long)(c + 1), (float)csr->val[k]); // Round-trips floats
+        }
+        out.insert(out.end(), line, line + len);
+      }
+    }
+  }
+}
+
+/*
+ * Streams rows [row_begin, row_end) of a CSR to a text (index_bytes < 0) or binary Matrix Market file with the
+ * sizes of the whole matrix. Rows are split in ranges of about MM_WRITE_RANGE_ENTRIES entries, encoded in parallel
+ * one wave at a time and written in order.
+ */
+template<typename IT, typename VT, typename OT>
+int write_csr_matrix_market(FILE *f, CSR_local<IT, VT, OT> *csr, IT row_begin, IT row_end, bool triangle, int index_bytes, Matrix_Metadata *meta) {
+  if (!f) return MM_COULD_NOT_WRITE_FILE;
+
+  uint8_t val_bytes = meta->val_bytes > 0 ? meta->val_bytes : 4;
+  if (index_bytes > 0 && !mm_is_valid_val_encoding(val_bytes, meta->val_encoding)) {
+    fprintf(stderr, "Values cannot be encoded using %hhu bytes with the requested encoding.\n", val_bytes);
+    fclose(f);
+    return MM_UNSUPPORTED_TYPE;
+  }
+  if (meta->val_type != MM_VAL_TYPE_REAL && meta->val_type != MM_VAL_TYPE_INTEGER && meta->val_type != MM_VAL_TYPE_PATTERN) {
+    fclose(f);
+    return MM_UNSUPPORTED_TYPE;
+  }
+
+  uint64_t first_entry = csr->row_ptr[row_begin];
+  uint64_t nentries = csr->row_ptr[row_end] - first_entry;
+  if (triangle) {
+    nentries = 0;
+    #pragma omp parallel for schedule(dynamic, 1024) reduction(+:nentries)
+    for (IT r = row_begin; r < row_end; ++r)
+      for (OT k = csr->row_ptr[r]; k < csr->row_ptr[r + 1]; ++k)
+        if (csr->col_idx[k] <= r) ++nentries;
+  }
+
+  double t = mm_phase_begin();
+  int err = write_matrix_market_header(f, meta, index_bytes, csr->nrows, csr->ncols, nentries, MM_SORT_ROW_MAJOR);
+  mm_phase_end(MM_PHASE_BANNER, t);
+  if (err != 0) {
+    fprintf(stderr, "Something went wrong writing the file header.\n");
+    fclose(f);
+    return err;
+  }
+
+  // Row ranges with about the same number of entries
+  std::vector<IT> bounds = {row_begin};
+  uint64_t last_entry = csr->row_ptr[row_end];
+  for (uint64_t target = first_entry + MM_WRITE_RANGE_ENTRIES; target < last_entry; target += MM_WRITE_RANGE_ENTRIES) {
+    IT r = std::upper_bound(csr->row_ptr + row_begin, csr->row_ptr + row_end + 1, (OT)target) - csr->row_ptr - 1;
+    if (r > bounds.back()) bounds.push_back(r);
+  }
+  bounds.push_back(row_end);
+  size_t nranges = bounds.size() - 1;
+  size_t wave = mm_max_threads();
+  std::vector<std::vector<char>> buffers(std::min(wave, nranges));
+
+  for (size_t first = 0; first < nranges && err == 0; first += wave) {
+    size_t last = std::min(nranges, first + wave);
+    if (!mm_progress(MM_PHASE_DATA_IO, csr->row_ptr[bounds[first]] - first_entry, last_entry - first_entry)) {
+      err = MM_CANCELLED;
+      break;
+    }
+    t = mm_phase_begin();
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (size_t i = first; i < last; ++i) {
+      mm_encode_csr_rows(csr, bounds[i], bounds[i + 1], triangle, index_bytes, val_bytes, meta, buffers[i - first]);
+    }
+    mm_phase_end(MM_PHASE_ENCODE, t);
+
+    t = mm_phase_begin();
+    for (size_t i = first; i < last; ++i) {
+      std::vector<char> &buf = buffers[i - first];
+      if (!buf.empty() && fwrite(buf.data(), 1, buf.size(), f) != buf.size()) {
+        err = MM_COULD_NOT_WRITE_FILE;
+        break;
+      }
+    }
+    mm_phase_end(MM_PHASE_DATA_IO, t);
+  }
+
+  mm_stats_bytes_written(f);
+  fclose(f);
+  return err;
+}
+
 void mm_set_metadata(Matrix_Metadata* meta, MM_typecode *matcode) {
   if (meta) {
     // Value type
@@ -624,40 +3133,176 @@ void mm_set_metadata(Matrix_Metadata* meta, MM_typecode *matcode) {
     }
     // Symmetry
     meta->is_symmetric = mm_is_symmetric(*matcode);
+    meta->is_array = mm_is_array(*matcode);
+  }
+}
+
+/*
+ * Checks that the decoded entries lie inside the nrows x ncols of the size line: the parsers take the indices as they
+ * are in the file (a row 0 of a text file wraps around), and the CSR, SELL and BSR fills index the rows with them.
+ */
+template<typename IT, typename VT>
+static int mm_check_entries_range(const Entry<IT, VT> *entries, uint64_t n, uint64_t nrows, uint64_t ncols) {
+  bool out_of_range = false;
+  #pragma omp parallel for schedule(static) reduction(||:out_of_range)
+  for (uint64_t i = 0; i < n; ++i)
+    out_of_range = out_of_range || (uint64_t)entries[i].row >= nrows || (uint64_t)entries[i].col >= ncols;
+  if (out_of_range) {
+    fprintf(stderr, "Matrix entries out of the %lu x %lu size of the matrix.\n", nrows, ncols);
+    return MM_INDEX_OUT_OF_RANGE;
+  }
+  return 0;
+}
+
+/*
+ * Data part of mm_parse_source for submatrix reads: the stored entries of the submatrix are decoded, the mirrors of
+ * symmetric matrices are added (those in the submatrix) and the indices are relabelled if requested.
+ */
+template<typename IT, typename VT, typename OT>
+static Entry<IT, VT>* mm_parse_submatrix(mm_reader &r, IT &nrows, IT &ncols, OT &nnz, MM_typecode *matcode, bool is_bmtx, bool sorted_rows,
+                                         uint64_t file_nrows, uint64_t file_ncols, uint64_t file_nnz, uint8_t idx_bytes, uint8_t val_bytes,
+                                         const Distr_MMIO_Submatrix *sub, Matrix_Metadata* meta) {
+  mm_submatrix_filter filter;
+  filter.symmetric = mm_is_symmetric(*matcode);
+  if (mm_resolve_index_set(&sub->rows, file_nrows, &filter.rows) != 0 || mm_resolve_index_set(&sub->cols, file_ncols, &filter.cols) != 0) {
+    fprintf(stderr, "Invalid submatrix row or column set.\n");
+    return mm_parse_failed<IT, VT>(MM_UNSUPPORTED_TYPE);
   }
+
+  mm_kept_entries<IT, VT> kept;
+  kept.reserve(1); // Never NULL, even when nothing is kept
+  int err = mm_read_submatrix_entries<IT, VT>(r, file_nnz, *matcode, is_bmtx, sorted_rows, idx_bytes, val_bytes, &filter, &kept);
+  if (err == 0) err = mm_check_entries_range(kept.data, kept.n, file_nrows, file_ncols);
+  if (err != 0) {
+    if (err != MM_CANCELLED) printf("Could not parse matrix data (error code: %d).\n", err);
+    mm_free(kept.data);
+    return mm_parse_failed<IT, VT>(err);
+  }
+
+  double t = mm_phase_begin();
+  if (filter.symmetric) {
+    // Mirrors go after the stored entries, then the stored entries outside the submatrix are dropped
+    uint64_t n = kept.n, mirrors = 0, k = 0;
+    kept.reserve(n);
+    Entry<IT, VT> *e = kept.data;
+    for (uint64_t i = 0; i < n; ++i) {
+      if (e[i].row != e[i].col && filter.keep(e[i].col, e[i].row)) {
+        e[n + mirrors].row = e[i].col;
+        e[n + mirrors].col = e[i].row;
+        e[n + mirrors].val = e[i].val;
+        ++mirrors;
+      }
+    }
+    for (uint64_t i = 0; i < n; ++i) {
+      if (filter.keep(e[i].row, e[i].col)) e[k++] = e[i];
+    }
+    memmove(e + k, e + n, mirrors * sizeof(Entry<IT, VT>));
+    kept.n = k + mirrors;
+  }
+  mm_phase_end(MM_PHASE_SYMMETRIC_EXPANSION, t);
+
+  if (kept.n > (uint64_t)std::numeric_limits<OT>::max()) {
+    fprintf(stderr, "Error: Offset Type (OT) is too small to represent the number of entries (%lu).\n", kept.n);
+    mm_free(kept.data);
+    return mm_parse_failed<IT, VT>(MM_UNSUPPORTED_TYPE);
+  }
+
+  if (sub->relabel) {
+    t = mm_phase_begin();
+    Entry<IT, VT> *e = kept.data;
+    #pragma omp parallel for schedule(static)
+    for (uint64_t i = 0; i < kept.n; ++i) {
+      e[i].row = static_cast<IT>(filter.rows.relabel(e[i].row));
+      e[i].col = static_cast<IT>(filter.cols.relabel(e[i].col));
+    }
+    file_nrows = filter.rows.count;
+    file_ncols = filter.cols.count;
+    mm_phase_end(MM_PHASE_REORDER, t);
+  }
+
+  nrows = static_cast<IT>(file_nrows);
+  ncols = static_cast<IT>(file_ncols);
+  nnz = static_cast<OT>(kept.n);
+  mm_set_metadata(meta, matcode);
+  return kept.data;
 }
 
+/*
+ * Writes the mirror (j, i) of each entry (i, j) off the diagonal after the nnz entries (which must have room for
+ * them), returns their number. Each thread counts the entries of its part to mirror, then writes them after those
+ * of the previous parts. The decode loops are not instantiated for symmetric files: the mirrors are written by this
+ * separate pass, which reads the entries already decoded and is the same whatever the file format.
+ */
 template<typename IT, typename VT>
-Entry<IT, VT>* mm_parse_file(FILE *f, IT &nrows, IT &ncols, IT &nnz, MM_typecode *matcode, bool is_bmtx, Matrix_Metadata* meta) {
-  if (f == NULL) return NULL;
+static uint64_t mm_mirror_entries(Entry<IT, VT> *entries, uint64_t nnz) {
+  int nthreads = mm_max_threads();
+  std::vector<uint64_t> mirrored(nthreads + 1, 0);
+  #pragma omp parallel for schedule(static)
+  for (int c = 0; c < nthreads; ++c) {
+    uint64_t count = 0;
+    for (uint64_t i = nnz * c / nthreads; i < nnz * (c + 1) / nthreads; ++i) count += entries[i].row != entries[i].col;
+    mirrored[c + 1] = count;
+  }
+  for (int c = 0; c < nthreads; ++c) mirrored[c + 1] += mirrored[c];
+  #pragma omp parallel for schedule(static)
+  for (int c = 0; c < nthreads; ++c) {
+    Entry<IT, VT> *dst = entries + nnz + mirrored[c];
+    for (uint64_t i = nnz * c / nthreads; i < nnz * (c + 1) / nthreads; ++i) {
+      if (entries[i].row == entries[i].col) continue;
+      dst->row = entries[i].col;
+      dst->col = entries[i].row;
+      dst->val = entries[i].val;
+      ++dst;
+    }
+  }
+  return mirrored[nthreads];
+}
 
-  int err = mm_read_banner(f, matcode, is_bmtx, meta);
+/*
+ * Parses the entries of a source (expanding symmetric matrices). With sub, only the entries of the submatrix are
+ * kept, filtered while decoding; is_sbmtx allows skipping the rows outside the submatrix in row-major sorted files.
+ */
+template<typename IT, typename VT, typename OT>
+Entry<IT, VT>* mm_parse_source(Distr_MMIO_Source *src, IT &nrows, IT &ncols, OT &nnz, MM_typecode *matcode, bool is_bmtx, Matrix_Metadata* meta,
+                               const Distr_MMIO_Submatrix *sub = NULL, bool is_sbmtx = false) {
+  if (src == NULL) return mm_parse_failed<IT, VT>(MM_COULD_NOT_READ_FILE);
+  mm_last_error = 0;
+  mm_reader r(src);
+  Matrix_Metadata metadata2;
+  if (meta == NULL) meta = &metadata2;
+
+  double t = mm_phase_begin();
+  int err = mm_read_banner(r, matcode, is_bmtx, meta);
+  mm_phase_end(MM_PHASE_BANNER, t);
   if (err != 0) {
     fprintf(stderr, "Could not process Matrix Market banner. Error (%d)\n", err);
-    return NULL;
+    return mm_parse_failed<IT, VT>(err);
   }
   if (mm_is_complex(*matcode)) {
     fprintf(stderr, "Cannot parse complex-valued matrices.\n");
-    return NULL;
+    return mm_parse_failed<IT, VT>(MM_UNSUPPORTED_TYPE);
   }
   if (mm_is_array(*matcode)) {
-    fprintf(stderr, "Cannot parse array matrices.\n");
-    return NULL;
+    fprintf(stderr, "Cannot parse array matrices as sparse, use Distr_MMIO_Dense_local_read.\n");
+    return mm_parse_failed<IT, VT>(MM_UNSUPPORTED_TYPE);
   }
   if (mm_is_skew(*matcode)) {
     fprintf(stderr, "Cannot parse skew-symmetric matrices.\n");
-    return NULL;
+    return mm_parse_failed<IT, VT>(MM_UNSUPPORTED_TYPE);
   }
   if (mm_is_hermitian(*matcode)) {
     fprintf(stderr, "Cannot parse hermitian matrices.\n");
-    return NULL;
+    return mm_parse_failed<IT, VT>(MM_UNSUPPORTED_TYPE);
   }
 
   uint64_t _nrows, _ncols, _nnz, mm_nnz;
-  if (mm_read_mtx_crd_size(f, &_nrows, &_ncols, &mm_nnz) != 0) {
+  t = mm_phase_begin();
+  err = mm_read_mtx_crd_size(r, &_nrows, &_ncols, &mm_nnz);
+  if (err != 0) {
     fprintf(stderr, "Could not parse matrix size.\n");
-    return NULL;
+    return mm_parse_failed<IT, VT>(err);
   }
+  mm_phase_end(MM_PHASE_SIZE_LINE, t);
 
   uint8_t idx_bytes = 0;
   uint8_t val_bytes = 0;
@@ -667,110 +3312,317 @@ Entry<IT, VT>* mm_parse_file(FILE *f, IT &nrows, IT &ncols, IT &nnz, MM_typecode
     idx_bytes = mm_get_idx_bytes(*matcode);
     val_bytes = mm_get_val_bytes(*matcode);
 
-    if(!(idx_bytes == 1 || idx_bytes == 2 || idx_bytes == 4 || idx_bytes == 8)
-       && !(val_bytes == 1 || val_bytes == 2 || val_bytes == 4 || val_bytes == 8)) {
+    if(!(idx_bytes == MM_IDX_BYTES_COMPRESSED || idx_bytes == 1 || idx_bytes == 2 || idx_bytes == 4 || idx_bytes == 8)
+       || !(val_bytes == 1 || val_bytes == 2 || val_bytes == 4 || val_bytes == 8)) {
       fprintf(stderr, "BMTX BUG: this should not happen. idx: %hhu bytes, val: %hhu bytes. Please report this.\n", idx_bytes, val_bytes);
-      return NULL;
+      return mm_parse_failed<IT, VT>(MM_UNSUPPORTED_TYPE);
+    }
+    if (!mm_is_pattern(*matcode) && !mm_is_valid_val_encoding(val_bytes, mm_get_val_encoding(*matcode))) {
+      fprintf(stderr, "BMTX: values encoding not supported with %hhu bytes.\n", val_bytes);
+      return mm_parse_failed<IT, VT>(MM_UNSUPPORTED_TYPE);
     }
-    if (idx_bytes < IT_required_bytes) {
+    if (idx_bytes != MM_IDX_BYTES_COMPRESSED && idx_bytes < IT_required_bytes) {
       fprintf(stderr, "BMTX BUG: this should not happen. Need at least %d bytes, binary is written using %hhu bytes. Please report this.\n", IT_required_bytes, idx_bytes);
-      return NULL;
+      return mm_parse_failed<IT, VT>(MM_UNSUPPORTED_TYPE);
     }
   }
 
   if (sizeof(IT) < (size_t)IT_required_bytes) {
     fprintf(stderr, "Error: Index Type (IT) is too small to represent matrix indices (need at least %d bytes, got %zu bytes).\n", IT_required_bytes, sizeof(IT));
-    return NULL;
+    return mm_parse_failed<IT, VT>(MM_UNSUPPORTED_TYPE);
   }
 
 
+  // Statistics from the header only describe the whole matrix, and are stale if entries were appended
+  if (sub != NULL || meta->structure.nrows != _nrows || meta->structure.ncols != _ncols) meta->structure.valid = false;
+
+  if (sub != NULL) return mm_parse_submatrix<IT, VT, OT>(r, nrows, ncols, nnz, matcode, is_bmtx, is_sbmtx && mm_file_sort_order(meta, is_sbmtx) == MM_SORT_ROW_MAJOR,
+                                                        _nrows, _ncols, mm_nnz, idx_bytes, val_bytes, sub, meta);
+
   _nnz = mm_is_symmetric(*matcode) ? mm_nnz * 2 : mm_nnz; // For symmetric matrices THIS IS AN UPPER BOUND
+  if (_nnz > (uint64_t)std::numeric_limits<OT>::max()) {
+    fprintf(stderr, "Error: Offset Type (OT) is too small to represent the number of entries (%lu).\n", _nnz);
+    return mm_parse_failed<IT, VT>(MM_UNSUPPORTED_TYPE);
+  }
   nrows = static_cast<IT>(_nrows);
   ncols = static_cast<IT>(_ncols);
 
-  Entry<IT, VT> *entries = (Entry<IT, VT> *)malloc(_nnz * sizeof(Entry<IT, VT>));
-  err = mm_read_mtx_crd_data<IT, VT>(f, mm_nnz, entries, *matcode, is_bmtx, idx_bytes, val_bytes);
+  Entry<IT, VT> *entries = (Entry<IT, VT> *)mm_alloc(_nnz * sizeof(Entry<IT, VT>));
+  if (is_bmtx && idx_bytes == MM_IDX_BYTES_COMPRESSED) {
+    std::vector<CBMTX_Block_Info> index;
+    uint64_t nread;
+    err = cbmtx_read_index(r, mm_nnz, index);
+    if (err == 0) err = mm_read_cbmtx_data<IT, VT>(r, index, entries, *matcode, val_bytes, 0, UINT64_MAX, &nread);
+    if (err == 0 && nread != mm_nnz) err = MM_PREMATURE_EOF;
+  } else {
+    err = mm_read_mtx_crd_data<IT, VT>(r, mm_nnz, entries, *matcode, is_bmtx, idx_bytes, val_bytes);
+  }
+  if (err == 0) err = mm_check_entries_range(entries, mm_nnz, _nrows, _ncols);
   if (err != 0) {
-    printf("Could not parse matrix data (error code: %d).\n", err);
-    free(entries);
-    fclose(f);
-    return NULL;
+    if (err != MM_CANCELLED) printf("Could not parse matrix data (error code: %d).\n", err);
+    mm_free(entries);
+    return mm_parse_failed<IT, VT>(err);
   }
-  fclose(f);
 
-  if (mm_is_symmetric(*matcode)) {
-    _nnz = mm_nnz;
-    // Duplicate the entries for symmetric matrices
-    for (uint64_t i = 0, j = 0; i < mm_nnz; ++i) {
-      if (entries[i].row != entries[i].col) { // Do not duplicate diagonal
-        entries[j + mm_nnz].row = entries[i].col;
-        entries[j + mm_nnz].col = entries[i].row;
-        entries[j + mm_nnz].val = entries[i].val;
-        ++_nnz;
-        ++j;
-      }
-    }
-  }
+  t = mm_phase_begin();
+  if (mm_is_symmetric(*matcode)) _nnz = mm_nnz + mm_mirror_entries(entries, mm_nnz);
+  mm_phase_end(MM_PHASE_SYMMETRIC_EXPANSION, t);
 
-  nnz = static_cast<IT>(_nnz);
+  nnz = static_cast<OT>(_nnz);
+  if (meta->structure.nnz != _nnz) meta->structure.valid = false;
   mm_set_metadata(meta, matcode);
 
   return entries;
 }
 
-// CSR
+// Opens, parses and closes a file
+template<typename IT, typename VT, typename OT>
+Entry<IT, VT>* mm_parse_file(const char *filename, IT &nrows, IT &ncols, OT &nnz, MM_typecode *matcode, bool is_bmtx, Matrix_Metadata* meta) {
+  Distr_MMIO_Source src;
+  if (Distr_MMIO_source_file(filename, &src) != 0) return NULL;
+  Entry<IT, VT> *entries = mm_parse_source<IT, VT, OT>(&src, nrows, ncols, nnz, matcode, is_bmtx, meta);
+  Distr_MMIO_source_close(&src);
+  return entries;
+}
 
-template<typename IT, typename VT>
-CSR_local<IT, VT>* Distr_MMIO_CSR_local_read(const char *filename, bool expl_val_for_bin_mtx, Matrix_Metadata* meta) {
-  return Distr_MMIO_CSR_local_read_f<IT, VT>(open_file_r(filename), is_file_extension_bmtx(std::string(filename)), expl_val_for_bin_mtx, meta);
+// PROBE
+
+int Distr_MMIO_probe(const char *filename, Matrix_Metadata* meta) {
+  Matrix_Metadata metadata2;
+  if (meta == NULL) meta = &metadata2;
+
+  Distr_MMIO_Source src;
+  if (Distr_MMIO_source_file(filename, &src) != 0) return MM_COULD_NOT_READ_FILE;
+
+  std::string fname(filename);
+  bool is_bin = is_file_extension_bmtx(fname) || is_file_extension_sbmtx(fname) || is_file_extension_cbmtx(fname);
+  MM_typecode matcode;
+  uint64_t nrows, ncols, nnz;
+  int err;
+  {
+    mm_reader r(&src);
+    err = mm_read_banner(r, &matcode, is_bin, meta);
+    if (err == 0 && !(mm_is_real(matcode) || mm_is_integer(matcode) || mm_is_pattern(matcode)))
+      err = MM_UNSUPPORTED_TYPE;
+    if (err == 0 && mm_is_array(matcode)) {
+      err = mm_read_mtx_array_size(r, &nrows, &ncols);
+      nnz = is_bin ? nrows * ncols : mm_array_stored_values(matcode, nrows, ncols);
+    } else if (err == 0) {
+      err = mm_read_mtx_crd_size(r, &nrows, &ncols, &nnz);
+    }
+  }
+  Distr_MMIO_source_close(&src);
+  if (err != 0) return err;
+
+  mm_set_metadata(meta, &matcode);
+  meta->nrows = nrows;
+  meta->ncols = ncols;
+  meta->nnz = nnz;
+  meta->expanded_nnz = mm_is_array(matcode) ? nrows * ncols : mm_is_symmetric(matcode) ? nnz * 2 : nnz;
+  const Distr_MMIO_Structure &s = meta->structure;
+  if (s.valid && s.nrows == nrows && s.ncols == ncols && (mm_is_symmetric(matcode) ? (s.nnz + s.diagonal) / 2 : s.nnz) == nnz)
+    meta->expanded_nnz = s.nnz; // Exact
+  else
+    meta->structure.valid = false;
+  if (is_bin) {
+    meta->val_bytes = mm_get_val_bytes(matcode);
+    meta->val_encoding = mm_get_val_encoding(matcode);
+  }
+  return 0;
+}
+
+template<typename IT, typename VT, typename OT>
+uint64_t Distr_MMIO_CSR_local_footprint(const Matrix_Metadata* meta, bool expl_val_for_bin_mtx) {
+  bool has_val = expl_val_for_bin_mtx || meta->val_type != MM_VAL_TYPE_PATTERN;
+  return sizeof(CSR_local<IT, VT, OT>) + (meta->nrows + 1) * sizeof(OT) + meta->expanded_nnz * (sizeof(IT) + (has_val ? sizeof(VT) : 0));
+}
+
+template<typename IT, typename VT, typename OT>
+uint64_t Distr_MMIO_COO_local_footprint(const Matrix_Metadata* meta, bool expl_val_for_bin_mtx) {
+  bool has_val = expl_val_for_bin_mtx || meta->val_type != MM_VAL_TYPE_PATTERN;
+  return sizeof(COO_local<IT, VT, OT>) + meta->expanded_nnz * (2 * sizeof(IT) + (has_val ? sizeof(VT) : 0));
+}
+
+// CSR
+
+template<typename IT, typename VT, typename OT>
+CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read(const char *filename, bool expl_val_for_bin_mtx, Matrix_Metadata* meta) {
+  std::string fname(filename);
+  Distr_MMIO_Source src;
+  if (Distr_MMIO_source_file(filename, &src) != 0) return NULL;
+  CSR_local<IT, VT, OT> *csr = Distr_MMIO_CSR_local_read_source<IT, VT, OT>(&src, is_file_extension_bmtx(fname) || is_file_extension_sbmtx(fname) || is_file_extension_cbmtx(fname), expl_val_for_bin_mtx, meta);
+  Distr_MMIO_source_close(&src);
+  return csr;
 }
 // template CSR_local<uint64_t, double>* Distr_MMIO_CSR_local_read(const char *filename, bool expl_val_for_bin_mtx);
 
-template<typename IT, typename VT>
-CSR_local<IT, VT>* Distr_MMIO_CSR_local_read_f(FILE *f, bool is_bmtx, bool expl_val_for_bin_mtx, Matrix_Metadata* meta) {
-  IT nrows, ncols, nnz;
+template<typename IT, typename VT, typename OT>
+CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read_f(FILE *f, bool is_bmtx, bool expl_val_for_bin_mtx, Matrix_Metadata* meta) {
+  Distr_MMIO_Source src;
+  if (Distr_MMIO_source_stream(f, &src) != 0) return NULL;
+  return Distr_MMIO_CSR_local_read_source<IT, VT, OT>(&src, is_bmtx, expl_val_for_bin_mtx, meta);
+}
+
+template<typename IT, typename VT, typename OT>
+CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read_source(Distr_MMIO_Source *src, bool is_bmtx, bool expl_val_for_bin_mtx, Matrix_Metadata* meta) {
+  IT nrows, ncols;
+  OT nnz;
   MM_typecode matcode;
-  Entry<IT, VT> *entries = mm_parse_file<IT, VT>(f, nrows, ncols, nnz, &matcode, is_bmtx, meta);
-  if (entries == NULL) return NULL;
+  mm_stats_begin();
+  Entry<IT, VT> *entries = mm_parse_source<IT, VT, OT>(src, nrows, ncols, nnz, &matcode, is_bmtx, meta);
+  if (entries == NULL) {
+    mm_stats_end(0);
+    return NULL;
+  }
 
-  CSR_local<IT, VT> *csr = Distr_MMIO_CSR_local_create<IT, VT>(nrows, ncols, nnz, expl_val_for_bin_mtx || !mm_is_pattern(matcode));
-  entries_to_local_csr<IT, VT>(entries, csr);
+  bool is_sorted = mm_canonicalize(entries, nnz, nrows, ncols, MM_SORT_ROW_MAJOR, false, meta);
+  CSR_local<IT, VT, OT> *csr = Distr_MMIO_CSR_local_create<IT, VT, OT>(nrows, ncols, nnz, expl_val_for_bin_mtx || !mm_is_pattern(matcode));
+  entries_to_local_csr<IT, VT, OT>(entries, csr, mm_structure_to_collect(meta), is_sorted);
 
-  free(entries);
+  double t = mm_phase_begin();
+  mm_free(entries);
+  mm_phase_end(MM_PHASE_FREE, t);
 
+  mm_stats_end(nnz);
   return csr;
 }
 // template CSR_local<uint64_t, double>* Distr_MMIO_CSR_local_read_f(FILE *f, bool expl_val_for_bin_mtx);
 
+template<typename IT, typename VT, typename OT>
+CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read_reordered(const char *filename, MM_REORDER order, IT **perm, bool persist_perm, bool expl_val_for_bin_mtx, Matrix_Metadata* meta) {
+  std::string fname(filename);
+  bool is_bmtx = is_file_extension_bmtx(fname) || is_file_extension_sbmtx(fname) || is_file_extension_cbmtx(fname);
+  if (perm != NULL) *perm = NULL;
+
+  // Stamp of the file as it is read, a change during the read makes the stored permutation stale
+  struct stat matrix_st;
+  persist_perm = persist_perm && stat(filename, &matrix_st) == 0;
+
+  IT nrows, ncols;
+  OT nnz;
+  MM_typecode matcode;
+  mm_stats_begin();
+  Entry<IT, VT> *entries = mm_parse_file<IT, VT, OT>(filename, nrows, ncols, nnz, &matcode, is_bmtx, meta);
+  if (entries == NULL) {
+    mm_stats_end(0);
+    return NULL;
+  }
+  if (order != MM_REORDER_NONE && nrows != ncols) {
+    fprintf(stderr, "Reordering requires a square matrix (%lu x %lu).\n", (uint64_t)nrows, (uint64_t)ncols);
+    mm_free(entries);
+    mm_stats_end(0);
+    return NULL;
+  }
+
+  IT *new_label = NULL;
+  if (order != MM_REORDER_NONE) {
+    double t = mm_phase_begin();
+    new_label = (IT *)mm_alloc((size_t)nrows * sizeof(IT));
+    std::string perm_filename = fname + "." + mm_reorder_name(order) + ".perm";
+    if (!persist_perm || !mm_read_permutation(perm_filename, mm_file_stamp(matrix_st), order, nrows, new_label)) {
+      mm_compute_permutation(entries, nnz, nrows, order, new_label);
+      if (persist_perm && mm_write_permutation(perm_filename, mm_file_stamp(matrix_st), order, nrows, new_label) != 0)
+        fprintf(stderr, "Could not store the permutation in [%s].\n", perm_filename.c_str());
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (OT i = 0; i < nnz; ++i) {
+      entries[i].row = new_label[entries[i].row];
+      entries[i].col = new_label[entries[i].col];
+    }
+    mm_phase_end(MM_PHASE_REORDER, t);
+    if (meta != NULL) meta->structure.valid = false; // Bandwidth and row lengths change with the labels
+  }
+
+  bool is_sorted = mm_canonicalize(entries, nnz, nrows, ncols, MM_SORT_ROW_MAJOR, false, meta);
+  CSR_local<IT, VT, OT> *csr = Distr_MMIO_CSR_local_create<IT, VT, OT>(nrows, ncols, nnz, expl_val_for_bin_mtx || !mm_is_pattern(matcode));
+  entries_to_local_csr<IT, VT, OT>(entries, csr, mm_structure_to_collect(meta), is_sorted);
+
+  double t = mm_phase_begin();
+  mm_free(entries);
+  if (perm != NULL) *perm = new_label;
+  else mm_free(new_label);
+  mm_phase_end(MM_PHASE_FREE, t);
+
+  mm_stats_end(nnz);
+  return csr;
+}
+
+template<typename IT, typename VT, typename OT>
+int Distr_MMIO_CSR_local_write(CSR_local<IT, VT, OT>* csr, const char *filename, bool write_as_binary, bool write_triangle, Matrix_Metadata* meta) {
+  return Distr_MMIO_CSR_local_write_f(csr, open_file_w(filename), write_as_binary, write_triangle, meta);
+}
+
+template<typename IT, typename VT, typename OT>
+int Distr_MMIO_CSR_local_write_f(CSR_local<IT, VT, OT>* csr, FILE *f, bool write_as_binary, bool write_triangle, Matrix_Metadata* meta) {
+  // Only a matrix declared symmetric can be stored as one triangle, otherwise all the entries are written
+  meta->is_symmetric = meta->is_symmetric && write_triangle;
+
+  meta->mm_header = "%%MatrixMarket matrix coordinate ";
+  switch (meta->val_type) {
+  case MM_VAL_TYPE_REAL:    { meta->mm_header += std::string(MM_REAL_STR);    break; }
+  case MM_VAL_TYPE_INTEGER: { meta->mm_header += std::string(MM_INT_STR);     break; }
+  case MM_VAL_TYPE_PATTERN: { meta->mm_header += std::string(MM_PATTERN_STR); break; }
+  default:                  { fprintf(stderr, "BUG: MM_VAL_TYPE not recognized\n"); return 100; }
+  }
+  meta->mm_header += meta->is_symmetric ? " symmetric" : " general";
+
+  int index_bytes = write_as_binary ? required_bytes_index(std::max(csr->nrows, csr->ncols)) : -1;
+  mm_stats_begin();
+  int err = write_csr_matrix_market(f, csr, (IT)0, csr->nrows, meta->is_symmetric, index_bytes, meta);
+  mm_stats_end(err == 0 ? csr->nnz : 0);
+  return err;
+}
+
 // COO
 
-template<typename IT, typename VT>
-COO_local<IT, VT>* Distr_MMIO_COO_local_read(const char *filename, bool expl_val_for_bin_mtx, Matrix_Metadata* meta) {
-  return Distr_MMIO_COO_local_read_f<IT, VT>(open_file_r(filename), is_file_extension_bmtx(std::string(filename)), expl_val_for_bin_mtx, meta);
+template<typename IT, typename VT, typename OT>
+COO_local<IT, VT, OT>* Distr_MMIO_COO_local_read(const char *filename, bool expl_val_for_bin_mtx, Matrix_Metadata* meta) {
+  std::string fname(filename);
+  Distr_MMIO_Source src;
+  if (Distr_MMIO_source_file(filename, &src) != 0) return NULL;
+  COO_local<IT, VT, OT> *coo = Distr_MMIO_COO_local_read_source<IT, VT, OT>(&src, is_file_extension_bmtx(fname) || is_file_extension_sbmtx(fname) || is_file_extension_cbmtx(fname), expl_val_for_bin_mtx, meta);
+  Distr_MMIO_source_close(&src);
+  return coo;
 }
 
-template<typename IT, typename VT>
-COO_local<IT, VT>* Distr_MMIO_COO_local_read_f(FILE *f, bool is_bmtx, bool expl_val_for_bin_mtx, Matrix_Metadata* meta) {
-  IT nrows, ncols, nnz;
+template<typename IT, typename VT, typename OT>
+COO_local<IT, VT, OT>* Distr_MMIO_COO_local_read_f(FILE *f, bool is_bmtx, bool expl_val_for_bin_mtx, Matrix_Metadata* meta) {
+  Distr_MMIO_Source src;
+  if (Distr_MMIO_source_stream(f, &src) != 0) return NULL;
+  return Distr_MMIO_COO_local_read_source<IT, VT, OT>(&src, is_bmtx, expl_val_for_bin_mtx, meta);
+}
+
+template<typename IT, typename VT, typename OT>
+COO_local<IT, VT, OT>* Distr_MMIO_COO_local_read_source(Distr_MMIO_Source *src, bool is_bmtx, bool expl_val_for_bin_mtx, Matrix_Metadata* meta) {
+  IT nrows, ncols;
+  OT nnz;
   MM_typecode matcode;
-  Entry<IT, VT> *entries = mm_parse_file<IT, VT>(f, nrows, ncols, nnz, &matcode, is_bmtx, meta);
-  if (entries == NULL) return NULL;
+  mm_stats_begin();
+  Entry<IT, VT> *entries = mm_parse_source<IT, VT, OT>(src, nrows, ncols, nnz, &matcode, is_bmtx, meta);
+  if (entries == NULL) {
+    mm_stats_end(0);
+    return NULL;
+  }
 
-  COO_local<IT, VT> *coo = Distr_MMIO_COO_local_create<IT, VT>(nrows, ncols, nnz, expl_val_for_bin_mtx || !mm_is_pattern(matcode));
-  entries_to_local_coo<IT, VT>(entries, coo);
+  COO_local<IT, VT, OT> *coo = Distr_MMIO_COO_local_create<IT, VT, OT>(nrows, ncols, nnz, expl_val_for_bin_mtx || !mm_is_pattern(matcode));
+  entries_to_local_coo<IT, VT, OT>(entries, coo);
 
-  free(entries);
+  double t = mm_phase_begin();
+  mm_free(entries);
+  mm_phase_end(MM_PHASE_FREE, t);
 
+  mm_stats_end(nnz);
   return coo;
 }
 
-template<typename IT, typename VT>
-int Distr_MMIO_COO_local_write(COO_local<IT, VT>* coo, const char *filename, bool write_as_binary, Matrix_Metadata* meta) {
+template<typename IT, typename VT, typename OT>
+int Distr_MMIO_COO_local_write(COO_local<IT, VT, OT>* coo, const char *filename, bool write_as_binary, Matrix_Metadata* meta) {
   return Distr_MMIO_COO_local_write_f(coo, open_file_w(filename), write_as_binary, meta);
 }
 
-template<typename IT, typename VT>
-int Distr_MMIO_COO_local_write_f(COO_local<IT, VT>* coo, FILE *f, bool write_as_binary, Matrix_Metadata* meta) {
+template<typename IT, typename VT, typename OT>
+int Distr_MMIO_COO_local_write_f(COO_local<IT, VT, OT>* coo, FILE *f, bool write_as_binary, Matrix_Metadata* meta) {
   if (meta->mm_header.empty()) {
     meta->mm_header = "%%MatrixMarket matrix coordinate ";
 
@@ -784,51 +3636,85 @@ int Distr_MMIO_COO_local_write_f(COO_local<IT, VT>* coo, FILE *f, bool write_as_
     meta->mm_header += meta->is_symmetric ? " symmetric" : " general";
   }
 
-  return write_as_binary ? write_binary_matrix_market(f, coo, meta) : write_matrix_market(f, coo, meta);
+  mm_stats_begin();
+  int err = write_as_binary ? write_binary_matrix_market(f, coo, meta) : write_matrix_market(f, coo, meta);
+  mm_stats_end(err == 0 ? coo->nnz : 0);
+  return err;
 }
 
 // SORTED COO
-template<typename IT, typename VT>
-COO_local<IT, VT>* Distr_MMIO_sorted_COO_local_read(const char *filename, bool fail_if_require_sort, bool expl_val_for_bin_mtx, Matrix_Metadata* meta) {
-    return Distr_MMIO_sorted_COO_local_read_f<IT, VT>(open_file_r(filename), fail_if_require_sort,
-        is_file_extension_bmtx(std::string(filename)), is_file_extension_sbmtx(std::string(filename)), expl_val_for_bin_mtx, meta);
+template<typename IT, typename VT, typename OT>
+COO_local<IT, VT, OT>* Distr_MMIO_sorted_COO_local_read(const char *filename, bool fail_if_require_sort, bool expl_val_for_bin_mtx, Matrix_Metadata* meta, MM_SORT_ORDER order) {
+    std::string fname(filename);
+    Distr_MMIO_Source src;
+    if (Distr_MMIO_source_file(filename, &src) != 0) return NULL;
+    COO_local<IT, VT, OT> *coo = Distr_MMIO_sorted_COO_local_read_source<IT, VT, OT>(&src, fail_if_require_sort,
+        is_file_extension_bmtx(fname) || is_file_extension_cbmtx(fname), is_file_extension_sbmtx(fname), expl_val_for_bin_mtx, meta, order);
+    Distr_MMIO_source_close(&src);
+    return coo;
 }
 
-template<typename IT, typename VT>
-COO_local<IT, VT>* Distr_MMIO_sorted_COO_local_read_f(FILE *f, bool fail_if_require_sort, bool is_bmtx, bool is_sbmtx, bool expl_val_for_bin_mtx, Matrix_Metadata* meta) {
+template<typename IT, typename VT, typename OT>
+COO_local<IT, VT, OT>* Distr_MMIO_sorted_COO_local_read_f(FILE *f, bool fail_if_require_sort, bool is_bmtx, bool is_sbmtx, bool expl_val_for_bin_mtx, Matrix_Metadata* meta, MM_SORT_ORDER order) {
+    Distr_MMIO_Source src;
+    if (Distr_MMIO_source_stream(f, &src) != 0) return NULL;
+    return Distr_MMIO_sorted_COO_local_read_source<IT, VT, OT>(&src, fail_if_require_sort, is_bmtx, is_sbmtx, expl_val_for_bin_mtx, meta, order);
+}
+
+template<typename IT, typename VT, typename OT>
+COO_local<IT, VT, OT>* Distr_MMIO_sorted_COO_local_read_source(Distr_MMIO_Source *src, bool fail_if_require_sort, bool is_bmtx, bool is_sbmtx, bool expl_val_for_bin_mtx, Matrix_Metadata* meta, MM_SORT_ORDER order) {
     Matrix_Metadata metadata2;
     if (meta == NULL) {
         meta = &metadata2;
     }
 
-    IT nrows, ncols, nnz;
+    IT nrows, ncols;
+    OT nnz;
     MM_typecode matcode;
-    Entry<IT, VT> *entries = mm_parse_file<IT, VT>(f, nrows, ncols, nnz, &matcode, is_bmtx || is_sbmtx, meta);
-    if (entries == NULL) return NULL;
+    mm_stats_begin();
+    Entry<IT, VT> *entries = mm_parse_source<IT, VT, OT>(src, nrows, ncols, nnz, &matcode, is_bmtx || is_sbmtx, meta);
+    if (entries == NULL) {
+        mm_stats_end(0);
+        return NULL;
+    }
 
 
-    if (!is_sbmtx)
+    // CBMTX blocks are always sorted row-major. The mirrors of symmetric files follow the stored entries, so those are never sorted
+    bool is_sorted = !mm_is_symmetric(matcode) &&
+                     ((is_sbmtx && mm_file_sort_order(meta, is_sbmtx) == order) || (mm_is_compressed(matcode) && order == MM_SORT_ROW_MAJOR));
+    if (!is_sorted)
     {
-        if (fail_if_require_sort) return NULL;
-        qsort(entries, nnz, sizeof(Entry<IT, VT>), compare_entries_csr<IT, VT>);
+        if (fail_if_require_sort) {
+            mm_free(entries);
+            mm_stats_end(0);
+            return NULL;
+        }
+        double t = mm_phase_begin();
+        entries = mm_sort_entries(entries, nnz, nrows, ncols, order);
+        mm_phase_end(MM_PHASE_SORT, t);
     }
+    meta->sort_order = order;
+    mm_canonicalize(entries, nnz, nrows, ncols, order, true, meta);
 
 
-    COO_local<IT, VT> *coo = Distr_MMIO_COO_local_create<IT, VT>(nrows, ncols, nnz, expl_val_for_bin_mtx || !mm_is_pattern(matcode));
-    entries_to_local_coo<IT, VT>(entries, coo);
+    COO_local<IT, VT, OT> *coo = Distr_MMIO_COO_local_create<IT, VT, OT>(nrows, ncols, nnz, expl_val_for_bin_mtx || !mm_is_pattern(matcode));
+    entries_to_local_coo<IT, VT, OT>(entries, coo);
 
-    free(entries);
+    double t = mm_phase_begin();
+    mm_free(entries);
+    mm_phase_end(MM_PHASE_FREE, t);
 
+    mm_stats_end(nnz);
     return coo;
 }
 
-template<typename IT, typename VT>
-int Distr_MMIO_sorted_COO_local_write(COO_local<IT, VT>* coo, const char *filename, bool write_as_binary, Matrix_Metadata* meta) {
+template<typename IT, typename VT, typename OT>
+int Distr_MMIO_sorted_COO_local_write(COO_local<IT, VT, OT>* coo, const char *filename, bool write_as_binary, Matrix_Metadata* meta) {
     return Distr_MMIO_sorted_COO_local_write_f(coo, open_file_w(filename), write_as_binary, meta);
 }
 
-template<typename IT, typename VT>
-int Distr_MMIO_sorted_COO_local_write_f(COO_local<IT, VT>* coo, FILE *f, bool write_as_binary, Matrix_Metadata* meta) {
+template<typename IT, typename VT, typename OT>
+int Distr_MMIO_sorted_COO_local_write_f(COO_local<IT, VT, OT>* coo, FILE *f, bool write_as_binary, Matrix_Metadata* meta) {
     meta->is_symmetric = false;
 
     meta->mm_header = "%%MatrixMarket matrix coordinate ";
@@ -841,7 +3727,2631 @@ int Distr_MMIO_sorted_COO_local_write_f(COO_local<IT, VT>* coo, FILE *f, bool wr
     meta->mm_header += " general";
 
 
-    return write_as_binary ? write_binary_matrix_market(f, coo, meta) : write_matrix_market(f, coo, meta);
+    mm_stats_begin();
+    int err = write_as_binary ? write_binary_matrix_market(f, coo, meta, meta->sort_order) : write_matrix_market(f, coo, meta);
+    mm_stats_end(err == 0 ? coo->nnz : 0);
+    return err;
+}
+
+// COMPRESSED COO
+template<typename IT, typename VT, typename OT>
+COO_local<IT, VT, OT>* Distr_MMIO_compressed_COO_local_read_rows(const char *filename, IT row_begin, IT row_end, bool expl_val_for_bin_mtx, Matrix_Metadata* meta) {
+  Distr_MMIO_Source src;
+  if (Distr_MMIO_source_file(filename, &src) != 0) return NULL;
+
+  mm_stats_begin();
+  mm_reader r(&src);
+  MM_typecode matcode;
+  double t = mm_phase_begin();
+  int err = mm_read_banner(r, &matcode, true, meta);
+  mm_phase_end(MM_PHASE_BANNER, t);
+  if (err != 0 || !mm_is_compressed(matcode)) {
+    fprintf(stderr, "Could not process CBMTX banner. Error (%d)\n", err);
+    Distr_MMIO_source_close(&src);
+    mm_stats_end(0);
+    return NULL;
+  }
+
+  uint64_t nrows, ncols, mm_nnz;
+  std::vector<CBMTX_Block_Info> index;
+  t = mm_phase_begin();
+  if (mm_read_mtx_crd_size(r, &nrows, &ncols, &mm_nnz) != 0 || cbmtx_read_index(r, mm_nnz, index) != 0) {
+    fprintf(stderr, "Could not parse matrix size.\n");
+    Distr_MMIO_source_close(&src);
+    mm_stats_end(0);
+    return NULL;
+  }
+  mm_phase_end(MM_PHASE_SIZE_LINE, t);
+  uint64_t count = cbmtx_count_entries(index, row_begin, row_end);
+  if (sizeof(IT) < (size_t)required_bytes_index(std::max(nrows, ncols)) || count > (uint64_t)std::numeric_limits<OT>::max()) {
+    fprintf(stderr, "Error: Index Type (IT) or Offset Type (OT) is too small to represent the matrix.\n");
+    Distr_MMIO_source_close(&src);
+    mm_stats_end(0);
+    return NULL;
+  }
+
+  uint64_t nnz;
+  Entry<IT, VT> *entries = (Entry<IT, VT> *)mm_alloc(count * sizeof(Entry<IT, VT>));
+  err = mm_read_cbmtx_data<IT, VT>(r, index, entries, matcode, mm_get_val_bytes(matcode), row_begin, row_end, &nnz);
+  Distr_MMIO_source_close(&src);
+  if (err != 0) {
+    if (err != MM_CANCELLED) fprintf(stderr, "Could not parse matrix data (error code: %d).\n", err);
+    mm_free(entries);
+    mm_stats_end(0);
+    return NULL;
+  }
+  mm_set_metadata(meta, &matcode);
+
+  COO_local<IT, VT, OT> *coo = Distr_MMIO_COO_local_create<IT, VT, OT>(nrows, ncols, nnz, expl_val_for_bin_mtx || !mm_is_pattern(matcode));
+  entries_to_local_coo<IT, VT, OT>(entries, coo);
+
+  t = mm_phase_begin();
+  mm_free(entries);
+  mm_phase_end(MM_PHASE_FREE, t);
+
+  mm_stats_end(nnz);
+  return coo;
+}
+
+template<typename IT, typename VT, typename OT>
+int Distr_MMIO_compressed_COO_local_write(COO_local<IT, VT, OT>* coo, const char *filename, Matrix_Metadata* meta) {
+  return Distr_MMIO_compressed_COO_local_write_f(coo, open_file_w(filename), meta);
+}
+
+template<typename IT, typename VT, typename OT>
+int Distr_MMIO_compressed_COO_local_write_f(COO_local<IT, VT, OT>* coo, FILE *f, Matrix_Metadata* meta) {
+  // As for sorted COO, all the entries are stored and the matrix is written as general
+  meta->is_symmetric = false;
+
+  meta->mm_header = "%%MatrixMarket matrix coordinate ";
+  switch (meta->val_type) {
+  case MM_VAL_TYPE_REAL:    { meta->mm_header += std::string(MM_REAL_STR);    break; }
+  case MM_VAL_TYPE_INTEGER: { meta->mm_header += std::string(MM_INT_STR);     break; }
+  case MM_VAL_TYPE_PATTERN: { meta->mm_header += std::string(MM_PATTERN_STR); break; }
+  default:                  { fprintf(stderr, "BUG: MM_VAL_TYPE not recognized\n"); return 100; }
+  }
+  meta->mm_header += " general";
+
+  mm_stats_begin();
+  int err = write_compressed_binary_matrix_market(f, coo, meta);
+  mm_stats_end(err == 0 ? coo->nnz : 0);
+  return err;
+}
+
+// SUBMATRIX
+template<typename IT, typename VT, typename OT>
+COO_local<IT, VT, OT>* Distr_MMIO_COO_local_read_submatrix(const char *filename, const Distr_MMIO_Submatrix *sub, bool expl_val_for_bin_mtx, Matrix_Metadata* meta) {
+  std::string fname(filename);
+  Distr_MMIO_Source src;
+  if (Distr_MMIO_source_file(filename, &src) != 0) return NULL;
+  COO_local<IT, VT, OT> *coo = Distr_MMIO_COO_local_read_submatrix_source<IT, VT, OT>(&src, sub,
+      is_file_extension_bmtx(fname) || is_file_extension_cbmtx(fname), is_file_extension_sbmtx(fname), expl_val_for_bin_mtx, meta);
+  Distr_MMIO_source_close(&src);
+  return coo;
+}
+
+template<typename IT, typename VT, typename OT>
+COO_local<IT, VT, OT>* Distr_MMIO_COO_local_read_submatrix_source(Distr_MMIO_Source *src, const Distr_MMIO_Submatrix *sub, bool is_bmtx, bool is_sbmtx, bool expl_val_for_bin_mtx, Matrix_Metadata* meta) {
+  IT nrows, ncols;
+  OT nnz;
+  MM_typecode matcode;
+  Distr_MMIO_Submatrix whole;
+  mm_stats_begin();
+  Entry<IT, VT> *entries = mm_parse_source<IT, VT, OT>(src, nrows, ncols, nnz, &matcode, is_bmtx || is_sbmtx, meta, sub != NULL ? sub : &whole, is_sbmtx);
+  if (entries == NULL) {
+    mm_stats_end(0);
+    return NULL;
+  }
+
+  COO_local<IT, VT, OT> *coo = Distr_MMIO_COO_local_create<IT, VT, OT>(nrows, ncols, nnz, expl_val_for_bin_mtx || !mm_is_pattern(matcode));
+  entries_to_local_coo<IT, VT, OT>(entries, coo);
+
+  double t = mm_phase_begin();
+  mm_free(entries);
+  mm_phase_end(MM_PHASE_FREE, t);
+
+  mm_stats_end(nnz);
+  return coo;
+}
+
+template<typename IT, typename VT, typename OT>
+CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read_submatrix(const char *filename, const Distr_MMIO_Submatrix *sub, bool expl_val_for_bin_mtx, Matrix_Metadata* meta) {
+  std::string fname(filename);
+  Distr_MMIO_Source src;
+  if (Distr_MMIO_source_file(filename, &src) != 0) return NULL;
+  CSR_local<IT, VT, OT> *csr = Distr_MMIO_CSR_local_read_submatrix_source<IT, VT, OT>(&src, sub,
+      is_file_extension_bmtx(fname) || is_file_extension_cbmtx(fname), is_file_extension_sbmtx(fname), expl_val_for_bin_mtx, meta);
+  Distr_MMIO_source_close(&src);
+  return csr;
+}
+
+template<typename IT, typename VT, typename OT>
+CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read_submatrix_source(Distr_MMIO_Source *src, const Distr_MMIO_Submatrix *sub, bool is_bmtx, bool is_sbmtx, bool expl_val_for_bin_mtx, Matrix_Metadata* meta) {
+  IT nrows, ncols;
+  OT nnz;
+  MM_typecode matcode;
+  Distr_MMIO_Submatrix whole;
+  mm_stats_begin();
+  Entry<IT, VT> *entries = mm_parse_source<IT, VT, OT>(src, nrows, ncols, nnz, &matcode, is_bmtx || is_sbmtx, meta, sub != NULL ? sub : &whole, is_sbmtx);
+  if (entries == NULL) {
+    mm_stats_end(0);
+    return NULL;
+  }
+
+  bool is_sorted = mm_canonicalize(entries, nnz, nrows, ncols, MM_SORT_ROW_MAJOR, false, meta);
+  CSR_local<IT, VT, OT> *csr = Distr_MMIO_CSR_local_create<IT, VT, OT>(nrows, ncols, nnz, expl_val_for_bin_mtx || !mm_is_pattern(matcode));
+  entries_to_local_csr<IT, VT, OT>(entries, csr, mm_structure_to_collect(meta), is_sorted);
+
+  double t = mm_phase_begin();
+  mm_free(entries);
+  mm_phase_end(MM_PHASE_FREE, t);
+
+  mm_stats_end(nnz);
+  return csr;
+}
+
+/**
+ * Graph files
+ */
+
+static bool mm_has_extension(const std::string &filename, const char *ext) {
+  size_t n = strlen(ext);
+  return filename.size() >= n && filename.compare(filename.size() - n, n, ext) == 0;
+}
+
+bool is_file_extension_metis(std::string filename) {
+  return mm_has_extension(filename, ".graph") || mm_has_extension(filename, ".metis");
+}
+
+bool is_file_extension_graph(std::string filename) {
+  static const char *edge_lists[] = {".txt", ".tsv", ".csv", ".el", ".edges", ".snap"};
+  for (const char *ext : edge_lists) {
+    if (mm_has_extension(filename, ext)) return true;
+  }
+  return is_file_extension_metis(filename);
+}
+
+// Skips the blanks and (at most) one delimiter between two fields
+static inline void mm_skip_delimiter(const char *&p, const char *end, char delimiter) {
+  while (p < end && mm_is_blank(*p)) ++p;
+  if (p < end && *p == delimiter) ++p;
+}
+
+struct mm_edge_extent {
+  uint64_t nrows = 0, ncols = 0; // Largest indices + 1
+  bool has_vals = false;
+};
+
+/*
+ * Parses the edge lines of [p, end), from entry first to entry last: "i j [value ...]" with missing values set
+ * to 1 and further fields ignored. Indices are shifted down by base, extent grows with them. Returns false on
+ * malformed lines.
+ */
+template<typename IT, typename VT>
+static bool mm_parse_edge_lines(const char *p, const char *end, Entry<IT, VT> *entries, uint64_t first, uint64_t last,
+                                const mm_line_syntax &syn, char delimiter, uint64_t base, mm_edge_extent *extent) {
+  for (uint64_t i = first; i < last && p < end;) {
+    while (p < end && mm_is_blank(*p)) ++p;
+    if (syn.is_data(p, end)) {
+      uint64_t row, col;
+      if (!mm_parse_number(p, end, &row)) return false;
+      mm_skip_delimiter(p, end, delimiter);
+      if (!mm_parse_number(p, end, &col) || row < base || col < base) return false;
+      mm_skip_delimiter(p, end, delimiter);
+      entries[i].row = static_cast<IT>(row - base);
+      entries[i].col = static_cast<IT>(col - base);
+      if (p < end && *p != '\n' && !syn.comment[(uint8_t)*p]) {
+        if (!mm_parse_number(p, end, &entries[i].val)) return false;
+        extent->has_vals = true;
+      } else {
+        entries[i].val = static_cast<VT>(1.0);
+      }
+      extent->nrows = std::max(extent->nrows, row - base + 1);
+      extent->ncols = std::max(extent->ncols, col - base + 1);
+      ++i;
+    }
+    const char *nl = (const char *)memchr(p, '\n', end - p);
+    p = nl != NULL ? nl + 1 : end;
+  }
+  return true;
+}
+
+// The number of lines is unknown, so the entries grow window by window
+template<typename IT, typename VT>
+static int mm_read_edge_list(mm_reader &r, const Distr_MMIO_Graph_Options *opts, uint64_t base,
+                             mm_kept_entries<IT, VT> *out, mm_edge_extent *extent) {
+  char line[MM_MAX_LINE_LENGTH];
+  for (uint64_t l = 0; l < opts->skip_lines;) {
+    if (!r.getline(line, sizeof(line))) return MM_PREMATURE_EOF;
+    l += strchr(line, '\n') != NULL; // Longer lines are read in pieces
+  }
+
+  mm_line_syntax syn(opts->comments);
+  int nthreads = mm_max_threads();
+  std::vector<mm_edge_extent> extents(nthreads);
+  int err = mm_read_text_windows(r, MM_UNKNOWN_LINES, [&](const char *w, const std::vector<uint64_t> &bounds, const std::vector<uint64_t> &first) {
+    uint64_t done = first[0];
+    out->reserve(first[nthreads] - done);
+    bool ok = true;
+    #pragma omp parallel for schedule(static) reduction(&&:ok)
+    for (int c = 0; c < nthreads; ++c)
+      ok = mm_parse_edge_lines<IT, VT>(w + bounds[c], w + bounds[c + 1], out->data + out->n, first[c] - done,
+                                       first[c + 1] - done, syn, opts->delimiter, base, &extents[c]);
+    out->n += first[nthreads] - done;
+    return ok ? 0 : MM_PREMATURE_EOF;
+  }, syn);
+  for (const mm_edge_extent &e : extents) {
+    extent->nrows = std::max(extent->nrows, e.nrows);
+    extent->ncols = std::max(extent->ncols, e.ncols);
+    extent->has_vals = extent->has_vals || e.has_vals;
+  }
+  return err;
+}
+
+// Optional fields of METIS graphs, from the "fmt" digits (vertex sizes, vertex weights, edge weights) and "ncon"
+struct mm_metis_format {
+  bool vertex_sizes = false;
+  uint64_t vertex_weights = 0; // Per vertex
+  bool edge_weights = false;
+};
+
+static int mm_read_metis_header(mm_reader &r, const mm_line_syntax &syn, uint64_t *n, uint64_t *m, mm_metis_format *fmt) {
+  char line[MM_MAX_LINE_LENGTH];
+  const char *p;
+  do {
+    if (!r.getline(line, sizeof(line))) return MM_PREMATURE_EOF;
+    for (p = line; mm_is_blank(*p); ++p);
+  } while (*p == '\0' || *p == '\n' || syn.comment[(uint8_t)*p]);
+
+  char digits[8] = "0";
+  unsigned long ncon = 1;
+  if (sscanf(p, "%lu %lu %7s %lu", n, m, digits, &ncon) < 2) return MM_NO_HEADER;
+  size_t len = strlen(digits);
+  if (len > 3 || strspn(digits, "01") != len) return MM_UNSUPPORTED_TYPE;
+  fmt->edge_weights = digits[len - 1] == '1';
+  fmt->vertex_weights = len >= 2 && digits[len - 2] == '1' ? ncon : 0;
+  fmt->vertex_sizes = len == 3 && digits[0] == '1';
+  return 0;
+}
+
+/*
+ * Parses the adjacency lists of the vertices first to last in [p, end) (blank lines are vertices without
+ * neighbours). The edges are stored in entries if not NULL, otherwise only counted; nedges is set to their number.
+ * Returns false on malformed lines or neighbours outside [base, base + n).
+ */
+template<typename IT, typename VT>
+static bool mm_parse_metis_lines(const char *p, const char *end, uint64_t first, uint64_t last, uint64_t n, uint64_t base,
+                                 const mm_metis_format &fmt, const mm_line_syntax &syn, Entry<IT, VT> *entries, uint64_t *nedges) {
+  uint64_t k = 0;
+  for (uint64_t v = first; v < last && p < end;) {
+    while (p < end && mm_is_blank(*p)) ++p;
+    if (syn.is_data(p, end)) {
+      uint64_t field;
+      for (uint64_t s = 0; s < fmt.vertex_sizes + fmt.vertex_weights; ++s) {
+        if (!mm_parse_number(p, end, &field)) return false;
+      }
+      for (;;) {
+        while (p < end && mm_is_blank(*p)) ++p;
+        if (p == end || *p == '\n') break;
+        uint64_t u;
+        VT weight = static_cast<VT>(1.0);
+        if (!mm_parse_number(p, end, &u) || u < base || u - base >= n) return false;
+        if (fmt.edge_weights && !mm_parse_number(p, end, &weight)) return false;
+        if (entries != NULL) entries[k] = {static_cast<IT>(v), static_cast<IT>(u - base), weight};
+        ++k;
+      }
+      ++v;
+    }
+    const char *nl = (const char *)memchr(p, '\n', end - p);
+    p = nl != NULL ? nl + 1 : end;
+  }
+  *nedges = k;
+  return true;
+}
+
+// Each window is parsed twice: the edges of each part are counted, then stored after those of the previous parts
+template<typename IT, typename VT>
+static int mm_read_metis(mm_reader &r, const Distr_MMIO_Graph_Options *opts, uint64_t base, mm_kept_entries<IT, VT> *out,
+                         uint64_t *n, bool *has_vals) {
+  mm_line_syntax syn(opts->comments, true);
+  uint64_t m;
+  mm_metis_format fmt;
+  int err = mm_read_metis_header(r, syn, n, &m, &fmt);
+  if (err != 0) return err;
+  *has_vals = fmt.edge_weights;
+  out->reserve(2 * m); // Both directions of each edge are listed
+
+  int nthreads = mm_max_threads();
+  std::vector<uint64_t> offset(nthreads + 1);
+  err = mm_read_text_windows(r, *n, [&](const char *w, const std::vector<uint64_t> &bounds, const std::vector<uint64_t> &first) {
+    bool ok = true;
+    #pragma omp parallel for schedule(static) reduction(&&:ok)
+    for (int c = 0; c < nthreads; ++c) {
+      offset[c + 1] = 0;
+      if (first[c] < *n)
+        ok = mm_parse_metis_lines<IT, VT>(w + bounds[c], w + bounds[c + 1], first[c], std::min(first[c + 1], *n), *n, base,
+                                          fmt, syn, NULL, &offset[c + 1]);
+    }
+    offset[0] = out->n;
+    for (int c = 0; c < nthreads; ++c) offset[c + 1] += offset[c];
+    if (!ok || offset[nthreads] > 2 * m) return MM_PREMATURE_EOF;
+
+    uint64_t stored;
+    #pragma omp parallel for schedule(static) private(stored)
+    for (int c = 0; c < nthreads; ++c) {
+      if (first[c] < *n)
+        mm_parse_metis_lines<IT, VT>(w + bounds[c], w + bounds[c + 1], first[c], std::min(first[c + 1], *n), *n, base,
+                                     fmt, syn, out->data + offset[c], &stored);
+    }
+    out->n = offset[nthreads];
+    return 0;
+  }, syn);
+  if (err == 0 && out->n != 2 * m) {
+    fprintf(stderr, "METIS: %lu adjacencies listed for %lu edges.\n", out->n, m);
+    return MM_PREMATURE_EOF;
+  }
+  return err;
+}
+
+/*
+ * Parses a graph source into entries (undirected edge lists are mirrored), setting the sizes and meta. Returns
+ * NULL on errors.
+ */
+template<typename IT, typename VT, typename OT>
+static Entry<IT, VT>* mm_parse_graph_source(Distr_MMIO_Source *src, const Distr_MMIO_Graph_Options *opts, IT &nrows, IT &ncols,
+                                            OT &nnz, Matrix_Metadata *meta) {
+  if (src == NULL) return NULL;
+  Distr_MMIO_Graph_Options defaults;
+  if (opts == NULL) opts = &defaults;
+  Matrix_Metadata metadata2;
+  if (meta == NULL) meta = &metadata2;
+
+  mm_reader r(src);
+  bool metis = opts->format == MM_GRAPH_FORMAT_METIS;
+  uint64_t base = opts->index_base >= 0 ? opts->index_base : metis ? 1 : 0;
+  mm_kept_entries<IT, VT> out;
+  out.reserve(1); // Not NULL for empty graphs
+  uint64_t _nrows, _ncols;
+  bool has_vals = false;
+  int err;
+  if (metis) {
+    err = mm_read_metis<IT, VT>(r, opts, base, &out, &_nrows, &has_vals);
+    _ncols = _nrows;
+  } else {
+    mm_edge_extent extent;
+    err = mm_read_edge_list<IT, VT>(r, opts, base, &out, &extent);
+    _nrows = std::max(opts->nrows, extent.nrows);
+    _ncols = std::max(opts->ncols, extent.ncols);
+    if (opts->undirected) _nrows = _ncols = std::max(_nrows, _ncols);
+    if ((opts->nrows > 0 && _nrows > opts->nrows) || (opts->ncols > 0 && _ncols > opts->ncols)) {
+      fprintf(stderr, "Graph indices exceed the given sizes (%lu x %lu).\n", opts->nrows, opts->ncols);
+      err = MM_UNSUPPORTED_TYPE;
+    }
+    has_vals = extent.has_vals;
+  }
+  uint64_t max_index = std::max<uint64_t>(std::max(_nrows, _ncols), 1) - 1;
+  if (err == 0 && max_index > (uint64_t)std::numeric_limits<IT>::max()) {
+    fprintf(stderr, "Error: Index Type (IT) is too small to represent graph indices (up to %lu).\n", max_index);
+    err = MM_UNSUPPORTED_TYPE;
+  }
+  if (err != 0) {
+    if (err != MM_CANCELLED) fprintf(stderr, "Could not parse graph data (error code: %d).\n", err);
+    mm_free(out.data);
+    return NULL;
+  }
+
+  double t = mm_phase_begin();
+  if (!metis && opts->undirected) {
+    uint64_t off_diagonal = 0;
+    #pragma omp parallel for schedule(static) reduction(+:off_diagonal)
+    for (uint64_t i = 0; i < out.n; ++i) off_diagonal += out.data[i].row != out.data[i].col;
+    out.reserve(off_diagonal);
+    out.n += mm_mirror_entries(out.data, out.n);
+  }
+  mm_phase_end(MM_PHASE_SYMMETRIC_EXPANSION, t);
+  if (out.n > (uint64_t)std::numeric_limits<OT>::max()) {
+    fprintf(stderr, "Error: Offset Type (OT) is too small to represent the number of entries (%lu).\n", out.n);
+    mm_free(out.data);
+    return NULL;
+  }
+
+  nrows = static_cast<IT>(_nrows);
+  ncols = static_cast<IT>(_ncols);
+  nnz = static_cast<OT>(out.n);
+  meta->val_type = has_vals ? (metis ? MM_VAL_TYPE_INTEGER : MM_VAL_TYPE_REAL) : MM_VAL_TYPE_PATTERN;
+  meta->is_symmetric = false;
+  meta->is_array = false;
+  meta->mm_header.clear();
+  meta->mm_header_body.clear();
+  meta->nrows = _nrows;
+  meta->ncols = _ncols;
+  meta->nnz = meta->expanded_nnz = out.n;
+  meta->structure.valid = false;
+  return out.data;
+}
+
+// The format of files read with MM_GRAPH_FORMAT_AUTO is chosen from their extension
+static Distr_MMIO_Graph_Options mm_graph_options(const char *filename, const Distr_MMIO_Graph_Options *opts) {
+  Distr_MMIO_Graph_Options resolved;
+  if (opts != NULL) resolved = *opts;
+  if (resolved.format == MM_GRAPH_FORMAT_AUTO)
+    resolved.format = is_file_extension_metis(filename) ? MM_GRAPH_FORMAT_METIS : MM_GRAPH_FORMAT_EDGE_LIST;
+  return resolved;
+}
+
+template<typename IT, typename VT, typename OT>
+COO_local<IT, VT, OT>* Distr_MMIO_COO_local_read_graph(const char *filename, const Distr_MMIO_Graph_Options *opts, bool expl_val_for_bin_mtx, Matrix_Metadata* meta) {
+  Distr_MMIO_Source src;
+  if (Distr_MMIO_source_file(filename, &src) != 0) return NULL;
+  Distr_MMIO_Graph_Options resolved = mm_graph_options(filename, opts);
+  COO_local<IT, VT, OT> *coo = Distr_MMIO_COO_local_read_graph_source<IT, VT, OT>(&src, &resolved, expl_val_for_bin_mtx, meta);
+  Distr_MMIO_source_close(&src);
+  return coo;
+}
+
+template<typename IT, typename VT, typename OT>
+COO_local<IT, VT, OT>* Distr_MMIO_COO_local_read_graph_source(Distr_MMIO_Source *src, const Distr_MMIO_Graph_Options *opts, bool expl_val_for_bin_mtx, Matrix_Metadata* meta) {
+  IT nrows, ncols;
+  OT nnz;
+  Matrix_Metadata metadata2;
+  if (meta == NULL) meta = &metadata2;
+  mm_stats_begin();
+  Entry<IT, VT> *entries = mm_parse_graph_source<IT, VT, OT>(src, opts, nrows, ncols, nnz, meta);
+  if (entries == NULL) {
+    mm_stats_end(0);
+    return NULL;
+  }
+
+  COO_local<IT, VT, OT> *coo = Distr_MMIO_COO_local_create<IT, VT, OT>(nrows, ncols, nnz, expl_val_for_bin_mtx || meta->val_type != MM_VAL_TYPE_PATTERN);
+  entries_to_local_coo<IT, VT, OT>(entries, coo);
+
+  double t = mm_phase_begin();
+  mm_free(entries);
+  mm_phase_end(MM_PHASE_FREE, t);
+
+  mm_stats_end(nnz);
+  return coo;
+}
+
+template<typename IT, typename VT, typename OT>
+CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read_graph(const char *filename, const Distr_MMIO_Graph_Options *opts, bool expl_val_for_bin_mtx, Matrix_Metadata* meta) {
+  Distr_MMIO_Source src;
+  if (Distr_MMIO_source_file(filename, &src) != 0) return NULL;
+  Distr_MMIO_Graph_Options resolved = mm_graph_options(filename, opts);
+  CSR_local<IT, VT, OT> *csr = Distr_MMIO_CSR_local_read_graph_source<IT, VT, OT>(&src, &resolved, expl_val_for_bin_mtx, meta);
+  Distr_MMIO_source_close(&src);
+  return csr;
+}
+
+template<typename IT, typename VT, typename OT>
+CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read_graph_source(Distr_MMIO_Source *src, const Distr_MMIO_Graph_Options *opts, bool expl_val_for_bin_mtx, Matrix_Metadata* meta) {
+  IT nrows, ncols;
+  OT nnz;
+  Matrix_Metadata metadata2;
+  if (meta == NULL) meta = &metadata2;
+  mm_stats_begin();
+  Entry<IT, VT> *entries = mm_parse_graph_source<IT, VT, OT>(src, opts, nrows, ncols, nnz, meta);
+  if (entries == NULL) {
+    mm_stats_end(0);
+    return NULL;
+  }
+
+  bool is_sorted = mm_canonicalize(entries, nnz, nrows, ncols, MM_SORT_ROW_MAJOR, false, meta);
+  CSR_local<IT, VT, OT> *csr = Distr_MMIO_CSR_local_create<IT, VT, OT>(nrows, ncols, nnz, expl_val_for_bin_mtx || meta->val_type != MM_VAL_TYPE_PATTERN);
+  entries_to_local_csr<IT, VT, OT>(entries, csr, mm_structure_to_collect(meta), is_sorted);
+
+  double t = mm_phase_begin();
+  mm_free(entries);
+  mm_phase_end(MM_PHASE_FREE, t);
+
+  mm_stats_end(nnz);
+  return csr;
+}
+
+/**
+ * Sharded files
+ */
+
+#define MM_CHECKSUM_CHUNK_BYTES (1UL << 20) // Checksums are computed in parallel over chunks of this size
+
+static inline uint64_t mm_fnv1a(uint64_t h, const uint8_t *data, uint64_t bytes) {
+  for (uint64_t i = 0; i < bytes; ++i) {
+    h ^= data[i];
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+// FNV-1a of the (little endian) FNV-1a hashes of the MM_CHECKSUM_CHUNK_BYTES chunks
+static uint64_t mm_checksum(const uint8_t *data, uint64_t bytes) {
+  uint64_t nchunks = (bytes + MM_CHECKSUM_CHUNK_BYTES - 1) / MM_CHECKSUM_CHUNK_BYTES;
+  std::vector<uint64_t> hashes(nchunks);
+  #pragma omp parallel for schedule(static)
+  for (uint64_t c = 0; c < nchunks; ++c) {
+    uint64_t begin = c * MM_CHECKSUM_CHUNK_BYTES;
+    hashes[c] = mm_fnv1a(0xcbf29ce484222325ULL, data + begin, std::min(MM_CHECKSUM_CHUNK_BYTES, bytes - begin));
+  }
+  return mm_fnv1a(0xcbf29ce484222325ULL, (const uint8_t *)hashes.data(), nchunks * sizeof(uint64_t));
+}
+
+static int mm_file_checksum(const char *filename, uint64_t *checksum) {
+  Distr_MMIO_Source src;
+  int err = Distr_MMIO_source_mmap(filename, &src);
+  if (err != 0) return err;
+  *checksum = mm_checksum(src.data, src.size);
+  Distr_MMIO_source_close(&src);
+  return 0;
+}
+
+int Distr_MMIO_read_manifest(const char *manifest_filename, std::vector<Distr_MMIO_Shard> *shards, Matrix_Metadata *meta) {
+  FILE *f = fopen(manifest_filename, "r");
+  if (f == NULL) {
+    fprintf(stderr, "Could not open file [%s] (read).\n", manifest_filename);
+    return MM_COULD_NOT_READ_FILE;
+  }
+  std::string manifest(manifest_filename);
+  size_t slash = manifest.find_last_of('/');
+  std::string dir = slash == std::string::npos ? "" : manifest.substr(0, slash + 1);
+
+  char line[MM_MAX_LINE_LENGTH], banner[MM_MAX_TOKEN_LENGTH], kind[MM_MAX_TOKEN_LENGTH];
+  uint64_t nshards, nrows, ncols, nnz;
+  if (fgets(line, sizeof(line), f) == NULL ||
+      sscanf(line, "%s %s %lu %lu %lu %lu", banner, kind, &nshards, &nrows, &ncols, &nnz) != 6 ||
+      strcmp(banner, "%%MMIO") != 0 || strcmp(kind, "shards") != 0) {
+    fprintf(stderr, "[%s] is not a shards manifest.\n", manifest_filename);
+    fclose(f);
+    return MM_NO_HEADER;
+  }
+
+  shards->clear();
+  char name[MM_MAX_LINE_LENGTH];
+  Distr_MMIO_Shard shard;
+  uint64_t row_end = 0, total_nnz = 0;
+  while (shards->size() < nshards && fgets(line, sizeof(line), f) != NULL) {
+    if (sscanf(line, "%s %lu %lu %lu %lx", name, &shard.row_begin, &shard.row_end, &shard.nnz, &shard.checksum) != 5) continue;
+    shard.filename = name[0] == '/' ? std::string(name) : dir + name;
+    if (shard.row_begin != row_end || shard.row_end < shard.row_begin) break; // Ranges must cover the rows in order
+    row_end = shard.row_end;
+    total_nnz += shard.nnz;
+    shards->push_back(shard);
+  }
+  fclose(f);
+  if (shards->size() != nshards || row_end != nrows || total_nnz != nnz) {
+    fprintf(stderr, "Shards manifest [%s] is incomplete or inconsistent.\n", manifest_filename);
+    return MM_PREMATURE_EOF;
+  }
+
+  if (meta) {
+    meta->nrows = nrows;
+    meta->ncols = ncols;
+    meta->nnz = meta->expanded_nnz = nnz;
+  }
+  return 0;
+}
+
+int Distr_MMIO_verify_shard(const Distr_MMIO_Shard *shard) {
+  uint64_t checksum;
+  int err = mm_file_checksum(shard->filename.c_str(), &checksum);
+  if (err != 0) return err;
+  if (checksum != shard->checksum) {
+    fprintf(stderr, "Checksum mismatch for shard [%s].\n", shard->filename.c_str());
+    return MM_CHECKSUM_MISMATCH;
+  }
+  return 0;
+}
+
+template<typename IT, typename VT, typename OT>
+int Distr_MMIO_CSR_local_write_sharded(CSR_local<IT, VT, OT>* csr, const char *manifest_filename, int nshards, Matrix_Metadata* meta) {
+  if (nshards < 1) return MM_UNSUPPORTED_TYPE;
+
+  // Every shard is self-contained: general, with global indices and the sizes of the whole matrix
+  Matrix_Metadata shard_meta = *meta;
+  shard_meta.is_symmetric = false;
+  shard_meta.sort_order = MM_SORT_ROW_MAJOR;
+  shard_meta.mm_header = "%%MatrixMarket matrix coordinate ";
+  switch (shard_meta.val_type) {
+  case MM_VAL_TYPE_REAL:    { shard_meta.mm_header += std::string(MM_REAL_STR);    break; }
+  case MM_VAL_TYPE_INTEGER: { shard_meta.mm_header += std::string(MM_INT_STR);     break; }
+  case MM_VAL_TYPE_PATTERN: { shard_meta.mm_header += std::string(MM_PATTERN_STR); break; }
+  default:                  { fprintf(stderr, "BUG: MM_VAL_TYPE not recognized\n"); return 100; }
+  }
+  shard_meta.mm_header += " general";
+
+  // Row ranges with about nnz / nshards entries each
+  std::vector<IT> bounds(nshards + 1, csr->nrows);
+  bounds[0] = 0;
+  for (int k = 1; k < nshards; ++k) {
+    OT target = (OT)((uint64_t)csr->nnz * k / nshards);
+    bounds[k] = std::max(bounds[k - 1], (IT)(std::lower_bound(csr->row_ptr, csr->row_ptr + csr->nrows + 1, target) - csr->row_ptr));
+    bounds[k] = std::min(bounds[k], csr->nrows);
+  }
+
+  std::string manifest(manifest_filename);
+  size_t slash = manifest.find_last_of('/');
+  size_t dot = manifest.find_last_of('.');
+  std::string base = dot == std::string::npos || (slash != std::string::npos && dot < slash) ? manifest : manifest.substr(0, dot);
+  int index_bytes = required_bytes_index(std::max(csr->nrows, csr->ncols));
+
+  mm_stats_begin();
+  std::vector<uint64_t> checksums(nshards);
+  int err = 0;
+  for (int k = 0; k < nshards && err == 0; ++k) {
+    std::string shard_filename = base + "." + std::to_string(k) + ".sbmtx";
+    err = write_csr_matrix_market(open_file_w(shard_filename.c_str()), csr, bounds[k], bounds[k + 1], false, index_bytes, &shard_meta);
+    if (err == 0) {
+      double t = mm_phase_begin();
+      err = mm_file_checksum(shard_filename.c_str(), &checksums[k]);
+      mm_phase_end(MM_PHASE_ENCODE, t);
+    }
+  }
+
+  FILE *f = err == 0 ? open_file_w(manifest_filename) : NULL;
+  if (err == 0 && f == NULL) err = MM_COULD_NOT_WRITE_FILE;
+  if (err == 0) {
+    fprintf(f, "%%%%MMIO shards %d %lu %lu %lu\n", nshards, (uint64_t)csr->nrows, (uint64_t)csr->ncols, (uint64_t)csr->nnz);
+    for (int k = 0; k < nshards; ++k) {
+      std::string shard_filename = base.substr(slash == std::string::npos ? 0 : slash + 1) + "." + std::to_string(k) + ".sbmtx";
+      fprintf(f, "%s\t%lu\t%lu\t%lu\t%016lx\n", shard_filename.c_str(), (uint64_t)bounds[k], (uint64_t)bounds[k + 1],
+              (uint64_t)(csr->row_ptr[bounds[k + 1]] - csr->row_ptr[bounds[k]]), checksums[k]);
+    }
+    if (ferror(f)) err = MM_COULD_NOT_WRITE_FILE;
+    mm_stats_bytes_written(f);
+    fclose(f);
+  }
+  mm_stats_end(err == 0 ? csr->nnz : 0);
+  return err;
+}
+
+/*
+ * Shards are parsed concurrently (each one by a single thread) straight into their rows of the CSR, which are
+ * known from the manifest. Stats and progress callbacks only see the whole load.
+ */
+template<typename IT, typename VT, typename OT>
+CSR_local<IT, VT, OT>* Distr_MMIO_CSR_local_read_sharded(const char *manifest_filename, bool verify_checksums, bool expl_val_for_bin_mtx, Matrix_Metadata* meta) {
+  Matrix_Metadata metadata2;
+  if (meta == NULL) meta = &metadata2;
+
+  mm_stats_begin();
+  std::vector<Distr_MMIO_Shard> shards;
+  double t = mm_phase_begin();
+  int err = Distr_MMIO_read_manifest(manifest_filename, &shards, meta);
+  mm_phase_end(MM_PHASE_BANNER, t);
+  if (err == 0 && (sizeof(IT) < (size_t)required_bytes_index(std::max(meta->nrows, meta->ncols)) ||
+                   meta->nnz > (uint64_t)std::numeric_limits<OT>::max())) {
+    fprintf(stderr, "Error: Index Type (IT) or Offset Type (OT) is too small to represent the matrix.\n");
+    err = MM_UNSUPPORTED_TYPE;
+  }
+  Matrix_Metadata shard_meta;
+  if (err == 0) err = shards.empty() ? MM_PREMATURE_EOF : Distr_MMIO_probe(shards[0].filename.c_str(), &shard_meta);
+  if (err != 0) {
+    mm_stats_end(0);
+    return NULL;
+  }
+  meta->val_type = shard_meta.val_type;
+  meta->is_symmetric = false;
+  meta->val_bytes = shard_meta.val_bytes;
+  meta->val_encoding = shard_meta.val_encoding;
+  meta->mm_header = shard_meta.mm_header;
+
+  CSR_local<IT, VT, OT> *csr = Distr_MMIO_CSR_local_create<IT, VT, OT>((IT)meta->nrows, (IT)meta->ncols, (OT)meta->nnz,
+                                                                       expl_val_for_bin_mtx || meta->val_type != MM_VAL_TYPE_PATTERN);
+  std::vector<uint64_t> first_entry(shards.size() + 1, 0);
+  for (size_t k = 0; k < shards.size(); ++k) first_entry[k + 1] = first_entry[k] + shards[k].nnz;
+
+  // Worker threads do not report to the caller stats and callbacks, neither should the caller while in the loop
+  Distr_MMIO_Stats *stats = mm_stats;
+  Distr_MMIO_Progress_Callback progress_callback = mm_progress_callback;
+  t = mm_phase_begin();
+  mm_stats = NULL;
+  mm_progress_callback = NULL;
+  uint64_t bytes_read = 0, shards_done = 0;
+  #pragma omp parallel for schedule(dynamic, 1) reduction(+:bytes_read)
+  for (size_t k = 0; k < shards.size(); ++k) {
+    int shard_err;
+    #pragma omp atomic read
+    shard_err = err;
+    if (shard_err != 0) continue;
+
+    const Distr_MMIO_Shard &shard = shards[k];
+    Distr_MMIO_Source src = {NULL, NULL, NULL, NULL, NULL, 0};
+    shard_err = Distr_MMIO_source_mmap(shard.filename.c_str(), &src);
+    if (shard_err == 0 && verify_checksums && mm_checksum(src.data, src.size) != shard.checksum) {
+      fprintf(stderr, "Checksum mismatch for shard [%s].\n", shard.filename.c_str());
+      shard_err = MM_CHECKSUM_MISMATCH;
+    }
+    IT nrows, ncols;
+    OT nnz = 0;
+    MM_typecode matcode;
+    Entry<IT, VT> *entries = NULL;
+    if (shard_err == 0 && shard.nnz > 0) {
+      bytes_read += src.size;
+      entries = mm_parse_source<IT, VT, OT>(&src, nrows, ncols, nnz, &matcode, true, NULL);
+      if (entries == NULL || (uint64_t)nrows != meta->nrows || (uint64_t)ncols != meta->ncols || (uint64_t)nnz != shard.nnz)
+        shard_err = MM_PREMATURE_EOF;
+    }
+    if (shard_err == 0) {
+      // Shards written by Distr_MMIO_CSR_local_write_sharded are already sorted
+      bool sorted = true;
+      for (OT i = 0; i < nnz && sorted; ++i) {
+        uint64_t row = (uint64_t)entries[i].row;
+        sorted = row >= shard.row_begin && row < shard.row_end &&
+                 (i == 0 || entries[i - 1].row < entries[i].row ||
+                  (entries[i - 1].row == entries[i].row && entries[i - 1].col <= entries[i].col));
+      }
+      if (!sorted) {
+        fprintf(stderr, "Shard [%s] is not sorted or has rows outside its range.\n", shard.filename.c_str());
+        shard_err = MM_UNSUPPORTED_TYPE;
+      }
+    }
+    if (shard_err == 0) {
+      OT base = (OT)first_entry[k];
+      IT row = (IT)shard.row_begin;
+      for (OT i = 0; i < nnz; ++i) {
+        while (row <= entries[i].row) csr->row_ptr[row++] = base + i;
+        csr->col_idx[base + i] = entries[i].col;
+        if (csr->val != NULL) csr->val[base + i] = entries[i].val;
+      }
+      while (row < (IT)shard.row_end) csr->row_ptr[row++] = base + nnz;
+    }
+    mm_free(entries);
+    Distr_MMIO_source_close(&src);
+
+    if (shard_err != 0) {
+      #pragma omp atomic write
+      err = shard_err;
+    }
+    uint64_t done;
+    #pragma omp atomic capture
+    done = ++shards_done;
+    bool is_caller = true;
+#ifdef _OPENMP
+    is_caller = omp_get_thread_num() == 0;
+#endif
+    if (is_caller && progress_callback != NULL && !progress_callback(MM_PHASE_DECODE, done, shards.size(), mm_progress_ctx)) {
+      #pragma omp atomic write
+      err = MM_CANCELLED;
+    }
+  }
+  mm_stats = stats;
+  mm_progress_callback = progress_callback;
+  mm_phase_end(MM_PHASE_DECODE, t);
+  mm_stats_bytes_read(bytes_read);
+  csr->row_ptr[csr->nrows] = (OT)meta->nnz;
+
+  if (err != 0) {
+    if (err != MM_CANCELLED) fprintf(stderr, "Could not read the shards of [%s] (error code: %d).\n", manifest_filename, err);
+    Distr_MMIO_CSR_local_destroy(&csr);
+    mm_stats_end(0);
+    return NULL;
+  }
+  mm_stats_end(csr->nnz);
+  return csr;
+}
+
+#ifdef DISTR_MMIO_WITH_MPI
+/**
+ * Collective writes
+ */
+
+#define MM_MPI_WRITE_CHUNK_BYTES (1UL << 30) // Bytes written by each rank per collective call (MPI counts are int)
+
+// Same error code on every rank: the worst one
+static int mm_mpi_agree(int err, MPI_Comm comm) {
+  int worst = err;
+  MPI_Allreduce(&err, &worst, 1, MPI_INT, MPI_MAX, comm);
+  return worst;
+}
+
+/*
+ * The file is sized collectively, then written in rounds: in each round every rank encodes (in parallel) up to
+ * MM_MPI_WRITE_CHUNK_BYTES of its entries and all the ranks write them with one MPI_File_write_at_all. Ranks with
+ * fewer entries take part in the remaining rounds with empty writes.
+ */
+template<typename IT, typename VT, typename OT>
+int Distr_MMIO_CSR_write_collective(CSR_local<IT, VT, OT>* csr, const char *filename, MPI_Comm comm, Matrix_Metadata* meta) {
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+
+  Matrix_Metadata out_meta = *meta;
+  out_meta.is_symmetric = false;
+  out_meta.sort_order = MM_SORT_ROW_MAJOR;
+  out_meta.structure.valid = false; // Statistics of a single block do not describe the matrix
+  out_meta.mm_header = "%%MatrixMarket matrix coordinate ";
+  switch (out_meta.val_type) {
+  case MM_VAL_TYPE_REAL:    { out_meta.mm_header += std::string(MM_REAL_STR);    break; }
+  case MM_VAL_TYPE_INTEGER: { out_meta.mm_header += std::string(MM_INT_STR);     break; }
+  case MM_VAL_TYPE_PATTERN: { out_meta.mm_header += std::string(MM_PATTERN_STR); break; }
+  default:                  { fprintf(stderr, "BUG: MM_VAL_TYPE not recognized\n"); return 100; }
+  }
+  out_meta.mm_header += " general";
+  uint8_t val_bytes = meta->val_bytes > 0 ? meta->val_bytes : 4;
+  if (!mm_is_valid_val_encoding(val_bytes, meta->val_encoding)) {
+    fprintf(stderr, "Values cannot be encoded using %hhu bytes with the requested encoding.\n", val_bytes);
+    return MM_UNSUPPORTED_TYPE;
+  }
+
+  mm_stats_begin();
+  double t = mm_phase_begin();
+  uint64_t local[2] = {(uint64_t)csr->nrows, (uint64_t)csr->nnz}, first[2] = {0, 0}, total[2], ncols = csr->ncols;
+  MPI_Exscan(local, first, 2, MPI_UINT64_T, MPI_SUM, comm);
+  if (rank == 0) first[0] = first[1] = 0; // Undefined on rank 0
+  MPI_Allreduce(local, total, 2, MPI_UINT64_T, MPI_SUM, comm);
+  MPI_Allreduce(MPI_IN_PLACE, &ncols, 1, MPI_UINT64_T, MPI_MAX, comm);
+  uint64_t nrows = total[0], nnz = total[1], first_row = first[0];
+
+  int index_bytes = required_bytes_index(std::max(nrows, ncols));
+  bool with_val = meta->val_type != MM_VAL_TYPE_PATTERN;
+  uint64_t entry_bytes = 2 * index_bytes + (with_val ? val_bytes : 0);
+
+  // The header is built by rank 0 only, the others just need its length
+  char *header = NULL;
+  size_t header_size = 0;
+  uint64_t header_bytes = 0;
+  int err = 0;
+  if (rank == 0) {
+    FILE *hf = open_memstream(&header, &header_size);
+    err = write_matrix_market_header(hf, &out_meta, index_bytes, nrows, ncols, nnz, out_meta.sort_order);
+    if (hf != NULL) fclose(hf);
+    header_bytes = header_size;
+  }
+  MPI_Bcast(&header_bytes, 1, MPI_UINT64_T, 0, comm);
+  mm_phase_end(MM_PHASE_BANNER, t);
+
+  t = mm_phase_begin();
+  MPI_File fh;
+  if (mm_mpi_agree(err, comm) != 0 ||
+      MPI_File_open(comm, filename, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+    fprintf(stderr, "Could not open [%s] for the collective write.\n", filename);
+    free(header);
+    mm_stats_end(0);
+    return err != 0 ? err : MM_COULD_NOT_WRITE_FILE;
+  }
+  if (MPI_File_set_size(fh, header_bytes + nnz * entry_bytes) != MPI_SUCCESS) err = MM_COULD_NOT_WRITE_FILE;
+  if (rank == 0 && err == 0 && MPI_File_write_at(fh, 0, header, (int)header_bytes, MPI_BYTE, MPI_STATUS_IGNORE) != MPI_SUCCESS)
+    err = MM_COULD_NOT_WRITE_FILE;
+  free(header);
+  mm_phase_end(MM_PHASE_DATA_IO, t);
+
+  uint64_t chunk_entries = std::max<uint64_t>(MM_MPI_WRITE_CHUNK_BYTES / entry_bytes, 1);
+  uint64_t rounds = ((uint64_t)csr->nnz + chunk_entries - 1) / chunk_entries;
+  MPI_Allreduce(MPI_IN_PLACE, &rounds, 1, MPI_UINT64_T, MPI_MAX, comm);
+  err = mm_mpi_agree(err, comm);
+  std::vector<uint8_t> buf;
+  for (uint64_t round = 0; round < rounds && err == 0; ++round) {
+    uint64_t begin = std::min<uint64_t>(round * chunk_entries, csr->nnz);
+    uint64_t end = std::min<uint64_t>(begin + chunk_entries, csr->nnz);
+    if (!mm_progress(MM_PHASE_DATA_IO, begin, csr->nnz)) err = MM_CANCELLED;
+    if ((err = mm_mpi_agree(err, comm)) != 0) break;
+
+    t = mm_phase_begin();
+    buf.resize((end - begin) * entry_bytes);
+    #pragma omp parallel
+    {
+      #ifdef _OPENMP
+      int nthreads = omp_get_num_threads(), tid = omp_get_thread_num();
+      #else
+      int nthreads = 1, tid = 0;
+      #endif
+      uint64_t kb = begin + (end - begin) * tid / nthreads, ke = begin + (end - begin) * (tid + 1) / nthreads;
+      IT r = kb < ke ? (IT)(std::upper_bound(csr->row_ptr, csr->row_ptr + csr->nrows + 1, (OT)kb) - csr->row_ptr - 1) : 0;
+      for (uint64_t k = kb; k < ke; ++k) {
+        while ((uint64_t)csr->row_ptr[r + 1] <= k) ++r;
+        uint8_t *out = buf.data() + (k - begin) * entry_bytes;
+        uint64_t idx[2] = {first_row + (uint64_t)r, (uint64_t)csr->col_idx[k]};
+        memcpy(out, &idx[0], index_bytes); // Little endian, truncated to index_bytes
+        memcpy(out + index_bytes, &idx[1], index_bytes);
+        if (with_val) mm_encode_val(out + 2 * index_bytes, csr->val != NULL ? csr->val[k] : (VT)1, val_bytes, meta->val_encoding);
+      }
+    }
+    mm_phase_end(MM_PHASE_ENCODE, t);
+
+    t = mm_phase_begin();
+    MPI_Offset offset = header_bytes + (first[1] + begin) * entry_bytes;
+    if (MPI_File_write_at_all(fh, offset, buf.data(), (int)buf.size(), MPI_BYTE, MPI_STATUS_IGNORE) != MPI_SUCCESS)
+      err = MM_COULD_NOT_WRITE_FILE;
+    mm_phase_end(MM_PHASE_DATA_IO, t);
+    if (mm_stats != NULL) mm_stats->bytes_written += buf.size();
+  }
+  if (rank == 0 && mm_stats != NULL) mm_stats->bytes_written += header_bytes;
+
+  if (MPI_File_close(&fh) != MPI_SUCCESS && err == 0) err = MM_COULD_NOT_WRITE_FILE;
+  err = mm_mpi_agree(err, comm);
+  if (err != 0 && err != MM_CANCELLED && rank == 0) fprintf(stderr, "Could not write [%s] (error code: %d).\n", filename, err);
+  mm_stats_end(err == 0 ? csr->nnz : 0);
+  return err;
+}
+#endif
+
+/**
+ * Row views
+ */
+
+#define MM_ROW_INDEX_BANNER       "%%MMIO row-index"
+#define MM_ROW_INDEX_HEADER_BYTES 128 // The offsets that follow are aligned, so that they can be used in place
+
+static inline uint64_t mm_view_index(const uint8_t *p, uint8_t idx_bytes) {
+  uint64_t v = 0;
+  memcpy(&v, p, idx_bytes); // Little endian
+  return v;
+}
+
+// Maps the row index stored next to a matrix, if it was built from this version of the file (same stamp)
+static const uint64_t *mm_map_row_index(const std::string &index_filename, const mm_file_stamp &stamp, uint64_t nrows,
+                                        uint64_t nnz, void **mapping, uint64_t *mapping_bytes) {
+  struct stat index_st;
+  if (stat(index_filename.c_str(), &index_st) != 0 || (uint64_t)index_st.st_size != MM_ROW_INDEX_HEADER_BYTES + (nrows + 1) * sizeof(uint64_t))
+    return NULL;
+
+  int fd = open(index_filename.c_str(), O_RDONLY);
+  if (fd < 0) return NULL;
+  void *data = mmap(NULL, index_st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return NULL;
+  madvise(data, index_st.st_size, MADV_RANDOM); // Only the entries of the rows accessed are loaded
+
+  char header[MM_ROW_INDEX_HEADER_BYTES + 1], banner[MM_MAX_TOKEN_LENGTH], name[MM_MAX_TOKEN_LENGTH];
+  memcpy(header, data, MM_ROW_INDEX_HEADER_BYTES);
+  header[MM_ROW_INDEX_HEADER_BYTES] = '\0';
+  uint64_t index_nrows, index_nnz, file_size, mtime_sec, mtime_nsec;
+  const uint64_t *row_ptr = (const uint64_t *)((const uint8_t *)data + MM_ROW_INDEX_HEADER_BYTES);
+  if (sscanf(header, "%63s %63s %lu %lu %lu %lu %lu", banner, name, &index_nrows, &index_nnz, &file_size, &mtime_sec, &mtime_nsec) != 7 ||
+      strncmp(header, MM_ROW_INDEX_BANNER " ", strlen(MM_ROW_INDEX_BANNER) + 1) != 0 || index_nrows != nrows || index_nnz != nnz ||
+      file_size != stamp.size || mtime_sec != stamp.mtime_sec || mtime_nsec != stamp.mtime_nsec || row_ptr[nrows] != nnz) {
+    munmap(data, index_st.st_size);
+    return NULL;
+  }
+  *mapping = data;
+  *mapping_bytes = index_st.st_size;
+  return row_ptr;
+}
+
+static int mm_write_row_index(const std::string &index_filename, const mm_file_stamp &stamp, uint64_t nrows, uint64_t nnz,
+                              const uint64_t *row_ptr) {
+  FILE *f = open_file_w(index_filename.c_str());
+  if (f == NULL) return MM_COULD_NOT_WRITE_FILE;
+  char header[MM_ROW_INDEX_HEADER_BYTES];
+  memset(header, ' ', sizeof(header));
+  int len = snprintf(header, sizeof(header), "%s %lu %lu %lu %lu %lu", MM_ROW_INDEX_BANNER, nrows, nnz, stamp.size, stamp.mtime_sec,
+                     stamp.mtime_nsec);
+  header[len] = ' ';
+  header[MM_ROW_INDEX_HEADER_BYTES - 1] = '\n';
+  bool ok = fwrite(header, 1, sizeof(header), f) == sizeof(header) && fwrite(row_ptr, sizeof(uint64_t), nrows + 1, f) == nrows + 1;
+  mm_stats_bytes_written(f);
+  ok = fclose(f) == 0 && ok;
+  return ok ? 0 : MM_COULD_NOT_WRITE_FILE;
+}
+
+/*
+ * Fills the nrows + 1 entry offsets of the rows with one parallel pass over the entries, as entries_to_local_csr does.
+ * Returns MM_UNSUPPORTED_TYPE if the entries are not row-major sorted.
+ */
+static int mm_build_row_index(const uint8_t *data, uint64_t nnz, uint64_t nrows, uint8_t idx_bytes, uint64_t entry_bytes, uint64_t *row_ptr) {
+  bool unsorted = false;
+  #pragma omp parallel for schedule(static) reduction(||:unsorted)
+  for (uint64_t k = 0; k < nnz; ++k) {
+    uint64_t row = mm_view_index(data + k * entry_bytes, idx_bytes);
+    uint64_t first_row = k == 0 ? 0 : mm_view_index(data + (k - 1) * entry_bytes, idx_bytes) + 1;
+    if (row >= nrows || row + 1 < first_row) {
+      unsorted = true;
+      continue;
+    }
+    for (uint64_t v = first_row; v <= row; ++v) row_ptr[v] = k;
+  }
+  if (unsorted) return MM_UNSUPPORTED_TYPE;
+  uint64_t last_row = nnz == 0 ? 0 : mm_view_index(data + (nnz - 1) * entry_bytes, idx_bytes) + 1;
+  for (uint64_t v = last_row; v <= nrows; ++v) row_ptr[v] = nnz;
+  return 0;
+}
+
+template<typename IT, typename VT, typename OT>
+CSR_view<IT, VT, OT>* Distr_MMIO_CSR_view_open(const char *filename, bool persist_index, Matrix_Metadata* meta) {
+  Matrix_Metadata metadata2;
+  if (meta == NULL) meta = &metadata2;
+
+  mm_stats_begin();
+  Distr_MMIO_Source src;
+  if (Distr_MMIO_source_file(filename, &src) != 0) { // The header is read, the mapping does not read ahead
+    mm_stats_end(0);
+    return NULL;
+  }
+  MM_typecode matcode;
+  uint64_t nrows = 0, ncols = 0, nnz = 0, data_offset = 0;
+  int err;
+  {
+    mm_reader r(&src);
+    double t = mm_phase_begin();
+    err = mm_read_banner(r, &matcode, true, meta);
+    mm_phase_end(MM_PHASE_BANNER, t);
+    // Files that record no order may still be sorted, which mm_build_row_index checks
+    if (err == 0 && (!mm_is_coordinate(matcode) || mm_is_compressed(matcode) || !mm_is_general(matcode) ||
+                     (meta->sort_order != MM_SORT_ROW_MAJOR && meta->sort_order != MM_SORT_NONE))) {
+      fprintf(stderr, "Only general, row-major sorted binary files can be viewed.\n");
+      err = MM_UNSUPPORTED_TYPE;
+    }
+    t = mm_phase_begin();
+    if (err == 0) err = mm_read_mtx_crd_size(r, &nrows, &ncols, &nnz);
+    mm_phase_end(MM_PHASE_SIZE_LINE, t);
+    data_offset = r.position();
+  }
+  Distr_MMIO_source_close(&src);
+  struct stat st;
+  uint64_t file_bytes = stat(filename, &st) == 0 ? (uint64_t)st.st_size : 0;
+
+  uint8_t idx_bytes = mm_get_idx_bytes(matcode);
+  uint8_t val_bytes = mm_is_pattern(matcode) ? 0 : mm_get_val_bytes(matcode);
+  uint64_t entry_bytes = 2 * idx_bytes + val_bytes;
+  if (err == 0 && (!(idx_bytes == 1 || idx_bytes == 2 || idx_bytes == 4 || idx_bytes == 8) ||
+                   (val_bytes > 0 && !mm_is_valid_val_encoding(val_bytes, mm_get_val_encoding(matcode))))) {
+    err = MM_UNSUPPORTED_TYPE;
+  }
+  if (err == 0 && (sizeof(IT) < (size_t)required_bytes_index(std::max(nrows, ncols)) || nnz > (uint64_t)std::numeric_limits<OT>::max())) {
+    fprintf(stderr, "Error: Index Type (IT) or Offset Type (OT) is too small to represent the matrix.\n");
+    err = MM_UNSUPPORTED_TYPE;
+  }
+  if (err == 0 && (file_bytes < data_offset || (file_bytes - data_offset) / entry_bytes < nnz)) err = MM_PREMATURE_EOF;
+
+  // Shared mapping: pages are those of the page cache, loaded on access
+  void *mapping = MAP_FAILED;
+  if (err == 0) {
+    int fd = open(filename, O_RDONLY);
+    if (fd >= 0) {
+      mapping = mmap(NULL, file_bytes, PROT_READ, MAP_SHARED, fd, 0);
+      close(fd);
+    }
+    if (mapping != MAP_FAILED) madvise(mapping, file_bytes, MADV_RANDOM); // Rows are accessed in any order
+    if (mapping == MAP_FAILED) {
+      fprintf(stderr, "Could not map %s.\n", filename);
+      err = MM_COULD_NOT_READ_FILE;
+    }
+  }
+  if (err != 0) {
+    if (err != MM_COULD_NOT_READ_FILE) fprintf(stderr, "Could not view [%s] (error code: %d).\n", filename, err);
+    mm_stats_end(0);
+    return NULL;
+  }
+  mm_set_metadata(meta, &matcode);
+  meta->nrows = nrows;
+  meta->ncols = ncols;
+  meta->nnz = meta->expanded_nnz = nnz;
+  meta->val_bytes = mm_get_val_bytes(matcode);
+  meta->val_encoding = mm_get_val_encoding(matcode);
+
+  CSR_view<IT, VT, OT> *view = (CSR_view<IT, VT, OT> *)mm_alloc(sizeof(CSR_view<IT, VT, OT>));
+  view->nrows = (IT)nrows;
+  view->ncols = (IT)ncols;
+  view->nnz = (OT)nnz;
+  view->data = (const uint8_t *)mapping + data_offset;
+  view->idx_bytes = idx_bytes;
+  view->val_bytes = val_bytes;
+  view->val_encoding = mm_get_val_encoding(matcode);
+  view->mapping = mapping;
+  view->mapping_bytes = file_bytes;
+  view->index_mapping = NULL;
+  view->index_mapping_bytes = 0;
+
+  std::string index_filename = std::string(filename) + ".rowidx";
+  mm_file_stamp stamp(st);
+  view->row_ptr = persist_index ? mm_map_row_index(index_filename, stamp, nrows, nnz, &view->index_mapping, &view->index_mapping_bytes) : NULL;
+  if (view->row_ptr == NULL) {
+    double t = mm_phase_begin();
+    uint64_t *row_ptr = (uint64_t *)mm_alloc((nrows + 1) * sizeof(uint64_t));
+    madvise(mapping, file_bytes, MADV_SEQUENTIAL);
+    err = mm_build_row_index(view->data, nnz, nrows, idx_bytes, entry_bytes, row_ptr);
+    madvise(mapping, file_bytes, MADV_DONTNEED); // The pass does not leave the whole file resident
+    madvise(mapping, file_bytes, MADV_RANDOM);
+    view->row_ptr = row_ptr;
+    mm_phase_end(MM_PHASE_DECODE, t);
+    mm_stats_bytes_read(nnz * entry_bytes);
+    if (err != 0) {
+      fprintf(stderr, "[%s] is not row-major sorted, it cannot be viewed.\n", filename);
+      Distr_MMIO_CSR_view_close(&view);
+      mm_stats_end(0);
+      return NULL;
+    }
+
+    if (persist_index) {
+      t = mm_phase_begin();
+      if (mm_write_row_index(index_filename, stamp, nrows, nnz, row_ptr) != 0)
+        fprintf(stderr, "Could not store the row index in [%s].\n", index_filename.c_str());
+      else if ((view->row_ptr = mm_map_row_index(index_filename, stamp, nrows, nnz, &view->index_mapping, &view->index_mapping_bytes)) != NULL)
+        mm_free(row_ptr);
+      else
+        view->row_ptr = row_ptr;
+      mm_phase_end(MM_PHASE_DATA_IO, t);
+    }
+  }
+  mm_stats_end(0);
+  return view;
+}
+
+template<typename IT, typename VT, typename OT>
+void Distr_MMIO_CSR_view_close(CSR_view<IT, VT, OT>** view) {
+  if (*view != NULL) {
+    if ((*view)->index_mapping != NULL) munmap((*view)->index_mapping, (*view)->index_mapping_bytes);
+    else mm_free((void *)(*view)->row_ptr);
+    munmap((*view)->mapping, (*view)->mapping_bytes);
+    mm_free(*view);
+    *view = NULL;
+  }
+}
+
+template<typename IT, typename VT, typename OT>
+uint64_t Distr_MMIO_CSR_view_row(const CSR_view<IT, VT, OT>* view, IT i, IT* col, VT* val) {
+  uint64_t entry_bytes = 2 * view->idx_bytes + view->val_bytes;
+  uint64_t begin = view->row_ptr[i], length = view->row_ptr[i + 1] - begin;
+  const uint8_t *p = view->data + begin * entry_bytes;
+  for (uint64_t k = 0; k < length; ++k, p += entry_bytes) {
+    col[k] = (IT)mm_view_index(p + view->idx_bytes, view->idx_bytes);
+    if (val != NULL && (view->val_bytes == 0 || mm_decode_val(p + 2 * view->idx_bytes, view->val_bytes, view->val_encoding, &val[k]) != 0))
+      val[k] = static_cast<VT>(1); // Pattern entries
+  }
+  return length;
+}
+
+template<typename IT, typename VT, typename OT>
+void Distr_MMIO_CSR_view_for_each_row(const CSR_view<IT, VT, OT>* view, IT row_begin, IT row_end,
+                                      const std::function<void(IT row, const IT* col, const VT* val, uint64_t length)>& f) {
+  std::vector<IT> col;
+  std::vector<VT> val;
+  for (IT i = row_begin; i < row_end; ++i) {
+    uint64_t length = view->row_ptr[i + 1] - view->row_ptr[i];
+    if (col.size() < length) {
+      col.resize(length);
+      if (view->val_bytes > 0) val.resize(length);
+    }
+    Distr_MMIO_CSR_view_row(view, i, col.data(), view->val_bytes > 0 ? val.data() : (VT *)NULL);
+    f(i, col.data(), view->val_bytes > 0 ? val.data() : NULL, length);
+  }
+}
+
+template<typename IT, typename VT, typename OT>
+void Distr_MMIO_CSR_view_prefetch(const CSR_view<IT, VT, OT>* view, const IT* rows, uint64_t nrows) {
+  uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+  uint64_t entry_bytes = 2 * view->idx_bytes + view->val_bytes;
+  auto will_need = [page](const void *begin, const void *end) {
+    uintptr_t b = (uintptr_t)begin & ~(page - 1), e = ((uintptr_t)end + page - 1) & ~(page - 1);
+    if (e > b) madvise((void *)b, e - b, MADV_WILLNEED);
+  };
+  for (uint64_t k = 0; k < nrows; ++k) {
+    if (view->index_mapping != NULL) will_need(view->row_ptr + rows[k], view->row_ptr + rows[k] + 2);
+  }
+  for (uint64_t k = 0; k < nrows; ++k) {
+    will_need(view->data + view->row_ptr[rows[k]] * entry_bytes, view->data + view->row_ptr[rows[k] + 1] * entry_bytes);
+  }
+}
+
+/**
+ * Appendable BMTX
+ */
+
+#define MM_LOG_COMMENT "%%MMIO-log"             // "%%MMIO-log <id> <base>" in the header of an append log
+#define MM_COMPACTED_COMMENT "%%MMIO-compacted" // "%%MMIO-compacted <log id> <watermark>" in a compacted file
+#define MM_COPY_CHUNK_BYTES (64UL << 20)
+
+// Header of a .bmtx file opened for appending. The entries of a log are numbered over its whole life: base is the
+// number of the first entry still in it (the ones before were compacted) and id tells different logs apart.
+struct mm_append_log {
+  MM_typecode matcode;
+  Matrix_Metadata meta;
+  uint64_t nrows, ncols, nnz;
+  uint64_t size_line_offset, data_offset;
+  uint8_t idx_bytes, val_bytes;
+  size_t entry_size;
+  uint64_t id, base;
+};
+
+static uint64_t mm_new_log_id() {
+  uint64_t x = (uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count() ^ ((uint64_t)getpid() << 40);
+  x += 0x9e3779b97f4a7c15ULL; // splitmix64
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x != 0 ? x : 1;
+}
+
+// Removes the header lines starting with prefix from header and parses the id and the number of the last one
+static bool mm_take_header_comment(std::string &header, const char *prefix, uint64_t *id, uint64_t *n) {
+  bool found = false;
+  size_t len = strlen(prefix), pos = 0;
+  while (pos < header.size()) {
+    size_t end = header.find('\n', pos);
+    end = end == std::string::npos ? header.size() : end + 1;
+    if (header.compare(pos, len, prefix) == 0 && header[pos + len] == ' ') {
+      if (sscanf(header.c_str() + pos + len, "%lx %lu", id, n) == 2) found = true;
+      header.erase(pos, end - pos);
+    } else {
+      pos = end;
+    }
+  }
+  return found;
+}
+
+static void mm_append_header_line(std::string &body, const char *line) {
+  if (!body.empty() && body.back() != '\n') body += '\n';
+  body += line;
+}
+
+static int mm_lock(int fd, int operation) {
+  while (flock(fd, operation) != 0) {
+    if (errno != EINTR) {
+      fprintf(stderr, "Could not lock file (%s).\n", strerror(errno));
+      return MM_COULD_NOT_WRITE_FILE;
+    }
+  }
+  return 0;
+}
+
+// Opens (if *fd < 0) and locks filename. Compactions replace the log with a new file, so a lock that was obtained
+// on a file replaced meanwhile is dropped and the current file is opened again.
+static int mm_lock_current(const char *filename, int *fd, int flags) {
+  while (true) {
+    if (*fd < 0) *fd = open(filename, flags, 0644);
+    if (*fd < 0) {
+      fprintf(stderr, "Could not open file [%s] (write).\n", filename);
+      return MM_COULD_NOT_WRITE_FILE;
+    }
+    int err = mm_lock(*fd, LOCK_EX);
+    if (err != 0) return err;
+    struct stat locked, current;
+    if (fstat(*fd, &locked) != 0) return MM_COULD_NOT_WRITE_FILE;
+    if (stat(filename, &current) == 0 && current.st_dev == locked.st_dev && current.st_ino == locked.st_ino) return 0;
+    close(*fd); // Also unlocks
+    *fd = -1;
+  }
+}
+
+// Unique file next to filename, so that it can be renamed over it
+int mm_create_temp(const char *filename, unsigned mode, std::string *tmp_filename) {
+  *tmp_filename = std::string(filename) + ".XXXXXX";
+  int fd = mkstemp(&(*tmp_filename)[0]);
+  if (fd < 0 || fchmod(fd, mode) != 0) {
+    fprintf(stderr, "Could not create a temporary file next to [%s].\n", filename);
+    if (fd >= 0) {
+      close(fd);
+      unlink(tmp_filename->c_str());
+    }
+    return -1;
+  }
+  return fd;
+}
+
+// The contents of fd are durable before it is renamed over filename, and the rename before this returns
+int mm_replace_file(int fd, const std::string &tmp_filename, const char *filename) {
+  if (fsync(fd) != 0 || rename(tmp_filename.c_str(), filename) != 0) {
+    fprintf(stderr, "Could not replace file [%s] (%s).\n", filename, strerror(errno));
+    return MM_COULD_NOT_WRITE_FILE;
+  }
+  std::string dir(filename);
+  size_t slash = dir.find_last_of('/');
+  dir = slash == std::string::npos ? "." : slash == 0 ? "/" : dir.substr(0, slash);
+  int dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  int err = dir_fd >= 0 && fsync(dir_fd) == 0 ? 0 : MM_COULD_NOT_WRITE_FILE;
+  if (dir_fd >= 0) close(dir_fd);
+  return err;
+}
+
+static int mm_pwrite_all(int fd, const uint8_t *data, uint64_t bytes, uint64_t offset) {
+  while (bytes > 0) {
+    ssize_t n = pwrite(fd, data, bytes, offset);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return MM_COULD_NOT_WRITE_FILE;
+    data += n;
+    bytes -= n;
+    offset += n;
+  }
+  return 0;
+}
+
+static int mm_write_fixed_size_line(int fd, const mm_append_log *log) {
+  char line[MM_FIXED_SIZE_LINE_LENGTH + 1];
+  snprintf(line, sizeof(line), MM_FIXED_SIZE_LINE_FMT, log->nrows, log->ncols, log->nnz);
+  return mm_pwrite_all(fd, (const uint8_t *)line, MM_FIXED_SIZE_LINE_LENGTH, log->size_line_offset);
+}
+
+static int mm_read_append_log(int fd, mm_append_log *log) {
+  Distr_MMIO_Source src;
+  if (lseek(fd, 0, SEEK_SET) != 0 || Distr_MMIO_source_fd(fd, false, &src) != 0) return MM_COULD_NOT_READ_FILE;
+  int err;
+  {
+    mm_reader r(&src);
+    err = mm_read_banner(r, &log->matcode, true, &log->meta); // With meta, comments are consumed too
+    log->size_line_offset = r.position();
+    char line[MM_MAX_LINE_LENGTH];
+    if (err == 0 && !r.getline(line, sizeof(line))) err = MM_PREMATURE_EOF;
+    if (err == 0 && (strlen(line) != MM_FIXED_SIZE_LINE_LENGTH || sscanf(line, "%lu %lu %lu", &log->nrows, &log->ncols, &log->nnz) != 3)) {
+      fprintf(stderr, "The sizes of this file cannot be updated in place, it must be rewritten once with a BMTX writer.\n");
+      err = MM_UNSUPPORTED_TYPE;
+    }
+    log->data_offset = r.position();
+  }
+  Distr_MMIO_source_close(&src);
+  if (err != 0) return err;
+
+  log->idx_bytes = mm_get_idx_bytes(log->matcode);
+  log->val_bytes = mm_get_val_bytes(log->matcode);
+  if (log->idx_bytes == MM_IDX_BYTES_COMPRESSED || log->meta.sort_order != MM_SORT_NONE ||
+      mm_is_complex(log->matcode) || mm_is_skew(log->matcode) || mm_is_hermitian(log->matcode)) {
+    fprintf(stderr, "Only uncompressed and unsorted real, integer or pattern BMTX files can be appended to.\n");
+    return MM_UNSUPPORTED_TYPE;
+  }
+  mm_set_metadata(&log->meta, &log->matcode);
+  log->meta.val_bytes = log->val_bytes;
+  log->meta.val_encoding = mm_get_val_encoding(log->matcode);
+  log->entry_size = 2 * log->idx_bytes + (mm_is_pattern(log->matcode) ? 0 : log->val_bytes);
+  log->id = log->base = 0; // Logs created before ids were recorded get one at their next compaction
+  mm_take_header_comment(log->meta.mm_header_body, MM_LOG_COMMENT, &log->id, &log->base);
+  return 0;
+}
+
+// Replaces the log (locked through *fd) with a copy without its first drop entries, then *fd is the new log, also
+// locked. The copy is durable before it is renamed over the log, so a crash leaves either the old or the new log.
+static int mm_trim_append_log(const char *filename, int *fd, mm_append_log *log, uint64_t drop) {
+  struct stat st;
+  std::string tmp_filename;
+  int tmp_fd = fstat(*fd, &st) == 0 ? mm_create_temp(filename, st.st_mode & 07777, &tmp_filename) : -1;
+  if (tmp_fd < 0) return MM_COULD_NOT_WRITE_FILE;
+  int err = mm_lock(tmp_fd, LOCK_EX); // Appends that open the new log wait for the end of the compaction
+
+  // Same header lines, with the new base and sizes
+  std::string header(log->size_line_offset, '\0');
+  if (err == 0 && pread(*fd, &header[0], header.size(), 0) != (ssize_t)header.size()) err = MM_PREMATURE_EOF;
+  uint64_t id, base;
+  mm_take_header_comment(header, MM_LOG_COMMENT, &id, &base);
+  char line[MM_MAX_LINE_LENGTH];
+  snprintf(line, sizeof(line), "%s %016lx %lu\n", MM_LOG_COMMENT, log->id != 0 ? log->id : mm_new_log_id(), log->base + drop);
+  header += line;
+  snprintf(line, sizeof(line), MM_FIXED_SIZE_LINE_FMT, log->nrows, log->ncols, log->nnz - drop);
+  header += line;
+  if (err == 0) err = mm_pwrite_all(tmp_fd, (const uint8_t *)header.data(), header.size(), 0);
+
+  uint64_t bytes = (log->nnz - drop) * log->entry_size, offset = log->data_offset + drop * log->entry_size;
+  uint8_t *chunk = (uint8_t *)mm_alloc(std::max<uint64_t>(1, std::min<uint64_t>(bytes, MM_COPY_CHUNK_BYTES)));
+  for (uint64_t done = 0; err == 0 && done < bytes; done += MM_COPY_CHUNK_BYTES) {
+    uint64_t n = std::min<uint64_t>(bytes - done, MM_COPY_CHUNK_BYTES);
+    if (pread(*fd, chunk, n, offset + done) != (ssize_t)n) err = MM_PREMATURE_EOF;
+    if (err == 0) err = mm_pwrite_all(tmp_fd, chunk, n, header.size() + done);
+  }
+  mm_free(chunk);
+  if (err == 0 && mm_stats != NULL) mm_stats->bytes_written += header.size() + bytes;
+
+  if (err == 0) err = mm_replace_file(tmp_fd, tmp_filename, filename);
+  if (err != 0) {
+    unlink(tmp_filename.c_str());
+    close(tmp_fd);
+    return err;
+  }
+  close(*fd);
+  *fd = tmp_fd;
+  return mm_read_append_log(*fd, log);
+}
+
+// Id of the log and number of its entries merged so far into a compacted file (zeros without a watermark)
+static void mm_read_compacted_mark(const char *filename, uint64_t *id, uint64_t *watermark) {
+  *id = *watermark = 0;
+  FILE *f = fopen(filename, "r");
+  if (f == NULL) return;
+  MM_typecode matcode;
+  Matrix_Metadata meta;
+  if (mm_read_banner(f, &matcode, true, &meta) == 0) mm_take_header_comment(meta.mm_header_body, MM_COMPACTED_COMMENT, id, watermark);
+  fclose(f);
+}
+
+template<typename IT, typename VT, typename OT>
+static int mm_append_entries(int fd, mm_append_log *log, COO_local<IT, VT, OT> *coo) {
+  bool symmetric = log->meta.is_symmetric;
+  bool with_val = log->meta.val_type != MM_VAL_TYPE_PATTERN;
+  uint64_t max_row = 0, max_col = 0;
+  #pragma omp parallel for reduction(max:max_row, max_col)
+  for (OT i = 0; i < coo->nnz; ++i) {
+    max_row = std::max(max_row, (uint64_t)coo->row[i] + 1);
+    max_col = std::max(max_col, (uint64_t)coo->col[i] + 1);
+  }
+  uint64_t nrows = std::max({log->nrows, (uint64_t)coo->nrows, max_row});
+  uint64_t ncols = std::max({log->ncols, (uint64_t)coo->ncols, max_col});
+  if (required_bytes_index(std::max(nrows, ncols)) > log->idx_bytes) {
+    fprintf(stderr, "Appended entries need wider indices than the file uses (%hhu bytes).\n", log->idx_bytes);
+    return MM_UNSUPPORTED_TYPE;
+  }
+
+  // Each thread encodes a contiguous part of the batch, symmetric files only take the lower triangle
+  int nthreads = mm_max_threads();
+  std::vector<uint64_t> first(nthreads + 1, 0);
+  double t = mm_phase_begin();
+  #pragma omp parallel for schedule(static)
+  for (int c = 0; c < nthreads; ++c) {
+    uint64_t kept = 0;
+    for (uint64_t i = coo->nnz * c / nthreads; i < (uint64_t)coo->nnz * (c + 1) / nthreads; ++i) {
+      if (!symmetric || coo->row[i] >= coo->col[i]) ++kept;
+    }
+    first[c + 1] = kept;
+  }
+  for (int c = 0; c < nthreads; ++c) first[c + 1] += first[c];
+  uint64_t nentries = first[nthreads];
+  uint8_t *buffer = (uint8_t *)mm_alloc(std::max<uint64_t>(1, nentries * log->entry_size));
+  #pragma omp parallel for schedule(static)
+  for (int c = 0; c < nthreads; ++c) {
+    uint8_t *out = buffer + first[c] * log->entry_size;
+    for (uint64_t i = coo->nnz * c / nthreads; i < (uint64_t)coo->nnz * (c + 1) / nthreads; ++i) {
+      if (symmetric && coo->row[i] < coo->col[i]) continue;
+      uint64_t row = coo->row[i], col = coo->col[i];
+      memcpy(out, &row, log->idx_bytes);
+      memcpy(out + log->idx_bytes, &col, log->idx_bytes);
+      if (with_val) mm_encode_val(out + 2 * log->idx_bytes, coo->val != NULL ? coo->val[i] : (VT)1, log->val_bytes, log->meta.val_encoding);
+      out += log->entry_size;
+    }
+  }
+  mm_phase_end(MM_PHASE_ENCODE, t);
+
+  // Leftovers of an interrupted append (past the entries counted in the header) are overwritten. The entries are
+  // durable before the sizes are updated, with a single write, so readers see either the old or the new matrix.
+  t = mm_phase_begin();
+  uint64_t end = log->data_offset + log->nnz * log->entry_size;
+  int err = ftruncate(fd, end) == 0 ? 0 : MM_COULD_NOT_WRITE_FILE;
+  if (err == 0) err = mm_pwrite_all(fd, buffer, nentries * log->entry_size, end);
+  if (err == 0 && fdatasync(fd) != 0) err = MM_COULD_NOT_WRITE_FILE;
+  if (err == 0) {
+    log->nrows = nrows;
+    log->ncols = ncols;
+    log->nnz += nentries;
+    err = mm_write_fixed_size_line(fd, log);
+  }
+  if (err == 0 && fdatasync(fd) != 0) err = MM_COULD_NOT_WRITE_FILE;
+  mm_phase_end(MM_PHASE_DATA_IO, t);
+  if (err == 0 && mm_stats != NULL) mm_stats->bytes_written += nentries * log->entry_size + MM_FIXED_SIZE_LINE_LENGTH;
+  mm_free(buffer);
+  return err;
+}
+
+template<typename IT, typename VT, typename OT>
+int Distr_MMIO_COO_local_append(COO_local<IT, VT, OT>* coo, const char *filename, Matrix_Metadata* meta) {
+  std::string fname(filename);
+  if (!is_file_extension_bmtx(fname)) {
+    fprintf(stderr, "Only .bmtx files can be appended to.\n");
+    return MM_UNSUPPORTED_TYPE;
+  }
+  int fd = -1;
+  int err = mm_lock_current(filename, &fd, O_RDWR | O_CREAT); // Appends and compactions of the same file are serialized
+  if (err != 0) {
+    if (fd >= 0) close(fd);
+    return err;
+  }
+
+  mm_stats_begin();
+  struct stat st;
+  if (fstat(fd, &st) != 0) err = MM_COULD_NOT_WRITE_FILE;
+  if (err == 0 && st.st_size == 0) { // New file: header only, with the binary layout described by meta
+    Matrix_Metadata new_meta = *meta;
+    new_meta.sort_order = MM_SORT_NONE;
+    new_meta.mm_header = "%%MatrixMarket matrix coordinate ";
+    switch (new_meta.val_type) {
+    case MM_VAL_TYPE_REAL:    { new_meta.mm_header += std::string(MM_REAL_STR);    break; }
+    case MM_VAL_TYPE_INTEGER: { new_meta.mm_header += std::string(MM_INT_STR);     break; }
+    case MM_VAL_TYPE_PATTERN: { new_meta.mm_header += std::string(MM_PATTERN_STR); break; }
+    default:                  { fprintf(stderr, "BUG: MM_VAL_TYPE not recognized\n"); err = 100; }
+    }
+    new_meta.mm_header += new_meta.is_symmetric ? " symmetric" : " general";
+    char line[MM_MAX_LINE_LENGTH];
+    snprintf(line, sizeof(line), "%s %016lx 0\n", MM_LOG_COMMENT, mm_new_log_id());
+    mm_append_header_line(new_meta.mm_header_body, line);
+    if (err == 0 && !mm_is_valid_val_encoding(new_meta.val_bytes > 0 ? new_meta.val_bytes : 4, new_meta.val_encoding)) {
+      fprintf(stderr, "Values cannot be encoded using %hhu bytes with the requested encoding.\n", new_meta.val_bytes);
+      err = MM_UNSUPPORTED_TYPE;
+    }
+    FILE *f = err == 0 ? fdopen(dup(fd), "w") : NULL;
+    if (err == 0) {
+      err = f != NULL ? write_matrix_market_header(f, &new_meta, required_bytes_index(std::max(coo->nrows, coo->ncols)), coo->nrows, coo->ncols, 0)
+                      : MM_COULD_NOT_WRITE_FILE;
+    }
+    if (f != NULL && fclose(f) != 0) err = MM_COULD_NOT_WRITE_FILE;
+  }
+
+  mm_append_log log;
+  double t = mm_phase_begin();
+  if (err == 0) err = mm_read_append_log(fd, &log);
+  mm_phase_end(MM_PHASE_BANNER, t);
+  if (err == 0) err = mm_append_entries(fd, &log, coo);
+  if (err == 0 && meta != NULL) {
+    log.meta.nrows = log.nrows;
+    log.meta.ncols = log.ncols;
+    log.meta.nnz = log.nnz;
+    log.meta.expanded_nnz = log.meta.is_symmetric ? 2 * log.nnz : log.nnz;
+    *meta = log.meta;
+  }
+  flock(fd, LOCK_UN);
+  close(fd);
+  mm_stats_end(err == 0 ? coo->nnz : 0);
+  return err;
+}
+
+/*
+ * Compactions into the same sorted file are serialized by a lock on <sorted file>.lock. The log is locked only
+ * while it is parsed and while the compacted entries are dropped from it, so appends can go on during the sort,
+ * the merge and the write of the new sorted file. Both files are replaced by durable copies renamed over them, and
+ * the sorted file records how many entries of the log it contains (the watermark): the entries of a compaction
+ * interrupted before the log was trimmed are dropped by the next one instead of being merged twice.
+ */
+template<typename IT, typename VT, typename OT>
+int Distr_MMIO_compact(const char *log_filename, const char *sorted_filename, Matrix_Metadata* meta) {
+  std::string lock_filename = std::string(sorted_filename) + ".lock";
+  int lock_fd = open(lock_filename.c_str(), O_RDWR | O_CREAT, 0644);
+  if (lock_fd < 0) {
+    fprintf(stderr, "Could not open file [%s] (write).\n", lock_filename.c_str());
+    return MM_COULD_NOT_WRITE_FILE;
+  }
+  int err = mm_lock(lock_fd, LOCK_EX);
+  if (err != 0) {
+    close(lock_fd);
+    return err;
+  }
+
+  mm_stats_begin();
+  int fd = -1;
+  mm_append_log log;
+  IT nrows, ncols;
+  OT nnz = 0;
+  MM_typecode matcode;
+  Entry<IT, VT> *tail = NULL;
+  err = mm_lock_current(log_filename, &fd, O_RDWR);
+  if (err == 0) err = mm_read_append_log(fd, &log);
+
+  // Recovery: entries already in the sorted file are dropped first (and logs without an id get one)
+  uint64_t mark_id, watermark;
+  mm_read_compacted_mark(sorted_filename, &mark_id, &watermark);
+  if (err == 0 && log.id != 0 && mark_id == log.id && watermark > log.base + log.nnz) {
+    fprintf(stderr, "[%s] contains entries that are missing from [%s].\n", sorted_filename, log_filename);
+    err = MM_UNSUPPORTED_TYPE;
+  }
+  uint64_t drop = err == 0 && log.id != 0 && mark_id == log.id && watermark > log.base ? watermark - log.base : 0;
+  if (err == 0 && (log.id == 0 || drop > 0)) err = mm_trim_append_log(log_filename, &fd, &log, drop);
+
+  uint64_t compacted = err == 0 ? log.nnz : 0;
+  watermark = err == 0 ? log.base + compacted : 0;
+  if (err == 0 && compacted > 0) {
+    Distr_MMIO_Source src;
+    lseek(fd, 0, SEEK_SET);
+    err = Distr_MMIO_source_fd(fd, false, &src);
+    if (err == 0) {
+      tail = mm_parse_source<IT, VT, OT>(&src, nrows, ncols, nnz, &matcode, true, NULL);
+      Distr_MMIO_source_close(&src);
+      if (tail == NULL) err = MM_PREMATURE_EOF;
+    }
+  }
+  if (fd >= 0) flock(fd, LOCK_UN);
+  if (err != 0 || compacted == 0) {
+    if (fd >= 0) close(fd);
+    close(lock_fd);
+    mm_stats_end(0);
+    return err;
+  }
+
+  double t = mm_phase_begin();
+  tail = mm_sort_entries(tail, nnz, nrows, ncols, MM_SORT_ROW_MAJOR);
+  mm_phase_end(MM_PHASE_SORT, t);
+
+  // The previous sorted file (if any) is general and row-major, so it only has to be merged. Its header must say so,
+  // and the order of its entries is checked too (CSR writes record row-major whatever the order of the columns)
+  IT base_nrows = 0, base_ncols = 0;
+  OT base_nnz = 0;
+  Entry<IT, VT> *base = NULL;
+  Matrix_Metadata base_meta;
+  if (access(sorted_filename, F_OK) == 0) {
+    base = mm_parse_file<IT, VT, OT>(sorted_filename, base_nrows, base_ncols, base_nnz, &matcode, true, &base_meta);
+    bool sorted = base != NULL && mm_file_sort_order(&base_meta, is_file_extension_sbmtx(sorted_filename)) == MM_SORT_ROW_MAJOR;
+    if (sorted) {
+      #pragma omp parallel for schedule(static) reduction(&&:sorted)
+      for (OT i = 1; i < base_nnz; ++i)
+        sorted = sorted && (base[i - 1].row < base[i].row || (base[i - 1].row == base[i].row && base[i - 1].col <= base[i].col));
+    }
+    if (base == NULL) {
+      err = MM_COULD_NOT_READ_FILE;
+    } else if (base_meta.val_type != log.meta.val_type || base_meta.is_symmetric || !sorted) {
+      fprintf(stderr, "[%s] is not a general row-major sorted file with the values of [%s].\n", sorted_filename, log_filename);
+      err = MM_UNSUPPORTED_TYPE;
+    }
+  }
+
+  COO_local<IT, VT, OT> *coo = NULL;
+  if (err == 0) {
+    t = mm_phase_begin();
+    Entry<IT, VT> *merged = (Entry<IT, VT> *)mm_alloc(((uint64_t)base_nnz + nnz) * sizeof(Entry<IT, VT>));
+    std::merge(base, base + base_nnz, tail, tail + nnz, merged,
+               [](const Entry<IT, VT> &a, const Entry<IT, VT> &b) { return a.row < b.row || (a.row == b.row && a.col < b.col); });
+    mm_phase_end(MM_PHASE_SORT, t);
+    t = mm_phase_begin();
+    coo = Distr_MMIO_COO_local_create<IT, VT, OT>(std::max(base_nrows, nrows), std::max(base_ncols, ncols), base_nnz + nnz,
+                                                  log.meta.val_type != MM_VAL_TYPE_PATTERN);
+    entries_to_local_coo<IT, VT, OT>(merged, coo);
+    mm_phase_end(MM_PHASE_ASSEMBLY, t);
+    mm_free(merged);
+  }
+  mm_free(base);
+  mm_free(tail);
+
+  // Written next to the destination and renamed over it, with the watermark of the log
+  Matrix_Metadata out_meta = log.meta;
+  if (err == 0) {
+    out_meta.is_symmetric = false;
+    out_meta.sort_order = MM_SORT_ROW_MAJOR;
+    out_meta.mm_header = "%%MatrixMarket matrix coordinate ";
+    out_meta.mm_header += log.meta.val_type == MM_VAL_TYPE_REAL ? MM_REAL_STR : log.meta.val_type == MM_VAL_TYPE_INTEGER ? MM_INT_STR : MM_PATTERN_STR;
+    out_meta.mm_header += " general";
+    char line[MM_MAX_LINE_LENGTH];
+    snprintf(line, sizeof(line), "%s %016lx %lu\n", MM_COMPACTED_COMMENT, log.id, watermark);
+    mm_append_header_line(out_meta.mm_header_body, line);
+    struct stat st;
+    std::string tmp_filename;
+    int tmp_fd = mm_create_temp(sorted_filename, stat(sorted_filename, &st) == 0 ? st.st_mode & 07777 : 0644, &tmp_filename);
+    int out_fd = tmp_fd >= 0 ? dup(tmp_fd) : -1;
+    FILE *f = out_fd >= 0 ? fdopen(out_fd, "wb") : NULL;
+    if (f == NULL && out_fd >= 0) close(out_fd);
+    err = write_binary_matrix_market(f, coo, &out_meta, out_meta.sort_order);
+    if (err == 0) err = mm_replace_file(tmp_fd, tmp_filename, sorted_filename);
+    if (tmp_fd >= 0) {
+      if (err != 0) unlink(tmp_filename.c_str());
+      close(tmp_fd);
+    }
+  }
+
+  // The compacted entries are dropped from the log, the ones appended meanwhile are kept
+  if (err == 0) {
+    t = mm_phase_begin();
+    err = mm_lock_current(log_filename, &fd, O_RDWR);
+    if (err == 0) err = mm_read_append_log(fd, &log);
+    if (err == 0) err = mm_trim_append_log(log_filename, &fd, &log, watermark - log.base);
+    if (fd >= 0) flock(fd, LOCK_UN);
+    mm_phase_end(MM_PHASE_DATA_IO, t);
+  }
+  if (fd >= 0) close(fd);
+  close(lock_fd);
+
+  if (err == 0 && meta != NULL) {
+    out_meta.nrows = coo->nrows;
+    out_meta.ncols = coo->ncols;
+    out_meta.nnz = out_meta.expanded_nnz = coo->nnz;
+    *meta = out_meta;
+  }
+  uint64_t entries = coo != NULL ? coo->nnz : 0;
+  Distr_MMIO_COO_local_destroy(&coo);
+  mm_stats_end(err == 0 ? entries : 0);
+  return err;
+}
+
+/**
+ * SELL-C-sigma and BSR
+ */
+
+#define MM_BLOCKED_ALIGNMENT 64 // Arrays of the binary .sell/.bsr forms start at multiples of this offset
+
+static int mm_write_padded(FILE *f, const void *data, size_t bytes) {
+  static const uint8_t zeros[MM_BLOCKED_ALIGNMENT] = {0};
+  if (bytes > 0 && fwrite(data, 1, bytes, f) != bytes) return MM_COULD_NOT_WRITE_FILE;
+  size_t pad = (MM_BLOCKED_ALIGNMENT - ftell(f) % MM_BLOCKED_ALIGNMENT) % MM_BLOCKED_ALIGNMENT;
+  if (pad > 0 && fwrite(zeros, 1, pad, f) != pad) return MM_COULD_NOT_WRITE_FILE;
+  return 0;
+}
+
+static int mm_read_padded(FILE *f, void *data, size_t bytes) {
+  int err = mm_fread_chunked((uint8_t *)data, bytes, f);
+  if (err != 0) return err;
+  long pos = ftell(f);
+  if (pos < 0) return MM_PREMATURE_EOF;
+  return fseek(f, (MM_BLOCKED_ALIGNMENT - pos % MM_BLOCKED_ALIGNMENT) % MM_BLOCKED_ALIGNMENT, SEEK_CUR) == 0 ? 0 : MM_PREMATURE_EOF;
+}
+
+// Reads the "%%MMIO <format> <it> <vt> <ot>" banner and moves to the first array, returns the sizes line
+static int mm_read_blocked_header(FILE *f, const char *format, size_t it_bytes, size_t vt_bytes, size_t ot_bytes, char *sizes) {
+  char line[MM_MAX_LINE_LENGTH];
+  char banner[MM_MAX_TOKEN_LENGTH], fmt[MM_MAX_TOKEN_LENGTH];
+  size_t it, vt, ot;
+  if (fgets(line, MM_MAX_LINE_LENGTH, f) == NULL) return MM_PREMATURE_EOF;
+  if (sscanf(line, "%s %s %zu %zu %zu", banner, fmt, &it, &vt, &ot) != 5 || strcmp(banner, "%%MMIO") != 0 || strcmp(fmt, format) != 0)
+    return MM_NO_HEADER;
+  if (it != it_bytes || vt != vt_bytes || ot != ot_bytes) {
+    fprintf(stderr, "%s file written with %zu/%zu/%zu bytes types, reading with %zu/%zu/%zu.\n", format, it, vt, ot, it_bytes, vt_bytes, ot_bytes);
+    return MM_UNSUPPORTED_TYPE;
+  }
+  if (fgets(sizes, MM_MAX_LINE_LENGTH, f) == NULL) return MM_PREMATURE_EOF;
+  long pos = ftell(f);
+  mm_stats_bytes_read(pos);
+  return fseek(f, (MM_BLOCKED_ALIGNMENT - pos % MM_BLOCKED_ALIGNMENT) % MM_BLOCKED_ALIGNMENT, SEEK_CUR) == 0 ? 0 : MM_PREMATURE_EOF;
+}
+
+#define MM_ROW_SORT_MAX_BUCKETS 16384
+
+/*
+ * Stable parallel sort of the entries by row, then by column inside each row (skipped when they already are),
+ * returning the row offsets (NULL if an entry lies outside nrows x ncols, the fills index the rows with them). A counting
+ * pass spreads the entries in buckets of consecutive rows, so only per-thread counts of the buckets are needed, then
+ * each bucket is sorted by row into the original array and its rows by column.
+ */
+template<typename IT, typename VT, typename OT>
+static OT *mm_sort_entries_by_row(Entry<IT, VT> *entries, OT nnz, IT nrows, IT ncols) {
+  bool sorted = true, out_of_range = false;
+  #pragma omp parallel for schedule(static) reduction(&&:sorted) reduction(||:out_of_range)
+  for (OT i = 0; i < nnz; ++i) {
+    out_of_range = out_of_range || (uint64_t)entries[i].row >= (uint64_t)nrows || (uint64_t)entries[i].col >= (uint64_t)ncols;
+    if (i > 0) sorted = sorted && (entries[i - 1].row < entries[i].row || (entries[i - 1].row == entries[i].row && entries[i - 1].col <= entries[i].col));
+  }
+  if (out_of_range) {
+    fprintf(stderr, "Matrix entries out of the %lu x %lu size of the matrix.\n", (uint64_t)nrows, (uint64_t)ncols);
+    return NULL;
+  }
+  OT *row_ptr = (OT *)mm_alloc(((uint64_t)nrows + 1) * sizeof(OT));
+  if (sorted) { // Each entry sets the offsets of the rows between the previous entry row and its own
+    #pragma omp parallel for schedule(static)
+    for (OT i = 0; i < nnz; ++i) {
+      IT first_row = i == 0 ? 0 : entries[i - 1].row + 1;
+      for (IT v = first_row; v <= entries[i].row; ++v) row_ptr[v] = i;
+    }
+    IT last_row = nnz == 0 ? 0 : entries[nnz - 1].row + 1;
+    for (IT v = last_row; v <= nrows; ++v) row_ptr[v] = nnz;
+    return row_ptr;
+  }
+
+  int shift = 0;
+  while (((uint64_t)nrows >> shift) >= MM_ROW_SORT_MAX_BUCKETS) ++shift;
+  uint64_t nbuckets = ((uint64_t)nrows + ((uint64_t)1 << shift) - 1) >> shift;
+  int nthreads = mm_max_threads();
+  std::vector<uint64_t> first((size_t)nthreads * nbuckets, 0), bucket_ptr(nbuckets + 1);
+  #pragma omp parallel for schedule(static)
+  for (int t = 0; t < nthreads; ++t) {
+    uint64_t *count = &first[(size_t)t * nbuckets];
+    for (uint64_t i = (uint64_t)nnz * t / nthreads; i < (uint64_t)nnz * (t + 1) / nthreads; ++i) count[entries[i].row >> shift]++;
+  }
+  uint64_t sum = 0;
+  for (uint64_t b = 0; b < nbuckets; ++b) {
+    bucket_ptr[b] = sum;
+    for (int t = 0; t < nthreads; ++t) {
+      uint64_t count = first[(size_t)t * nbuckets + b];
+      first[(size_t)t * nbuckets + b] = sum;
+      sum += count;
+    }
+  }
+  bucket_ptr[nbuckets] = sum;
+  Entry<IT, VT> *buckets = (Entry<IT, VT> *)mm_alloc(nnz * sizeof(Entry<IT, VT>));
+  #pragma omp parallel for schedule(static)
+  for (int t = 0; t < nthreads; ++t) {
+    uint64_t *next = &first[(size_t)t * nbuckets];
+    for (uint64_t i = (uint64_t)nnz * t / nthreads; i < (uint64_t)nnz * (t + 1) / nthreads; ++i) buckets[next[entries[i].row >> shift]++] = entries[i];
+  }
+
+  #pragma omp parallel
+  {
+    std::vector<uint64_t> next((size_t)1 << shift);
+    #pragma omp for schedule(dynamic, 1)
+    for (uint64_t b = 0; b < nbuckets; ++b) {
+      uint64_t first_row = b << shift, rows = std::min<uint64_t>((uint64_t)1 << shift, (uint64_t)nrows - first_row);
+      std::fill(next.begin(), next.begin() + rows, 0);
+      for (uint64_t i = bucket_ptr[b]; i < bucket_ptr[b + 1]; ++i) next[buckets[i].row - first_row]++;
+      uint64_t offset = bucket_ptr[b];
+      for (uint64_t r = 0; r < rows; ++r) {
+        uint64_t count = next[r];
+        row_ptr[first_row + r] = offset;
+        next[r] = offset;
+        offset += count;
+      }
+      for (uint64_t i = bucket_ptr[b]; i < bucket_ptr[b + 1]; ++i) entries[next[buckets[i].row - first_row]++] = buckets[i];
+
+      // Rows are usually short: insertion sort, which is stable too
+      for (uint64_t r = 0; r < rows; ++r) {
+        Entry<IT, VT> *begin = entries + row_ptr[first_row + r], *end = entries + next[r];
+        if (end - begin > 32) {
+          std::stable_sort(begin, end, [](const Entry<IT, VT> &x, const Entry<IT, VT> &y) { return x.col < y.col; });
+          continue;
+        }
+        for (Entry<IT, VT> *p = begin + 1; p < end; ++p) {
+          Entry<IT, VT> e = *p, *q = p;
+          for (; q > begin && q[-1].col > e.col; --q) *q = q[-1];
+          *q = e;
+        }
+      }
+    }
+  }
+  row_ptr[nrows] = nnz;
+  mm_free(buckets);
+  return row_ptr;
+}
+
+// Entries of a COO, with value 1 for patterns
+template<typename IT, typename VT, typename OT>
+static Entry<IT, VT> *mm_coo_entries(COO_local<IT, VT, OT> *coo) {
+  Entry<IT, VT> *entries = (Entry<IT, VT> *)mm_alloc(std::max<uint64_t>(1, coo->nnz) * sizeof(Entry<IT, VT>));
+  #pragma omp parallel for schedule(static)
+  for (OT i = 0; i < coo->nnz; ++i) {
+    entries[i].row = coo->row[i];
+    entries[i].col = coo->col[i];
+    entries[i].val = coo->val != NULL ? coo->val[i] : (VT)1;
+  }
+  return entries;
+}
+
+template<typename IT, typename VT, typename OT>
+static SELL_local<IT, VT, OT>* mm_sell_create(IT nrows, IT ncols, OT nnz, IT C, IT sigma) {
+  SELL_local<IT, VT, OT> *sell = (SELL_local<IT, VT, OT> *)mm_alloc(sizeof(SELL_local<IT, VT, OT>));
+  sell->nrows = nrows;
+  sell->ncols = ncols;
+  sell->nnz = nnz;
+  sell->C = C;
+  sell->sigma = sigma;
+  sell->nchunks = (nrows + C - 1) / C;
+  sell->chunk_ptr = (OT *)mm_alloc_aligned((sell->nchunks + 1) * sizeof(OT));
+  sell->chunk_len = (IT *)mm_alloc_aligned(sell->nchunks * sizeof(IT));
+  sell->row_perm = (IT *)mm_alloc_aligned(nrows * sizeof(IT));
+  sell->col_idx = NULL;
+  sell->val = NULL;
+  return sell;
+}
+
+// Builds the SELL-C-sigma of the entries, which are consumed
+template<typename IT, typename VT, typename OT>
+static SELL_local<IT, VT, OT>* mm_entries_to_sell(Entry<IT, VT> *entries, IT nrows, IT ncols, OT nnz, IT C, IT sigma) {
+  if (C == 0 || sigma == 0) {
+    fprintf(stderr, "SELL-C-sigma requires C > 0 and sigma > 0.\n");
+    mm_free(entries);
+    return NULL;
+  }
+  double t = mm_phase_begin();
+  OT *row_ptr = mm_sort_entries_by_row(entries, nnz, nrows, ncols);
+  mm_phase_end(MM_PHASE_SORT, t);
+  if (row_ptr == NULL) {
+    mm_free(entries);
+    return NULL;
+  }
+
+  t = mm_phase_begin();
+  SELL_local<IT, VT, OT> *sell = mm_sell_create<IT, VT, OT>(nrows, ncols, nnz, C, sigma);
+
+  // Inside each sigma window, rows are sorted by decreasing length (ties keep the original order)
+  IT nwindows = (nrows + sigma - 1) / sigma;
+  #pragma omp parallel for schedule(dynamic, 16)
+  for (IT w = 0; w < nwindows; ++w) {
+    IT begin = w * sigma, end = std::min<IT>(nrows, begin + sigma);
+    for (IT r = begin; r < end; ++r) sell->row_perm[r] = r;
+    std::stable_sort(sell->row_perm + begin, sell->row_perm + end, [row_ptr](IT a, IT b) {
+      return row_ptr[a + 1] - row_ptr[a] > row_ptr[b + 1] - row_ptr[b];
+    });
+  }
+
+  #pragma omp parallel for schedule(static)
+  for (IT c = 0; c < sell->nchunks; ++c) {
+    IT len = 0;
+    for (IT r = c * C; r < std::min<IT>(nrows, (c + 1) * C); ++r) {
+      IT row = sell->row_perm[r];
+      len = std::max<IT>(len, row_ptr[row + 1] - row_ptr[row]);
+    }
+    sell->chunk_len[c] = len;
+  }
+  sell->chunk_ptr[0] = 0;
+  for (IT c = 0; c < sell->nchunks; ++c) sell->chunk_ptr[c + 1] = sell->chunk_ptr[c] + (OT)sell->chunk_len[c] * C;
+
+  OT padded = sell->chunk_ptr[sell->nchunks];
+  sell->col_idx = (IT *)mm_alloc_aligned(padded * sizeof(IT));
+  sell->val = (VT *)mm_alloc_aligned(padded * sizeof(VT));
+
+  #pragma omp parallel for schedule(dynamic, 16)
+  for (IT c = 0; c < sell->nchunks; ++c) {
+    OT base = sell->chunk_ptr[c];
+    for (IT r = 0; r < C; ++r) {
+      IT slot = c * C + r;
+      OT begin = 0, len = 0;
+      if (slot < nrows) {
+        begin = row_ptr[sell->row_perm[slot]];
+        len = row_ptr[sell->row_perm[slot] + 1] - begin;
+      }
+      IT last_col = len > 0 ? entries[begin + len - 1].col : 0;
+      for (IT j = 0; j < sell->chunk_len[c]; ++j) {
+        OT dst = base + (OT)j * C + r;
+        if (j < len) {
+          sell->col_idx[dst] = entries[begin + j].col;
+          sell->val[dst] = entries[begin + j].val;
+        } else {
+          sell->col_idx[dst] = last_col;
+          sell->val[dst] = 0.0;
+        }
+      }
+    }
+  }
+  mm_free(row_ptr);
+  mm_free(entries);
+  mm_phase_end(MM_PHASE_ASSEMBLY, t);
+  return sell;
+}
+
+/*
+ * Blocks of block row b in column order, merged from the column sorted runs of its rows (next holds their
+ * positions). Without bsr they are only counted, otherwise they are filled from bsr->block_row_ptr[b].
+ */
+template<typename IT, typename VT, typename OT>
+static OT mm_bsr_block_row(const Entry<IT, VT> *entries, const OT *row_ptr, IT nrows, IT bs, IT b, OT *next,
+                           BSR_local<IT, VT, OT> *bsr) {
+  IT first = b * bs, rows = std::min<IT>(nrows - first, bs);
+  for (IT k = 0; k < rows; ++k) next[k] = row_ptr[first + k];
+  size_t block_elems = (size_t)bs * bs;
+  OT blocks = 0;
+  while (true) {
+    bool any = false;
+    IT block_col = 0;
+    for (IT k = 0; k < rows; ++k) {
+      if (next[k] == row_ptr[first + k + 1]) continue;
+      IT c = entries[next[k]].col / bs;
+      if (!any || c < block_col) block_col = c;
+      any = true;
+    }
+    if (!any) return blocks;
+
+    VT *val = NULL;
+    if (bsr != NULL) {
+      OT blk = bsr->block_row_ptr[b] + blocks;
+      bsr->block_col_idx[blk] = block_col;
+      val = bsr->val + blk * block_elems;
+      std::fill(val, val + block_elems, (VT)0);
+    }
+    for (IT k = 0; k < rows; ++k) {
+      for (; next[k] < row_ptr[first + k + 1] && entries[next[k]].col / bs == block_col; ++next[k]) {
+        // Duplicated entries are summed, as in a finite elements assembly
+        if (val != NULL) val[k * bs + entries[next[k]].col % bs] += entries[next[k]].val;
+      }
+    }
+    ++blocks;
+  }
+}
+
+// Builds the BSR of the entries, which are consumed
+template<typename IT, typename VT, typename OT>
+static BSR_local<IT, VT, OT>* mm_entries_to_bsr(Entry<IT, VT> *entries, IT nrows, IT ncols, OT nnz, IT bs) {
+  if (bs == 0) {
+    fprintf(stderr, "BSR requires a block size > 0.\n");
+    mm_free(entries);
+    return NULL;
+  }
+  double t = mm_phase_begin();
+  OT *row_ptr = mm_sort_entries_by_row(entries, nnz, nrows, ncols);
+  mm_phase_end(MM_PHASE_SORT, t);
+  if (row_ptr == NULL) {
+    mm_free(entries);
+    return NULL;
+  }
+
+  t = mm_phase_begin();
+  IT nblock_rows = (nrows + bs - 1) / bs;
+  BSR_local<IT, VT, OT> *bsr = (BSR_local<IT, VT, OT> *)mm_alloc(sizeof(BSR_local<IT, VT, OT>));
+  bsr->nrows = nrows;
+  bsr->ncols = ncols;
+  bsr->nnz = nnz;
+  bsr->block_size = bs;
+  bsr->nblock_rows = nblock_rows;
+  bsr->nblock_cols = (ncols + bs - 1) / bs;
+  bsr->block_row_ptr = (OT *)mm_alloc_aligned((nblock_rows + 1) * sizeof(OT));
+
+  // A pass counts the blocks of each block row, a second one fills them
+  bsr->block_row_ptr[0] = 0;
+  #pragma omp parallel
+  {
+    std::vector<OT> next(bs);
+    #pragma omp for schedule(dynamic, 16)
+    for (IT b = 0; b < nblock_rows; ++b) {
+      bsr->block_row_ptr[b + 1] = mm_bsr_block_row<IT, VT, OT>(entries, row_ptr, nrows, bs, b, next.data(), NULL);
+    }
+  }
+  for (IT b = 0; b < nblock_rows; ++b) bsr->block_row_ptr[b + 1] += bsr->block_row_ptr[b];
+  bsr->nblocks = bsr->block_row_ptr[nblock_rows];
+
+  size_t block_elems = (size_t)bs * bs;
+  bsr->block_col_idx = (IT *)mm_alloc_aligned(bsr->nblocks * sizeof(IT));
+  bsr->val = (VT *)mm_alloc_aligned(bsr->nblocks * block_elems * sizeof(VT));
+  #pragma omp parallel
+  {
+    std::vector<OT> next(bs);
+    #pragma omp for schedule(dynamic, 16)
+    for (IT b = 0; b < nblock_rows; ++b) mm_bsr_block_row<IT, VT, OT>(entries, row_ptr, nrows, bs, b, next.data(), bsr);
+  }
+  mm_free(row_ptr);
+  mm_free(entries);
+  mm_phase_end(MM_PHASE_ASSEMBLY, t);
+  return bsr;
+}
+
+// Parses any supported Matrix Market file into entries with values (pattern entries are 1)
+template<typename IT, typename VT, typename OT>
+static Entry<IT, VT>* mm_read_entries_with_val(const char *filename, IT &nrows, IT &ncols, OT &nnz, Matrix_Metadata* meta) {
+  std::string fname(filename);
+  bool is_bmtx = is_file_extension_bmtx(fname) || is_file_extension_sbmtx(fname) || is_file_extension_cbmtx(fname);
+  MM_typecode matcode;
+  return mm_parse_file<IT, VT, OT>(filename, nrows, ncols, nnz, &matcode, is_bmtx, meta);
+}
+
+// SELL-C-sigma
+
+template<typename IT, typename VT, typename OT>
+static SELL_local<IT, VT, OT>* mm_read_sell_binary(const char *filename) {
+  FILE *f = fopen(filename, "rb");
+  if (f == NULL) {
+    fprintf(stderr, "Could not open file [%s] (read).\n", filename);
+    return NULL;
+  }
+  char sizes[MM_MAX_LINE_LENGTH];
+  uint64_t nrows, ncols, nnz, C, sigma, nchunks;
+  int err = mm_read_blocked_header(f, "SELL-C-sigma", sizeof(IT), sizeof(VT), sizeof(OT), sizes);
+  if (err == 0 && (sscanf(sizes, "%lu %lu %lu %lu %lu %lu", &nrows, &ncols, &nnz, &C, &sigma, &nchunks) != 6 || C == 0
+                   || nchunks != (nrows + C - 1) / C))
+    err = MM_PREMATURE_EOF;
+  if (err != 0) {
+    fprintf(stderr, "Could not read SELL-C-sigma file [%s] (error code: %d).\n", filename, err);
+    fclose(f);
+    return NULL;
+  }
+
+  double t = mm_phase_begin();
+  SELL_local<IT, VT, OT> *sell = mm_sell_create<IT, VT, OT>(nrows, ncols, nnz, C, sigma);
+  err = mm_read_padded(f, sell->chunk_ptr, (nchunks + 1) * sizeof(OT));
+  if (err == 0) err = mm_read_padded(f, sell->chunk_len, nchunks * sizeof(IT));
+  if (err == 0) err = mm_read_padded(f, sell->row_perm, nrows * sizeof(IT));
+  if (err == 0) {
+    OT padded = sell->chunk_ptr[nchunks];
+    sell->col_idx = (IT *)mm_alloc_aligned(padded * sizeof(IT));
+    sell->val = (VT *)mm_alloc_aligned(padded * sizeof(VT));
+    err = mm_read_padded(f, sell->col_idx, padded * sizeof(IT));
+    if (err == 0) err = mm_read_padded(f, sell->val, padded * sizeof(VT));
+  }
+  fclose(f);
+  mm_phase_end(MM_PHASE_DATA_IO, t);
+  if (err != 0) {
+    if (err != MM_CANCELLED) fprintf(stderr, "Could not read SELL-C-sigma data (error code: %d).\n", err);
+    Distr_MMIO_SELL_local_destroy(&sell);
+  }
+  return sell;
+}
+
+template<typename IT, typename VT, typename OT>
+SELL_local<IT, VT, OT>* Distr_MMIO_SELL_local_read(const char *filename, IT C, IT sigma, Matrix_Metadata* meta) {
+  mm_stats_begin();
+  SELL_local<IT, VT, OT> *sell = NULL;
+  if (std::string(filename).ends_with(".sell")) {
+    sell = mm_read_sell_binary<IT, VT, OT>(filename);
+  } else {
+    IT nrows, ncols;
+    OT nnz;
+    Entry<IT, VT> *entries = mm_read_entries_with_val<IT, VT, OT>(filename, nrows, ncols, nnz, meta);
+    if (entries != NULL) sell = mm_entries_to_sell(entries, nrows, ncols, nnz, C, sigma);
+  }
+  mm_stats_end(sell != NULL ? sell->nnz : 0);
+  return sell;
+}
+
+template<typename IT, typename VT, typename OT>
+SELL_local<IT, VT, OT>* Distr_MMIO_SELL_local_from_COO(COO_local<IT, VT, OT>* coo, IT C, IT sigma) {
+  mm_stats_begin();
+  SELL_local<IT, VT, OT> *sell = mm_entries_to_sell(mm_coo_entries(coo), coo->nrows, coo->ncols, coo->nnz, C, sigma);
+  mm_stats_end(sell != NULL ? sell->nnz : 0);
+  return sell;
+}
+
+template<typename IT, typename VT, typename OT>
+int Distr_MMIO_SELL_local_write(SELL_local<IT, VT, OT>* sell, const char *filename) {
+  FILE *f = open_file_w(filename);
+  if (f == NULL) return MM_COULD_NOT_WRITE_FILE;
+  mm_stats_begin();
+  double t = mm_phase_begin();
+  int err = 0;
+  if (fprintf(f, "%%%%MMIO SELL-C-sigma %zu %zu %zu\n%lu %lu %lu %lu %lu %lu\n", sizeof(IT), sizeof(VT), sizeof(OT),
+              (uint64_t)sell->nrows, (uint64_t)sell->ncols, (uint64_t)sell->nnz, (uint64_t)sell->C, (uint64_t)sell->sigma,
+              (uint64_t)sell->nchunks) < 0)
+    err = MM_COULD_NOT_WRITE_FILE;
+  if (err == 0) err = mm_write_padded(f, NULL, 0);
+  if (err == 0) err = mm_write_padded(f, sell->chunk_ptr, (sell->nchunks + 1) * sizeof(OT));
+  if (err == 0) err = mm_write_padded(f, sell->chunk_len, sell->nchunks * sizeof(IT));
+  if (err == 0) err = mm_write_padded(f, sell->row_perm, sell->nrows * sizeof(IT));
+  if (err == 0) err = mm_write_padded(f, sell->col_idx, sell->chunk_ptr[sell->nchunks] * sizeof(IT));
+  if (err == 0) err = mm_write_padded(f, sell->val, sell->chunk_ptr[sell->nchunks] * sizeof(VT));
+  mm_stats_bytes_written(f);
+  fclose(f);
+  mm_phase_end(MM_PHASE_DATA_IO, t);
+  mm_stats_end(err == 0 ? sell->nnz : 0);
+  return err;
+}
+
+template<typename IT, typename VT, typename OT>
+void Distr_MMIO_SELL_local_destroy(SELL_local<IT, VT, OT> **sell) {
+  if (*sell != NULL) {
+    mm_free_aligned((*sell)->chunk_ptr);
+    mm_free_aligned((*sell)->chunk_len);
+    mm_free_aligned((*sell)->row_perm);
+    mm_free_aligned((*sell)->col_idx);
+    mm_free_aligned((*sell)->val);
+    mm_free(*sell);
+    *sell = NULL;
+  }
+}
+
+// BSR
+
+template<typename IT, typename VT, typename OT>
+static BSR_local<IT, VT, OT>* mm_read_bsr_binary(const char *filename) {
+  FILE *f = fopen(filename, "rb");
+  if (f == NULL) {
+    fprintf(stderr, "Could not open file [%s] (read).\n", filename);
+    return NULL;
+  }
+  char sizes[MM_MAX_LINE_LENGTH];
+  uint64_t nrows, ncols, nnz, bs, nblocks;
+  int err = mm_read_blocked_header(f, "BSR", sizeof(IT), sizeof(VT), sizeof(OT), sizes);
+  if (err == 0 && (sscanf(sizes, "%lu %lu %lu %lu %lu", &nrows, &ncols, &nnz, &bs, &nblocks) != 5 || bs == 0))
+    err = MM_PREMATURE_EOF;
+  if (err != 0) {
+    fprintf(stderr, "Could not read BSR file [%s] (error code: %d).\n", filename, err);
+    fclose(f);
+    return NULL;
+  }
+
+  double t = mm_phase_begin();
+  BSR_local<IT, VT, OT> *bsr = (BSR_local<IT, VT, OT> *)mm_alloc(sizeof(BSR_local<IT, VT, OT>));
+  bsr->nrows = nrows;
+  bsr->ncols = ncols;
+  bsr->nnz = nnz;
+  bsr->block_size = bs;
+  bsr->nblock_rows = (nrows + bs - 1) / bs;
+  bsr->nblock_cols = (ncols + bs - 1) / bs;
+  bsr->nblocks = nblocks;
+  bsr->block_row_ptr = (OT *)mm_alloc_aligned((bsr->nblock_rows + 1) * sizeof(OT));
+  bsr->block_col_idx = (IT *)mm_alloc_aligned(nblocks * sizeof(IT));
+  bsr->val = (VT *)mm_alloc_aligned(nblocks * bs * bs * sizeof(VT));
+  err = mm_read_padded(f, bsr->block_row_ptr, (bsr->nblock_rows + 1) * sizeof(OT));
+  if (err == 0) err = mm_read_padded(f, bsr->block_col_idx, nblocks * sizeof(IT));
+  if (err == 0) err = mm_read_padded(f, bsr->val, nblocks * bs * bs * sizeof(VT));
+  fclose(f);
+  mm_phase_end(MM_PHASE_DATA_IO, t);
+  if (err != 0) {
+    if (err != MM_CANCELLED) fprintf(stderr, "Could not read BSR data (error code: %d).\n", err);
+    Distr_MMIO_BSR_local_destroy(&bsr);
+  }
+  return bsr;
+}
+
+template<typename IT, typename VT, typename OT>
+BSR_local<IT, VT, OT>* Distr_MMIO_BSR_local_read(const char *filename, IT block_size, Matrix_Metadata* meta) {
+  mm_stats_begin();
+  BSR_local<IT, VT, OT> *bsr = NULL;
+  if (std::string(filename).ends_with(".bsr")) {
+    bsr = mm_read_bsr_binary<IT, VT, OT>(filename);
+  } else {
+    IT nrows, ncols;
+    OT nnz;
+    Entry<IT, VT> *entries = mm_read_entries_with_val<IT, VT, OT>(filename, nrows, ncols, nnz, meta);
+    if (entries != NULL) bsr = mm_entries_to_bsr(entries, nrows, ncols, nnz, block_size);
+  }
+  mm_stats_end(bsr != NULL ? bsr->nnz : 0);
+  return bsr;
+}
+
+template<typename IT, typename VT, typename OT>
+BSR_local<IT, VT, OT>* Distr_MMIO_BSR_local_from_COO(COO_local<IT, VT, OT>* coo, IT block_size) {
+  mm_stats_begin();
+  BSR_local<IT, VT, OT> *bsr = mm_entries_to_bsr(mm_coo_entries(coo), coo->nrows, coo->ncols, coo->nnz, block_size);
+  mm_stats_end(bsr != NULL ? bsr->nnz : 0);
+  return bsr;
+}
+
+template<typename IT, typename VT, typename OT>
+int Distr_MMIO_BSR_local_write(BSR_local<IT, VT, OT>* bsr, const char *filename) {
+  FILE *f = open_file_w(filename);
+  if (f == NULL) return MM_COULD_NOT_WRITE_FILE;
+  mm_stats_begin();
+  double t = mm_phase_begin();
+  size_t block_elems = (size_t)bsr->block_size * bsr->block_size;
+  int err = 0;
+  if (fprintf(f, "%%%%MMIO BSR %zu %zu %zu\n%lu %lu %lu %lu %lu\n", sizeof(IT), sizeof(VT), sizeof(OT), (uint64_t)bsr->nrows,
+              (uint64_t)bsr->ncols, (uint64_t)bsr->nnz, (uint64_t)bsr->block_size, (uint64_t)bsr->nblocks) < 0)
+    err = MM_COULD_NOT_WRITE_FILE;
+  if (err == 0) err = mm_write_padded(f, NULL, 0);
+  if (err == 0) err = mm_write_padded(f, bsr->block_row_ptr, (bsr->nblock_rows + 1) * sizeof(OT));
+  if (err == 0) err = mm_write_padded(f, bsr->block_col_idx, bsr->nblocks * sizeof(IT));
+  if (err == 0) err = mm_write_padded(f, bsr->val, bsr->nblocks * block_elems * sizeof(VT));
+  mm_stats_bytes_written(f);
+  fclose(f);
+  mm_phase_end(MM_PHASE_DATA_IO, t);
+  mm_stats_end(err == 0 ? bsr->nnz : 0);
+  return err;
+}
+
+template<typename IT, typename VT, typename OT>
+void Distr_MMIO_BSR_local_destroy(BSR_local<IT, VT, OT> **bsr) {
+  if (*bsr != NULL) {
+    mm_free_aligned((*bsr)->block_row_ptr);
+    mm_free_aligned((*bsr)->block_col_idx);
+    mm_free_aligned((*bsr)->val);
+    mm_free(*bsr);
+    *bsr = NULL;
+  }
+}
+
+/**
+ * Dense arrays
+ */
+
+// Position of the stored values of an array file: column-major, only the lower triangle of symmetric matrices
+// (strictly lower for skew-symmetric ones)
+struct mm_array_layout {
+  uint64_t nrows, ncols;
+  bool triangle;
+  uint64_t skew; // 1 if the diagonal is not stored
+
+  uint64_t first_row(uint64_t j) const { return triangle ? j + skew : 0; }
+
+  void position(uint64_t k, uint64_t *i, uint64_t *j) const {
+    if (!triangle) {
+      *j = k / nrows;
+      *i = k % nrows;
+      return;
+    }
+    // Column j starts at j * (n - skew) - j * (j - 1) / 2, the last column starting at or before k holds it
+    uint64_t lo = 0, hi = ncols;
+    while (hi - lo > 1) {
+      uint64_t mid = lo + (hi - lo) / 2;
+      if (mid * (nrows - skew) - mid * (mid - 1) / 2 <= k) lo = mid;
+      else hi = mid;
+    }
+    *j = lo;
+    *i = first_row(lo) + k - (lo * (nrows - skew) - (lo > 0 ? lo * (lo - 1) / 2 : 0));
+  }
+
+  void next(uint64_t *i, uint64_t *j) const {
+    if (++*i == nrows) {
+      ++*j;
+      *i = first_row(*j);
+    }
+  }
+};
+
+template<typename IT, typename VT>
+static inline uint64_t mm_dense_offset(const Dense_local<IT, VT> *dense, uint64_t i, uint64_t j) {
+  return dense->row_major ? i * dense->ncols + j : j * dense->nrows + i;
+}
+
+// Parses the text values of [p, end), from the first-th stored value to the last-th, mirroring triangles
+template<typename IT, typename VT>
+static bool mm_parse_array_values(const char *p, const char *end, Dense_local<IT, VT> *dense, const mm_array_layout &layout,
+                                  uint64_t first, uint64_t last) {
+  uint64_t i, j;
+  layout.position(first, &i, &j);
+  for (uint64_t k = first; k < last && p < end;) {
+    while (p < end && mm_is_blank(*p)) ++p;
+    if (p < end && *p != '\n' && *p != '%') {
+      VT v;
+      if (!mm_parse_number(p, end, &v)) return false;
+      dense->val[mm_dense_offset(dense, i, j)] = v;
+      if (layout.triangle && i != j) dense->val[mm_dense_offset(dense, j, i)] = layout.skew ? -v : v;
+      layout.next(&i, &j);
+      ++k;
+    }
+    const char *nl = (const char *)memchr(p, '\n', end - p);
+    p = nl != NULL ? nl + 1 : end;
+  }
+  return true;
+}
+
+// Binary array data starts at the first multiple of MM_BLOCKED_ALIGNMENT after the header
+static inline uint64_t mm_dense_data_offset(uint64_t header_end) {
+  return (header_end + MM_BLOCKED_ALIGNMENT - 1) / MM_BLOCKED_ALIGNMENT * MM_BLOCKED_ALIGNMENT;
+}
+
+// Reads the banner and the sizes of an array file, checking that it can be loaded with IT
+template<typename IT>
+static int mm_read_dense_header(mm_reader &r, bool is_bmtx, MM_typecode *matcode, uint64_t *nrows, uint64_t *ncols,
+                                Matrix_Metadata *meta) {
+  double t = mm_phase_begin();
+  int err = mm_read_banner(r, matcode, is_bmtx, meta);
+  mm_phase_end(MM_PHASE_BANNER, t);
+  if (err != 0) {
+    fprintf(stderr, "Could not process Matrix Market banner. Error (%d)\n", err);
+    return err;
+  }
+  if (!mm_is_array(*matcode)) {
+    fprintf(stderr, "Not an array file, use the sparse read functions.\n");
+    return MM_UNSUPPORTED_TYPE;
+  }
+  if (!mm_is_real(*matcode) && !mm_is_integer(*matcode)) {
+    fprintf(stderr, "Only real and integer arrays are supported.\n");
+    return MM_UNSUPPORTED_TYPE;
+  }
+  if (mm_is_hermitian(*matcode)) {
+    fprintf(stderr, "Cannot parse hermitian matrices.\n");
+    return MM_UNSUPPORTED_TYPE;
+  }
+
+  t = mm_phase_begin();
+  err = mm_read_mtx_array_size(r, nrows, ncols);
+  mm_phase_end(MM_PHASE_SIZE_LINE, t);
+  if (err != 0) {
+    fprintf(stderr, "Could not parse matrix size.\n");
+    return err;
+  }
+  if ((mm_is_symmetric(*matcode) || mm_is_skew(*matcode)) && *nrows != *ncols) {
+    fprintf(stderr, "Symmetric arrays must be square.\n");
+    return MM_UNSUPPORTED_TYPE;
+  }
+  if (sizeof(IT) < (size_t)required_bytes_index(std::max(*nrows, *ncols))) {
+    fprintf(stderr, "Error: Index Type (IT) is too small to represent the matrix sizes.\n");
+    return MM_UNSUPPORTED_TYPE;
+  }
+  if (is_bmtx && mm_get_idx_bytes(*matcode) != MM_IDX_BYTES_NONE) {
+    fprintf(stderr, "Binary arrays have no indices, their header declares %d index bytes.\n", MM_IDX_BYTES_NONE);
+    return MM_UNSUPPORTED_TYPE;
+  }
+  if (is_bmtx && meta->sort_order != MM_SORT_ROW_MAJOR && meta->sort_order != MM_SORT_COL_MAJOR) {
+    fprintf(stderr, "Binary arrays are either row-major or col-major.\n");
+    return MM_UNSUPPORTED_TYPE;
+  }
+  mm_set_metadata(meta, matcode);
+  return 0;
+}
+
+template<typename IT, typename VT>
+Dense_local<IT, VT>* Distr_MMIO_Dense_local_create(IT nrows, IT ncols, bool row_major) {
+  Dense_local<IT, VT> *dense = (Dense_local<IT, VT> *)mm_alloc(sizeof(Dense_local<IT, VT>));
+  dense->nrows = nrows;
+  dense->ncols = ncols;
+  dense->row_major = row_major;
+  dense->val = (VT *)mm_alloc_aligned((uint64_t)nrows * ncols * sizeof(VT));
+  dense->mapping = NULL;
+  dense->mapping_bytes = 0;
+  return dense;
+}
+
+template<typename IT, typename VT>
+void Distr_MMIO_Dense_local_destroy(Dense_local<IT, VT> **dense) {
+  if (*dense != NULL) {
+    if ((*dense)->mapping != NULL) munmap((*dense)->mapping, (*dense)->mapping_bytes);
+    else mm_free_aligned((*dense)->val);
+    mm_free(*dense);
+    *dense = NULL;
+  }
+}
+
+template<typename IT, typename VT>
+Dense_local<IT, VT>* Distr_MMIO_Dense_local_read(const char *filename, bool row_major, Matrix_Metadata* meta) {
+  std::string fname(filename);
+  Distr_MMIO_Source src;
+  if (Distr_MMIO_source_file(filename, &src) != 0) return NULL;
+  Dense_local<IT, VT> *dense = Distr_MMIO_Dense_local_read_source<IT, VT>(&src, is_file_extension_bmtx(fname), row_major, meta);
+  Distr_MMIO_source_close(&src);
+  return dense;
+}
+
+template<typename IT, typename VT>
+Dense_local<IT, VT>* Distr_MMIO_Dense_local_read_source(Distr_MMIO_Source *src, bool is_bmtx, bool row_major, Matrix_Metadata* meta) {
+  Matrix_Metadata metadata2;
+  if (meta == NULL) meta = &metadata2;
+
+  mm_stats_begin();
+  mm_reader r(src);
+  MM_typecode matcode;
+  uint64_t nrows, ncols;
+  if (mm_read_dense_header<IT>(r, is_bmtx, &matcode, &nrows, &ncols, meta) != 0) {
+    mm_stats_end(0);
+    return NULL;
+  }
+
+  double t = mm_phase_begin();
+  Dense_local<IT, VT> *dense = Distr_MMIO_Dense_local_create<IT, VT>(nrows, ncols, row_major);
+  mm_phase_end(MM_PHASE_ASSEMBLY, t);
+  uint64_t count = nrows * ncols;
+  int err = 0;
+
+  if (!is_bmtx) {
+    mm_array_layout layout = {nrows, ncols, mm_is_symmetric(matcode) || mm_is_skew(matcode), mm_is_skew(matcode) ? 1UL : 0UL};
+    if (layout.skew) {
+      for (uint64_t i = 0; i < nrows; ++i) dense->val[mm_dense_offset(dense, i, i)] = static_cast<VT>(0);
+    }
+    uint64_t nvalues = mm_array_stored_values(matcode, nrows, ncols);
+    err = mm_read_text_windows(r, nvalues, [&](const char *w, const std::vector<uint64_t> &bounds, const std::vector<uint64_t> &first) {
+      int nthreads = bounds.size() - 1;
+      bool ok = true;
+      #pragma omp parallel for schedule(static) reduction(&&:ok)
+      for (int c = 0; c < nthreads; ++c) {
+        if (first[c] < nvalues)
+          ok = mm_parse_array_values(w + bounds[c], w + bounds[c + 1], dense, layout, first[c], std::min(first[c + 1], nvalues));
+      }
+      return ok ? 0 : MM_PREMATURE_EOF;
+    });
+  } else {
+    uint8_t val_bytes = mm_get_val_bytes(matcode);
+    MM_VAL_ENCODING val_enc = mm_get_val_encoding(matcode);
+    bool file_row_major = meta->sort_order == MM_SORT_ROW_MAJOR;
+    err = mm_is_valid_val_encoding(val_bytes, val_enc) ? r.skip(mm_dense_data_offset(r.position()) - r.position()) : MM_UNSUPPORTED_TYPE;
+    if (err == 0 && val_enc == MM_VAL_ENCODING_FLOAT && val_bytes == sizeof(VT) && file_row_major == row_major) {
+      t = mm_phase_begin();
+      err = r.read((uint8_t *)dense->val, count * sizeof(VT)); // Same layout and type: a plain (parallel) copy
+      mm_phase_end(MM_PHASE_DATA_IO, t);
+    } else if (err == 0) {
+      const uint8_t *data;
+      uint8_t *buffer;
+      t = mm_phase_begin();
+      err = r.view(count * val_bytes, &data, &buffer);
+      mm_phase_end(MM_PHASE_DATA_IO, t);
+      if (err == 0) {
+        t = mm_phase_begin();
+        uint64_t outer = file_row_major ? nrows : ncols, inner = file_row_major ? ncols : nrows;
+        #pragma omp parallel for schedule(static)
+        for (uint64_t a = 0; a < outer; ++a) {
+          for (uint64_t b = 0; b < inner; ++b) {
+            VT v;
+            if (mm_decode_val(data + (a * inner + b) * val_bytes, val_bytes, val_enc, &v) != 0) v = static_cast<VT>(0);
+            dense->val[file_row_major ? mm_dense_offset(dense, a, b) : mm_dense_offset(dense, b, a)] = v;
+          }
+        }
+        mm_phase_end(MM_PHASE_DECODE, t);
+        t = mm_phase_begin();
+        mm_free(buffer);
+        mm_phase_end(MM_PHASE_FREE, t);
+      }
+    }
+  }
+
+  if (err != 0) {
+    if (err != MM_CANCELLED) fprintf(stderr, "Could not parse matrix data (error code: %d).\n", err);
+    Distr_MMIO_Dense_local_destroy(&dense);
+    mm_stats_end(0);
+    return NULL;
+  }
+  mm_stats_end(count);
+  return dense;
+}
+
+template<typename IT, typename VT>
+Dense_local<IT, VT>* Distr_MMIO_Dense_local_map(const char *filename, Matrix_Metadata* meta) {
+  Matrix_Metadata metadata2;
+  if (meta == NULL) meta = &metadata2;
+
+  Distr_MMIO_Source src;
+  if (Distr_MMIO_source_mmap(filename, &src) != 0) return NULL;
+  MM_typecode matcode;
+  uint64_t nrows, ncols, data_offset = 0;
+  int err;
+  {
+    mm_reader r(&src);
+    err = mm_read_dense_header<IT>(r, true, &matcode, &nrows, &ncols, meta);
+    if (err == 0) data_offset = mm_dense_data_offset(r.position());
+  }
+  if (err == 0 && (mm_get_val_encoding(matcode) != MM_VAL_ENCODING_FLOAT || mm_get_val_bytes(matcode) != sizeof(VT))) {
+    fprintf(stderr, "Binary array stored with %hhu bytes values, it can only be mapped with the same type.\n", mm_get_val_bytes(matcode));
+    err = MM_UNSUPPORTED_TYPE;
+  }
+  if (err == 0 && (src.size < data_offset || src.size - data_offset < nrows * ncols * sizeof(VT))) err = MM_PREMATURE_EOF;
+  if (err != 0) {
+    Distr_MMIO_source_close(&src);
+    return NULL;
+  }
+
+  // Remapped privately, so that the matrix can be modified without changing the file
+  void *mapping = MAP_FAILED;
+  int fd = open(filename, O_RDONLY);
+  if (fd >= 0) {
+    mapping = mmap(NULL, src.size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+  }
+  uint64_t size = src.size;
+  Distr_MMIO_source_close(&src);
+  if (mapping == MAP_FAILED) {
+    fprintf(stderr, "Could not map %s.\n", filename);
+    return NULL;
+  }
+
+  Dense_local<IT, VT> *dense = (Dense_local<IT, VT> *)mm_alloc(sizeof(Dense_local<IT, VT>));
+  dense->nrows = static_cast<IT>(nrows);
+  dense->ncols = static_cast<IT>(ncols);
+  dense->row_major = meta->sort_order == MM_SORT_ROW_MAJOR;
+  dense->val = (VT *)((uint8_t *)mapping + data_offset);
+  dense->mapping = mapping;
+  dense->mapping_bytes = size;
+  return dense;
+}
+
+template<typename IT, typename VT>
+int Distr_MMIO_Dense_local_write(Dense_local<IT, VT>* dense, const char *filename, bool write_as_binary, Matrix_Metadata* meta) {
+  return Distr_MMIO_Dense_local_write_f(dense, open_file_w(filename), write_as_binary, meta);
+}
+
+// Prints the stored values [first, last) of a text array
+template<typename IT, typename VT>
+static void mm_encode_array_values(Dense_local<IT, VT> *dense, const mm_array_layout &layout, uint64_t first, uint64_t last,
+                                   Matrix_Metadata *meta, std::vector<char> &out) {
+  out.clear();
+  char line[64];
+  uint64_t i, j;
+  layout.position(first, &i, &j);
+  for (uint64_t k = first; k < last; ++k, layout.next(&i, &j)) {
+    VT v = dense->val[mm_dense_offset(dense, i, j)];
+    int len;
+    if (meta->val_type == MM_VAL_TYPE_INTEGER) len = snprintf(line, sizeof(line), "%ld\n", mm_saturate_cast<int64_t>(v));
+    else if (meta->val_bytes == 8) len = snprintf(line, sizeof(line), "%.16g\n", (double)v);
+    else len = snprintf(line, sizeof(line), "%.9g\n", (float)v);
+    out.insert(out.end(), line, line + len);
+  }
+}
+
+template<typename IT, typename VT>
+int Distr_MMIO_Dense_local_write_f(Dense_local<IT, VT>* dense, FILE *f, bool write_as_binary, Matrix_Metadata* meta) {
+  if (!f) return MM_COULD_NOT_WRITE_FILE;
+  Matrix_Metadata metadata2;
+  if (meta == NULL) {
+    metadata2.val_type = MM_VAL_TYPE_REAL;
+    metadata2.is_symmetric = false;
+    metadata2.val_bytes = sizeof(VT);
+    meta = &metadata2;
+  }
+  bool symmetric = meta->is_symmetric && !write_as_binary; // Binary files store every value
+  if (meta->val_type == MM_VAL_TYPE_PATTERN || (symmetric && dense->nrows != dense->ncols)) {
+    fprintf(stderr, "Dense matrices are written as real or integer, symmetric ones must be square.\n");
+    fclose(f);
+    return MM_UNSUPPORTED_TYPE;
+  }
+
+  mm_stats_begin();
+  double t = mm_phase_begin();
+  std::string header = "%%MatrixMarket matrix array ";
+  header += meta->val_type == MM_VAL_TYPE_INTEGER ? MM_INT_STR : MM_REAL_STR;
+  header += symmetric ? " " MM_SYMM_STR : " " MM_GENERAL_STR;
+  if (write_as_binary) {
+    header += " " + std::to_string(MM_IDX_BYTES_NONE) + " " + std::to_string(sizeof(VT)) + " " MM_VAL_ENC_FLOAT_STR " ";
+    header += dense->row_major ? MM_SORT_ROW_MAJOR_STR : MM_SORT_COL_MAJOR_STR;
+  }
+  fprintf(f, "%s\n", header.c_str());
+  std::string header_body = meta->mm_header_body;
+  while (!header_body.empty() && header_body.back() == '\n') header_body.pop_back();
+  if (!header_body.empty()) fprintf(f, "%s\n", header_body.c_str());
+  fprintf(f, "%lu %lu\n", (uint64_t)dense->nrows, (uint64_t)dense->ncols);
+  int err = write_as_binary ? mm_write_padded(f, NULL, 0) : 0;
+  mm_phase_end(MM_PHASE_BANNER, t);
+
+  uint64_t count = (uint64_t)dense->nrows * dense->ncols;
+  if (err == 0 && write_as_binary) {
+    t = mm_phase_begin();
+    for (uint64_t done = 0; done < count && err == 0;) {
+      if (!mm_progress(MM_PHASE_DATA_IO, done * sizeof(VT), count * sizeof(VT))) {
+        err = MM_CANCELLED;
+        break;
+      }
+      uint64_t n = std::min<uint64_t>(MM_IO_CHUNK_BYTES / sizeof(VT), count - done);
+      if (fwrite(dense->val + done, sizeof(VT), n, f) != n) err = MM_COULD_NOT_WRITE_FILE;
+      done += n;
+    }
+    mm_phase_end(MM_PHASE_DATA_IO, t);
+  } else if (err == 0) {
+    // Ranges of values printed in parallel one wave at a time and written in order
+    MM_typecode matcode;
+    mm_initialize_typecode(&matcode);
+    if (symmetric) mm_set_symmetric(&matcode);
+    mm_array_layout layout = {(uint64_t)dense->nrows, (uint64_t)dense->ncols, symmetric, 0};
+    uint64_t nvalues = mm_array_stored_values(matcode, dense->nrows, dense->ncols);
+    uint64_t nranges = (nvalues + MM_WRITE_RANGE_ENTRIES - 1) / MM_WRITE_RANGE_ENTRIES;
+    uint64_t wave = mm_max_threads();
+    std::vector<std::vector<char>> buffers(std::min(wave, nranges));
+    for (uint64_t first = 0; first < nranges && err == 0; first += wave) {
+      uint64_t last = std::min(nranges, first + wave);
+      if (!mm_progress(MM_PHASE_DATA_IO, first * MM_WRITE_RANGE_ENTRIES, nvalues)) {
+        err = MM_CANCELLED;
+        break;
+      }
+      t = mm_phase_begin();
+      #pragma omp parallel for schedule(dynamic, 1)
+      for (uint64_t i = first; i < last; ++i) {
+        mm_encode_array_values(dense, layout, i * MM_WRITE_RANGE_ENTRIES, std::min(nvalues, (i + 1) * MM_WRITE_RANGE_ENTRIES), meta, buffers[i - first]);
+      }
+      mm_phase_end(MM_PHASE_ENCODE, t);
+
+      t = mm_phase_begin();
+      for (uint64_t i = first; i < last && err == 0; ++i) {
+        std::vector<char> &buf = buffers[i - first];
+        if (!buf.empty() && fwrite(buf.data(), 1, buf.size(), f) != buf.size()) err = MM_COULD_NOT_WRITE_FILE;
+      }
+      mm_phase_end(MM_PHASE_DATA_IO, t);
+    }
+  }
+
+  mm_stats_bytes_written(f);
+  fclose(f);
+  mm_stats_end(err == 0 ? count : 0);
+  return err;
 }
 
 MMIO_EXPLICIT_TEMPLATE_INST(uint32_t, float)
@@ -850,3 +6360,9 @@ MMIO_EXPLICIT_TEMPLATE_INST(uint64_t, float)
 MMIO_EXPLICIT_TEMPLATE_INST(uint64_t, double)
 MMIO_EXPLICIT_TEMPLATE_INST(int, float)
 MMIO_EXPLICIT_TEMPLATE_INST(int, double)
+MMIO_EXPLICIT_TEMPLATE_INST(int64_t, float)
+MMIO_EXPLICIT_TEMPLATE_INST(int64_t, double)
+MMIO_EXPLICIT_TEMPLATE_INST_OT(uint16_t, float, uint32_t)
+MMIO_EXPLICIT_TEMPLATE_INST_OT(uint16_t, double, uint32_t)
+MMIO_EXPLICIT_TEMPLATE_INST_OT(uint32_t, float, uint64_t)
+MMIO_EXPLICIT_TEMPLATE_INST_OT(uint32_t, double, uint64_t)
@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <string.h>
+#include <glob.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "../include/mmio.h"
+#include "../include/mmio_batch.h"
+
+#define MMIO_BATCH_EXPLICIT_TEMPLATE_INST(IT, VT, OT) \
+  template std::vector<Distr_MMIO_Batch_Result<IT, VT, OT>> Distr_MMIO_CSR_local_read_batch(const std::vector<std::string>& filenames, \
+      const Distr_MMIO_Batch_Options* opts, std::type_identity_t<std::function<void(const Distr_MMIO_Batch_Result<IT, VT, OT>&)>> on_done);
+
+static bool is_matrix_file(const std::string &filename) {
+  return (filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".mtx") == 0) ||
+         is_file_extension_bmtx(filename) || is_file_extension_sbmtx(filename) || is_file_extension_cbmtx(filename);
+}
+
+std::vector<std::string> Distr_MMIO_list_matrix_files(const char *dir_or_glob) {
+  std::vector<std::string> files;
+  std::error_code ec;
+
+  if (std::filesystem::is_directory(dir_or_glob, ec)) {
+    for (auto it = std::filesystem::recursive_directory_iterator(dir_or_glob, ec);
+         it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+      if (ec) break;
+      if (it->is_regular_file(ec) && is_matrix_file(it->path().string())) files.push_back(it->path().string());
+    }
+  } else {
+    glob_t g;
+    if (glob(dir_or_glob, 0, NULL, &g) == 0) {
+      for (size_t i = 0; i < g.gl_pathc; ++i) {
+        if (is_matrix_file(g.gl_pathv[i])) files.push_back(g.gl_pathv[i]);
+      }
+    }
+    globfree(&g);
+  }
+
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+/*
+ * Upper bound of the memory used while reading a file as CSR (parsed entries plus the CSR arrays).
+ * Only the header is read.
+ */
+template<typename IT, typename VT, typename OT>
+static size_t estimate_csr_read_bytes(const std::string &filename) {
+  Matrix_Metadata meta;
+  if (Distr_MMIO_probe(filename.c_str(), &meta) != 0) return 0;
+  return meta.expanded_nnz * sizeof(Entry<IT, VT>) + Distr_MMIO_CSR_local_footprint<IT, VT, OT>(&meta, true);
+}
+
+/**
+ * Catalog
+ */
+
+#define MM_CATALOG_BANNER    "%%MatrixMarketCatalog v2"
+#define MM_CATALOG_BANNER_V1 "%%MatrixMarketCatalog v1" // Without the mtime nanoseconds
+
+static const char *val_type_str(MM_VAL_TYPE val_type) {
+  switch (val_type) {
+    case MM_VAL_TYPE_REAL:    return MM_REAL_STR;
+    case MM_VAL_TYPE_INTEGER: return MM_INT_STR;
+    default:                  return MM_PATTERN_STR;
+  }
+}
+
+int Distr_MMIO_read_catalog(const char *catalog_filename, std::vector<Distr_MMIO_Catalog_Entry> *entries) {
+  FILE *f = fopen(catalog_filename, "r");
+  if (!f) return MM_COULD_NOT_READ_FILE;
+
+  char line[MM_MAX_LINE_LENGTH + 4096];
+  bool v1 = false;
+  if (fgets(line, sizeof(line), f) == NULL || (strncmp(line, MM_CATALOG_BANNER, strlen(MM_CATALOG_BANNER)) != 0 &&
+                                               !(v1 = strncmp(line, MM_CATALOG_BANNER_V1, strlen(MM_CATALOG_BANNER_V1)) == 0))) {
+    fclose(f);
+    return MM_NO_HEADER;
+  }
+
+  // One tab separated line per matrix: path, file bytes, mtime (seconds, nanoseconds), nrows, ncols, nnz, expanded nnz,
+  // value type, symmetric, value bytes
+  while (fgets(line, sizeof(line), f)) {
+    char *tab = strchr(line, '\t');
+    if (tab == NULL) continue;
+    *tab = '\0';
+
+    Distr_MMIO_Catalog_Entry e;
+    char val_type[MM_MAX_TOKEN_LENGTH];
+    int is_symmetric;
+    unsigned val_bytes;
+    e.mtime_nsec = 0;
+    int ok = v1 ? sscanf(tab + 1, "%lu %ld %lu %lu %lu %lu %63s %d %u", &e.file_bytes, &e.mtime, &e.meta.nrows,
+                         &e.meta.ncols, &e.meta.nnz, &e.meta.expanded_nnz, val_type, &is_symmetric, &val_bytes) == 9
+                : sscanf(tab + 1, "%lu %ld %ld %lu %lu %lu %lu %63s %d %u", &e.file_bytes, &e.mtime, &e.mtime_nsec,
+                         &e.meta.nrows, &e.meta.ncols, &e.meta.nnz, &e.meta.expanded_nnz, val_type, &is_symmetric,
+                         &val_bytes) == 10;
+    if (!ok) {
+      fclose(f);
+      return MM_PREMATURE_EOF;
+    }
+    e.filename = line;
+    e.meta.val_type = strcmp(val_type, MM_REAL_STR) == 0 ? MM_VAL_TYPE_REAL :
+                      strcmp(val_type, MM_INT_STR) == 0  ? MM_VAL_TYPE_INTEGER : MM_VAL_TYPE_PATTERN;
+    e.meta.is_symmetric = is_symmetric != 0;
+    e.meta.val_bytes = (uint8_t)val_bytes;
+    entries->push_back(std::move(e));
+  }
+
+  fclose(f);
+  return 0;
+}
+
+int Distr_MMIO_write_catalog(const char *dir_or_glob, const char *catalog_filename) {
+  std::vector<std::string> files = Distr_MMIO_list_matrix_files(dir_or_glob);
+
+  std::vector<Distr_MMIO_Catalog_Entry> previous;
+  Distr_MMIO_read_catalog(catalog_filename, &previous); // Missing or invalid catalogs are rebuilt
+  std::unordered_map<std::string, const Distr_MMIO_Catalog_Entry *> by_name;
+  for (auto &e : previous) by_name[e.filename] = &e;
+
+  std::vector<Distr_MMIO_Catalog_Entry> entries(files.size());
+  std::vector<char> valid(files.size(), 0);
+  #pragma omp parallel for schedule(dynamic)
+  for (size_t i = 0; i < files.size(); ++i) {
+    struct stat st;
+    if (stat(files[i].c_str(), &st) != 0) continue;
+
+    auto it = by_name.find(files[i]);
+    if (it != by_name.end() && it->second->file_bytes == (uint64_t)st.st_size && it->second->mtime == (int64_t)st.st_mtim.tv_sec &&
+        it->second->mtime_nsec == (int64_t)st.st_mtim.tv_nsec) {
+      entries[i] = *it->second;
+      valid[i] = 1;
+      continue;
+    }
+    entries[i].filename = files[i];
+    entries[i].file_bytes = st.st_size;
+    entries[i].mtime = st.st_mtim.tv_sec;
+    entries[i].mtime_nsec = st.st_mtim.tv_nsec;
+    entries[i].meta.val_bytes = 0;
+    valid[i] = Distr_MMIO_probe(files[i].c_str(), &entries[i].meta) == 0;
+  }
+
+  // Written next to the catalog and renamed over it, so that readers never see a partial catalog
+  struct stat st;
+  std::string tmp_filename;
+  int tmp_fd = mm_create_temp(catalog_filename, stat(catalog_filename, &st) == 0 ? st.st_mode & 07777 : 0644, &tmp_filename);
+  FILE *f = tmp_fd >= 0 ? fdopen(tmp_fd, "w") : NULL;
+  if (!f) {
+    if (tmp_fd >= 0) {
+      close(tmp_fd);
+      unlink(tmp_filename.c_str());
+    }
+    fprintf(stderr, "Could not open file [%s] (write).\n", catalog_filename);
+    return MM_COULD_NOT_WRITE_FILE;
+  }
+  fprintf(f, "%s\n", MM_CATALOG_BANNER);
+  for (size_t i = 0; i < files.size(); ++i) {
+    if (!valid[i]) continue;
+    const Distr_MMIO_Catalog_Entry &e = entries[i];
+    fprintf(f, "%s\t%lu\t%ld\t%ld\t%lu\t%lu\t%lu\t%lu\t%s\t%d\t%u\n", e.filename.c_str(), e.file_bytes, e.mtime,
+            e.mtime_nsec, e.meta.nrows, e.meta.ncols, e.meta.nnz, e.meta.expanded_nnz, val_type_str(e.meta.val_type),
+            e.meta.is_symmetric ? 1 : 0, (unsigned)e.meta.val_bytes);
+  }
+  int err = fflush(f) == 0 && !ferror(f) ? mm_replace_file(tmp_fd, tmp_filename, catalog_filename) : MM_COULD_NOT_WRITE_FILE;
+  if (err != 0) unlink(tmp_filename.c_str());
+  fclose(f);
+  return err;
+}
+
+namespace {
+
+struct Batch_Job {
+  std::vector<size_t> files; // Indices in the input list
+  size_t bytes;              // Memory budget needed, 0 for small files
+};
+
+// Tracks the memory used by the loads in flight
+class Memory_Budget {
+public:
+  explicit Memory_Budget(size_t budget) : budget(budget), used(0) {}
+
+  void acquire(size_t bytes) {
+    if (budget == 0 || bytes == 0) return;
+    std::unique_lock<std::mutex> lock(mtx);
+    // A load larger than the whole budget runs alone
+    cv.wait(lock, [&] { return used == 0 || used + bytes <= budget; });
+    used += bytes;
+  }
+
+  void release(size_t bytes) {
+    if (budget == 0 || bytes == 0) return;
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      used -= bytes;
+    }
+    cv.notify_all();
+  }
+
+private:
+  size_t budget, used;
+  std::mutex mtx;
+  std::condition_variable cv;
+};
+
+} // namespace
+
+template<typename IT, typename VT, typename OT>
+std::vector<Distr_MMIO_Batch_Result<IT, VT, OT>> Distr_MMIO_CSR_local_read_batch(const std::vector<std::string>& filenames,
+    const Distr_MMIO_Batch_Options* opts, std::type_identity_t<std::function<void(const Distr_MMIO_Batch_Result<IT, VT, OT>&)>> on_done) {
+  Distr_MMIO_Batch_Options default_opts;
+  if (opts == NULL) opts = &default_opts;
+
+  // Sort by file size (largest first), so long loads do not end up last
+  std::vector<std::pair<size_t, size_t>> sizes(filenames.size());
+  for (size_t i = 0; i < filenames.size(); ++i) {
+    struct stat st;
+    sizes[i] = {stat(filenames[i].c_str(), &st) == 0 ? (size_t)st.st_size : 0, i};
+  }
+  std::sort(sizes.begin(), sizes.end(), [](auto &a, auto &b) { return a.first > b.first; });
+
+  std::vector<Batch_Job> jobs;
+  for (size_t i = 0; i < sizes.size(); ++i) {
+    if (sizes[i].first >= MM_BATCH_SMALL_FILE_BYTES) {
+      jobs.push_back({{sizes[i].second}, estimate_csr_read_bytes<IT, VT, OT>(filenames[sizes[i].second])});
+    } else {
+      if (jobs.empty() || jobs.back().bytes != 0 || jobs.back().files.size() >= MM_BATCH_SMALL_GROUP_SIZE)
+        jobs.push_back({{}, 0});
+      jobs.back().files.push_back(sizes[i].second);
+    }
+  }
+
+  unsigned n_threads = opts->n_threads > 0 ? opts->n_threads : std::max(1u, std::thread::hardware_concurrency());
+  n_threads = std::min<size_t>(n_threads, std::max<size_t>(1, jobs.size()));
+  [[maybe_unused]] int inner_threads = 1;
+#ifdef _OPENMP
+  inner_threads = std::max(1, omp_get_max_threads() / (int)n_threads);
+#endif
+
+  std::vector<Distr_MMIO_Batch_Result<IT, VT, OT>> results;
+  results.reserve(filenames.size());
+  std::mutex results_mtx;
+  std::atomic<size_t> next_job(0);
+  Memory_Budget budget(opts->memory_budget);
+
+  auto worker = [&]() {
+#ifdef _OPENMP
+    int caller_threads = omp_get_max_threads(); // worker() also runs on the calling thread
+    omp_set_num_threads(inner_threads);
+#endif
+    Distr_MMIO_Stats *caller_stats = Distr_MMIO_get_stats();
+    for (size_t j = next_job++; j < jobs.size(); j = next_job++) {
+      budget.acquire(jobs[j].bytes);
+      for (size_t i : jobs[j].files) {
+        Distr_MMIO_Batch_Result<IT, VT, OT> res;
+        res.filename = filenames[i];
+        Distr_MMIO_set_stats(&res.stats);
+        res.csr = Distr_MMIO_CSR_local_read<IT, VT, OT>(filenames[i].c_str(), opts->expl_val_for_bin_mtx, &res.meta);
+        res.err = res.csr != NULL ? 0 : Distr_MMIO_last_error();
+        if (res.csr == NULL && res.err == 0) res.err = MM_COULD_NOT_READ_FILE;
+
+        std::lock_guard<std::mutex> lock(results_mtx);
+        if (on_done) on_done(res);
+        results.push_back(std::move(res));
+      }
+      budget.release(jobs[j].bytes);
+    }
+    Distr_MMIO_set_stats(caller_stats);
+#ifdef _OPENMP
+    omp_set_num_threads(caller_threads);
+#endif
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < n_threads; ++t) pool.emplace_back(worker);
+  worker();
+  for (auto &t : pool) t.join();
+
+  return results;
+}
+
+MMIO_BATCH_EXPLICIT_TEMPLATE_INST(uint32_t, float, uint32_t)
+MMIO_BATCH_EXPLICIT_TEMPLATE_INST(uint32_t, double, uint32_t)
+MMIO_BATCH_EXPLICIT_TEMPLATE_INST(uint64_t, float, uint64_t)
+MMIO_BATCH_EXPLICIT_TEMPLATE_INST(uint64_t, double, uint64_t)
+MMIO_BATCH_EXPLICIT_TEMPLATE_INST(int, float, int)
+MMIO_BATCH_EXPLICIT_TEMPLATE_INST(int, double, int)
+MMIO_BATCH_EXPLICIT_TEMPLATE_INST(int64_t, float, int64_t)
+MMIO_BATCH_EXPLICIT_TEMPLATE_INST(int64_t, double, int64_t)
+MMIO_BATCH_EXPLICIT_TEMPLATE_INST(uint16_t, float, uint32_t)
+MMIO_BATCH_EXPLICIT_TEMPLATE_INST(uint16_t, double, uint32_t)
+MMIO_BATCH_EXPLICIT_TEMPLATE_INST(uint32_t, float, uint64_t)
+MMIO_BATCH_EXPLICIT_TEMPLATE_INST(uint32_t, double, uint64_t)
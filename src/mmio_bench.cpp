@@ -0,0 +1,466 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "../include/mmio.h"
+
+/*
+ * Benchmark harness: generates synthetic matrices, writes them in every format and measures
+ * write, read and convert throughput for the instantiated (IT, VT, OT) combinations at several thread counts.
+ */
+
+enum Generator
+{
+  GEN_ER,      // Erdos-Renyi, uniform random entries
+  GEN_RMAT,    // R-MAT / Kronecker power-law
+  GEN_BAND,    // Banded, all entries within the half bandwidth
+  GEN_STENCIL, // 5-point 2D stencil
+  GEN_COUNT
+};
+
+static const char *gen_names[GEN_COUNT] = {"er", "rmat", "band", "stencil"};
+
+enum Format
+{
+  FMT_MTX,
+  FMT_BMTX,
+  FMT_SBMTX,
+  FMT_CBMTX,
+  FMT_COUNT
+};
+
+static const char *fmt_names[FMT_COUNT] = {"mtx", "bmtx", "sbmtx", "cbmtx"};
+
+struct Bench_Config
+{
+  std::vector<Generator> generators;
+  std::vector<uint64_t> sizes;   // Rows (and columns)
+  std::vector<int> symmetry;     // 0 general, 1 symmetric
+  std::vector<int> threads;
+  uint64_t degree = 8;           // Average entries per row
+  int repeats = 3;
+  uint64_t seed = 42;
+  bool json = false;
+  bool keep = false;
+  std::string dir = "/tmp/mmio_bench";
+  std::string out;
+};
+
+struct Bench_Matrix
+{
+  Generator gen;
+  bool symmetric;
+  COO_local<uint64_t, double> *coo; // Row-major sorted, both triangles for symmetric matrices
+};
+
+/**
+ * Generators
+ */
+
+static inline uint64_t splitmix64(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+static inline double to_unit(uint64_t x) {
+  return (x >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int compare_entries(const void *a, const void *b) {
+  const Entry<uint64_t, double> *ea = (const Entry<uint64_t, double> *)a, *eb = (const Entry<uint64_t, double> *)b;
+  if (ea->row != eb->row) return ea->row < eb->row ? -1 : 1;
+  if (ea->col != eb->col) return ea->col < eb->col ? -1 : 1;
+  return 0;
+}
+
+static void rmat_entry(uint64_t n, int scale, uint64_t seed, uint64_t *row, uint64_t *col) {
+  const double a = 0.57, b = 0.19, c = 0.19;
+  uint64_t r = 0, cl = 0;
+  for (int l = 0; l < scale; ++l) {
+    double p = to_unit(splitmix64(seed + l));
+    r <<= 1;
+    cl <<= 1;
+    if (p < a) {
+    } else if (p < a + b) {
+      cl |= 1;
+    } else if (p < a + b + c) {
+      r |= 1;
+    } else {
+      r |= 1;
+      cl |= 1;
+    }
+  }
+  *row = r % n;
+  *col = cl % n;
+}
+
+/*
+ * Entries are generated in parallel from a per-entry seed, so the matrix does not depend on the number of threads.
+ */
+static Bench_Matrix generate(Generator gen, uint64_t n, uint64_t degree, bool symmetric, uint64_t seed) {
+  std::vector<Entry<uint64_t, double>> entries;
+  uint64_t half_band = std::max<uint64_t>(1, degree / 2);
+  uint64_t side = (uint64_t)sqrt((double)n);
+
+  switch (gen) {
+    case GEN_ER:
+    case GEN_RMAT: {
+      int scale = 0;
+      while ((1ULL << scale) < n) ++scale;
+      entries.resize(n * degree);
+      #pragma omp parallel for schedule(static)
+      for (uint64_t i = 0; i < entries.size(); ++i) {
+        uint64_t s = splitmix64(seed ^ splitmix64(i));
+        if (gen == GEN_ER) {
+          entries[i].row = splitmix64(s) % n;
+          entries[i].col = splitmix64(s + 1) % n;
+        } else {
+          rmat_entry(n, scale, s, &entries[i].row, &entries[i].col);
+        }
+        entries[i].val = to_unit(splitmix64(s + 2));
+      }
+      break;
+    }
+    case GEN_BAND: {
+      entries.reserve(n * (2 * half_band + 1));
+      for (uint64_t i = 0; i < n; ++i) {
+        for (uint64_t j = i > half_band ? i - half_band : 0; j <= std::min(n - 1, i + half_band); ++j)
+          entries.push_back({i, j, to_unit(splitmix64(seed ^ splitmix64(i * n + j)))});
+      }
+      break;
+    }
+    case GEN_STENCIL: {
+      n = side * side;
+      entries.reserve(n * 5);
+      for (uint64_t i = 0; i < n; ++i) {
+        uint64_t x = i % side, y = i / side;
+        if (y > 0)        entries.push_back({i, i - side, -1.0});
+        if (x > 0)        entries.push_back({i, i - 1, -1.0});
+        entries.push_back({i, i, 4.0});
+        if (x + 1 < side) entries.push_back({i, i + 1, -1.0});
+        if (y + 1 < side) entries.push_back({i, i + side, -1.0});
+      }
+      break;
+    }
+    default: break;
+  }
+
+  if (symmetric) {
+    // Keep the lower triangle and mirror it
+    size_t kept = 0;
+    for (auto &e : entries) {
+      if (e.row >= e.col) entries[kept++] = e;
+    }
+    entries.resize(kept);
+    for (size_t i = 0; i < kept; ++i) {
+      if (entries[i].row != entries[i].col) entries.push_back({entries[i].col, entries[i].row, entries[i].val});
+    }
+  }
+
+  qsort(entries.data(), entries.size(), sizeof(Entry<uint64_t, double>), compare_entries);
+  auto last = std::unique(entries.begin(), entries.end(), [](auto &a, auto &b) { return a.row == b.row && a.col == b.col; });
+  entries.erase(last, entries.end());
+
+  COO_local<uint64_t, double> *coo = Distr_MMIO_COO_local_create<uint64_t, double>(n, n, entries.size(), true);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    coo->row[i] = entries[i].row;
+    coo->col[i] = entries[i].col;
+    coo->val[i] = entries[i].val;
+  }
+  return {gen, symmetric, coo};
+}
+
+/**
+ * Results
+ */
+
+struct Bench_Result
+{
+  const char *gen;
+  bool symmetric;
+  uint64_t nrows, nnz;
+  const char *format;
+  const char *op;
+  const char *it, *vt, *ot;
+  int threads, repeat;
+  bool ok;
+  Distr_MMIO_Stats stats;
+};
+
+static std::vector<Bench_Result> results;
+
+template<typename T> static const char *type_name();
+template<> const char *type_name<uint32_t>() { return "uint32_t"; }
+template<> const char *type_name<uint64_t>() { return "uint64_t"; }
+template<> const char *type_name<float>()    { return "float"; }
+template<> const char *type_name<double>()   { return "double"; }
+
+static void add_result(const Bench_Matrix &m, Format fmt, const char *op, const char *it, const char *vt, const char *ot,
+                       int threads, int repeat, bool ok, const Distr_MMIO_Stats &stats) {
+  results.push_back({gen_names[m.gen], m.symmetric, m.coo->nrows, m.coo->nnz, fmt_names[fmt], op, it, vt, ot, threads, repeat, ok, stats});
+}
+
+// Phase names as column/key names, e.g. "data I/O" -> "data_io"
+static std::string phase_key(int p) {
+  std::string key;
+  for (const char *c = Distr_MMIO_phase_name((MM_PHASE)p); *c; ++c) {
+    if (*c == ' ') key += '_';
+    else if (*c != '/') key += tolower(*c);
+  }
+  return key;
+}
+
+static void print_results(FILE *f, bool json) {
+  if (json) {
+    fprintf(f, "[\n");
+  } else {
+    fprintf(f, "generator,symmetric,nrows,nnz,format,op,it,vt,ot,threads,repeat,ok,seconds,bytes_read,bytes_written,peak_bytes,gb_per_s,entries_per_s");
+    for (int p = 0; p < MM_PHASE_COUNT; ++p) fprintf(f, ",%s", phase_key(p).c_str());
+    fprintf(f, "\n");
+  }
+
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Bench_Result &r = results[i];
+    const Distr_MMIO_Stats &s = r.stats;
+    if (json) {
+      fprintf(f, "  {\"generator\": \"%s\", \"symmetric\": %s, \"nrows\": %lu, \"nnz\": %lu, \"format\": \"%s\", \"op\": \"%s\", "
+                 "\"it\": \"%s\", \"vt\": \"%s\", \"ot\": \"%s\", \"threads\": %d, \"repeat\": %d, \"ok\": %s, \"seconds\": %.9f, "
+                 "\"bytes_read\": %lu, \"bytes_written\": %lu, \"peak_bytes\": %lu, \"gb_per_s\": %.6f, \"entries_per_s\": %.3f, \"phases\": {",
+              r.gen, r.symmetric ? "true" : "false", r.nrows, r.nnz, r.format, r.op, r.it, r.vt, r.ot, r.threads, r.repeat,
+              r.ok ? "true" : "false", s.total_seconds, s.bytes_read, s.bytes_written, s.peak_bytes_allocated, s.gb_per_s, s.entries_per_s);
+      for (int p = 0; p < MM_PHASE_COUNT; ++p)
+        fprintf(f, "%s\"%s\": %.9f", p > 0 ? ", " : "", phase_key(p).c_str(), s.phase_seconds[p]);
+      fprintf(f, "}}%s\n", i + 1 < results.size() ? "," : "");
+    } else {
+      fprintf(f, "%s,%d,%lu,%lu,%s,%s,%s,%s,%s,%d,%d,%d,%.9f,%lu,%lu,%lu,%.6f,%.3f", r.gen, r.symmetric ? 1 : 0, r.nrows, r.nnz,
+              r.format, r.op, r.it, r.vt, r.ot, r.threads, r.repeat, r.ok ? 1 : 0, s.total_seconds, s.bytes_read, s.bytes_written,
+              s.peak_bytes_allocated, s.gb_per_s, s.entries_per_s);
+      for (int p = 0; p < MM_PHASE_COUNT; ++p) fprintf(f, ",%.9f", s.phase_seconds[p]);
+      fprintf(f, "\n");
+    }
+  }
+
+  if (json) fprintf(f, "]\n");
+}
+
+/**
+ * Runs
+ */
+
+static Matrix_Metadata write_metadata(bool symmetric, uint8_t val_bytes) {
+  Matrix_Metadata meta;
+  meta.val_type = MM_VAL_TYPE_REAL;
+  meta.is_symmetric = symmetric;
+  meta.val_bytes = val_bytes;
+  return meta;
+}
+
+template<typename IT, typename VT, typename OT>
+static int write_format(COO_local<IT, VT, OT> *coo, Format fmt, const std::string &filename, bool symmetric) {
+  Matrix_Metadata meta = write_metadata(symmetric, sizeof(VT));
+  switch (fmt) {
+    case FMT_MTX:   return Distr_MMIO_COO_local_write(coo, filename.c_str(), false, &meta);
+    case FMT_BMTX:  return Distr_MMIO_COO_local_write(coo, filename.c_str(), true, &meta);
+    case FMT_SBMTX: return Distr_MMIO_sorted_COO_local_write(coo, filename.c_str(), true, &meta);
+    case FMT_CBMTX: return Distr_MMIO_compressed_COO_local_write(coo, filename.c_str(), &meta);
+    default:        return MM_UNSUPPORTED_TYPE;
+  }
+}
+
+template<typename IT, typename VT, typename OT>
+static void run_pair(const Bench_Config &cfg, const Bench_Matrix &m, const std::string &basename) {
+  const char *it = type_name<IT>(), *vt = type_name<VT>(), *ot = type_name<OT>();
+  if (sizeof(IT) < (size_t)required_bytes_index(m.coo->nrows) || m.coo->nnz > (uint64_t)std::numeric_limits<OT>::max()) return;
+
+  COO_local<IT, VT, OT> *coo = Distr_MMIO_COO_local_create<IT, VT, OT>(m.coo->nrows, m.coo->ncols, m.coo->nnz, true);
+  for (OT i = 0; i < coo->nnz; ++i) {
+    coo->row[i] = m.coo->row[i];
+    coo->col[i] = m.coo->col[i];
+    coo->val[i] = m.coo->val[i];
+  }
+
+  Distr_MMIO_Stats stats;
+  Distr_MMIO_set_stats(&stats);
+  for (int threads : cfg.threads) {
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#endif
+    for (int rep = 0; rep < cfg.repeats; ++rep) {
+      for (int fmt = 0; fmt < FMT_COUNT; ++fmt) {
+        std::string filename = basename + "." + it + "_" + vt + "_" + ot + "." + fmt_names[fmt];
+
+        int err = write_format(coo, (Format)fmt, filename, m.symmetric);
+        add_result(m, (Format)fmt, "write", it, vt, ot, threads, rep, err == 0, stats);
+        if (err != 0) continue;
+
+        // Reads must keep the exact entry count, also when OT is wider than IT (e.g. more than UINT32_MAX entries
+        // with 32 bits indices)
+        CSR_local<IT, VT, OT> *csr = Distr_MMIO_CSR_local_read<IT, VT, OT>(filename.c_str());
+        add_result(m, (Format)fmt, "read_csr", it, vt, ot, threads, rep, csr != NULL && (uint64_t)csr->nnz == m.coo->nnz, stats);
+        Distr_MMIO_CSR_local_destroy(&csr);
+
+        COO_local<IT, VT, OT> *read = Distr_MMIO_COO_local_read<IT, VT, OT>(filename.c_str());
+        add_result(m, (Format)fmt, "read_coo", it, vt, ot, threads, rep, read != NULL && (uint64_t)read->nnz == m.coo->nnz, stats);
+
+        // Conversion from text as done by mtx_to_bmtx (read stats plus write stats)
+        if (fmt == FMT_MTX && read != NULL) {
+          Distr_MMIO_Stats read_stats = stats;
+          err = write_format(read, FMT_BMTX, filename + ".conv.bmtx", m.symmetric);
+          for (int p = 0; p < MM_PHASE_COUNT; ++p) stats.phase_seconds[p] += read_stats.phase_seconds[p];
+          stats.total_seconds += read_stats.total_seconds;
+          stats.bytes_read = read_stats.bytes_read;
+          stats.peak_bytes_allocated = std::max(stats.peak_bytes_allocated, read_stats.peak_bytes_allocated);
+          stats.entries_per_s = stats.entries / stats.total_seconds;
+          stats.gb_per_s = (stats.bytes_read + stats.bytes_written) / stats.total_seconds / 1e9;
+          add_result(m, (Format)fmt, "convert", it, vt, ot, threads, rep, err == 0, stats);
+          if (!cfg.keep) remove((filename + ".conv.bmtx").c_str());
+        }
+        Distr_MMIO_COO_local_destroy(&read);
+
+        if (!cfg.keep) remove(filename.c_str());
+      }
+    }
+  }
+  Distr_MMIO_set_stats(NULL);
+
+  Distr_MMIO_COO_local_destroy(&coo);
+}
+
+/**
+ * Command line
+ */
+
+template<typename T>
+static std::vector<T> parse_list(const char *arg) {
+  std::vector<T> list;
+  std::string s(arg);
+  size_t start = 0;
+  while (start <= s.size()) {
+    size_t end = s.find(',', start);
+    if (end == std::string::npos) end = s.size();
+    std::string tok = s.substr(start, end - start);
+    if (!tok.empty()) {
+      // Sizes accept K, M and G suffixes
+      char *suffix;
+      double v = strtod(tok.c_str(), &suffix);
+      if (*suffix == 'K' || *suffix == 'k') v *= 1e3;
+      if (*suffix == 'M' || *suffix == 'm') v *= 1e6;
+      if (*suffix == 'G' || *suffix == 'g') v *= 1e9;
+      list.push_back((T)v);
+    }
+    start = end + 1;
+  }
+  return list;
+}
+
+static void usage(const char *prog) {
+  printf("Usage: %s [options]\n", prog);
+  printf("  -g, --generators <list>  er,rmat,band,stencil (default: all)\n");
+  printf("  -n, --sizes <list>       Rows of the generated matrices, K/M/G suffixes allowed (default: 16K)\n");
+  printf("  -d, --degree <n>         Average entries per row (default: 8)\n");
+  printf("  -y, --symmetry <s>       general, symmetric or both (default: both)\n");
+  printf("  -t, --threads <list>     Thread counts (default: 1 and the maximum)\n");
+  printf("  -r, --repeats <n>        Repetitions of each measure (default: 3)\n");
+  printf("  -f, --format <f>         Output format: csv or json (default: csv)\n");
+  printf("  -o, --output <file>      Output file (default: stdout)\n");
+  printf("      --dir <dir>          Directory for the generated files (default: /tmp/mmio_bench)\n");
+  printf("      --keep               Keep the generated files\n");
+  printf("      --seed <n>           Generators seed (default: 42)\n");
+}
+
+int main(int argc, char const *argv[]) {
+  Bench_Config cfg;
+  for (int arg_i = 1; arg_i < argc; ++arg_i) {
+    std::string flag = argv[arg_i];
+    bool has_value = arg_i + 1 < argc;
+    if ((flag == "-g" || flag == "--generators") && has_value) {
+      std::string list = argv[++arg_i];
+      for (int g = 0; g < GEN_COUNT; ++g) {
+        if (("," + list + ",").find("," + std::string(gen_names[g]) + ",") != std::string::npos) cfg.generators.push_back((Generator)g);
+      }
+    } else if ((flag == "-n" || flag == "--sizes") && has_value) {
+      cfg.sizes = parse_list<uint64_t>(argv[++arg_i]);
+    } else if ((flag == "-d" || flag == "--degree") && has_value) {
+      cfg.degree = strtoull(argv[++arg_i], NULL, 10);
+    } else if ((flag == "-y" || flag == "--symmetry") && has_value) {
+      std::string s = argv[++arg_i];
+      if (s == "general" || s == "both") cfg.symmetry.push_back(0);
+      if (s == "symmetric" || s == "both") cfg.symmetry.push_back(1);
+    } else if ((flag == "-t" || flag == "--threads") && has_value) {
+      cfg.threads = parse_list<int>(argv[++arg_i]);
+    } else if ((flag == "-r" || flag == "--repeats") && has_value) {
+      cfg.repeats = atoi(argv[++arg_i]);
+    } else if ((flag == "-f" || flag == "--format") && has_value) {
+      cfg.json = std::string(argv[++arg_i]) == "json";
+    } else if ((flag == "-o" || flag == "--output") && has_value) {
+      cfg.out = argv[++arg_i];
+    } else if (flag == "--dir" && has_value) {
+      cfg.dir = argv[++arg_i];
+    } else if (flag == "--seed" && has_value) {
+      cfg.seed = strtoull(argv[++arg_i], NULL, 10);
+    } else if (flag == "--keep") {
+      cfg.keep = true;
+    } else {
+      usage(argv[0]);
+      return flag == "-h" || flag == "--help" ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+
+  if (cfg.generators.empty()) cfg.generators = {GEN_ER, GEN_RMAT, GEN_BAND, GEN_STENCIL};
+  if (cfg.sizes.empty()) cfg.sizes = {1UL << 14};
+  if (cfg.symmetry.empty()) cfg.symmetry = {0, 1};
+  if (cfg.threads.empty()) {
+    cfg.threads = {1};
+#ifdef _OPENMP
+    if (omp_get_max_threads() > 1) cfg.threads.push_back(omp_get_max_threads());
+#endif
+  }
+
+  std::error_code ec;
+  std::filesystem::create_directories(cfg.dir, ec);
+  if (ec) {
+    fprintf(stderr, "Could not create directory [%s].\n", cfg.dir.c_str());
+    return EXIT_FAILURE;
+  }
+
+  for (uint64_t n : cfg.sizes) {
+    for (Generator gen : cfg.generators) {
+      for (int sym : cfg.symmetry) {
+        Bench_Matrix m = generate(gen, n, cfg.degree, sym != 0, cfg.seed);
+        fprintf(stderr, "Benchmarking %s%s: %lu rows, %lu entries\n", gen_names[gen], sym ? " (symmetric)" : "", m.coo->nrows, m.coo->nnz);
+
+        std::string basename = cfg.dir + "/" + gen_names[gen] + (sym ? "_sym_" : "_") + std::to_string(n);
+        run_pair<uint32_t, float, uint32_t>(cfg, m, basename);
+        run_pair<uint32_t, double, uint32_t>(cfg, m, basename);
+        run_pair<uint64_t, float, uint64_t>(cfg, m, basename);
+        run_pair<uint64_t, double, uint64_t>(cfg, m, basename);
+        run_pair<uint32_t, float, uint64_t>(cfg, m, basename);
+        run_pair<uint32_t, double, uint64_t>(cfg, m, basename);
+
+        Distr_MMIO_COO_local_destroy(&m.coo);
+      }
+    }
+  }
+
+  FILE *f = cfg.out.empty() ? stdout : fopen(cfg.out.c_str(), "w");
+  if (f == NULL) {
+    fprintf(stderr, "Could not open file [%s] (write).\n", cfg.out.c_str());
+    return EXIT_FAILURE;
+  }
+  print_results(f, cfg.json);
+  if (f != stdout) fclose(f);
+
+  return 0;
+}
@@ -1,4 +1,11 @@
+#include <string>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "mmio.h"           // Original C++ library header
+#include "mmio_batch.h"
 #include "mmio_c_wrapper.h" // Our new C API header
 
 // The entire file provides C-linkage, so we wrap it in extern "C".
@@ -111,4 +118,300 @@ void mmio_destroy_coo_u64_f64(mmio_coo_u64_f64_t* matrix) {
     Distr_MMIO_COO_local_destroy(&cpp_coo);
 }
 
-} // extern "C"
\ No newline at end of file
+/*
+ * ============================================================================
+ * Implementations for uint64_t offsets / uint32_t / float
+ * ============================================================================
+ */
+mmio_csr_u64_u32_f32_t* mmio_read_csr_u64_u32_f32(const char* filename, bool alloc_val) {
+    CSR_local<uint32_t, float, uint64_t>* cpp_csr = Distr_MMIO_CSR_local_read<uint32_t, float, uint64_t>(filename, alloc_val, NULL);
+    return reinterpret_cast<mmio_csr_u64_u32_f32_t*>(cpp_csr);
+}
+
+mmio_coo_u64_u32_f32_t* mmio_read_coo_u64_u32_f32(const char* filename, bool alloc_val) {
+    COO_local<uint32_t, float, uint64_t>* cpp_coo = Distr_MMIO_COO_local_read<uint32_t, float, uint64_t>(filename, alloc_val, NULL);
+    return reinterpret_cast<mmio_coo_u64_u32_f32_t*>(cpp_coo);
+}
+
+void mmio_destroy_csr_u64_u32_f32(mmio_csr_u64_u32_f32_t* matrix) {
+    CSR_local<uint32_t, float, uint64_t>* cpp_csr = reinterpret_cast<CSR_local<uint32_t, float, uint64_t>*>(matrix);
+    Distr_MMIO_CSR_local_destroy(&cpp_csr);
+}
+
+void mmio_destroy_coo_u64_u32_f32(mmio_coo_u64_u32_f32_t* matrix) {
+    COO_local<uint32_t, float, uint64_t>* cpp_coo = reinterpret_cast<COO_local<uint32_t, float, uint64_t>*>(matrix);
+    Distr_MMIO_COO_local_destroy(&cpp_coo);
+}
+
+
+/*
+ * ============================================================================
+ * Implementations for uint64_t offsets / uint32_t / double
+ * ============================================================================
+ */
+mmio_csr_u64_u32_f64_t* mmio_read_csr_u64_u32_f64(const char* filename, bool alloc_val) {
+    CSR_local<uint32_t, double, uint64_t>* cpp_csr = Distr_MMIO_CSR_local_read<uint32_t, double, uint64_t>(filename, alloc_val, NULL);
+    return reinterpret_cast<mmio_csr_u64_u32_f64_t*>(cpp_csr);
+}
+
+mmio_coo_u64_u32_f64_t* mmio_read_coo_u64_u32_f64(const char* filename, bool alloc_val) {
+    COO_local<uint32_t, double, uint64_t>* cpp_coo = Distr_MMIO_COO_local_read<uint32_t, double, uint64_t>(filename, alloc_val, NULL);
+    return reinterpret_cast<mmio_coo_u64_u32_f64_t*>(cpp_coo);
+}
+
+void mmio_destroy_csr_u64_u32_f64(mmio_csr_u64_u32_f64_t* matrix) {
+    CSR_local<uint32_t, double, uint64_t>* cpp_csr = reinterpret_cast<CSR_local<uint32_t, double, uint64_t>*>(matrix);
+    Distr_MMIO_CSR_local_destroy(&cpp_csr);
+}
+
+void mmio_destroy_coo_u64_u32_f64(mmio_coo_u64_u32_f64_t* matrix) {
+    COO_local<uint32_t, double, uint64_t>* cpp_coo = reinterpret_cast<COO_local<uint32_t, double, uint64_t>*>(matrix);
+    Distr_MMIO_COO_local_destroy(&cpp_coo);
+}
+
+} // extern "C"
+
+
+/*
+ * ============================================================================
+ * Options based API
+ * ============================================================================
+ */
+
+static_assert(MMIO_VAL_REAL == (int)MM_VAL_TYPE_REAL && MMIO_VAL_INTEGER == (int)MM_VAL_TYPE_INTEGER &&
+              MMIO_VAL_PATTERN == (int)MM_VAL_TYPE_PATTERN, "mmio_val_type_t must mirror MM_VAL_TYPE");
+
+struct mmio_batch {
+    std::vector<std::string> filenames;
+    size_t next;
+    mmio_options_t opts;
+};
+
+namespace {
+
+const mmio_options_t* options_or_defaults(const mmio_options_t* opts, mmio_options_t* defaults) {
+    if (opts != NULL) return opts;
+    mmio_options_init(defaults);
+    return defaults;
+}
+
+// Installs the thread count and the allocator of the options for the lifetime of a call (on the calling thread only)
+class Call_Scope {
+public:
+    explicit Call_Scope(const mmio_options_t* opts) {
+#ifdef _OPENMP
+        prev_threads = omp_get_max_threads();
+        if (opts->n_threads > 0) omp_set_num_threads(opts->n_threads);
+#endif
+        set_allocator = opts->alloc != NULL && opts->free != NULL;
+        if (set_allocator) {
+            allocator = {opts->alloc, opts->free, opts->alloc_ctx, false};
+            prev_allocator = Distr_MMIO_set_thread_allocator(&allocator);
+        }
+    }
+
+    ~Call_Scope() {
+#ifdef _OPENMP
+        omp_set_num_threads(prev_threads);
+#endif
+        if (set_allocator) Distr_MMIO_set_thread_allocator(prev_allocator);
+    }
+
+private:
+    int prev_threads = 1;
+    bool set_allocator;
+    Distr_MMIO_Allocator allocator;
+    const Distr_MMIO_Allocator* prev_allocator;
+};
+
+mmio_format_t resolve_format(const char* filename, const mmio_options_t* opts) {
+    if (opts->format != MMIO_FORMAT_AUTO) return opts->format;
+    std::string fname(filename);
+    if (is_file_extension_cbmtx(fname)) return MMIO_FORMAT_CBMTX;
+    if (is_file_extension_bmtx(fname) || is_file_extension_sbmtx(fname)) return MMIO_FORMAT_BMTX;
+    return MMIO_FORMAT_MTX;
+}
+
+void to_c_metadata(const Matrix_Metadata& cpp_meta, mmio_metadata_t* meta) {
+    meta->val_type = (mmio_val_type_t)cpp_meta.val_type;
+    meta->is_symmetric = cpp_meta.is_symmetric;
+    meta->val_bytes = cpp_meta.val_bytes;
+    meta->nrows = cpp_meta.nrows;
+    meta->ncols = cpp_meta.ncols;
+    meta->nnz = cpp_meta.nnz;
+    meta->expanded_nnz = cpp_meta.expanded_nnz;
+    meta->is_array = cpp_meta.is_array;
+}
+
+// Without metadata matrices are written as real and general, with values as wide as VT
+template <typename VT>
+Matrix_Metadata from_c_metadata(const mmio_metadata_t* meta) {
+    Matrix_Metadata cpp_meta;
+    cpp_meta.val_type = meta != NULL ? (MM_VAL_TYPE)meta->val_type : MM_VAL_TYPE_REAL;
+    cpp_meta.is_symmetric = meta != NULL && meta->is_symmetric;
+    cpp_meta.val_bytes = meta != NULL && meta->val_bytes > 0 ? meta->val_bytes : sizeof(VT);
+    return cpp_meta;
+}
+
+template <typename Matrix>
+Matrix* read_matrix(const char* filename, const mmio_options_t* opts, mmio_metadata_t* meta,
+                    Matrix* (*read_source)(Distr_MMIO_Source*, bool, bool, Matrix_Metadata*)) {
+    mmio_options_t defaults;
+    opts = options_or_defaults(opts, &defaults);
+    Call_Scope scope(opts);
+
+    Distr_MMIO_Source src;
+    int err = opts->use_mmap ? Distr_MMIO_source_mmap(filename, &src) : Distr_MMIO_source_file(filename, &src);
+    if (err != 0) return NULL;
+    Matrix_Metadata cpp_meta;
+    cpp_meta.val_bytes = 0; // Only set for binary files
+    Matrix* matrix = read_source(&src, resolve_format(filename, opts) != MMIO_FORMAT_MTX, opts->alloc_val, &cpp_meta);
+    Distr_MMIO_source_close(&src);
+    if (matrix != NULL && meta != NULL) {
+        cpp_meta.nrows = matrix->nrows;
+        cpp_meta.ncols = matrix->ncols;
+        cpp_meta.nnz = cpp_meta.expanded_nnz = matrix->nnz;
+        to_c_metadata(cpp_meta, meta);
+    }
+    return matrix;
+}
+
+template <typename IT, typename VT, typename OT>
+CSR_local<IT, VT, OT>* read_csr(const char* filename, const mmio_options_t* opts, mmio_metadata_t* meta) {
+    return read_matrix<CSR_local<IT, VT, OT>>(filename, opts, meta, [](Distr_MMIO_Source* src, bool is_bmtx, bool alloc_val, Matrix_Metadata* m) {
+        return Distr_MMIO_CSR_local_read_source<IT, VT, OT>(src, is_bmtx, alloc_val, m);
+    });
+}
+
+template <typename IT, typename VT, typename OT>
+COO_local<IT, VT, OT>* read_coo(const char* filename, const mmio_options_t* opts, mmio_metadata_t* meta) {
+    return read_matrix<COO_local<IT, VT, OT>>(filename, opts, meta, [](Distr_MMIO_Source* src, bool is_bmtx, bool alloc_val, Matrix_Metadata* m) {
+        return Distr_MMIO_COO_local_read_source<IT, VT, OT>(src, is_bmtx, alloc_val, m);
+    });
+}
+
+template <typename IT, typename VT, typename OT>
+int write_csr(const CSR_local<IT, VT, OT>* csr, const char* filename, const mmio_options_t* opts, const mmio_metadata_t* meta) {
+    mmio_options_t defaults;
+    opts = options_or_defaults(opts, &defaults);
+    Call_Scope scope(opts);
+    mmio_format_t format = resolve_format(filename, opts);
+    if (format == MMIO_FORMAT_CBMTX) return MMIO_UNSUPPORTED_TYPE; // Block-compressed files are written from COO matrices
+    Matrix_Metadata cpp_meta = from_c_metadata<VT>(meta);
+    return Distr_MMIO_CSR_local_write(const_cast<CSR_local<IT, VT, OT>*>(csr), filename, format == MMIO_FORMAT_BMTX,
+                                      opts->symmetric_triangle, &cpp_meta);
+}
+
+template <typename IT, typename VT, typename OT>
+int write_coo(const COO_local<IT, VT, OT>* coo, const char* filename, const mmio_options_t* opts, const mmio_metadata_t* meta) {
+    mmio_options_t defaults;
+    opts = options_or_defaults(opts, &defaults);
+    Call_Scope scope(opts);
+    Matrix_Metadata cpp_meta = from_c_metadata<VT>(meta);
+    // COO writers store one triangle of symmetric matrices, otherwise every entry is written as general
+    cpp_meta.is_symmetric = cpp_meta.is_symmetric && opts->symmetric_triangle;
+    COO_local<IT, VT, OT>* m = const_cast<COO_local<IT, VT, OT>*>(coo);
+    switch (resolve_format(filename, opts)) {
+        case MMIO_FORMAT_CBMTX: return Distr_MMIO_compressed_COO_local_write(m, filename, &cpp_meta);
+        case MMIO_FORMAT_BMTX:  return Distr_MMIO_COO_local_write(m, filename, true, &cpp_meta);
+        default:                return Distr_MMIO_COO_local_write(m, filename, false, &cpp_meta);
+    }
+}
+
+// Reads the next file of the batch (skipped if it cannot be read, the error of the read is returned)
+template <typename Matrix, typename Read>
+int batch_next(mmio_batch_t* batch, Matrix** matrix, mmio_metadata_t* meta, Read read) {
+    *matrix = NULL;
+    if (batch == NULL || batch->next >= batch->filenames.size()) return MMIO_END;
+    const std::string& filename = batch->filenames[batch->next++];
+    *matrix = read(filename.c_str(), &batch->opts, meta);
+    if (*matrix != NULL) return MMIO_OK;
+    int err = Distr_MMIO_last_error();
+    return err != 0 ? err : MMIO_COULD_NOT_READ_FILE;
+}
+
+template <typename Matrix, typename Destroy>
+void destroy_with(Matrix* matrix, const mmio_options_t* opts, Destroy destroy) {
+    mmio_options_t defaults;
+    Call_Scope scope(options_or_defaults(opts, &defaults));
+    destroy(&matrix);
+}
+
+} // namespace
+
+extern "C" {
+
+void mmio_options_init(mmio_options_t* opts) {
+    opts->n_threads = 0;
+    opts->format = MMIO_FORMAT_AUTO;
+    opts->alloc_val = false;
+    opts->symmetric_triangle = false;
+    opts->use_mmap = false;
+    opts->alloc = NULL;
+    opts->free = NULL;
+    opts->alloc_ctx = NULL;
+}
+
+int mmio_probe(const char* filename, mmio_metadata_t* meta) {
+    Matrix_Metadata cpp_meta;
+    cpp_meta.val_bytes = 0; // Only set for binary files
+    int err = Distr_MMIO_probe(filename, &cpp_meta);
+    if (err == 0 && meta != NULL) to_c_metadata(cpp_meta, meta);
+    return err;
+}
+
+mmio_batch_t* mmio_batch_open(const char* dir_or_glob, const mmio_options_t* opts) {
+    mmio_batch_t* batch = new mmio_batch_t;
+    batch->filenames = Distr_MMIO_list_matrix_files(dir_or_glob);
+    batch->next = 0;
+    if (opts != NULL) batch->opts = *opts;
+    else mmio_options_init(&batch->opts);
+    return batch;
+}
+
+size_t mmio_batch_count(const mmio_batch_t* batch) {
+    return batch->filenames.size();
+}
+
+const char* mmio_batch_filename(const mmio_batch_t* batch) {
+    return batch->next > 0 ? batch->filenames[batch->next - 1].c_str() : NULL;
+}
+
+void mmio_batch_close(mmio_batch_t* batch) {
+    delete batch;
+}
+
+#define MMIO_C_OPTIONS_API(SUFFIX, IT, VT, OT) \
+    mmio_csr_##SUFFIX##_t* mmio_read_csr_##SUFFIX##_ex(const char* filename, const mmio_options_t* opts, mmio_metadata_t* meta) { \
+        return reinterpret_cast<mmio_csr_##SUFFIX##_t*>(read_csr<IT, VT, OT>(filename, opts, meta)); \
+    } \
+    mmio_coo_##SUFFIX##_t* mmio_read_coo_##SUFFIX##_ex(const char* filename, const mmio_options_t* opts, mmio_metadata_t* meta) { \
+        return reinterpret_cast<mmio_coo_##SUFFIX##_t*>(read_coo<IT, VT, OT>(filename, opts, meta)); \
+    } \
+    int mmio_write_csr_##SUFFIX(const mmio_csr_##SUFFIX##_t* matrix, const char* filename, const mmio_options_t* opts, const mmio_metadata_t* meta) { \
+        return write_csr(reinterpret_cast<const CSR_local<IT, VT, OT>*>(matrix), filename, opts, meta); \
+    } \
+    int mmio_write_coo_##SUFFIX(const mmio_coo_##SUFFIX##_t* matrix, const char* filename, const mmio_options_t* opts, const mmio_metadata_t* meta) { \
+        return write_coo(reinterpret_cast<const COO_local<IT, VT, OT>*>(matrix), filename, opts, meta); \
+    } \
+    int mmio_batch_next_csr_##SUFFIX(mmio_batch_t* batch, mmio_csr_##SUFFIX##_t** matrix, mmio_metadata_t* meta) { \
+        return batch_next(batch, matrix, meta, mmio_read_csr_##SUFFIX##_ex); \
+    } \
+    int mmio_batch_next_coo_##SUFFIX(mmio_batch_t* batch, mmio_coo_##SUFFIX##_t** matrix, mmio_metadata_t* meta) { \
+        return batch_next(batch, matrix, meta, mmio_read_coo_##SUFFIX##_ex); \
+    } \
+    void mmio_destroy_csr_##SUFFIX##_ex(mmio_csr_##SUFFIX##_t* matrix, const mmio_options_t* opts) { \
+        destroy_with(reinterpret_cast<CSR_local<IT, VT, OT>*>(matrix), opts, Distr_MMIO_CSR_local_destroy<IT, VT, OT>); \
+    } \
+    void mmio_destroy_coo_##SUFFIX##_ex(mmio_coo_##SUFFIX##_t* matrix, const mmio_options_t* opts) { \
+        destroy_with(reinterpret_cast<COO_local<IT, VT, OT>*>(matrix), opts, Distr_MMIO_COO_local_destroy<IT, VT, OT>); \
+    }
+
+MMIO_C_OPTIONS_API(u32_f32, uint32_t, float, uint32_t)
+MMIO_C_OPTIONS_API(u32_f64, uint32_t, double, uint32_t)
+MMIO_C_OPTIONS_API(u64_f32, uint64_t, float, uint64_t)
+MMIO_C_OPTIONS_API(u64_f64, uint64_t, double, uint64_t)
+MMIO_C_OPTIONS_API(u64_u32_f32, uint32_t, float, uint64_t)
+MMIO_C_OPTIONS_API(u64_u32_f64, uint32_t, double, uint64_t)
+
+} // extern "C"
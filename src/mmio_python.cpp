@@ -0,0 +1,302 @@
+// CPython extension module behind python/distributed_mmio. It only depends on the Python headers: the arrays of the
+// matrices are exported through the buffer protocol and wrapped by NumPy/SciPy on the Python side, without copies.
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <stdint.h>
+#include <string>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "../include/mmio.h"
+
+/********************* Arrays owned by the library ***************************/
+
+// One array of a matrix: keeps the matrix (a capsule that destroys it) alive for as long as it or its views exist
+typedef struct {
+  PyObject_HEAD
+  PyObject *owner;
+  void *data;
+  Py_ssize_t shape;
+  Py_ssize_t itemsize;
+  const char *format;
+} mm_py_array;
+
+static int mm_py_array_getbuffer(PyObject *self, Py_buffer *view, int flags) {
+  mm_py_array *a = (mm_py_array*)self;
+  view->obj = Py_NewRef(self);
+  view->buf = a->data;
+  view->len = a->shape * a->itemsize;
+  view->readonly = 0;
+  view->itemsize = a->itemsize;
+  view->format = (flags & PyBUF_FORMAT) ? (char*)a->format : NULL;
+  view->ndim = 1;
+  view->shape = (flags & PyBUF_ND) ? &a->shape : NULL;
+  view->strides = (flags & PyBUF_STRIDES) ? &a->itemsize : NULL;
+  view->suboffsets = NULL;
+  view->internal = NULL;
+  return 0;
+}
+
+static void mm_py_array_dealloc(PyObject *self) {
+  Py_XDECREF(((mm_py_array*)self)->owner);
+  Py_TYPE(self)->tp_free(self);
+}
+
+static Py_ssize_t mm_py_array_len(PyObject *self) {
+  return ((mm_py_array*)self)->shape;
+}
+
+// Zero-initialized, the slots are set by name in PyInit__distributed_mmio
+static PyBufferProcs mm_py_array_as_buffer;
+static PySequenceMethods mm_py_array_as_sequence;
+static PyTypeObject mm_py_array_type;
+
+static PyObject* mm_py_array_new(PyObject *owner, void *data, Py_ssize_t shape, Py_ssize_t itemsize, const char *format) {
+  if (data == NULL) Py_RETURN_NONE; // Values of pattern matrices read without alloc_val
+  mm_py_array *a = PyObject_New(mm_py_array, &mm_py_array_type);
+  if (a == NULL) return NULL;
+  a->owner = Py_NewRef(owner);
+  a->data = data;
+  a->shape = shape;
+  a->itemsize = itemsize;
+  a->format = format;
+  return (PyObject*)a;
+}
+
+template<typename T> const char* mm_py_format();
+template<> const char* mm_py_format<int>() { return "i"; }
+template<> const char* mm_py_format<int64_t>() { return "q"; }
+template<> const char* mm_py_format<float>() { return "f"; }
+template<> const char* mm_py_format<double>() { return "d"; }
+
+/********************* Calls into the library ***************************/
+
+// Releases the GIL and sets the OpenMP threads (n_threads > 0) for the duration of a call
+class mm_py_call {
+public:
+  explicit mm_py_call(int n_threads) {
+#ifdef _OPENMP
+    prev_threads = omp_get_max_threads();
+    if (n_threads > 0) omp_set_num_threads(n_threads);
+#endif
+    state = PyEval_SaveThread();
+  }
+  ~mm_py_call() {
+    PyEval_RestoreThread(state);
+#ifdef _OPENMP
+    omp_set_num_threads(prev_threads);
+#endif
+  }
+private:
+  PyThreadState *state;
+  int prev_threads = 1;
+};
+
+// binary: -1 from the file extension, 0 text, 1 BMTX, 2 block-compressed CBMTX
+static bool mm_py_is_binary(const std::string &filename, int binary) {
+  if (binary >= 0) return binary != 0;
+  return is_file_extension_bmtx(filename) || is_file_extension_sbmtx(filename) || is_file_extension_cbmtx(filename);
+}
+
+static bool mm_py_is_compressed(const std::string &filename, int binary) {
+  return binary == 2 || (binary < 0 && is_file_extension_cbmtx(filename));
+}
+
+static PyObject* mm_py_metadata(const Matrix_Metadata &meta) {
+  static const char *val_types[] = {"real", "integer", "pattern"};
+  return Py_BuildValue("{s:s,s:O,s:i,s:K,s:K,s:K,s:K,s:O}",
+                       "val_type", val_types[meta.val_type], "symmetric", meta.is_symmetric ? Py_True : Py_False,
+                       "val_bytes", (int)meta.val_bytes, "nrows", (unsigned long long)meta.nrows,
+                       "ncols", (unsigned long long)meta.ncols, "nnz", (unsigned long long)meta.nnz,
+                       "expanded_nnz", (unsigned long long)meta.expanded_nnz, "array", meta.is_array ? Py_True : Py_False);
+}
+
+template<typename IT, typename VT>
+static void mm_py_destroy_csr(PyObject *capsule) {
+  CSR_local<IT, VT> *csr = (CSR_local<IT, VT>*)PyCapsule_GetPointer(capsule, NULL);
+  Distr_MMIO_CSR_local_destroy(&csr);
+}
+
+template<typename IT, typename VT>
+static void mm_py_destroy_coo(PyObject *capsule) {
+  COO_local<IT, VT> *coo = (COO_local<IT, VT>*)PyCapsule_GetPointer(capsule, NULL);
+  Distr_MMIO_COO_local_destroy(&coo);
+}
+
+// Returns (nrows, ncols, (indptr, indices, data)) for CSR and (nrows, ncols, (row, col, data)) for COO
+template<typename IT, typename VT>
+static PyObject* mm_py_read(bool csr_format, const char *filename, int binary, bool use_mmap, int n_threads) {
+  Distr_MMIO_Source src;
+  bool is_bmtx = mm_py_is_binary(filename, binary);
+  Matrix_Metadata meta;
+  CSR_local<IT, VT> *csr = NULL;
+  COO_local<IT, VT> *coo = NULL;
+  {
+    mm_py_call call(n_threads);
+    if ((use_mmap ? Distr_MMIO_source_mmap(filename, &src) : Distr_MMIO_source_file(filename, &src)) == 0) {
+      // Pattern matrices get explicit values, SciPy matrices always have data
+      if (csr_format) csr = Distr_MMIO_CSR_local_read_source<IT, VT>(&src, is_bmtx, true, &meta);
+      else coo = Distr_MMIO_COO_local_read_source<IT, VT>(&src, is_bmtx, true, &meta);
+      Distr_MMIO_source_close(&src);
+    }
+  }
+  if (csr == NULL && coo == NULL) return PyErr_Format(PyExc_OSError, "Could not read %s", filename);
+
+  PyObject *owner = csr != NULL ? PyCapsule_New(csr, NULL, mm_py_destroy_csr<IT, VT>)
+                                : PyCapsule_New(coo, NULL, mm_py_destroy_coo<IT, VT>);
+  if (owner == NULL) {
+    if (csr != NULL) Distr_MMIO_CSR_local_destroy(&csr);
+    else Distr_MMIO_COO_local_destroy(&coo);
+    return NULL;
+  }
+  const char *ifmt = mm_py_format<IT>(), *vfmt = mm_py_format<VT>();
+  PyObject *arrays = csr != NULL
+    ? Py_BuildValue("(NNN)", mm_py_array_new(owner, csr->row_ptr, (Py_ssize_t)csr->nrows + 1, sizeof(IT), ifmt),
+                    mm_py_array_new(owner, csr->col_idx, (Py_ssize_t)csr->nnz, sizeof(IT), ifmt),
+                    mm_py_array_new(owner, csr->val, (Py_ssize_t)csr->nnz, sizeof(VT), vfmt))
+    : Py_BuildValue("(NNN)", mm_py_array_new(owner, coo->row, (Py_ssize_t)coo->nnz, sizeof(IT), ifmt),
+                    mm_py_array_new(owner, coo->col, (Py_ssize_t)coo->nnz, sizeof(IT), ifmt),
+                    mm_py_array_new(owner, coo->val, (Py_ssize_t)coo->nnz, sizeof(VT), vfmt));
+  Py_DECREF(owner); // Now owned by the arrays
+  if (arrays == NULL) return NULL;
+  long long nrows = csr != NULL ? csr->nrows : coo->nrows, ncols = csr != NULL ? csr->ncols : coo->ncols;
+  return Py_BuildValue("(LLN)", nrows, ncols, arrays);
+}
+
+// The arrays are written in place: CSR_local/COO_local only point to the buffers
+template<typename IT, typename VT>
+static int mm_py_write(bool csr_format, const char *filename, long long nrows, long long ncols, Py_buffer *a0,
+                       Py_buffer *a1, Py_buffer *vals, int binary, bool symmetric, Matrix_Metadata *meta, int n_threads) {
+  mm_py_call call(n_threads);
+  bool is_bmtx = mm_py_is_binary(filename, binary);
+  if (csr_format) {
+    if (mm_py_is_compressed(filename, binary)) return MM_UNSUPPORTED_TYPE; // Block-compressed files are written from COO
+    CSR_local<IT, VT> csr = {(IT)nrows, (IT)ncols, (IT)(a1->len / a1->itemsize), (IT*)a0->buf, (IT*)a1->buf,
+                             vals != NULL ? (VT*)vals->buf : NULL};
+    return Distr_MMIO_CSR_local_write(&csr, filename, is_bmtx, symmetric, meta);
+  }
+  COO_local<IT, VT> coo = {(IT)nrows, (IT)ncols, (IT)(a0->len / a0->itemsize), (IT*)a0->buf, (IT*)a1->buf,
+                           vals != NULL ? (VT*)vals->buf : NULL};
+  if (mm_py_is_compressed(filename, binary)) return Distr_MMIO_compressed_COO_local_write(&coo, filename, meta);
+  return Distr_MMIO_COO_local_write(&coo, filename, is_bmtx, meta);
+}
+
+/********************* Module functions ***************************/
+
+static bool mm_py_parse_format(const char *format, bool *csr_format) {
+  std::string f(format);
+  if (f != "csr" && f != "coo") {
+    PyErr_Format(PyExc_ValueError, "Unknown format '%s' (expected 'csr' or 'coo')", format);
+    return false;
+  }
+  *csr_format = f == "csr";
+  return true;
+}
+
+static PyObject* mm_py_read_matrix(PyObject *Py_UNUSED(self), PyObject *args, PyObject *kwargs) {
+  static const char *kwlist[] = {"filename", "format", "index_type", "value_type", "binary", "mmap", "n_threads", NULL};
+  const char *filename, *format = "csr", *index_type = "i", *value_type = "d";
+  int binary = -1, use_mmap = 0, n_threads = 0;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|sssipi", (char**)kwlist, &filename, &format, &index_type,
+                                   &value_type, &binary, &use_mmap, &n_threads))
+    return NULL;
+  bool csr_format;
+  if (!mm_py_parse_format(format, &csr_format)) return NULL;
+  std::string it(index_type), vt(value_type);
+  if (it == "i" && vt == "f") return mm_py_read<int, float>(csr_format, filename, binary, use_mmap, n_threads);
+  if (it == "i" && vt == "d") return mm_py_read<int, double>(csr_format, filename, binary, use_mmap, n_threads);
+  if (it == "q" && vt == "f") return mm_py_read<int64_t, float>(csr_format, filename, binary, use_mmap, n_threads);
+  if (it == "q" && vt == "d") return mm_py_read<int64_t, double>(csr_format, filename, binary, use_mmap, n_threads);
+  return PyErr_Format(PyExc_ValueError, "Unsupported index/value types '%s'/'%s' (expected 'i' or 'q' and 'f' or 'd')",
+                      index_type, value_type);
+}
+
+static PyObject* mm_py_write_matrix(PyObject *Py_UNUSED(self), PyObject *args, PyObject *kwargs) {
+  static const char *kwlist[] = {"filename", "format", "nrows", "ncols", "a0", "a1", "data", "binary", "symmetric",
+                                 "val_type", "val_bytes", "n_threads", NULL};
+  const char *filename, *format, *val_type = "real";
+  long long nrows, ncols;
+  PyObject *data;
+  Py_buffer a0, a1, vals;
+  int binary = -1, symmetric = 0, val_bytes = 0, n_threads = 0;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "ssLLy*y*O|ipsii", (char**)kwlist, &filename, &format, &nrows, &ncols,
+                                   &a0, &a1, &data, &binary, &symmetric, &val_type, &val_bytes, &n_threads))
+    return NULL;
+  bool has_vals = data != Py_None;
+  if (has_vals && PyObject_GetBuffer(data, &vals, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0) {
+    PyBuffer_Release(&a0);
+    PyBuffer_Release(&a1);
+    return NULL;
+  }
+
+  bool csr_format;
+  Matrix_Metadata meta;
+  std::string vtype(val_type);
+  meta.val_type = vtype == "pattern" ? MM_VAL_TYPE_PATTERN : vtype == "integer" ? MM_VAL_TYPE_INTEGER : MM_VAL_TYPE_REAL;
+  meta.is_symmetric = symmetric;
+  int vsize = has_vals ? (int)vals.itemsize : 8;
+  meta.val_bytes = val_bytes > 0 ? val_bytes : vsize;
+  int err = -1;
+  if (mm_py_parse_format(format, &csr_format)) {
+    Py_buffer *v = has_vals ? &vals : NULL;
+    if (a0.itemsize == 4 && a1.itemsize == 4 && vsize == 4)
+      err = mm_py_write<int, float>(csr_format, filename, nrows, ncols, &a0, &a1, v, binary, symmetric, &meta, n_threads);
+    else if (a0.itemsize == 4 && a1.itemsize == 4 && vsize == 8)
+      err = mm_py_write<int, double>(csr_format, filename, nrows, ncols, &a0, &a1, v, binary, symmetric, &meta, n_threads);
+    else if (a0.itemsize == 8 && a1.itemsize == 8 && vsize == 4)
+      err = mm_py_write<int64_t, float>(csr_format, filename, nrows, ncols, &a0, &a1, v, binary, symmetric, &meta, n_threads);
+    else if (a0.itemsize == 8 && a1.itemsize == 8 && vsize == 8)
+      err = mm_py_write<int64_t, double>(csr_format, filename, nrows, ncols, &a0, &a1, v, binary, symmetric, &meta, n_threads);
+    else
+      PyErr_SetString(PyExc_ValueError, "Indices must be both int32 or both int64, values float32 or float64");
+  }
+  PyBuffer_Release(&a0);
+  PyBuffer_Release(&a1);
+  if (has_vals) PyBuffer_Release(&vals);
+  if (err < 0) return NULL;
+  if (err != 0) return PyErr_Format(PyExc_OSError, "Could not write %s (error code: %d)", filename, err);
+  Py_RETURN_NONE;
+}
+
+static PyObject* mm_py_probe(PyObject *Py_UNUSED(self), PyObject *args) {
+  const char *filename;
+  if (!PyArg_ParseTuple(args, "s", &filename)) return NULL;
+  Matrix_Metadata meta;
+  meta.val_bytes = 0; // Only set for binary files
+  int err = Distr_MMIO_probe(filename, &meta);
+  if (err != 0) return PyErr_Format(PyExc_OSError, "Could not probe %s (error code: %d)", filename, err);
+  return mm_py_metadata(meta);
+}
+
+static PyMethodDef mm_py_methods[] = {
+  {"read", (PyCFunction)(void(*)(void))mm_py_read_matrix, METH_VARARGS | METH_KEYWORDS,
+   "read(filename, format='csr', index_type='i', value_type='d', binary=-1, mmap=False, n_threads=0)\n"
+   "Returns (nrows, ncols, arrays) with the arrays of the matrix exported through the buffer protocol."},
+  {"write", (PyCFunction)(void(*)(void))mm_py_write_matrix, METH_VARARGS | METH_KEYWORDS,
+   "write(filename, format, nrows, ncols, a0, a1, data, binary=-1, symmetric=False, val_type='real', val_bytes=0, n_threads=0)"},
+  {"probe", mm_py_probe, METH_VARARGS, "probe(filename) -> dict with the metadata of the header."},
+  {NULL, NULL, 0, NULL}
+};
+
+static struct PyModuleDef mm_py_module = {
+  PyModuleDef_HEAD_INIT, "_distributed_mmio", "Native part of the distributed_mmio Python bindings.", -1, mm_py_methods,
+  NULL, NULL, NULL, NULL,
+};
+
+PyMODINIT_FUNC PyInit__distributed_mmio(void) {
+  static const PyVarObject head = {PyObject_HEAD_INIT(NULL) 0};
+  mm_py_array_type.ob_base = head;
+  mm_py_array_type.tp_name = "distributed_mmio._distributed_mmio.Array";
+  mm_py_array_type.tp_basicsize = sizeof(mm_py_array);
+  mm_py_array_type.tp_flags = Py_TPFLAGS_DEFAULT;
+  mm_py_array_type.tp_dealloc = mm_py_array_dealloc;
+  mm_py_array_as_buffer.bf_getbuffer = mm_py_array_getbuffer;
+  mm_py_array_as_sequence.sq_length = mm_py_array_len;
+  mm_py_array_type.tp_as_buffer = &mm_py_array_as_buffer;
+  mm_py_array_type.tp_as_sequence = &mm_py_array_as_sequence;
+  mm_py_array_type.tp_doc = "Array of a matrix allocated by the library, released with its last reference.";
+  if (PyType_Ready(&mm_py_array_type) < 0) return NULL;
+  return PyModule_Create(&mm_py_module);
+}
@@ -1,49 +1,61 @@
 #include <stdio.h>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include "../include/mmio.h"
 #include "../include/mmio_utils.h"
 
-#define MMIO_UTILS_EXPLICIT_TEMPLATE_INST(IT, VT) \
-  template void print_csr(CSR_local<IT, VT> *csr, std::string header); \
-  template void print_csr_as_dense<IT, VT>(CSR_local<IT, VT> *csr, std::string header); \
-  template void print_coo(COO_local<IT, VT> *coo, std::string header); \
+#define MMIO_UTILS_EXPLICIT_TEMPLATE_INST(IT, VT) MMIO_UTILS_EXPLICIT_TEMPLATE_INST_OT(IT, VT, IT)
 
-template<typename IT, typename VT>
-void print_csr(CSR_local<IT, VT> *csr, std::string header) {
+#define MMIO_UTILS_EXPLICIT_TEMPLATE_INST_OT(IT, VT, OT) \
+  template void print_csr(CSR_local<IT, VT, OT> *csr, std::string header); \
+  template void print_csr_as_dense<IT, VT, OT>(CSR_local<IT, VT, OT> *csr, std::string header); \
+  template void print_coo(COO_local<IT, VT, OT> *coo, std::string header); \
+
+// printf conversion of an integer type: signed or unsigned, long for 8 bytes
+template<typename T>
+static std::string print_fmt(const char *width) {
+  std::string fmt = width;
+  if constexpr (sizeof(T) == 8)
+    fmt += "l";
+  return fmt + (std::is_signed_v<T> ? "d" : "u");
+}
+
+template<typename IT, typename VT, typename OT>
+void print_csr(CSR_local<IT, VT, OT> *csr, std::string header) {
   if (header != "") {
     printf("%s -- ", header.c_str());
   }
-  std::string I_FMT = "%3u";
-  if constexpr (std::is_same<IT, uint64_t>::value)
-    I_FMT = "%3lu";
+  std::string I_FMT = print_fmt<IT>("%3");
+  std::string O_FMT = print_fmt<OT>("%3");
 
-  char fmt[100];
-  snprintf(fmt, 100, "Matrix %s x %s (%s non-zeros)\n", I_FMT.c_str(), I_FMT.c_str(), I_FMT.c_str());
+  char fmt[100], ofmt[100];
+  snprintf(fmt, 100, "Matrix %s x %s (%s non-zeros)\n", I_FMT.c_str(), I_FMT.c_str(), O_FMT.c_str());
   printf(fmt, csr->nrows, csr->ncols, csr->nnz);
 
   snprintf(fmt, 100, "%s ", I_FMT.c_str());
+  snprintf(ofmt, 100, "%s ", O_FMT.c_str());
   printf("idx   : ");
-  for (IT i = 0; i < csr->nnz; ++i) printf(fmt, i);
+  for (OT i = 0; i < csr->nnz; ++i) printf(ofmt, i);
   printf("\nrowptr: ");
-  for (IT i = 0; i <= csr->nrows; ++i) printf(fmt, csr->row_ptr[i]);
+  for (IT i = 0; i <= csr->nrows; ++i) printf(ofmt, csr->row_ptr[i]);
   printf("\ncolidx: ");
-  for (IT i = 0; i < csr->nnz; ++i) printf(fmt, csr->col_idx[i]);
+  for (OT i = 0; i < csr->nnz; ++i) printf(fmt, csr->col_idx[i]);
   if (csr->val != NULL) {
     printf("\nval:    ");
-    for (IT i = 0; i < csr->nnz; ++i) {
+    for (OT i = 0; i < csr->nnz; ++i) {
       printf("%.1f ", csr->val[i]); // TODO handle different VT
     }
   }
   printf("\n");
 }
 
-template<typename IT, typename VT>
-void print_csr_as_dense(CSR_local<IT, VT> *csr, std::string header) {
+template<typename IT, typename VT, typename OT>
+void print_csr_as_dense(CSR_local<IT, VT, OT> *csr, std::string header) {
   std::vector<std::vector<VT>> dense_matrix(csr->nrows, std::vector<VT>(csr->ncols, 0.0f));
   for (IT row = 0; row < csr->nrows; ++row) {
-    for (IT idx = csr->row_ptr[row]; idx < csr->row_ptr[row + 1]; ++idx) {
+    for (OT idx = csr->row_ptr[row]; idx < csr->row_ptr[row + 1]; ++idx) {
       IT col = csr->col_idx[idx];
       dense_matrix[row][col] = csr->val != NULL ? csr->val[idx] : 1.0f; // TODO handle different VT
     }
@@ -52,12 +64,12 @@ void print_csr_as_dense(CSR_local<IT, VT> *csr, std::string header) {
       printf("%s -- ", header.c_str());
   }
 
-  std::string I_FMT = "%3u";
-  if constexpr (std::is_same<IT, uint64_t>::value)
-    I_FMT = "%3lu";
+  std::string I_FMT = print_fmt<IT>("%3");
+
+  std::string O_FMT = print_fmt<OT>("%3");
 
   char fmt[100];
-  snprintf(fmt, 100, "Matrix %s x %s (%s non-zeros)\n", I_FMT.c_str(), I_FMT.c_str(), I_FMT.c_str());
+  snprintf(fmt, 100, "Matrix %s x %s (%s non-zeros)\n", I_FMT.c_str(), I_FMT.c_str(), O_FMT.c_str());
   printf(fmt, csr->nrows, csr->ncols, csr->nnz);
   
   for (IT row = 0; row < csr->nrows; ++row) {
@@ -71,30 +83,30 @@ void print_csr_as_dense(CSR_local<IT, VT> *csr, std::string header) {
   }
 }
 
-template<typename IT, typename VT>
-void print_coo(COO_local<IT, VT> *coo, std::string header) {
+template<typename IT, typename VT, typename OT>
+void print_coo(COO_local<IT, VT, OT> *coo, std::string header) {
   if (header != "") {
     printf("%s -- ", header.c_str());
   }
   
-  std::string I_FMT = "%4u";
-  if constexpr (std::is_same<IT, uint64_t>::value)
-    I_FMT = "%4lu";
+  std::string I_FMT = print_fmt<IT>("%4");
+  std::string O_FMT = print_fmt<OT>("%4");
 
-  char fmt[100];
-  snprintf(fmt, 100, "Matrix %s x %s (%s non-zeros)\n", I_FMT.c_str(), I_FMT.c_str(), I_FMT.c_str());
+  char fmt[100], ofmt[100];
+  snprintf(fmt, 100, "Matrix %s x %s (%s non-zeros)\n", I_FMT.c_str(), I_FMT.c_str(), O_FMT.c_str());
   printf(fmt, coo->nrows, coo->ncols, coo->nnz);
 
   snprintf(fmt, 100, "%s ", I_FMT.c_str());
+  snprintf(ofmt, 100, "%s ", O_FMT.c_str());
   printf("idx: ");
-  for (IT i = 0; i < coo->nnz; ++i) printf(fmt, i);
+  for (OT i = 0; i < coo->nnz; ++i) printf(ofmt, i);
   printf("\nrow: ");
-  for (IT i = 0; i < coo->nnz; ++i) printf(fmt, coo->row[i]);
+  for (OT i = 0; i < coo->nnz; ++i) printf(fmt, coo->row[i]);
   printf("\ncol: ");
-  for (IT i = 0; i < coo->nnz; ++i) printf(fmt, coo->col[i]);
+  for (OT i = 0; i < coo->nnz; ++i) printf(fmt, coo->col[i]);
   if (coo->val != NULL) {
     printf("\nval: ");
-    for (IT i = 0; i < coo->nnz; ++i) {
+    for (OT i = 0; i < coo->nnz; ++i) {
       printf("%4.1f ", coo->val[i]); // TODO handle different VT
     }
   }
@@ -104,7 +116,25 @@ void print_coo(COO_local<IT, VT> *coo, std::string header) {
 
 MMIO_UTILS_EXPLICIT_TEMPLATE_INST(int, float)
 MMIO_UTILS_EXPLICIT_TEMPLATE_INST(int, double)
+void print_stats(const Distr_MMIO_Stats *stats, std::string header) {
+  if (header != "") {
+    printf("%s -- ", header.c_str());
+  }
+  printf("%lu entries in %.3f ms (%d threads)\n", stats->entries, stats->total_seconds * 1e3, stats->threads);
+  for (int p = 0; p < MM_PHASE_COUNT; ++p) {
+    if (stats->phase_seconds[p] > 0) printf("  %-20s %10.3f ms\n", Distr_MMIO_phase_name((MM_PHASE)p), stats->phase_seconds[p] * 1e3);
+  }
+  printf("  read %lu bytes, written %lu bytes, peak allocated %lu bytes\n", stats->bytes_read, stats->bytes_written, stats->peak_bytes_allocated);
+  printf("  %.3f GB/s, %.3e entries/s\n", stats->gb_per_s, stats->entries_per_s);
+}
+
 MMIO_UTILS_EXPLICIT_TEMPLATE_INST(uint32_t, float)
 MMIO_UTILS_EXPLICIT_TEMPLATE_INST(uint32_t, double)
 MMIO_UTILS_EXPLICIT_TEMPLATE_INST(uint64_t, float)
-MMIO_UTILS_EXPLICIT_TEMPLATE_INST(uint64_t, double)
\ No newline at end of file
+MMIO_UTILS_EXPLICIT_TEMPLATE_INST(uint64_t, double)
+MMIO_UTILS_EXPLICIT_TEMPLATE_INST(int64_t, float)
+MMIO_UTILS_EXPLICIT_TEMPLATE_INST(int64_t, double)
+MMIO_UTILS_EXPLICIT_TEMPLATE_INST_OT(uint16_t, float, uint32_t)
+MMIO_UTILS_EXPLICIT_TEMPLATE_INST_OT(uint16_t, double, uint32_t)
+MMIO_UTILS_EXPLICIT_TEMPLATE_INST_OT(uint32_t, float, uint64_t)
+MMIO_UTILS_EXPLICIT_TEMPLATE_INST_OT(uint32_t, double, uint64_t)
\ No newline at end of file
@@ -28,18 +28,41 @@
 
 #define CPU_TIMER_CLOSE(name) CPU_TIMER_STOP(name) CPU_TIMER_PRINT(name)
 
+int compare_file_sizes(const std::string &filename, const std::string &out_filename);
+
+// Array files are converted through a dense matrix, binary ones store every value in column-major order
+template<typename VT>
+int convert_dense(const std::string &filename, const std::string &out_filename, bool to_bmtx, Matrix_Metadata *meta) {
+  CPU_TIMER_INIT(Dense_read)
+  Dense_local<uint64_t, VT> *dense = Distr_MMIO_Dense_local_read<uint64_t, VT>(filename.c_str(), false, meta);
+  CPU_TIMER_CLOSE(Dense_read)
+  if (dense == NULL) return MM_COULD_NOT_READ_FILE;
+  printf("Converting dense array to %s...\n", to_bmtx ? "BMTX" : "MTX");
+  meta->val_bytes = sizeof(VT);
+  CPU_TIMER_INIT(Conversion)
+  int err = Distr_MMIO_Dense_local_write(dense, out_filename.c_str(), to_bmtx, meta);
+  CPU_TIMER_CLOSE(Conversion)
+  Distr_MMIO_Dense_local_destroy(&dense);
+  return err;
+}
+
 int main(int argc, char const *argv[]) {
   if (argc < 2) {
     // printf("Usage: %s <filename> [-r|--reverse] [-d|--double-val]\n", argv[0]);
-    printf("Usage: %s <filename> [-d|--double-val]\n", argv[0]);
+    printf("Usage: %s <filename> [-d|--double-val] [-c|--compressed] [-k|--shards <K>] [-s|--stats] [-u|--undirected] [-b|--index-base <0|1>] [--skip-lines <N>]\n", argv[0]);
+    printf("Graph files (.txt, .tsv, .csv, .el, .edges, .snap edge lists and .graph, .metis METIS graphs) are converted too.\n");
     return EXIT_FAILURE;
   }
 
   std::string filename = argv[1];
   // bool reverse = false;
   bool double_val = false;
+  bool compressed = false;
+  bool print_phase_stats = false;
+  int nshards = 0;
+  Distr_MMIO_Graph_Options graph_opts;
 
-  uint32_t arg_i = 2;
+  int arg_i = 2;
   while (arg_i < argc) {    
     std::string flag = argv[arg_i];
     // if (flag == "-r" || flag == "--reverse") {
@@ -47,35 +70,104 @@ int main(int argc, char const *argv[]) {
     // } else
     if (flag == "-d" || flag == "--double-val") {
       double_val = true;
+    } else if (flag == "-c" || flag == "--compressed") {
+      compressed = true;
+    } else if (flag == "-s" || flag == "--stats") {
+      print_phase_stats = true;
+    } else if ((flag == "-k" || flag == "--shards") && arg_i + 1 < argc) {
+      nshards = atoi(argv[++arg_i]);
+    } else if (flag == "-u" || flag == "--undirected") {
+      graph_opts.undirected = true;
+    } else if ((flag == "-b" || flag == "--index-base") && arg_i + 1 < argc) {
+      graph_opts.index_base = atoi(argv[++arg_i]);
+    } else if (flag == "--skip-lines" && arg_i + 1 < argc) {
+      graph_opts.skip_lines = strtoull(argv[++arg_i], NULL, 10);
     } else {
       printf("Unknown option: %s\n", argv[arg_i]);
     }
+    ++arg_i;
   }
 
   Matrix_Metadata mtx_meta;
   mtx_meta.val_bytes = double_val ? 8 : 4;
-  CPU_TIMER_INIT(COO_read)
-  COO_local<uint64_t, double> *coo = Distr_MMIO_COO_local_read<uint64_t, double>(filename.c_str(), false, &mtx_meta);
-  CPU_TIMER_CLOSE(COO_read)
-  if (coo == NULL) {
-    fprintf(stderr, "Something went wrong\n");
-    exit(EXIT_FAILURE);
+  Distr_MMIO_Stats stats;
+  if (print_phase_stats) Distr_MMIO_set_stats(&stats);
+  bool is_graph = is_file_extension_graph(filename);
+
+  if (nshards > 0) {
+    // Shards are row ranges, so they are written from a CSR
+    CSR_local<uint64_t, double> *csr = is_graph ? Distr_MMIO_CSR_local_read_graph<uint64_t, double>(filename.c_str(), &graph_opts, false, &mtx_meta)
+                                                : Distr_MMIO_CSR_local_read<uint64_t, double>(filename.c_str(), false, &mtx_meta);
+    if (print_phase_stats) print_stats(&stats, "Read");
+    if (csr == NULL) {
+      fprintf(stderr, "Something went wrong\n");
+      exit(EXIT_FAILURE);
+    }
+    if (Distr_MMIO_narrow_val_encoding(csr, &mtx_meta)) {
+      const char *enc_names[] = {"float", "half", "bfloat16", "int"};
+      printf("Values can be stored without loss as %s using %hhu bytes\n", enc_names[mtx_meta.val_encoding], mtx_meta.val_bytes);
+    }
+    std::string manifest_filename = filename.substr(0, filename.find_last_of('.')) + ".shards";
+    CPU_TIMER_INIT(Sharding)
+    int err = Distr_MMIO_CSR_local_write_sharded(csr, manifest_filename.c_str(), nshards, &mtx_meta);
+    CPU_TIMER_CLOSE(Sharding)
+    if (print_phase_stats) print_stats(&stats, "Write");
+    Distr_MMIO_CSR_local_destroy(&csr);
+    if (err != 0) {
+      fprintf(stderr, "Could not write the shards (error code: %d)\n", err);
+      exit(EXIT_FAILURE);
+    }
+    printf("%d shards listed in %s\n", nshards, manifest_filename.c_str());
+    return 0;
   }
-
   std::string out_filename = filename;
   size_t last_dot = out_filename.find_last_of('.');
   if (last_dot != std::string::npos) {
     out_filename = out_filename.substr(0, last_dot);
   }
 
-  bool converting_to_bmtx = !is_file_extension_bmtx(filename);
+  bool converting_to_bmtx = !is_file_extension_bmtx(filename) && !is_file_extension_cbmtx(filename);
+
+  Matrix_Metadata probe_meta;
+  if (!is_graph && Distr_MMIO_probe(filename.c_str(), &probe_meta) == 0 && probe_meta.is_array) {
+    out_filename += converting_to_bmtx ? ".bmtx" : ".mtx";
+    int err = double_val ? convert_dense<double>(filename, out_filename, converting_to_bmtx, &mtx_meta)
+                         : convert_dense<float>(filename, out_filename, converting_to_bmtx, &mtx_meta);
+    if (print_phase_stats) print_stats(&stats, "Write");
+    if (err != 0) {
+      fprintf(stderr, "Something went wrong\n");
+      exit(EXIT_FAILURE);
+    }
+    printf("Dense array written to %s\n", out_filename.c_str());
+    return compare_file_sizes(filename, out_filename);
+  }
+
+  CPU_TIMER_INIT(COO_read)
+  COO_local<uint64_t, double> *coo = is_graph ? Distr_MMIO_COO_local_read_graph<uint64_t, double>(filename.c_str(), &graph_opts, false, &mtx_meta)
+                                              : Distr_MMIO_COO_local_read<uint64_t, double>(filename.c_str(), false, &mtx_meta);
+  CPU_TIMER_CLOSE(COO_read)
+  if (print_phase_stats) print_stats(&stats, "Read");
+  if (coo == NULL) {
+    fprintf(stderr, "Something went wrong\n");
+    exit(EXIT_FAILURE);
+  }
 
   // print_coo(coo);
   // if (!converting_to_bmtx) exit(0);
 
+  if (converting_to_bmtx && Distr_MMIO_narrow_val_encoding(coo, &mtx_meta)) {
+    const char *enc_names[] = {"float", "half", "bfloat16", "int"};
+    printf("Values can be stored without loss as %s using %hhu bytes\n", enc_names[mtx_meta.val_encoding], mtx_meta.val_bytes);
+  }
+
   CPU_TIMER_INIT(Conversion)
-  if (converting_to_bmtx) {
-    printf("Converting MTX file to BMTX...\n");
+  if (converting_to_bmtx && compressed) {
+    printf("Converting %s to CBMTX...\n", is_graph ? "graph" : "MTX file");
+    out_filename += ".cbmtx";
+    Distr_MMIO_compressed_COO_local_write(coo, out_filename.c_str(), &mtx_meta);
+    printf("CBMTX file written to %s\n", out_filename.c_str());
+  } else if (converting_to_bmtx) {
+    printf("Converting %s to BMTX...\n", is_graph ? "graph" : "MTX file");
     out_filename += ".bmtx";
     Distr_MMIO_COO_local_write(coo, out_filename.c_str(), true, &mtx_meta);
     printf("BMTX file written to %s\n", out_filename.c_str());
@@ -86,9 +178,14 @@ int main(int argc, char const *argv[]) {
     printf("MTX file written to %s\n", out_filename.c_str());
   }
   CPU_TIMER_CLOSE(Conversion)
+  if (print_phase_stats) print_stats(&stats, "Write");
 
   Distr_MMIO_COO_local_destroy(&coo);
 
+  return compare_file_sizes(filename, out_filename);
+}
+
+int compare_file_sizes(const std::string &filename, const std::string &out_filename) {
   // Compare file sizes of input and output files
   FILE *f_in = fopen(filename.c_str(), "rb");
   FILE *f_out = fopen(out_filename.c_str(), "rb");
@@ -31,13 +31,14 @@
 int main(int argc, char const *argv[]) {
   if (argc < 2) {
     // printf("Usage: %s <filename> [-r|--reverse] [-d|--double-val]\n", argv[0]);
-    printf("Usage: %s <filename> [-d|--double-val]\n", argv[0]);
+    printf("Usage: %s <filename> [-d|--double-val] [-o|--order row-major|col-major|morton|hilbert]\n", argv[0]);
     return EXIT_FAILURE;
   }
 
   std::string filename = argv[1];
   // bool reverse = false;
   bool double_val = false;
+  MM_SORT_ORDER order = MM_SORT_ROW_MAJOR;
 
   uint32_t arg_i = 2;
   while (arg_i < argc) {    
@@ -47,9 +48,17 @@ int main(int argc, char const *argv[]) {
     // } else
     if (flag == "-d" || flag == "--double-val") {
       double_val = true;
+    } else if ((flag == "-o" || flag == "--order") && arg_i + 1 < argc) {
+      std::string name = argv[++arg_i];
+      if (name == MM_SORT_ROW_MAJOR_STR) order = MM_SORT_ROW_MAJOR;
+      else if (name == MM_SORT_COL_MAJOR_STR) order = MM_SORT_COL_MAJOR;
+      else if (name == MM_SORT_MORTON_STR) order = MM_SORT_MORTON;
+      else if (name == MM_SORT_HILBERT_STR) order = MM_SORT_HILBERT;
+      else printf("Unknown order: %s\n", name.c_str());
     } else {
       printf("Unknown option: %s\n", argv[arg_i]);
     }
+    ++arg_i;
   }
 
   printf("May take huge amount of time");
@@ -57,7 +66,7 @@ int main(int argc, char const *argv[]) {
   Matrix_Metadata mtx_meta;
   mtx_meta.val_bytes = double_val ? 8 : 4;
   CPU_TIMER_INIT(COO_read)
-  COO_local<uint64_t, double> *coo = Distr_MMIO_sorted_COO_local_read<uint64_t, double>(filename.c_str(), false);
+  COO_local<uint64_t, double> *coo = Distr_MMIO_sorted_COO_local_read<uint64_t, double>(filename.c_str(), false, false, NULL, order);
   CPU_TIMER_CLOSE(COO_read)
   if (coo == NULL) {
     fprintf(stderr, "Something went wrong\n");
@@ -79,6 +88,7 @@ int main(int argc, char const *argv[]) {
   if (converting_to_bmtx) {
     printf("Converting MTX file to SBMTX...\n");
     out_filename += ".sbmtx";
+    mtx_meta.sort_order = order;
     Distr_MMIO_sorted_COO_local_write(coo, out_filename.c_str(), true, &mtx_meta);
     printf("BMTX file written to %s\n", out_filename.c_str());
   } else {